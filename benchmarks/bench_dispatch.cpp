@@ -0,0 +1,112 @@
+// Per-step cost of finding the handler for an element: the dynamic_cast chain
+// ProcessExecutor::executeElement used before kind tags, against the
+// ElementKind table it uses now. Handlers only count, so the numbers are the
+// dispatch overhead alone.
+#include <benchmark/benchmark.h>
+#include <bpmn/model.h>
+#include <bpmn/process_graph.h>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+using namespace bpmn;
+
+namespace {
+
+    // Mix close to production definitions: end events and exclusive gateways
+    // dominate, which were the last two entries of the old cast chain
+    std::unique_ptr<Process> makeMixedProcess(std::size_t size) {
+        auto process = std::make_unique<Process>("dispatch", "Dispatch");
+        for (std::size_t i = 0; i < size; ++i) {
+            const std::string id = "e" + std::to_string(i);
+            switch (i % 8) {
+            case 0: process->addElement(std::make_shared<StartEvent>(id, "")); break;
+            case 1: process->addElement(std::make_shared<UserTask>(id, "")); break;
+            case 2: process->addElement(std::make_shared<services::ServiceTask>(id, "")); break;
+            case 3: process->addElement(std::make_shared<ParallelGateway>(id, "")); break;
+            case 4:
+            case 5: process->addElement(std::make_shared<ExclusiveGateway>(id, "")); break;
+            default: process->addElement(std::make_shared<EndEvent>(id, "")); break;
+            }
+        }
+        return process;
+    }
+
+    struct Counters {
+        std::uint64_t visits[static_cast<std::size_t>(ElementKind::Count)] = {};
+    };
+
+    template <ElementKind Kind>
+    void visit(Counters& counters, FlowElement&) {
+        ++counters.visits[static_cast<std::size_t>(Kind)];
+    }
+
+    void castChain(Counters& counters, FlowElement* element) {
+        if (dynamic_cast<StartEvent*>(element)) {
+            visit<ElementKind::StartEvent>(counters, *element);
+        }
+        else if (dynamic_cast<UserTask*>(element)) {
+            visit<ElementKind::UserTask>(counters, *element);
+        }
+        else if (dynamic_cast<services::ServiceTask*>(element)) {
+            visit<ElementKind::ServiceTask>(counters, *element);
+        }
+        else if (dynamic_cast<ParallelGateway*>(element)) {
+            visit<ElementKind::ParallelGateway>(counters, *element);
+        }
+        else if (dynamic_cast<ExclusiveGateway*>(element)) {
+            visit<ElementKind::ExclusiveGateway>(counters, *element);
+        }
+        else if (dynamic_cast<EndEvent*>(element)) {
+            visit<ElementKind::EndEvent>(counters, *element);
+        }
+    }
+
+    using Handler = void (*)(Counters&, FlowElement&);
+    const Handler handlers[static_cast<std::size_t>(ElementKind::Count)] = {
+        nullptr,
+        &visit<ElementKind::StartEvent>,
+        &visit<ElementKind::EndEvent>,
+        &visit<ElementKind::UserTask>,
+        &visit<ElementKind::ServiceTask>,
+        &visit<ElementKind::ParallelGateway>,
+        &visit<ElementKind::ExclusiveGateway>,
+        nullptr,
+        nullptr,
+        nullptr,
+        nullptr,
+    };
+
+} // anonymous namespace
+
+static void BM_DispatchCastChain(benchmark::State& state) {
+    auto process = makeMixedProcess(static_cast<std::size_t>(state.range(0)));
+    const ProcessGraph& graph = process->getGraph();
+    Counters counters;
+
+    for (auto _ : state) {
+        for (ProcessGraph::Index i = 0; i < graph.elementCount(); ++i) {
+            castChain(counters, graph.element(i));
+        }
+        benchmark::ClobberMemory();
+    }
+    benchmark::DoNotOptimize(counters);
+    state.SetItemsProcessed(state.iterations() * static_cast<int64_t>(graph.elementCount()));
+}
+BENCHMARK(BM_DispatchCastChain)->Arg(64)->Arg(4096);
+
+static void BM_DispatchKindTable(benchmark::State& state) {
+    auto process = makeMixedProcess(static_cast<std::size_t>(state.range(0)));
+    const ProcessGraph& graph = process->getGraph();
+    Counters counters;
+
+    for (auto _ : state) {
+        for (ProcessGraph::Index i = 0; i < graph.elementCount(); ++i) {
+            handlers[static_cast<std::size_t>(graph.kind(i))](counters, *graph.element(i));
+        }
+        benchmark::ClobberMemory();
+    }
+    benchmark::DoNotOptimize(counters);
+    state.SetItemsProcessed(state.iterations() * static_cast<int64_t>(graph.elementCount()));
+}
+BENCHMARK(BM_DispatchKindTable)->Arg(64)->Arg(4096);
@@ -0,0 +1,62 @@
+// Process construction and lookups: addSequenceFlow, validate, getOutgoingFlows
+#include "bench_support.h"
+
+using namespace bpmn;
+
+static void BM_AddSequenceFlow(benchmark::State& state, bench::Shape shape) {
+    const bench::Definition definition = bench::generate(shape, static_cast<std::size_t>(state.range(0)));
+
+    std::uint64_t allocations = 0;
+    for (auto _ : state) {
+        state.PauseTiming();
+        auto process = bench::buildElements(definition);
+        state.ResumeTiming();
+
+        const std::uint64_t before = bench::allocationCount();
+        bench::addFlows(definition, *process);
+        allocations += bench::allocationCount() - before;
+
+        state.PauseTiming();
+        process.reset();
+        state.ResumeTiming();
+    }
+    bench::reportPerElement(state, definition.elements.size(), allocations);
+}
+BENCHMARK_CAPTURE(BM_AddSequenceFlow, linear_chain, bench::Shape::LinearChain)->Apply(bench::applySizes);
+BENCHMARK_CAPTURE(BM_AddSequenceFlow, parallel_fan_out, bench::Shape::ParallelFanOut)->Apply(bench::applySizes);
+BENCHMARK_CAPTURE(BM_AddSequenceFlow, gateway_nest, bench::Shape::GatewayNest)->Apply(bench::applySizes);
+
+static void BM_Validate(benchmark::State& state, bench::Shape shape) {
+    const bench::Definition definition = bench::generate(shape, static_cast<std::size_t>(state.range(0)));
+    auto process = bench::buildElements(definition);
+    bench::addFlows(definition, *process);
+
+    const std::uint64_t before = bench::allocationCount();
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(process->validate());
+    }
+    bench::reportPerElement(state, definition.elements.size(), bench::allocationCount() - before);
+}
+BENCHMARK_CAPTURE(BM_Validate, linear_chain, bench::Shape::LinearChain)->Apply(bench::applySizes);
+BENCHMARK_CAPTURE(BM_Validate, parallel_fan_out, bench::Shape::ParallelFanOut)->Apply(bench::applySizes);
+BENCHMARK_CAPTURE(BM_Validate, gateway_nest, bench::Shape::GatewayNest)->Apply(bench::applySizes);
+
+// One lookup per element, the access pattern of a full walk over the definition
+static void BM_GetOutgoingFlows(benchmark::State& state, bench::Shape shape) {
+    const bench::Definition definition = bench::generate(shape, static_cast<std::size_t>(state.range(0)));
+    auto process = bench::buildElements(definition);
+    bench::addFlows(definition, *process);
+
+    const std::uint64_t before = bench::allocationCount();
+    for (auto _ : state) {
+        std::size_t flows = 0;
+        for (const auto& element : definition.elements) {
+            flows += process->getOutgoingFlows(element.id).size();
+        }
+        benchmark::DoNotOptimize(flows);
+    }
+    bench::reportPerElement(state, definition.elements.size(), bench::allocationCount() - before);
+}
+BENCHMARK_CAPTURE(BM_GetOutgoingFlows, linear_chain, bench::Shape::LinearChain)->Apply(bench::applySizes);
+BENCHMARK_CAPTURE(BM_GetOutgoingFlows, parallel_fan_out, bench::Shape::ParallelFanOut)->Apply(bench::applySizes);
+BENCHMARK_CAPTURE(BM_GetOutgoingFlows, gateway_nest, bench::Shape::GatewayNest)->Apply(bench::applySizes);
@@ -0,0 +1,23 @@
+// BpmnParser::parseFromString over generated definitions of every shape and size
+#include "bench_support.h"
+#include <bpmn/parser.h>
+
+using namespace bpmn;
+
+static void BM_ParseFromString(benchmark::State& state, bench::Shape shape) {
+    const bench::Definition definition = bench::generate(shape, static_cast<std::size_t>(state.range(0)));
+    const std::string xml = bench::toXml(definition);
+    BpmnParser parser;
+
+    const std::uint64_t before = bench::allocationCount();
+    for (auto _ : state) {
+        auto process = parser.parseFromString(xml);
+        benchmark::DoNotOptimize(process.get());
+    }
+    // Includes freeing the parsed process, which is part of its lifetime cost
+    bench::reportPerElement(state, definition.elements.size(), bench::allocationCount() - before);
+    state.SetBytesProcessed(state.iterations() * static_cast<int64_t>(xml.size()));
+}
+BENCHMARK_CAPTURE(BM_ParseFromString, linear_chain, bench::Shape::LinearChain)->Apply(bench::applySizes);
+BENCHMARK_CAPTURE(BM_ParseFromString, parallel_fan_out, bench::Shape::ParallelFanOut)->Apply(bench::applySizes);
+BENCHMARK_CAPTURE(BM_ParseFromString, gateway_nest, bench::Shape::GatewayNest)->Apply(bench::applySizes);
@@ -0,0 +1,267 @@
+#include "bench_support.h"
+#include <bpmn/services/abstractService.h>
+#include <libxml/xmlmemory.h>
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <stdexcept>
+
+namespace {
+
+    std::atomic<std::uint64_t> allocations{ 0 };
+
+    void* countedMalloc(std::size_t size) {
+        allocations.fetch_add(1, std::memory_order_relaxed);
+        return std::malloc(size == 0 ? 1 : size);
+    }
+
+    void* xmlCountedMalloc(std::size_t size) {
+        return countedMalloc(size);
+    }
+
+    void* xmlCountedRealloc(void* ptr, std::size_t size) {
+        allocations.fetch_add(1, std::memory_order_relaxed);
+        return std::realloc(ptr, size);
+    }
+
+    char* xmlCountedStrdup(const char* str) {
+        const std::size_t size = std::strlen(str) + 1;
+        auto copy = static_cast<char*>(countedMalloc(size));
+        std::memcpy(copy, str, size);
+        return copy;
+    }
+
+    // libxml2 allocates through its own hooks; they have to be installed
+    // before the first parser is created, i.e. before main()
+    [[maybe_unused]] const int xmlHooksInstalled = xmlMemSetup(std::free, xmlCountedMalloc, xmlCountedRealloc, xmlCountedStrdup);
+
+} // anonymous namespace
+
+void* operator new(std::size_t size) {
+    if (void* ptr = countedMalloc(size)) {
+        return ptr;
+    }
+    throw std::bad_alloc();
+}
+
+void* operator new[](std::size_t size) {
+    return operator new(size);
+}
+
+void operator delete(void* ptr) noexcept {
+    std::free(ptr);
+}
+
+void operator delete[](void* ptr) noexcept {
+    std::free(ptr);
+}
+
+void operator delete(void* ptr, std::size_t) noexcept {
+    std::free(ptr);
+}
+
+void operator delete[](void* ptr, std::size_t) noexcept {
+    std::free(ptr);
+}
+
+namespace bpmn {
+    namespace bench {
+
+        namespace {
+
+            const char* tagOf(ElementKind kind) {
+                switch (kind) {
+                case ElementKind::StartEvent: return "startEvent";
+                case ElementKind::EndEvent: return "endEvent";
+                case ElementKind::UserTask: return "userTask";
+                case ElementKind::ServiceTask: return "serviceTask";
+                case ElementKind::ParallelGateway: return "parallelGateway";
+                case ElementKind::ExclusiveGateway: return "exclusiveGateway";
+                default: throw std::invalid_argument("Element kind cannot be generated");
+                }
+            }
+
+            std::shared_ptr<FlowElement> createElement(const Definition::Element& element) {
+                switch (element.kind) {
+                case ElementKind::StartEvent: return std::make_shared<StartEvent>(element.id, "");
+                case ElementKind::EndEvent: return std::make_shared<EndEvent>(element.id, "");
+                case ElementKind::UserTask: return std::make_shared<UserTask>(element.id, "");
+                case ElementKind::ServiceTask: return std::make_shared<services::ServiceTask>(element.id, "");
+                case ElementKind::ParallelGateway: return std::make_shared<ParallelGateway>(element.id, "");
+                case ElementKind::ExclusiveGateway: {
+                    auto gateway = std::make_shared<ExclusiveGateway>(element.id, "");
+                    gateway->default_flow = element.default_flow;
+                    return gateway;
+                }
+                default: throw std::invalid_argument("Element kind cannot be generated");
+                }
+            }
+
+            class Builder {
+            public:
+                explicit Builder(Definition& definition) : definition_(definition) {}
+
+                std::string add(ElementKind kind, const std::string& prefix) {
+                    std::string id = prefix + std::to_string(definition_.elements.size());
+                    definition_.elements.push_back({ kind, id, std::string() });
+                    return id;
+                }
+
+                std::string connect(const std::string& source, const std::string& target) {
+                    std::string id = "flow" + std::to_string(definition_.flows.size());
+                    definition_.flows.push_back({ id, source, target });
+                    return id;
+                }
+
+                // Alternates user and service tasks
+                std::string task() {
+                    return add(definition_.elements.size() % 2 ? ElementKind::UserTask : ElementKind::ServiceTask, "task");
+                }
+
+                void setDefault(const std::string& gateway, const std::string& flow) {
+                    for (auto it = definition_.elements.rbegin(); it != definition_.elements.rend(); ++it) {
+                        if (it->id == gateway) {
+                            it->default_flow = flow;
+                            return;
+                        }
+                    }
+                }
+
+            private:
+                Definition& definition_;
+            };
+
+            void linearChain(Builder& builder, std::size_t elements) {
+                std::string previous = builder.add(ElementKind::StartEvent, "start");
+                for (std::size_t i = 2; i < elements; ++i) {
+                    std::string task = builder.task();
+                    builder.connect(previous, task);
+                    previous = task;
+                }
+                builder.connect(previous, builder.add(ElementKind::EndEvent, "end"));
+            }
+
+            void parallelFanOut(Builder& builder, std::size_t elements) {
+                const std::string start = builder.add(ElementKind::StartEvent, "start");
+                const std::string fork = builder.add(ElementKind::ParallelGateway, "fork");
+                const std::string join = builder.add(ElementKind::ParallelGateway, "join");
+                builder.connect(start, fork);
+                for (std::size_t i = 4; i < elements; ++i) {
+                    std::string task = builder.task();
+                    builder.connect(fork, task);
+                    builder.connect(task, join);
+                }
+                builder.connect(join, builder.add(ElementKind::EndEvent, "end"));
+            }
+
+            // Each level is split -> (next level | task) -> merge
+            void gatewayNest(Builder& builder, std::size_t elements) {
+                const std::size_t levels = elements > 5 ? (elements - 3) / 3 : 1;
+                std::vector<std::string> merges;
+                merges.reserve(levels);
+
+                std::string previous = builder.add(ElementKind::StartEvent, "start");
+                for (std::size_t level = 0; level < levels; ++level) {
+                    const std::string split = builder.add(ElementKind::ExclusiveGateway, "split");
+                    const std::string task = builder.task();
+                    const std::string merge = builder.add(ElementKind::ExclusiveGateway, "merge");
+                    builder.connect(previous, split);
+                    builder.setDefault(split, builder.connect(split, task));
+                    builder.connect(task, merge);
+                    merges.push_back(merge);
+                    previous = split;
+                }
+
+                const std::string innermost = builder.task();
+                builder.connect(previous, innermost);
+                previous = innermost;
+                for (auto it = merges.rbegin(); it != merges.rend(); ++it) {
+                    builder.connect(previous, *it);
+                    previous = *it;
+                }
+                builder.connect(previous, builder.add(ElementKind::EndEvent, "end"));
+            }
+
+        } // anonymous namespace
+
+        void applySizes(benchmark::internal::Benchmark* benchmark) {
+            for (int64_t size = 10; size <= 1000000; size *= 10) {
+                benchmark->Arg(size);
+            }
+            benchmark->Unit(benchmark::kMicrosecond);
+        }
+
+        Definition generate(Shape shape, std::size_t elements) {
+            Definition definition;
+            definition.id = "bench";
+            definition.elements.reserve(elements + 2);
+            definition.flows.reserve(2 * elements);
+
+            Builder builder(definition);
+            switch (shape) {
+            case Shape::LinearChain: linearChain(builder, elements); break;
+            case Shape::ParallelFanOut: parallelFanOut(builder, elements); break;
+            case Shape::GatewayNest: gatewayNest(builder, elements); break;
+            }
+            return definition;
+        }
+
+        std::string toXml(const Definition& definition) {
+            std::string xml;
+            xml.reserve(96 * (definition.elements.size() + definition.flows.size()) + 256);
+            xml += "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+                "<bpmn:definitions xmlns:bpmn=\"http://www.omg.org/spec/BPMN/20100524/MODEL\" id=\"defs\">\n"
+                "<bpmn:process id=\"" + definition.id + "\" isExecutable=\"true\">\n";
+
+            for (const auto& element : definition.elements) {
+                xml += "<bpmn:";
+                xml += tagOf(element.kind);
+                xml += " id=\"" + element.id + "\"";
+                if (!element.default_flow.empty()) {
+                    xml += " default=\"" + element.default_flow + "\"";
+                }
+                xml += "/>\n";
+            }
+            for (const auto& flow : definition.flows) {
+                xml += "<bpmn:sequenceFlow id=\"" + flow.id + "\" sourceRef=\"" + flow.source +
+                    "\" targetRef=\"" + flow.target + "\"/>\n";
+            }
+
+            xml += "</bpmn:process>\n</bpmn:definitions>\n";
+            return xml;
+        }
+
+        std::unique_ptr<Process> buildElements(const Definition& definition) {
+            auto process = std::make_unique<Process>(definition.id, definition.id);
+            for (const auto& element : definition.elements) {
+                process->addElement(createElement(element));
+            }
+            if (!definition.elements.empty()) {
+                process->setStartEventId(definition.elements.front().id);
+            }
+            return process;
+        }
+
+        void addFlows(const Definition& definition, Process& process) {
+            for (const auto& flow : definition.flows) {
+                process.addSequenceFlow(flow.id, "", flow.source, flow.target);
+            }
+        }
+
+        std::uint64_t allocationCount() {
+            return allocations.load(std::memory_order_relaxed);
+        }
+
+        void reportPerElement(benchmark::State& state, std::size_t elements, std::uint64_t allocationsTotal) {
+            const double processed = static_cast<double>(state.iterations()) * static_cast<double>(elements);
+            state.SetItemsProcessed(static_cast<int64_t>(processed));
+            state.counters["elements"] = static_cast<double>(elements);
+            // Seconds per element, shown with the benchmark's time unit prefix
+            state.counters["time/elem"] = benchmark::Counter(static_cast<double>(elements),
+                benchmark::Counter::kIsIterationInvariantRate | benchmark::Counter::kInvert);
+            state.counters["allocs/elem"] = processed > 0 ? static_cast<double>(allocationsTotal) / processed : 0.0;
+        }
+
+    } // namespace bench
+} // namespace bpmn
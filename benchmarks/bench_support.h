@@ -0,0 +1,62 @@
+#ifndef BPMN_BENCH_SUPPORT_H
+#define BPMN_BENCH_SUPPORT_H
+
+#include <benchmark/benchmark.h>
+#include <bpmn/model.h>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace bpmn {
+    namespace bench {
+
+        // Shapes of generated definitions
+        enum class Shape {
+            // start -> task -> ... -> task -> end
+            LinearChain,
+            // start -> fork -> N tasks -> join -> end
+            ParallelFanOut,
+            // exclusive gateways nested inside each other's first branch
+            GatewayNest
+        };
+
+        // Element count of every generated size, 10 .. 1M
+        void applySizes(benchmark::internal::Benchmark* benchmark);
+
+        // Synthetic definition in element/flow form, independent of the model
+        struct Definition {
+            struct Element {
+                ElementKind kind;
+                std::string id;
+                std::string default_flow;
+            };
+            struct Flow {
+                std::string id;
+                std::string source;
+                std::string target;
+            };
+
+            std::string id;
+            std::vector<Element> elements;
+            std::vector<Flow> flows;
+        };
+
+        // Builds a definition with roughly `elements` flow nodes of the given shape
+        Definition generate(Shape shape, std::size_t elements);
+
+        std::string toXml(const Definition& definition);
+        // Process holding every element but no sequence flows yet
+        std::unique_ptr<Process> buildElements(const Definition& definition);
+        void addFlows(const Definition& definition, Process& process);
+
+        // Number of operator new and libxml2 allocations since program start
+        std::uint64_t allocationCount();
+
+        // Reports time and allocations per element as benchmark counters
+        void reportPerElement(benchmark::State& state, std::size_t elements, std::uint64_t allocations);
+
+    } // namespace bench
+} // namespace bpmn
+
+#endif // BPMN_BENCH_SUPPORT_H
@@ -0,0 +1,34 @@
+#ifndef BPMN_COMPILED_PROCESS_H
+#define BPMN_COMPILED_PROCESS_H
+
+#include "bpmn/model.h"
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+
+namespace bpmn {
+
+    // Binary precompiled form of a Process (flatbuffers, schema/process.fbs).
+    // The buffer holds elements, sequence flows, CSR outgoing/incoming adjacency
+    // and gateway defaults. Loading verifies the buffer and rebuilds a Process
+    // from it without XML parsing; the flatbuffers accessors read the buffer in
+    // place, but the elements and flows are copied into the new Process.
+    class CompiledProcess {
+    public:
+        // Serializes a parsed process; flows whose endpoints are missing are rejected
+        static std::string compile(const Process& process);
+
+        // Verifies the buffer and rebuilds the Process it describes
+        static std::unique_ptr<Process> load(const void* data, std::size_t size);
+        static std::unique_ptr<Process> load(const std::string& buffer);
+
+        // Cheap check of the file identifier, does not verify the whole buffer
+        static bool isCompiledProcess(const void* data, std::size_t size);
+
+        static constexpr std::uint16_t kFormatVersion = 1;
+    };
+
+} // namespace bpmn
+
+#endif // BPMN_COMPILED_PROCESS_H
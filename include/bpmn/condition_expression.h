@@ -0,0 +1,79 @@
+#ifndef BPMN_CONDITION_EXPRESSION_H
+#define BPMN_CONDITION_EXPRESSION_H
+
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace bpmn {
+
+    class Variables;
+
+    // Sequence flow condition compiled to stack bytecode. The language is the
+    // JUEL subset used in BPMN files, optionally wrapped in ${...}:
+    //   literals     123, 1.5, 'text', "text", true, false, null
+    //   variables    amount, order.status (the whole dotted name is one key)
+    //   operators    ! not - * / % div mod + - < <= > >= lt le gt ge
+    //                == != eq ne && and || or, parentheses
+    // String values are converted to numbers or booleans when compared with
+    // one, typed values compare as they are and nested objects as null.
+    // Evaluation does not allocate.
+    class ConditionExpression {
+    public:
+        // Throws std::invalid_argument on syntax errors
+        static std::shared_ptr<const ConditionExpression> compile(const std::string& source);
+
+        bool evaluate(const std::map<std::string, std::string>& variables) const;
+        bool evaluate(const Variables& variables) const;
+
+        const std::string& source() const { return source_; }
+        // Variable names by slot, each looked up at most once per evaluation
+        const std::vector<std::string>& variables() const { return slots_; }
+
+        static constexpr std::size_t kMaxStack = 64;
+        static constexpr std::size_t kMaxSlots = 32;
+
+    private:
+        class Compiler;
+
+        enum class Op : std::uint8_t {
+            PushConst, PushVar,
+            Not, Negate,
+            Add, Subtract, Multiply, Divide, Modulo,
+            Equal, NotEqual, Less, LessEqual, Greater, GreaterEqual,
+            // Short-circuit: leave the operand as the result and jump, or pop it
+            JumpIfFalse, JumpIfTrue
+        };
+
+        struct Instruction {
+            Op op;
+            std::uint16_t operand;
+        };
+
+        struct Constant {
+            enum class Type : std::uint8_t { Null, Bool, Number, String } type;
+            bool boolean;
+            double number;
+            // Index into strings_
+            std::uint32_t string;
+        };
+
+        explicit ConditionExpression(const std::string& source) : source_(source) {}
+
+        // lookup(name, value) fills value for a variable or leaves it null
+        template <typename Lookup>
+        bool run(Lookup&& lookup) const;
+
+        std::string source_;
+        std::vector<Instruction> code_;
+        std::vector<Constant> constants_;
+        std::vector<std::string> strings_;
+        std::vector<std::string> slots_;
+    };
+
+} // namespace bpmn
+
+#endif // BPMN_CONDITION_EXPRESSION_H
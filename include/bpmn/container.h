@@ -1,3 +1,6 @@
+#ifndef BPMN_CONTAINER_H
+#define BPMN_CONTAINER_H
+
 #include <unordered_map>
 #include <variant>
 #include <vector>
@@ -91,7 +94,43 @@ namespace bpmn {
             return getField<Array>(name);
         }
 
+        // All fields, e.g. for serialization
+        const std::unordered_map<std::string, Value>& fields() const {
+            return fields_;
+        }
+
+        // Deep copy, nested containers included
+        Container clone() const {
+            Container copy;
+            for (const auto& [name, value] : fields_) {
+                copy.fields_.emplace(name, cloneValue(value));
+            }
+            return copy;
+        }
+
+        static Value cloneValue(const Value& value) {
+            if (const Ptr* nested = std::get_if<Ptr>(&value)) {
+                return *nested ? std::make_unique<Container>((*nested)->clone()) : Ptr();
+            }
+            if (const Array* array = std::get_if<Array>(&value)) {
+                Array copy;
+                copy.reserve(array->size());
+                for (const auto& element : *array) {
+                    copy.push_back(element ? std::make_unique<Container>(element->clone()) : Ptr());
+                }
+                return copy;
+            }
+            switch (value.index()) {
+            case 0: return std::get<int>(value);
+            case 1: return std::get<double>(value);
+            case 2: return std::get<bool>(value);
+            default: return std::get<std::string>(value);
+            }
+        }
+
     private:
         std::unordered_map<std::string, Value> fields_;
     };
-}
\ No newline at end of file
+} // namespace bpmn
+
+#endif // BPMN_CONTAINER_H
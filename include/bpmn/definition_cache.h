@@ -0,0 +1,80 @@
+#ifndef BPMN_DEFINITION_CACHE_H
+#define BPMN_DEFINITION_CACHE_H
+
+#include "bpmn/model.h"
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <future>
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+
+namespace bpmn {
+
+    // Thread-safe LRU cache of parsed and validated process definitions.
+    // Entries are keyed by (process_id, version) and shared immutably between
+    // all instances started from them. Concurrent misses on the same key wait
+    // for a single load instead of parsing the definition several times.
+    class ProcessDefinitionCache {
+    public:
+        using Loader = std::function<std::shared_ptr<const Process>()>;
+
+        struct Stats {
+            std::uint64_t hits = 0;
+            std::uint64_t misses = 0;
+            std::uint64_t evictions = 0;
+            std::size_t size = 0;
+        };
+
+        explicit ProcessDefinitionCache(std::size_t capacity = 256);
+
+        ProcessDefinitionCache(const ProcessDefinitionCache&) = delete;
+        ProcessDefinitionCache& operator=(const ProcessDefinitionCache&) = delete;
+
+        // Returns the cached definition or calls loader once to fill the entry.
+        // Loader exceptions are propagated to every waiting caller and nothing is cached.
+        std::shared_ptr<const Process> getOrLoad(const std::string& process_id, int version, const Loader& loader);
+
+        // Returns the cached definition or nullptr, does not count as a miss
+        std::shared_ptr<const Process> find(const std::string& process_id, int version) const;
+
+        void put(const std::string& process_id, int version, std::shared_ptr<const Process> process);
+        void invalidate(const std::string& process_id);
+        void clear();
+
+        Stats stats() const;
+        std::size_t capacity() const { return capacity_; }
+
+    private:
+        using Key = std::pair<std::string, int>;
+        using Future = std::shared_future<std::shared_ptr<const Process>>;
+
+        struct Entry {
+            Future definition;
+            std::list<Key>::iterator lru;
+            // Identifies the load that created the entry
+            std::uint64_t ticket;
+        };
+
+        void touch(const Entry& entry) const;
+        void insert(const Key& key, Future definition, std::uint64_t ticket);
+
+        const std::size_t capacity_;
+        mutable std::mutex mutex_;
+        std::map<Key, Entry> entries_;
+        // Most recently used key at the front
+        mutable std::list<Key> lru_;
+        std::uint64_t nextTicket_ = 0;
+
+        std::atomic<std::uint64_t> hits_{ 0 };
+        std::atomic<std::uint64_t> misses_{ 0 };
+        std::atomic<std::uint64_t> evictions_{ 0 };
+    };
+
+} // namespace bpmn
+
+#endif // BPMN_DEFINITION_CACHE_H
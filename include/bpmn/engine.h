@@ -6,22 +6,62 @@
 #include "parser.h"
 #include "process.h"
 #include "executor.h"
+#include "in_memory_state_store.h"
+#include "wal_state_store.h"
+#include "metrics.h"
 
 namespace bpmn {
 
+    // Outcome of deploying one file in a bulk deployment
+    struct DeploymentResult {
+        std::string source;
+        std::string process_id;
+        int version = 0;
+        bool deployed = false;
+        std::string error;
+    };
+
     class BpmnEngine {
     public:
         //     
-        static std::unique_ptr<BpmnEngine> create(const db::DatabaseConfig& config);
-        static std::unique_ptr<BpmnEngine> createFromConfig(const std::string& configPath);
-        static std::unique_ptr<BpmnEngine> createFromEnvironment();
+        // workerThreads sizes the pool running parallel branches, 0 = one per core
+        static std::unique_ptr<BpmnEngine> create(const db::DatabaseConfig& config, std::size_t workerThreads = 0);
+        static std::unique_ptr<BpmnEngine> createFromConfig(const std::string& configPath, std::size_t workerThreads = 0);
+        static std::unique_ptr<BpmnEngine> createFromEnvironment(std::size_t workerThreads = 0);
+        // No PostgreSQL at all: instance state lives in an InMemoryStateStore and
+        // deployed definitions are kept in memory, nothing survives the engine
+        static std::unique_ptr<BpmnEngine> createInMemory(std::size_t workerThreads = 0);
+        // No PostgreSQL, but durable: instance state, timers and message
+        // subscriptions go to a WalStateStore in directory. Definitions are
+        // kept in memory and must be deployed again after a restart; the
+        // timers of a definition are restored when it is deployed.
+        static std::unique_ptr<BpmnEngine> createEmbedded(const std::string& directory, std::size_t workerThreads = 0);
 
         //  API 
         std::string startProcess(const std::string& processDefinition, const std::string& initData = "{}");
         std::string startProcessFromFile(const std::string& filePath, const std::string& initData = "{}");
+        // Starts one instance of a deployed definition per initData entry; see
+        // ProcessExecutor::startProcesses
+        std::vector<StartResult> startProcesses(const std::string& processId, const std::vector<std::string>& initData);
+
+        // Parses, validates and stores a definition with its precompiled form, returns its version
+        int deployProcess(const std::string& processDefinition);
+        // Parses and compiles files concurrently on `workers` threads (0 = one per core),
+        // then stores every valid definition in a single transaction
+        std::vector<DeploymentResult> deployProcessFiles(const std::vector<std::string>& filePaths, std::size_t workers = 0);
+
+        // Instances of processId keep their state in memory instead of the
+        // engine's store; for short-lived flows that never need durability
+        void useInMemoryStore(const std::string& processId);
 
         void completeTask(const std::string& instanceId, const std::string& taskId, const std::string& data = "{}");
+        // Delivers message eventId to the instance's token waiting for it
         void signalEvent(const std::string& instanceId, const std::string& eventId, const std::string& data = "{}");
+        // Delivers a message to the one token waiting for (messageName, correlationKey);
+        // returns its instance id, or an empty string if nobody waits for it
+        std::string correlateMessage(const std::string& messageName, const std::string& correlationKey, const std::string& data = "{}");
+        // Resumes every token waiting for the signal, returns how many
+        std::size_t broadcastSignal(const std::string& signalName, const std::string& data = "{}");
 
         std::string getProcessState(const std::string& instanceId) const;
         std::string getActiveTasks(const std::string& instanceId) const;
@@ -34,26 +74,59 @@ namespace bpmn {
         std::vector<std::string> getActiveInstances() const;
         bool isProcessActive(const std::string& instanceId) const;
 
+        // Queue depth and steal counters of the parallel branch pool
+        WorkStealingPool::Stats getWorkerPoolStats() const;
+
+        // Element, database and checkpoint latencies, instance counters and
+        // active tokens of this engine in the Prometheus text format
+        std::string getMetricsPrometheus() const;
+        // The same metrics as a JSON document, durations in nanoseconds
+        std::string getMetricsJson() const;
+
         // 
-        virtual ~BpmnEngine() = default;
+        // Stops timers before the worker pool they submit to goes away
+        virtual ~BpmnEngine();
 
     private:
-        BpmnEngine(const db::DatabaseConfig& config);
+        BpmnEngine(const db::DatabaseConfig& config, std::size_t workerThreads);
+        // In-memory engine, see createInMemory
+        explicit BpmnEngine(std::size_t workerThreads);
+        // Embedded engine, see createEmbedded
+        BpmnEngine(std::unique_ptr<WalStateStore> walStore, std::size_t workerThreads);
+
+        // Registers a definition with the executor when there is no database
+        int deployInMemory(std::shared_ptr<const Process> process);
+        InMemoryStateStore& memoryStore();
 
         //  
         void initializeDatabase();
         void validateProcessDefinition(const std::string& processDefinition) const;
         std::string generateInstanceId() const;
+        // Throws unless the instance is cached here or stored by the executor,
+        // e.g. started by startProcesses or before a restart
+        void requireInstance(const std::string& instanceId) const;
 
         //  
         db::DatabaseConfig config_;
         std::unique_ptr<BpmnParser> parser_;
+        // Declared before the executor and database that record into it
+        Metrics metrics_;
+        // Created on first use; declared before the executor that refers to it
+        std::unique_ptr<InMemoryStateStore> memoryStore_;
+        // Store of an embedded engine, declared before the executor for the same reason
+        std::unique_ptr<WalStateStore> walStore_;
+        // Versions of in-memory deployments
+        std::unordered_map<std::string, int> memoryVersions_;
         std::unique_ptr<ProcessExecutor> executor_;
         std::unique_ptr<db::Database> database_;
         std::unordered_map<std::string, std::shared_ptr<Process>> processCache_;
 
         //  
         mutable std::mutex engineMutex_;
+
+        // Declared last so that queued branches finish before the executor
+        // and database they use are destroyed
+        std::unique_ptr<WorkStealingPool> workerPool_;
     };
 
 } // namespace bpmn
\ No newline at end of file
@@ -1,17 +1,36 @@
 #pragma once
 
+#include "bpmn/variables.h"
+#include <cstdint>
 #include <string>
 #include <map>
 #include <vector>
 #include <future>
+#include <memory>
 
 namespace bpmn {
     class ProcessExecutor; // Forward declaration
+    class Process;
+    class JoinCounters;
+    class StartBatch;
+    class StateStore;
 
     struct ExecutionState {
         std::string process_id;
+        // Immutable definition the instance runs on, shared with the definition cache
+        std::shared_ptr<const Process> definition;
         std::string current_element;
-        std::map<std::string, std::string> variables;
+        // Index of current_element in definition->getGraph(); the executor
+        // navigates by index and refreshes current_element when saving
+        std::uint32_t current_index = UINT32_MAX;
+        Variables variables;
+        // Parallel join arrivals, shared by every token of the instance
+        std::shared_ptr<JoinCounters> joins;
+        // Set for instances started by startProcesses: checkpoints are buffered
+        // there until the batch is written, shared by every token of the instance
+        std::shared_ptr<StartBatch> batch;
+        // Store holding the instance, chosen by process id when it starts
+        StateStore* store = nullptr;
         std::vector<std::future<void>> parallel_tasks;
         bool isPaused = false;
         bool isCompleted = false;
@@ -4,70 +4,306 @@
 #include "bpmn/model.h"
 #include "./db/orm.h"
 #include "./bpmn/parser.h"
+#include "./bpmn/definition_cache.h"
+#include "./bpmn/compiled_process.h"
+#include "./bpmn/work_stealing_pool.h"
+#include "./bpmn/join_counters.h"
+#include "./bpmn/timer_service.h"
+#include "./bpmn/message_subscriptions.h"
+#include "./bpmn/state_store.h"
+#include "./bpmn/logger.h"
+#include "./bpmn/metrics.h"
+#include "./bpmn/instance_id.h"
 #include "./bpmn/services/abstractService.h"
 #include <string>
 #include <map>
 #include <vector>
+#include <array>
+#include <atomic>
 #include <future>
 #include <memory>
-#include <random>
-#include <boost/uuid/uuid.hpp>
-#include <boost/uuid/uuid_generators.hpp>
-#include <boost/uuid/uuid_io.hpp>
+#include <mutex>
+#include <unordered_map>
 
 namespace bpmn {
 
+    // When instance state is written to the database. Wait states, the end of
+    // a process and errors are always checkpointed; automated steps between
+    // them run in memory and are replayed from the last checkpoint after a crash.
+    struct CheckpointPolicy {
+        // Before a token leaves its thread: service calls and parallel forks
+        bool atAsyncBoundaries = true;
+        // Additionally every N executed elements, 0 = never
+        std::size_t everySteps = 0;
+    };
+
+    // Outcome of one instance started by startProcesses
+    struct StartResult {
+        enum class Status {
+            Waiting,    // paused at a user task or a timer
+            Running,    // continues asynchronously or used up the step budget
+            Completed,
+            Failed
+        };
+
+        std::string instance_id;
+        Status status = Status::Running;
+        // User task for Waiting, next element for instances out of step budget
+        std::string current_element;
+        std::string error;
+    };
+
     class ProcessExecutor {
     public:
         // Reuse the ExecutionState from forward header
         // using ExecutionState = bpmn::ExecutionState;
 
-        explicit ProcessExecutor(db::Database& db);
+        // Runs parallel branches on a pool of its own with one worker per core
+        explicit ProcessExecutor(db::Database& db, std::size_t definition_cache_capacity = 256);
+        // Runs parallel branches on pool, which must outlive the executor
+        ProcessExecutor(db::Database& db, WorkStealingPool& pool, std::size_t definition_cache_capacity = 256);
+        // Without a database: instance state lives in store, which must outlive
+        // the executor, and definitions are registered with addProcessDefinition
+        explicit ProcessExecutor(StateStore& store, std::size_t definition_cache_capacity = 256);
+        ProcessExecutor(StateStore& store, WorkStealingPool& pool, std::size_t definition_cache_capacity = 256);
+        ~ProcessExecutor();
 
-        // Starts a new process instance
+        // Starts a new process instance on a copy of process, which the caller
+        // may free at once; the copy shares its elements
         std::string startProcess(const Process& process, const std::string& init_data, std::function<bool(const std::string&)> user_task_callback);
+        // Starts a new process instance sharing an immutable definition
+        std::string startProcess(std::shared_ptr<const Process> process, const std::string& init_data, std::function<bool(const std::string&)> user_task_callback);
         // Starts a new process by Id
         std::string startProcessById(const std::string& process_id, const std::string& init_data, std::function<bool(const std::string&)> user_task_callback);
 
+        // Starts one instance per init_data entry on a shared definition. IDs are
+        // generated up front, the initial automated segments run in parallel on
+        // the pool and their checkpoints are written together once all segments
+        // are done. Results are in input order; a failing instance does not stop
+        // the others.
+        std::vector<StartResult> startProcesses(std::shared_ptr<const Process> process, const std::vector<std::string>& init_data);
+        std::vector<StartResult> startProcessesById(const std::string& process_id, const std::vector<std::string>& init_data);
+
         // Resumes a process paused at a user task
         std::string resumeProcess(const std::string& instance_id, const std::string& user_task_result, std::function<bool(const std::string&)> user_task_callback);
+        // Continues an instance that used up its step budget
+        std::string continueProcess(const std::string& instance_id, std::function<bool(const std::string&)> user_task_callback);
         
         // Get output form by Id
         nlohmann::json getFormById(const std::string formId) const;
         const ExecutionState& getExecutionState(const std::string & instanceId) const;
-        void completeTask(const std::string& instance_id, const std::string& user_task, const std::string& user_task_callback);
+        // Stored position and variables of an instance, variables as JSON
+        nlohmann::json getProcessState(const std::string& instance_id);
+        // Whether any store holds the instance as running
+        bool hasProcessInstance(const std::string& instance_id) const;
+        // Completes user_task and runs the instance on the calling thread; false
+        // if the token no longer waits there, e.g. a boundary timer fired first
+        bool completeTask(const std::string& instance_id, const std::string& user_task, const std::string& user_task_result);
+
+        // Process definition cache counters
+        ProcessDefinitionCache::Stats getDefinitionCacheStats() const;
+        // Queue depth and steal counters of the branch pool
+        WorkStealingPool::Stats getWorkerPoolStats() const;
+        // Service calls started and not yet called back
+        std::size_t getInFlightServiceCalls() const { return inFlightServiceCalls_.load(); }
+
+        // Maximum number of elements one start/resume/continue call executes
+        // before it returns and leaves the instance runnable; 0 means no limit
+        void setStepBudget(std::size_t steps) { stepBudget_ = steps; }
+        std::size_t getStepBudget() const { return stepBudget_; }
+
+        void setCheckpointPolicy(const CheckpointPolicy& policy) { checkpointPolicy_ = policy; }
+        const CheckpointPolicy& getCheckpointPolicy() const { return checkpointPolicy_; }
+
+        // Defaults to Logger::global(); logger must outlive the executor
+        void setLogger(Logger& logger) { logger_ = &logger; }
+        Logger& getLogger() const { return *logger_; }
+
+        // Defaults to Metrics::global(); metrics must outlive the executor
+        void setMetrics(Metrics& metrics);
+        Metrics& getMetrics() const { return *metrics_; }
+
+        // Applied when parallel branches wrote different values to a variable
+        void setVariableMergePolicy(VariableMergePolicy policy) { variableMergePolicy_ = policy; }
+        VariableMergePolicy getVariableMergePolicy() const { return variableMergePolicy_; }
+
+        // Replaces InstanceIdGenerator::global() for new instance ids, e.g. to
+        // route them to a shard. Ids must stay UUIDs, the database stores them
+        // as uuid. Called on the thread that starts the instance.
+        void setInstanceIdGenerator(std::function<std::string()> generator) { instanceIdGenerator_ = std::move(generator); }
+
+        // Replaces the store of every definition without a store of its own.
+        // Stores must outlive the executor; set them before starting instances.
+        void setStateStore(StateStore& store);
+        // Instances of process_id keep their state in store, e.g. in memory for
+        // flows that need no durability
+        void setStateStore(const std::string& process_id, StateStore& store);
+
+        // Makes a definition available to startProcessById and to resumed
+        // instances; registered definitions take precedence over deployed ones
+        void addProcessDefinition(std::shared_ptr<const Process> process);
+        // Forgets the latest deployed version of a definition; call after
+        // deploying a new one, the next start asks the database once
+        void invalidateProcessDefinition(const std::string& process_id);
+
+        // Arms the timer start events of the latest deployed version of a definition
+        void scheduleStartTimers(const std::string& process_id);
+        // Schedules the persisted timers, e.g. after a restart; returns how many.
+        // owns selects the timers of this executor when several share a database.
+        std::size_t loadTimers(const std::function<bool(const TimerService::Timer&)>& owns = nullptr);
+        // No timer fires afterwards; pending timers stay in the database
+        void stopTimers();
+        std::size_t getPendingTimers() const;
+
+        // Delivers a message to one token waiting for (message_name, correlation_key)
+        // and runs the instance on the calling thread. Returns the instance id, or
+        // an empty string if no token waits for the message.
+        std::string correlateMessage(const std::string& message_name, const std::string& correlation_key,
+            const std::string& data, std::function<bool(const std::string&)> user_task_callback);
+        // Delivers a message to the token of instance_id waiting for it; false if there is none
+        bool deliverMessage(const std::string& instance_id, const std::string& message_name,
+            const std::string& data, std::function<bool(const std::string&)> user_task_callback);
+        // Resumes every token waiting for the signal on the pool; returns how many
+        std::size_t broadcastSignal(const std::string& signal_name, const std::string& data);
+        // Indexes the persisted subscriptions, e.g. after a restart; returns how many
+        std::size_t loadMessageSubscriptions();
+        std::size_t getWaitingMessages() const { return messages_.size(); }
 
     private:
-        std::random_device random_device_;
-        std::mt19937 random_engine_;
-        boost::uuids::random_generator uuid_generator_;
+        std::function<std::string()> instanceIdGenerator_;
         std::unique_ptr<ExecutionState> lastState_;
-        db::Database& db_;
-
-        // Element type handlers
-        void executeElement(const std::string& instance_id, const std::string& element_id, ExecutionState& state);
-        void handleStartEvent(const std::string& instance_id, const StartEvent& start_event, ExecutionState& state);
-        void handleUserTask(const std::string& instance_id, const UserTask& user_task, ExecutionState& state);
-        void handleServiceTask(const std::string& instance_id, const services::ServiceTask& service_task, ExecutionState& state);
-        void handleParallelGateway(const std::string& instance_id, const ParallelGateway& gateway, ExecutionState& state);
-        void handleExclusiveGateway(const std::string& instance_id, const ExclusiveGateway& gateway, ExecutionState& state);
-        void handleEndEvent(const std::string& instance_id, const EndEvent& end_event, ExecutionState& state);
-        void handleGatewayCompletion(const std::string& instance_id, const std::string& gateway_id, ExecutionState& state);
+        // Deployed definitions and forms; null when running on a store alone
+        db::Database* db_;
+        std::unique_ptr<StateStore> ownStore_;
+        StateStore* store_;
+        // Per-definition stores, and every such store once for lookups by instance id
+        std::unordered_map<std::string, StateStore*> processStores_;
+        std::vector<StateStore*> extraStores_;
+        std::mutex definitionsMutex_;
+        std::unordered_map<std::string, std::shared_ptr<const Process>> definitions_;
+        // Latest deployed version per definition, read from the database once
+        std::unordered_map<std::string, int> latestVersions_;
+        ProcessDefinitionCache definitionCache_;
+        std::size_t stepBudget_ = 0;
+        CheckpointPolicy checkpointPolicy_;
+        VariableMergePolicy variableMergePolicy_ = VariableMergePolicy::LastArrivalWins;
+        Logger* logger_ = &Logger::global();
+        Metrics* metrics_ = &Metrics::global();
+        // Element histograms of one definition in metrics_, indexed by
+        // ProcessGraph::Index; a slot is filled when its element first runs
+        struct ElementTimers {
+            std::weak_ptr<const Process> definition;
+            Metrics* metrics = nullptr;
+            std::unique_ptr<std::atomic<LatencyHistogram*>[]> histograms;
+        };
+        // Keyed by definition; an expired entry is a recycled address
+        std::mutex elementTimersMutex_;
+        std::unordered_map<const Process*, std::shared_ptr<ElementTimers>> elementTimers_;
+        std::atomic<std::size_t> inFlightServiceCalls_{ 0 };
+        std::mutex lastStateMutex_;
+        // Join counters of running instances, looked up when a token forks or
+        // first reaches a join; arrivals themselves only touch the counters
+        std::mutex joinsMutex_;
+        std::unordered_map<std::string, std::shared_ptr<JoinCounters>> joins_;
+        // Striped by instance id; held from loading a waiting token until it
+        // is checkpointed again, so only one of a racing user task completion,
+        // timer or message moves it and the others see where it went
+        std::array<std::mutex, 64> instanceLocks_;
+        // Started with the first timer; due timers are handed to the pool
+        std::unique_ptr<TimerService> timers_;
+        // Tokens waiting in message and signal catch events
+        MessageSubscriptions messages_;
+        // Declared last: destroyed first, so queued branches finish while the
+        // rest of the executor is still alive
+        std::unique_ptr<WorkStealingPool> ownPool_;
+        WorkStealingPool* pool_;
+
+        // What a handler did with the token
+        enum class Step {
+            Advance,    // moved to state.current_index, keep running
+            Wait,       // parked and checkpointed in a wait state until resumed from outside
+            Stop,       // consumed: process ended or the token was handed to branch tasks
+            Suspend     // moved out of state into an asynchronous call, resumed on the pool
+        };
+
+        // Why the run loop returned
+        enum class RunResult {
+            Waiting,
+            Stopped,
+            Yielded,    // step budget used up, the current element has not run yet
+            Suspended   // waiting for a service call; the caller's state was moved out
+        };
+
+        // Element type handlers, dispatched by ElementKind through elementHandlers_
+        using ElementHandler = Step (ProcessExecutor::*)(const std::string&, FlowElement&, ExecutionState&);
+        static const ElementHandler elementHandlers_[static_cast<std::size_t>(ElementKind::Count)];
+
+        template <class Element, Step (ProcessExecutor::*Handle)(const std::string&, const Element&, ExecutionState&)>
+        Step dispatch(const std::string& instance_id, FlowElement& element, ExecutionState& state) {
+            // The table guarantees that the kind matches Element
+            return (this->*Handle)(instance_id, static_cast<const Element&>(element), state);
+        }
+
+        // Trampoline: executes elements one at a time until the token waits,
+        // stops or runs out of budget. Handlers never call back into it, so
+        // stack use does not depend on the length of the path.
+        RunResult run(const std::string& instance_id, ExecutionState& state, std::size_t budget);
+        // Leaves the user task the loaded token waits in; the caller holds lockInstance
+        RunResult resumeUserTask(const std::string& instance_id, ExecutionState& state, const std::string& user_task_result);
+        // Common tail of start/resume/continue
+        std::string finishRun(const std::string& instance_id, RunResult result, ExecutionState& state, const std::function<bool(const std::string&)>& user_task_callback);
+        // Initial segment of one startProcesses instance
+        void startBatchedInstance(const std::shared_ptr<const Process>& process, const std::string& init_data,
+            const std::shared_ptr<StartBatch>& batch, StartResult& result);
+        Step executeElement(const std::string& instance_id, ProcessGraph::Index element, ExecutionState& state, ElementTimers& timers);
+        // Histogram slots of a definition, looked up once per run
+        std::shared_ptr<ElementTimers> elementTimersFor(const std::shared_ptr<const Process>& definition);
+        Step handleStartEvent(const std::string& instance_id, const StartEvent& start_event, ExecutionState& state);
+        Step handleUserTask(const std::string& instance_id, const UserTask& user_task, ExecutionState& state);
+        Step handleServiceTask(const std::string& instance_id, const services::ServiceTask& service_task, ExecutionState& state);
+        // Completion of an asynchronous service call, runs on the pool
+        void resumeServiceTask(const std::string& instance_id, const services::ServiceTask& service_task, ExecutionState& state, const json& result);
+        Step handleParallelGateway(const std::string& instance_id, const ParallelGateway& gateway, ExecutionState& state);
+        Step handleExclusiveGateway(const std::string& instance_id, const ExclusiveGateway& gateway, ExecutionState& state);
+        Step handleEndEvent(const std::string& instance_id, const EndEvent& end_event, ExecutionState& state);
+        Step handleTimerCatchEvent(const std::string& instance_id, const TimerCatchEvent& timer_event, ExecutionState& state);
+        Step handleBoundaryEvent(const std::string& instance_id, const BoundaryEvent& boundary_event, ExecutionState& state);
+        Step handleMessageCatchEvent(const std::string& instance_id, const MessageCatchEvent& message_event, ExecutionState& state);
+        // Continues the token of a subscription found in messages_ if it still
+        // waits there, taking the subscription; false leaves both untouched.
+        // result is what finishRun returned.
+        bool resumeMessageEvent(const MessageSubscriptions::Subscription& subscription, const std::string& data,
+            const std::function<bool(const std::string&)>& user_task_callback, std::string& result);
+        // Persists and schedules a timer armed now; a live batch holds it until its flush
+        void armTimer(StateStore& store, StartBatch* batch, const std::string& instance_id, const std::string& element_id,
+            const std::string& process_id, const std::string& kind, const TimerDefinition& timer);
+        // Disarms the boundary timers of the activity the token waits in
+        void cancelBoundaryTimers(const std::string& instance_id, const ExecutionState& state);
+        // Due timer, runs on the pool
+        void fireTimer(const TimerService::Timer& timer);
+        std::unique_lock<std::mutex> lockInstance(const std::string& instance_id);
+        std::unique_ptr<TimerService> makeTimerService();
+        std::shared_ptr<JoinCounters> joinCountersFor(const std::string& instance_id, const ProcessGraph& graph);
+        void releaseJoinCounters(const std::string& instance_id);
 
         // State management
         void saveState(const std::string& instance_id, ExecutionState& state);
+        // Asks the per-definition stores first, then the default one
         ExecutionState loadState(const std::string& instance_id);
+        StateStore& storeFor(const std::string& process_id) const;
+        StateStore& storeOf(const ExecutionState& state) const { return state.store ? *state.store : *store_; }
+        // The default store followed by the per-definition ones
+        std::vector<StateStore*> allStores() const;
 
         // Helper methods
-        void log(const std::string& message);
         void handleError(const std::string& instance_id, const std::string& error_message, ExecutionState& state);
-        std::vector<FlowElement*> getOutgoingElements(const std::string& element_id, const std::string& process_id);
-        std::shared_ptr<SequenceFlow> getDefaultFlow(const ExclusiveGateway& gateway, const std::vector<std::shared_ptr<SequenceFlow>>& flows);
+        // Target of the first outgoing flow of the current element, npos if there is none
+        ProcessGraph::Index firstSuccessor(const ExecutionState& state) const;
 
-        // Process definition cache
-        const Process* getProcessDefinition(const std::string& process_id);
+        // Latest deployed version of a definition, parsed once through the cache
+        std::shared_ptr<const Process> getProcessDefinition(const std::string& process_id);
 
-        // UUID generation
+        // Time-ordered UUIDv7 text unless a generator was set
         std::string generate_uuid();
     };
 
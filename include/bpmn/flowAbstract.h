@@ -1,22 +1,42 @@
 #ifndef FLOW_ABSTRACT_H
 #define FLOW_ABSTRACT_H
 
+#include <cstdint>
 #include <string>
 namespace bpmn {
+    // Concrete element type, fixed at construction so that the executor can
+    // dispatch on it without RTTI. Values index ProcessExecutor's handler table.
+    enum class ElementKind : std::uint8_t {
+        Unknown = 0,
+        StartEvent,
+        EndEvent,
+        UserTask,
+        ServiceTask,
+        ParallelGateway,
+        ExclusiveGateway,
+        TimerCatchEvent,
+        BoundaryEvent,
+        MessageCatchEvent,
+        SequenceFlow,
+        Count
+    };
+
     class FlowElement {
     public:
-        FlowElement(const std::string& id, const std::string& name)
-            : id(id), name(name) {
+        FlowElement(const std::string& id, const std::string& name, ElementKind kind = ElementKind::Unknown)
+            : id(id), name(name), kind(kind) {
         }
 
         virtual ~FlowElement() = default;
 
         std::string getId() const { return id; }
         std::string getName() const { return name; }
+        ElementKind getKind() const { return kind; }
 
     private:
         std::string id;
         std::string name;
+        ElementKind kind;
     };
 }
 #endif
\ No newline at end of file
@@ -0,0 +1,64 @@
+#ifndef BPMN_IN_MEMORY_STATE_STORE_H
+#define BPMN_IN_MEMORY_STATE_STORE_H
+
+#include "bpmn/state_store.h"
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace bpmn {
+
+    // StateStore for short-lived orchestrations that never need durability.
+    // Instances are spread over independently locked stripes by a hash of
+    // their id, so checkpoints of different instances practically never
+    // contend and nothing leaves the process. Timers and message
+    // subscriptions are not persisted.
+    class InMemoryStateStore : public StateStore {
+    public:
+        // Completed instances are dropped unless keep_completed is set
+        explicit InMemoryStateStore(bool keep_completed = false, std::size_t stripes = 64);
+
+        InMemoryStateStore(const InMemoryStateStore&) = delete;
+        InMemoryStateStore& operator=(const InMemoryStateStore&) = delete;
+
+        void saveProcessInstance(const std::string& instance_id, const std::string& process_id,
+            const std::string& current_element, const Variables& variables) override;
+        ProcessInstance loadProcessInstance(const std::string& instance_id) override;
+        bool containsProcessInstance(const std::string& instance_id) override;
+        void completeProcessInstance(const std::string& instance_id) override;
+        void saveUserTask(const std::string& instance_id, const std::string& task_id,
+            const std::string& form_key, const Variables& variables) override;
+        void saveError(const std::string& instance_id, const std::string& error_message) override;
+
+        // Instances held, running and kept completed ones
+        std::size_t size() const;
+        bool isCompleted(const std::string& instance_id) const;
+        std::vector<UserTaskRecord> getUserTasks(const std::string& instance_id) const;
+        std::vector<std::string> getErrors(const std::string& instance_id) const;
+
+    private:
+        struct Instance {
+            ProcessInstance state;
+            bool completed = false;
+            std::vector<UserTaskRecord> tasks;
+            std::vector<std::string> errors;
+        };
+
+        struct Stripe {
+            mutable std::mutex mutex;
+            std::unordered_map<std::string, Instance> instances;
+        };
+
+        Stripe& stripeFor(const std::string& instance_id) const;
+
+        const bool keepCompleted_;
+        const std::size_t stripeMask_;
+        std::unique_ptr<Stripe[]> stripes_;
+    };
+
+} // namespace bpmn
+
+#endif // BPMN_IN_MEMORY_STATE_STORE_H
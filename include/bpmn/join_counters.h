@@ -0,0 +1,75 @@
+#ifndef BPMN_JOIN_COUNTERS_H
+#define BPMN_JOIN_COUNTERS_H
+
+#include "bpmn/variables.h"
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace bpmn {
+
+    // Arrival counters of one process instance, one per joining parallel
+    // gateway (see ProcessGraph::joinSlot). Shared by all tokens of the
+    // instance; arriving never locks and never waits. Variable deltas handed
+    // in at a join are collected per slot under a slot mutex.
+    class JoinCounters {
+    public:
+        explicit JoinCounters(std::size_t slots)
+            : counters_(std::make_unique<std::atomic<std::uint32_t>[]>(slots)),
+            deltas_(std::make_unique<Deltas[]>(slots)), size_(slots) {
+            for (std::size_t i = 0; i < slots; ++i) {
+                counters_[i].store(0, std::memory_order_relaxed);
+            }
+        }
+
+        // Records one token at slot. Returns true for exactly one of every
+        // `expected` arrivals, the token that continues past the join; the
+        // counter then starts over so that joins inside loops work too.
+        bool arrive(std::size_t slot, std::uint32_t expected) {
+            std::atomic<std::uint32_t>& counter = counters_[slot];
+            std::uint32_t current = counter.load(std::memory_order_acquire);
+            std::uint32_t next;
+            do {
+                next = current + 1 >= expected ? 0 : current + 1;
+            } while (!counter.compare_exchange_weak(current, next, std::memory_order_acq_rel, std::memory_order_acquire));
+            return next == 0;
+        }
+
+        std::uint32_t arrived(std::size_t slot) const {
+            return counters_[slot].load(std::memory_order_acquire);
+        }
+
+        std::size_t size() const { return size_; }
+
+        // Called by every token before arrive(), so the token released by
+        // arrive() finds the deltas of the whole round
+        void deposit(std::size_t slot, Variables::Delta delta) {
+            std::lock_guard<std::mutex> lock(deltas_[slot].mutex);
+            deltas_[slot].arrived.push_back(std::move(delta));
+        }
+
+        // Deltas of the round in arrival order, the slot starts over empty
+        std::vector<Variables::Delta> collect(std::size_t slot) {
+            std::lock_guard<std::mutex> lock(deltas_[slot].mutex);
+            std::vector<Variables::Delta> result;
+            result.swap(deltas_[slot].arrived);
+            return result;
+        }
+
+    private:
+        struct Deltas {
+            std::mutex mutex;
+            std::vector<Variables::Delta> arrived;
+        };
+
+        std::unique_ptr<std::atomic<std::uint32_t>[]> counters_;
+        std::unique_ptr<Deltas[]> deltas_;
+        std::size_t size_;
+    };
+
+} // namespace bpmn
+
+#endif // BPMN_JOIN_COUNTERS_H
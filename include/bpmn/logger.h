@@ -0,0 +1,115 @@
+#ifndef BPMN_LOGGER_H
+#define BPMN_LOGGER_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+// Levels below this are compiled out of Logger::log<Level>: 0 trace,
+// 1 debug, 2 info, 3 warn, 4 error
+#ifndef BPMN_LOG_COMPILED_LEVEL
+#define BPMN_LOG_COMPILED_LEVEL 1
+#endif
+
+namespace bpmn {
+
+    enum class LogLevel : std::uint8_t { Trace, Debug, Info, Warn, Error, Off };
+
+    // Typed fields of a record; empty views and a zero elapsed_ns are left out
+    struct LogFields {
+        std::string_view instance_id;
+        std::string_view element_id;
+        std::uint64_t elapsed_ns = 0;
+    };
+
+    // Structured logger that never blocks the logging thread. Each thread
+    // writes fixed-size records into its own single-producer ring, and a
+    // sink thread drains all rings every few milliseconds. It formats one
+    // batch per round, one logfmt line per record, and hands the batch to
+    // the sink in a single call. When a ring is full the record is dropped
+    // and counted. Fields longer than their slot in the record are cut.
+    class Logger {
+    public:
+        // Receives formatted lines; called on the sink thread only
+        using Sink = std::function<void(const std::string& batch)>;
+
+        // A null sink writes to std::cout
+        explicit Logger(Sink sink = nullptr, LogLevel level = LogLevel::Info, std::size_t ring_capacity = 1024);
+        // Drains what is still buffered
+        ~Logger();
+
+        Logger(const Logger&) = delete;
+        Logger& operator=(const Logger&) = delete;
+
+        // Shared by every executor that was not given its own
+        static Logger& global();
+
+        static constexpr bool compiledIn(LogLevel level) {
+            return static_cast<int>(level) >= BPMN_LOG_COMPILED_LEVEL;
+        }
+        bool enabled(LogLevel level) const {
+            return compiledIn(level) && level >= level_.load(std::memory_order_relaxed);
+        }
+        void setLevel(LogLevel level) { level_.store(level, std::memory_order_relaxed); }
+        LogLevel getLevel() const { return level_.load(std::memory_order_relaxed); }
+
+        // detail carries free text such as an error message
+        template <LogLevel Level>
+        void log(std::string_view message, const LogFields& fields = {}, std::string_view detail = {}) {
+            if constexpr (compiledIn(Level)) {
+                if (enabled(Level)) {
+                    write(Level, message, fields, detail);
+                }
+            }
+        }
+
+        // Returns once everything logged before the call reached the sink
+        void flush();
+
+        // Records lost to full rings since the logger was created
+        std::uint64_t dropped() const;
+        std::uint64_t written() const { return written_.load(std::memory_order_relaxed); }
+
+    private:
+        struct Record;
+        class Ring;
+
+        void write(LogLevel level, std::string_view message, const LogFields& fields, std::string_view detail);
+        Ring& threadRing();
+        void sinkLoop();
+        // Drains every ring into one batch; returns false if there was nothing
+        bool drain(std::string& batch);
+
+        const std::uint64_t id_;
+        const std::size_t ringCapacity_;
+        Sink sink_;
+        std::atomic<LogLevel> level_;
+        std::atomic<std::uint64_t> written_{ 0 };
+
+        mutable std::mutex ringsMutex_;
+        std::vector<std::shared_ptr<Ring>> rings_;
+        // Drops of rings whose thread ended and that were released
+        std::uint64_t retiredDropped_ = 0;
+        // Drops already reported in the output
+        std::uint64_t reportedDropped_ = 0;
+
+        std::mutex mutex_;
+        std::condition_variable wake_;
+        std::condition_variable flushed_;
+        std::uint64_t flushRequests_ = 0;
+        std::uint64_t flushesDone_ = 0;
+        bool stop_ = false;
+        std::thread thread_;
+    };
+
+} // namespace bpmn
+
+#endif // BPMN_LOGGER_H
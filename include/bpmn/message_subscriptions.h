@@ -0,0 +1,67 @@
+#ifndef BPMN_MESSAGE_SUBSCRIPTIONS_H
+#define BPMN_MESSAGE_SUBSCRIPTIONS_H
+
+#include "db/orm.h"
+#include <cstddef>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace bpmn {
+
+    // Thread-safe in-memory index of tokens waiting in message and signal
+    // catch events. Subscriptions are hashed by (message name, correlation
+    // key), so delivering a message touches one bucket however many tokens
+    // wait; a second index by instance serves targeted delivery and cleanup
+    // when an instance ends. Persistence is up to the caller.
+    class MessageSubscriptions {
+    public:
+        using Subscription = db::Database::MessageSubscriptionRecord;
+
+        MessageSubscriptions() = default;
+
+        MessageSubscriptions(const MessageSubscriptions&) = delete;
+        MessageSubscriptions& operator=(const MessageSubscriptions&) = delete;
+
+        // Replaces an existing subscription of the same (instance_id, element_id)
+        void add(const Subscription& subscription);
+        // Bulk insert under one lock, e.g. when reloading persisted subscriptions
+        void add(const std::vector<Subscription>& subscriptions);
+
+        // Removes and returns one subscription matching the message, if any
+        bool takeOne(const std::string& message_name, const std::string& correlation_key, Subscription& subscription);
+        // Removes and returns every subscription matching the message
+        std::vector<Subscription> takeAll(const std::string& message_name, const std::string& correlation_key);
+        // Removes and returns the subscription of instance_id to message_name, if any
+        bool takeForInstance(const std::string& instance_id, const std::string& message_name, Subscription& subscription);
+
+        // Copies of the subscriptions matching the message; nothing is removed
+        std::vector<Subscription> find(const std::string& message_name, const std::string& correlation_key) const;
+        bool findForInstance(const std::string& instance_id, const std::string& message_name, Subscription& subscription) const;
+        // Removes the subscription of (instance_id, element_id); false if another caller took it first
+        bool remove(const Subscription& subscription);
+
+        // Returns the number of subscriptions removed
+        std::size_t removeInstance(const std::string& instance_id);
+
+        std::size_t size() const;
+
+    private:
+        // Names and ids cannot contain NUL, so the joined key is unambiguous
+        static std::string join(const std::string& first, const std::string& second);
+
+        void addLocked(const Subscription& subscription);
+        void eraseLocked(const Subscription& subscription);
+
+        mutable std::mutex mutex_;
+        // (message_name, correlation_key) -> (instance_id, element_id) -> subscription
+        std::unordered_map<std::string, std::unordered_map<std::string, Subscription>> byMessage_;
+        // instance_id -> its subscriptions, usually one
+        std::unordered_map<std::string, std::vector<Subscription>> byInstance_;
+        std::size_t size_ = 0;
+    };
+
+} // namespace bpmn
+
+#endif // BPMN_MESSAGE_SUBSCRIPTIONS_H
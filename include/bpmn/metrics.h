@@ -0,0 +1,136 @@
+#ifndef BPMN_METRICS_H
+#define BPMN_METRICS_H
+
+#include <nlohmann/json.hpp>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <shared_mutex>
+#include <string>
+#include <string_view>
+
+namespace bpmn {
+
+    // Latency histogram in the HDR layout. Every power of two is split into
+    // 16 linear sub-buckets, so a recorded value is off by at most 1/16
+    // (6.25%). Values go up to 2^44 ns (about 4.9 hours). Larger values land
+    // in the last bucket. Recording is a few relaxed atomic adds and never
+    // blocks. Readers see a consistent total only once writers are quiet.
+    class LatencyHistogram {
+    public:
+        static constexpr std::size_t kSubBuckets = 16;
+        static constexpr std::size_t kMaxExponent = 44;
+        static constexpr std::size_t kBuckets = kSubBuckets + (kMaxExponent - 4) * kSubBuckets;
+
+        void record(std::uint64_t ns);
+        void record(std::chrono::nanoseconds elapsed) {
+            record(static_cast<std::uint64_t>(elapsed.count() < 0 ? 0 : elapsed.count()));
+        }
+
+        struct Snapshot {
+            std::uint64_t count = 0;
+            std::uint64_t sum_ns = 0;
+            std::uint64_t max_ns = 0;
+            std::array<std::uint64_t, kBuckets> buckets{};
+
+            // Upper bound of the bucket holding the q-th value, q in [0, 1]
+            std::uint64_t percentile(double q) const;
+        };
+
+        Snapshot snapshot() const;
+
+        static std::size_t bucketOf(std::uint64_t ns);
+        // Largest value that lands in bucket
+        static std::uint64_t bucketUpperBound(std::size_t bucket);
+
+    private:
+        std::array<std::atomic<std::uint64_t>, kBuckets> buckets_{};
+        std::atomic<std::uint64_t> count_{ 0 };
+        std::atomic<std::uint64_t> sum_{ 0 };
+        std::atomic<std::uint64_t> max_{ 0 };
+    };
+
+    // Records the time from construction to destruction; a null histogram
+    // records nothing and does not read the clock
+    class ScopedLatency {
+    public:
+        explicit ScopedLatency(LatencyHistogram* histogram)
+            : histogram_(histogram), started_(histogram ? std::chrono::steady_clock::now() : std::chrono::steady_clock::time_point()) {}
+        ~ScopedLatency() {
+            if (histogram_) {
+                histogram_->record(std::chrono::steady_clock::now() - started_);
+            }
+        }
+
+        ScopedLatency(const ScopedLatency&) = delete;
+        ScopedLatency& operator=(const ScopedLatency&) = delete;
+
+    private:
+        LatencyHistogram* histogram_;
+        std::chrono::steady_clock::time_point started_;
+    };
+
+    // Execution metrics of an engine: latency per (process_id, element_id),
+    // per database statement and per checkpoint, instance counters and the
+    // active token gauge. Histograms are created on first use and live as
+    // long as the registry. Finding one takes a shared lock. Recording into
+    // it takes no lock.
+    class Metrics {
+    public:
+        Metrics() = default;
+        Metrics(const Metrics&) = delete;
+        Metrics& operator=(const Metrics&) = delete;
+
+        // Shared by every executor that was not given its own
+        static Metrics& global();
+
+        // Time spent in the handler of one element
+        LatencyHistogram& element(std::string_view process_id, std::string_view element_id);
+        // Time of one db::Database call, named in snake case
+        LatencyHistogram& statement(std::string_view name);
+        // Time to hand one instance checkpoint to its store or start batch
+        LatencyHistogram& checkpoint() { return checkpoint_; }
+
+        void instanceStarted() { started_.fetch_add(1, std::memory_order_relaxed); }
+        void instanceCompleted() { completed_.fetch_add(1, std::memory_order_relaxed); }
+        void instanceFailed() { failed_.fetch_add(1, std::memory_order_relaxed); }
+        std::uint64_t instancesStarted() const { return started_.load(std::memory_order_relaxed); }
+        std::uint64_t instancesCompleted() const { return completed_.load(std::memory_order_relaxed); }
+        std::uint64_t instancesFailed() const { return failed_.load(std::memory_order_relaxed); }
+
+        // Tokens executing elements right now; waiting tokens are not counted
+        void tokenActivated() { activeTokens_.fetch_add(1, std::memory_order_relaxed); }
+        void tokenDeactivated() { activeTokens_.fetch_sub(1, std::memory_order_relaxed); }
+        std::int64_t activeTokens() const { return activeTokens_.load(std::memory_order_relaxed); }
+
+        // Prometheus text exposition format 0.0.4. Histograms are exported as
+        // summaries with the 0.5, 0.9, 0.99 and 0.999 quantiles in seconds.
+        std::string toPrometheus() const;
+        // Same content, durations in nanoseconds
+        nlohmann::json toJson() const;
+
+    private:
+        using Histograms = std::map<std::string, std::unique_ptr<LatencyHistogram>, std::less<>>;
+
+        static LatencyHistogram& findOrCreate(std::shared_mutex& mutex, Histograms& histograms, std::string_view key);
+
+        mutable std::shared_mutex elementsMutex_;
+        std::map<std::string, Histograms, std::less<>> elements_;
+        mutable std::shared_mutex statementsMutex_;
+        Histograms statements_;
+        LatencyHistogram checkpoint_;
+
+        std::atomic<std::uint64_t> started_{ 0 };
+        std::atomic<std::uint64_t> completed_{ 0 };
+        std::atomic<std::uint64_t> failed_{ 0 };
+        std::atomic<std::int64_t> activeTokens_{ 0 };
+    };
+
+} // namespace bpmn
+
+#endif // BPMN_METRICS_H
@@ -5,7 +5,12 @@
 #include <vector>
 #include <map>
 #include <memory>
+#include <mutex>
+#include <unordered_map>
 #include "../bpmn/services/abstractService.h"
+#include "../bpmn/process_graph.h"
+#include "../bpmn/condition_expression.h"
+#include "../bpmn/timer_definition.h"
 
 namespace bpmn {
 
@@ -29,15 +34,24 @@ namespace bpmn {
         FlowElement* getElement(const std::string& id) const;
         void addElement(const std::unique_ptr<FlowElement> element);
         void addElement(const std::shared_ptr<FlowElement> element);
-        void addSequenceFlow(const std::string& id, const std::string& name, const std::string& sourceRef, const std::string& targetRef);
+        void addSequenceFlow(const std::string& id, const std::string& name, const std::string& sourceRef, const std::string& targetRef,
+            const std::string& conditionExpression = "");
         StartEvent* getStartEvent() const;
         std::vector<services::ServiceTask*> getServiceTasks() const;
         std::vector<UserTask*> getUserTasks() const;
         bool validate() const;
         const std::vector<std::shared_ptr<SequenceFlow>> getOutgoingFlows(const std::string& element_id) const;
+        const std::vector<std::shared_ptr<SequenceFlow>> getIncomingFlows(const std::string& element_id) const;
+        const std::vector<std::shared_ptr<FlowElement>>& getElements() const { return elements; }
+        const std::vector<std::shared_ptr<SequenceFlow>>& getSequenceFlows() const { return flows; }
+
+        // Integer-indexed form used by the executor. Built on first use; the
+        // process can no longer be modified afterwards.
+        const ProcessGraph& getGraph() const;
 
         //Getters 
         const std::string getId() const;
+        const std::string getName() const { return name; }
         const std::string getStartEventId() const;
 
         // 
@@ -48,14 +62,19 @@ namespace bpmn {
     private:
         std::string id;
         std::string name;
-        std::vector<std::unique_ptr<FlowElement>> elements;
+        std::vector<std::shared_ptr<FlowElement>> elements;
         std::unordered_map<std::string, std::shared_ptr<FlowElement>> elementsById;
-        std::vector<std::unique_ptr<SequenceFlow>> flows;
+        std::vector<std::shared_ptr<SequenceFlow>> flows;
         std::unordered_map<std::string, std::shared_ptr<SequenceFlow>> flowsById;
         std::unordered_map<std::string, std::vector<std::shared_ptr<SequenceFlow>>> outgoingFlows;
         std::unordered_map<std::string, std::vector<std::shared_ptr<SequenceFlow>>> incomingFlows;
         std::string start_event_id;
         std::map<std::string, FlowElement*> element_map;
+
+        void checkMutable() const;
+
+        mutable std::once_flag graph_once;
+        mutable std::unique_ptr<ProcessGraph> graph;
     };
 
     class SequenceFlow : public FlowElement {
@@ -63,31 +82,41 @@ namespace bpmn {
         std::string source_ref;
         std::string target_ref;
         std::string condition_expression;
+        // Compiled once when the flow is added, null for unconditional flows
+        std::shared_ptr<const ConditionExpression> condition;
 
         // 
         SequenceFlow(const std::string& id, const std::string& name,
             const std::string& source_ref, const std::string& target_ref)
-            : FlowElement(id, name), source_ref(source_ref), target_ref(target_ref) {
+            : FlowElement(id, name, ElementKind::SequenceFlow), source_ref(source_ref), target_ref(target_ref) {
         }
     };
 
     class StartEvent : public FlowElement {
     public:
-        using FlowElement::FlowElement; //  
+        StartEvent(const std::string& id, const std::string& name)
+            : FlowElement(id, name, ElementKind::StartEvent) {
+        }
         ~StartEvent() override = default;
-        // Start event specific properties
+
+        // Timer start event if not empty
+        TimerDefinition timer;
     };
 
     class EndEvent : public FlowElement {
     public:
-        using FlowElement::FlowElement;
+        EndEvent(const std::string& id, const std::string& name)
+            : FlowElement(id, name, ElementKind::EndEvent) {
+        }
         ~EndEvent() override = default;
         // End event specific properties
     };
 
     class UserTask : public FlowElement {
     public:
-        using FlowElement::FlowElement;
+        UserTask(const std::string& id, const std::string& name)
+            : FlowElement(id, name, ElementKind::UserTask) {
+        }
 
         std::string form_key;
         std::string assignee;
@@ -98,20 +127,67 @@ namespace bpmn {
 
     class ParallelGateway : public FlowElement {
     public:
-        using FlowElement::FlowElement;
+        ParallelGateway(const std::string& id, const std::string& name)
+            : FlowElement(id, name, ElementKind::ParallelGateway) {
+        }
         ~ParallelGateway() override = default;
         // Parallel gateway specific properties
     };
 
     class ExclusiveGateway : public FlowElement {
     public:
-        using FlowElement::FlowElement;
+        ExclusiveGateway(const std::string& id, const std::string& name)
+            : FlowElement(id, name, ElementKind::ExclusiveGateway) {
+        }
 
         std::string default_flow;  // ID of default sequence flow
 
         ~ExclusiveGateway() override = default;
     };
 
+    // Intermediate catch event with a timer: the token waits until it fires
+    class TimerCatchEvent : public FlowElement {
+    public:
+        TimerCatchEvent(const std::string& id, const std::string& name)
+            : FlowElement(id, name, ElementKind::TimerCatchEvent) {
+        }
+        ~TimerCatchEvent() override = default;
+
+        TimerDefinition timer;
+    };
+
+    // Timer attached to an activity. While a token waits in the activity the
+    // timer is armed; when it fires the activity is interrupted and the token
+    // leaves through the boundary event's outgoing flow.
+    class BoundaryEvent : public FlowElement {
+    public:
+        BoundaryEvent(const std::string& id, const std::string& name)
+            : FlowElement(id, name, ElementKind::BoundaryEvent) {
+        }
+        ~BoundaryEvent() override = default;
+
+        std::string attached_to_ref;
+        // Only interrupting boundary events are supported
+        bool cancel_activity = true;
+        TimerDefinition timer;
+    };
+
+    // Intermediate message or signal catch event: the token waits until a
+    // message with the same name and correlation key is delivered
+    class MessageCatchEvent : public FlowElement {
+    public:
+        MessageCatchEvent(const std::string& id, const std::string& name)
+            : FlowElement(id, name, ElementKind::MessageCatchEvent) {
+        }
+        ~MessageCatchEvent() override = default;
+
+        // Name of the <message> or <signal> the event waits for
+        std::string message_name;
+        // Process variable whose value is the correlation key; signals have none
+        std::string correlation_variable;
+        bool signal = false;
+    };
+
 } // namespace bpmn
 
 #endif // BPMN_MODEL_H
\ No newline at end of file
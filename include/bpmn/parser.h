@@ -1,8 +1,9 @@
 #pragma once
 #include <string>
 #include <memory>
-#include <libxml/parser.h>
-#include <libxml/xpath.h>
+#include <unordered_map>
+#include <vector>
+#include <libxml/xmlreader.h>
 
 #include "model.h"
 #include "process.h"
@@ -15,24 +16,52 @@ namespace bpmn {
         BpmnParser();
         ~BpmnParser();
 
-        std::unique_ptr<Process> parse(const std::string& file_path);
-        std::unique_ptr<Process> parseFromString(const std::string& xml_content);
+        // Each call owns its reader, so one parser may be shared between threads
+        std::unique_ptr<Process> parse(const std::string& file_path) const;
+        std::unique_ptr<Process> parseFromString(const std::string& xml_content) const;
 
     private:
-        std::unique_ptr<Process> parseDocument();
-        void parseProcess(xmlNodePtr node, Process& process);
-        void parseStartEvent(xmlNodePtr node, Process& process);
-        void parseUserTask(xmlNodePtr node, Process& process);
-        void parseServiceTask(xmlNodePtr node, Process& process);
-        void parseEndEvent(xmlNodePtr node, Process& process);
-        void parseParallelGateway(xmlNodePtr node, Process& process);
-        void parseExclusiveGateway(xmlNodePtr node, Process& process);
-        void parseSequenceFlow(xmlNodePtr node, Process& process);
-
-        std::string getAttribute(xmlNodePtr node, const std::string& attribute_name);
-        std::string getNodeName(xmlNodePtr node);
-
-        xmlDocPtr doc_ = nullptr;
+        // Sequence flow seen during the pass; resolved once all elements are known
+        struct PendingFlow {
+            std::string id;
+            std::string name;
+            std::string sourceRef;
+            std::string targetRef;
+            // Text of <conditionExpression>, empty if none
+            std::string condition;
+        };
+
+        // Event definition children of an event element
+        struct EventDefinition {
+            TimerDefinition timer;
+            // messageRef or signalRef, resolved to a name after the pass
+            std::string messageRef;
+            bool signal = false;
+        };
+
+        // Single forward pass over the reader, takes ownership of it
+        std::unique_ptr<Process> parseStream(xmlTextReaderPtr reader, const std::string& source) const;
+        void parseElement(xmlTextReaderPtr reader, const std::string& nodeName, Process& process) const;
+        void parseStartEvent(xmlTextReaderPtr reader, Process& process) const;
+        void parseUserTask(xmlTextReaderPtr reader, Process& process) const;
+        void parseServiceTask(xmlTextReaderPtr reader, Process& process) const;
+        void parseEndEvent(xmlTextReaderPtr reader, Process& process) const;
+        void parseParallelGateway(xmlTextReaderPtr reader, Process& process) const;
+        void parseExclusiveGateway(xmlTextReaderPtr reader, Process& process) const;
+        void parseIntermediateCatchEvent(xmlTextReaderPtr reader, Process& process) const;
+        void parseBoundaryEvent(xmlTextReaderPtr reader, Process& process) const;
+        // Consumes the event's subtree
+        EventDefinition readEventDefinition(xmlTextReaderPtr reader) const;
+        void parseSequenceFlow(xmlTextReaderPtr reader, std::vector<PendingFlow>& flows) const;
+        void resolveSequenceFlows(const std::vector<PendingFlow>& flows, Process& process) const;
+        // Replaces message and signal refs by the names of the <message>/<signal> elements
+        void resolveMessageRefs(const std::unordered_map<std::string, std::string>& names, Process& process) const;
+
+        std::string getAttribute(xmlTextReaderPtr reader, const std::string& attribute_name) const;
+        // Attribute by local name in any namespace, e.g. camunda:class as "class"
+        std::string getLocalAttribute(xmlTextReaderPtr reader, const std::string& local_name) const;
+        std::string getNodeName(xmlTextReaderPtr reader) const;
+        bool isBpmnNode(xmlTextReaderPtr reader) const;
     };
 
-} // namespace bpmn
\ No newline at end of file
+} // namespace bpmn
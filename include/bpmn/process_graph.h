@@ -0,0 +1,114 @@
+#ifndef BPMN_PROCESS_GRAPH_H
+#define BPMN_PROCESS_GRAPH_H
+
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "flowAbstract.h"
+
+namespace bpmn {
+
+    class Process;
+    class SequenceFlow;
+
+    // Integer-indexed, read-only view of a Process used by the executor.
+    // Elements and flows get dense indices in declaration order; adjacency is
+    // stored CSR-style as one offsets array and one contiguous array of flow
+    // indices per direction. String lookups are only needed at the API edges.
+    class ProcessGraph {
+    public:
+        using Index = std::uint32_t;
+        static constexpr Index npos = std::numeric_limits<Index>::max();
+
+        // Contiguous run of flow indices
+        class Range {
+        public:
+            Range(const Index* first, const Index* last) : first_(first), last_(last) {}
+            const Index* begin() const { return first_; }
+            const Index* end() const { return last_; }
+            std::size_t size() const { return static_cast<std::size_t>(last_ - first_); }
+            bool empty() const { return first_ == last_; }
+            Index operator[](std::size_t i) const { return first_[i]; }
+
+        private:
+            const Index* first_;
+            const Index* last_;
+        };
+
+        explicit ProcessGraph(const Process& process);
+
+        std::size_t elementCount() const { return elements_.size(); }
+        std::size_t flowCount() const { return flows_.size(); }
+
+        Index startElement() const { return start_; }
+        // Hashes the id; npos if the element does not exist
+        Index indexOf(const std::string& element_id) const;
+
+        FlowElement* element(Index element) const { return elements_[element]; }
+        const std::string& elementId(Index element) const { return elementIds_[element]; }
+        // Kept in its own array so dispatch does not touch the element itself
+        ElementKind kind(Index element) const { return kinds_[element]; }
+        const SequenceFlow* flow(Index flow) const { return flows_[flow]; }
+
+        Index flowSource(Index flow) const { return flowSource_[flow]; }
+        Index flowTarget(Index flow) const { return flowTarget_[flow]; }
+
+        Range outgoing(Index element) const {
+            return Range(outFlows_.data() + outOffsets_[element], outFlows_.data() + outOffsets_[element + 1]);
+        }
+        Range incoming(Index element) const {
+            return Range(inFlows_.data() + inOffsets_[element], inFlows_.data() + inOffsets_[element + 1]);
+        }
+
+        // Default flow of an exclusive gateway, npos otherwise
+        Index defaultFlow(Index element) const { return defaultFlow_[element]; }
+
+        // Parallel gateways with more than one incoming flow are joins. Each
+        // gets a dense slot for per-instance arrival counters, npos otherwise;
+        // the expected token count is incoming(element).size().
+        Index joinSlot(Index element) const { return joinSlot_[element]; }
+        std::size_t joinCount() const { return joinCount_; }
+
+        // Boundary events attached to an activity, as element indices
+        Range boundaryEvents(Index element) const {
+            return Range(boundaries_.data() + boundaryOffsets_[element], boundaries_.data() + boundaryOffsets_[element + 1]);
+        }
+        // Whether instances can have pending timers at all
+        bool hasTimers() const { return hasTimers_; }
+        // Whether instances can wait for messages or signals
+        bool hasMessageEvents() const { return hasMessageEvents_; }
+        // First timer, message or boundary event a token reaches between a
+        // fork and its join, npos if there is none. An instance persists one
+        // position, which a sibling branch overwrites while such a token waits.
+        Index parallelWait() const { return parallelWait_; }
+
+    private:
+        // Element pointers are owned by the Process the graph was built from
+        std::vector<FlowElement*> elements_;
+        std::vector<std::string> elementIds_;
+        std::vector<ElementKind> kinds_;
+        std::vector<const SequenceFlow*> flows_;
+        std::vector<Index> flowSource_;
+        std::vector<Index> flowTarget_;
+        std::vector<Index> outOffsets_;
+        std::vector<Index> outFlows_;
+        std::vector<Index> inOffsets_;
+        std::vector<Index> inFlows_;
+        std::vector<Index> defaultFlow_;
+        std::vector<Index> joinSlot_;
+        std::size_t joinCount_ = 0;
+        std::vector<Index> boundaryOffsets_;
+        std::vector<Index> boundaries_;
+        bool hasTimers_ = false;
+        bool hasMessageEvents_ = false;
+        Index parallelWait_ = npos;
+        std::unordered_map<std::string, Index> index_;
+        Index start_ = npos;
+    };
+
+} // namespace bpmn
+
+#endif // BPMN_PROCESS_GRAPH_H
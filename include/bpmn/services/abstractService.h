@@ -12,10 +12,14 @@ namespace bpmn {
             std::string expression;
             
             std::future<json> execute(ExecutionState& state) override;
+            void executeAsync(const ExecutionState& state, Callback done) const override;
             ~ServiceTask() override;
             ServiceTask(const std::string& id, const std::string& name)
                 : IService(id, name) {
             }
+
+        private:
+            json invoke() const;
         };
     }
 }
@@ -1,5 +1,6 @@
 #pragma once
 #include <nlohmann/json.hpp>
+#include <functional>
 #include <future>
 #include "../execution_state_fwd.h"  // New header
 #include "../flowAbstract.h"
@@ -10,10 +11,17 @@ namespace bpmn {
     namespace services {
         class IService : public FlowElement {
         public:
+            // Receives the call result; may be invoked on any thread
+            using Callback = std::function<void(json result)>;
+
             IService(const std::string& id, const std::string& name);
             virtual ~IService() = default;
             virtual std::future<json> execute(ExecutionState& state) = 0;
+            // Starts the call and returns without waiting for it. state is only
+            // valid until executeAsync returns; done must be called exactly once.
+            // A result object with an "error" member fails the task.
+            virtual void executeAsync(const ExecutionState& state, Callback done) const = 0;
             
         };
     }
-}
\ No newline at end of file
+}
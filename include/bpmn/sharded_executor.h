@@ -0,0 +1,120 @@
+#ifndef BPMN_SHARDED_EXECUTOR_H
+#define BPMN_SHARDED_EXECUTOR_H
+
+#include "bpmn/executor.h"
+#include "bpmn/state_store.h"
+#include "bpmn/work_stealing_pool.h"
+#include "db/orm.h"
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <future>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace bpmn {
+
+    // Executor split into shards that share nothing. Each shard owns a
+    // ProcessExecutor with its own database connection or state store,
+    // definition cache and instance state, and runs it on a single thread whose run queue is a
+    // one-worker pool. An instance id maps to one shard for its whole life,
+    // so start, resume, parallel branches and service continuations of an
+    // instance all run on the same thread and no locking crosses shards.
+    //
+    // The shard is taken from the last 8 hex digits of the id (the random
+    // part of a UUID); ids of new instances are stamped so that they route
+    // back to the shard that created them.
+    class ShardedExecutor {
+    public:
+        using StoreFactory = std::function<std::unique_ptr<StateStore>(std::size_t shard)>;
+
+        // 0 shards means one per hardware thread
+        explicit ShardedExecutor(const std::string& connection_string, std::size_t shards = 0,
+            std::size_t definition_cache_capacity = 256);
+        // Every shard keeps its instances in the store make_store returns for
+        // it, e.g. an InMemoryStateStore; register definitions with addProcessDefinition
+        explicit ShardedExecutor(const StoreFactory& make_store, std::size_t shards = 0,
+            std::size_t definition_cache_capacity = 256);
+        // Drains every shard's queue before the connections are closed
+        ~ShardedExecutor();
+
+        ShardedExecutor(const ShardedExecutor&) = delete;
+        ShardedExecutor& operator=(const ShardedExecutor&) = delete;
+
+        // New instances are spread round-robin over the shards
+        std::future<std::string> startProcess(std::shared_ptr<const Process> process, const std::string& init_data,
+            std::function<bool(const std::string&)> user_task_callback);
+        std::future<std::string> startProcessById(const std::string& process_id, const std::string& init_data,
+            std::function<bool(const std::string&)> user_task_callback);
+        // Splits init_data evenly over the shards, each writes its part as one batch;
+        // results are in input order
+        std::vector<StartResult> startProcessesById(const std::string& process_id, const std::vector<std::string>& init_data);
+
+        std::future<std::string> resumeProcess(const std::string& instance_id, const std::string& user_task_result,
+            std::function<bool(const std::string&)> user_task_callback);
+        std::future<std::string> continueProcess(const std::string& instance_id,
+            std::function<bool(const std::string&)> user_task_callback);
+
+        // Offers the message to one shard after another on their threads; the
+        // shard whose token waits for it runs the instance. Returns its id, or
+        // an empty string if no token waits for the message.
+        std::string correlateMessage(const std::string& message_name, const std::string& correlation_key,
+            const std::string& data, std::function<bool(const std::string&)> user_task_callback);
+
+        // Registers a definition with every shard and waits until they have it
+        void addProcessDefinition(std::shared_ptr<const Process> process);
+
+        // Hands every persisted timer to the shard owning its instance and
+        // waits until they are scheduled; returns how many
+        std::size_t loadTimers();
+
+        // Runs fn(executor) on the thread of the shard owning instance_id
+        template <class Fn>
+        auto submit(const std::string& instance_id, Fn fn) -> std::future<decltype(fn(std::declval<ProcessExecutor&>()))> {
+            return submitTo(shardOf(instance_id), std::move(fn));
+        }
+
+        std::size_t shardCount() const { return shards_.size(); }
+        std::size_t shardOf(const std::string& instance_id) const { return shardOf(instance_id, shards_.size()); }
+        // Run queue counters of every shard, indexed by shard
+        std::vector<WorkStealingPool::Stats> getShardStats() const;
+
+        static std::size_t shardOf(const std::string& instance_id, std::size_t shards);
+        // Rewrites the last 8 hex digits of uuid so that it maps to shard
+        static std::string stampShard(const std::string& uuid, std::size_t shard, std::size_t shards);
+
+    private:
+        struct Shard {
+            // One of the two is set
+            std::unique_ptr<db::Database> database;
+            std::unique_ptr<StateStore> store;
+            std::unique_ptr<ProcessExecutor> executor;
+            // Declared last: drained before the executor and connection go away
+            std::unique_ptr<WorkStealingPool> queue;
+        };
+
+        template <class Fn>
+        auto submitTo(std::size_t shard, Fn fn) -> std::future<decltype(fn(std::declval<ProcessExecutor&>()))> {
+            using Result = decltype(fn(std::declval<ProcessExecutor&>()));
+            Shard& target = *shards_[shard];
+            // Pool tasks must be copyable, the packaged_task is not
+            auto task = std::make_shared<std::packaged_task<Result()>>(
+                [executor = target.executor.get(), fn = std::move(fn)]() mutable { return fn(*executor); });
+            std::future<Result> result = task->get_future();
+            target.queue->submit([task]() { (*task)(); });
+            return result;
+        }
+
+        // Creates the shard's executor and queue around its database or store;
+        // shards is the final count, used to stamp instance ids
+        void addShard(std::unique_ptr<Shard> shard, std::size_t shards, std::size_t definition_cache_capacity);
+        std::size_t nextShard();
+
+        std::vector<std::unique_ptr<Shard>> shards_;
+        std::atomic<std::size_t> nextShard_{ 0 };
+    };
+
+} // namespace bpmn
+
+#endif // BPMN_SHARDED_EXECUTOR_H
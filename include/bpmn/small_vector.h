@@ -0,0 +1,172 @@
+#ifndef BPMN_SMALL_VECTOR_H
+#define BPMN_SMALL_VECTOR_H
+
+#include <algorithm>
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+namespace bpmn {
+
+    // Vector holding up to N elements in place and moving to the heap beyond
+    // that. Only what the flat containers of the engine need: append, insert,
+    // erase and random access.
+    template <typename T, std::size_t N>
+    class SmallVector {
+    public:
+        using value_type = T;
+        using iterator = T*;
+        using const_iterator = const T*;
+
+        SmallVector() noexcept : data_(inlineData()) {}
+
+        SmallVector(const SmallVector& other) : SmallVector() {
+            reserve(other.size_);
+            std::uninitialized_copy(other.begin(), other.end(), data_);
+            size_ = other.size_;
+        }
+
+        SmallVector(SmallVector&& other) noexcept(std::is_nothrow_move_constructible<T>::value) : SmallVector() {
+            take(std::move(other));
+        }
+
+        SmallVector& operator=(const SmallVector& other) {
+            if (this != &other) {
+                clear();
+                reserve(other.size_);
+                std::uninitialized_copy(other.begin(), other.end(), data_);
+                size_ = other.size_;
+            }
+            return *this;
+        }
+
+        SmallVector& operator=(SmallVector&& other) noexcept(std::is_nothrow_move_constructible<T>::value) {
+            if (this != &other) {
+                clear();
+                releaseHeap();
+                take(std::move(other));
+            }
+            return *this;
+        }
+
+        ~SmallVector() {
+            clear();
+            releaseHeap();
+        }
+
+        std::size_t size() const { return size_; }
+        bool empty() const { return size_ == 0; }
+        std::size_t capacity() const { return capacity_; }
+        // False once the elements spilled to the heap
+        bool isInline() const { return data_ == inlineData(); }
+
+        iterator begin() { return data_; }
+        iterator end() { return data_ + size_; }
+        const_iterator begin() const { return data_; }
+        const_iterator end() const { return data_ + size_; }
+
+        T& operator[](std::size_t index) { return data_[index]; }
+        const T& operator[](std::size_t index) const { return data_[index]; }
+        T& back() { return data_[size_ - 1]; }
+
+        void reserve(std::size_t capacity) {
+            if (capacity > capacity_) {
+                grow(capacity);
+            }
+        }
+
+        template <typename... Args>
+        T& emplace_back(Args&&... args) {
+            if (size_ == capacity_) {
+                grow(capacity_ * 2);
+            }
+            T* slot = new (data_ + size_) T(std::forward<Args>(args)...);
+            ++size_;
+            return *slot;
+        }
+
+        template <typename... Args>
+        iterator emplace(const_iterator position, Args&&... args) {
+            const std::size_t index = static_cast<std::size_t>(position - data_);
+            if (index == size_) {
+                emplace_back(std::forward<Args>(args)...);
+                return data_ + index;
+            }
+            // Built first, args may refer to an element about to move
+            T value(std::forward<Args>(args)...);
+            if (size_ == capacity_) {
+                grow(capacity_ * 2);
+            }
+            new (data_ + size_) T(std::move(data_[size_ - 1]));
+            std::move_backward(data_ + index, data_ + size_ - 1, data_ + size_);
+            data_[index] = std::move(value);
+            ++size_;
+            return data_ + index;
+        }
+
+        iterator erase(const_iterator position) {
+            const std::size_t index = static_cast<std::size_t>(position - data_);
+            std::move(data_ + index + 1, data_ + size_, data_ + index);
+            data_[--size_].~T();
+            return data_ + index;
+        }
+
+        void clear() {
+            for (std::size_t i = 0; i < size_; ++i) {
+                data_[i].~T();
+            }
+            size_ = 0;
+        }
+
+    private:
+        T* inlineData() { return reinterpret_cast<T*>(buffer_); }
+        const T* inlineData() const { return reinterpret_cast<const T*>(buffer_); }
+
+        void grow(std::size_t capacity) {
+            T* fresh = static_cast<T*>(::operator new(capacity * sizeof(T)));
+            for (std::size_t i = 0; i < size_; ++i) {
+                new (fresh + i) T(std::move(data_[i]));
+                data_[i].~T();
+            }
+            releaseHeap();
+            data_ = fresh;
+            capacity_ = capacity;
+        }
+
+        void releaseHeap() {
+            if (!isInline()) {
+                ::operator delete(data_);
+                data_ = inlineData();
+                capacity_ = N;
+            }
+        }
+
+        // Expects this to be empty and inline
+        void take(SmallVector&& other) {
+            if (other.isInline()) {
+                for (std::size_t i = 0; i < other.size_; ++i) {
+                    new (data_ + i) T(std::move(other.data_[i]));
+                }
+                size_ = other.size_;
+                other.clear();
+                return;
+            }
+            data_ = other.data_;
+            size_ = other.size_;
+            capacity_ = other.capacity_;
+            other.data_ = other.inlineData();
+            other.size_ = 0;
+            other.capacity_ = N;
+        }
+
+        alignas(T) unsigned char buffer_[sizeof(T) * N];
+        T* data_;
+        std::size_t size_ = 0;
+        std::size_t capacity_ = N;
+    };
+
+} // namespace bpmn
+
+#endif // BPMN_SMALL_VECTOR_H
@@ -0,0 +1,95 @@
+#ifndef BPMN_STATE_STORE_H
+#define BPMN_STATE_STORE_H
+
+#include "db/orm.h"
+#include <map>
+#include <string>
+#include <vector>
+
+namespace bpmn {
+
+    // Where ProcessExecutor keeps the runtime state of its instances:
+    // checkpoints, user tasks, errors, pending timers and message
+    // subscriptions. Process definitions are not part of it. Implementations
+    // must be safe to call from several threads, the executor's branches and
+    // service continuations checkpoint concurrently.
+    class StateStore {
+    public:
+        using ProcessInstance = db::Database::ProcessInstance;
+        using ProcessInstanceRecord = db::Database::ProcessInstanceRecord;
+        using UserTaskRecord = db::Database::UserTaskRecord;
+        using TimerRecord = db::Database::TimerRecord;
+        using MessageSubscriptionRecord = db::Database::MessageSubscriptionRecord;
+        using Variables = std::map<std::string, std::string>;
+
+        virtual ~StateStore() = default;
+
+        virtual void saveProcessInstance(const std::string& instance_id, const std::string& process_id,
+            const std::string& current_element, const Variables& variables) = 0;
+        // Throws std::runtime_error if the instance is unknown
+        virtual ProcessInstance loadProcessInstance(const std::string& instance_id) = 0;
+        // Only asked when an executor uses several stores
+        virtual bool containsProcessInstance(const std::string& instance_id) = 0;
+        virtual void completeProcessInstance(const std::string& instance_id) = 0;
+        virtual void saveUserTask(const std::string& instance_id, const std::string& task_id,
+            const std::string& form_key, const Variables& variables) = 0;
+        virtual void saveError(const std::string& instance_id, const std::string& error_message) = 0;
+
+        // Bulk forms used by startProcesses; the defaults write one by one
+        virtual void saveProcessInstances(const std::vector<ProcessInstanceRecord>& instances);
+        virtual void saveUserTasks(const std::vector<UserTaskRecord>& tasks);
+        // Both at once, atomically where the store has transactions
+        virtual void saveProcessInstancesWithTasks(const std::vector<ProcessInstanceRecord>& instances,
+            const std::vector<UserTaskRecord>& tasks);
+
+        // Durable copies of timers and subscriptions, reloaded after a restart.
+        // The defaults keep nothing: the executor's in-memory indexes are the
+        // only copy.
+        virtual void saveTimer(const TimerRecord& timer) {}
+        virtual void deleteTimer(const std::string& instance_id, const std::string& element_id) {}
+        virtual void deleteTimers(const std::string& instance_id) {}
+        virtual std::vector<TimerRecord> loadTimers() { return {}; }
+        virtual void saveMessageSubscription(const MessageSubscriptionRecord& subscription) {}
+        virtual void deleteMessageSubscription(const std::string& instance_id, const std::string& element_id) {}
+        virtual void deleteMessageSubscriptions(const std::string& instance_id) {}
+        virtual std::vector<MessageSubscriptionRecord> loadMessageSubscriptions() { return {}; }
+    };
+
+    // StateStore on the PostgreSQL tables of db::Database. The database
+    // serializes its calls on its single connection, so concurrent
+    // checkpoints wait for each other here.
+    class DatabaseStateStore : public StateStore {
+    public:
+        // db must outlive the store
+        explicit DatabaseStateStore(db::Database& db) : db_(db) {}
+
+        void saveProcessInstance(const std::string& instance_id, const std::string& process_id,
+            const std::string& current_element, const Variables& variables) override;
+        ProcessInstance loadProcessInstance(const std::string& instance_id) override;
+        bool containsProcessInstance(const std::string& instance_id) override;
+        void completeProcessInstance(const std::string& instance_id) override;
+        void saveUserTask(const std::string& instance_id, const std::string& task_id,
+            const std::string& form_key, const Variables& variables) override;
+        void saveError(const std::string& instance_id, const std::string& error_message) override;
+
+        void saveProcessInstances(const std::vector<ProcessInstanceRecord>& instances) override;
+        void saveUserTasks(const std::vector<UserTaskRecord>& tasks) override;
+        void saveProcessInstancesWithTasks(const std::vector<ProcessInstanceRecord>& instances,
+            const std::vector<UserTaskRecord>& tasks) override;
+
+        void saveTimer(const TimerRecord& timer) override;
+        void deleteTimer(const std::string& instance_id, const std::string& element_id) override;
+        void deleteTimers(const std::string& instance_id) override;
+        std::vector<TimerRecord> loadTimers() override;
+        void saveMessageSubscription(const MessageSubscriptionRecord& subscription) override;
+        void deleteMessageSubscription(const std::string& instance_id, const std::string& element_id) override;
+        void deleteMessageSubscriptions(const std::string& instance_id) override;
+        std::vector<MessageSubscriptionRecord> loadMessageSubscriptions() override;
+
+    private:
+        db::Database& db_;
+    };
+
+} // namespace bpmn
+
+#endif // BPMN_STATE_STORE_H
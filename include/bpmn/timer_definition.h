@@ -0,0 +1,42 @@
+#ifndef BPMN_TIMER_DEFINITION_H
+#define BPMN_TIMER_DEFINITION_H
+
+#include <cstdint>
+#include <string>
+
+namespace bpmn {
+
+    // <timerEventDefinition> of a start, intermediate catch or boundary event.
+    // Expressions are ISO 8601 as in the BPMN spec:
+    //   timeDate      2026-03-01T12:00:00Z, 2026-03-01T12:00:00+03:00
+    //   timeDuration  PT15M, P2DT4H, P1W (no years or months)
+    //   timeCycle     R3/PT1H, R/PT10M, R2/2026-03-01T12:00:00Z/P1D
+    // Times are milliseconds since the Unix epoch.
+    struct TimerDefinition {
+        enum class Type : std::uint8_t { None = 0, Date, Duration, Cycle };
+
+        Type type = Type::None;
+        // As written in the definition, kept for compiled processes
+        std::string expression;
+
+        // Date, or the start of a Cycle; 0 if the cycle starts when armed
+        std::int64_t date_ms = 0;
+        // Duration, or the period of a Cycle
+        std::int64_t interval_ms = 0;
+        // Cycle only: number of occurrences, -1 = unbounded
+        std::int32_t repetitions = 0;
+
+        bool empty() const { return type == Type::None; }
+
+        // First due time of a timer armed at now_ms
+        std::int64_t firstDue(std::int64_t now_ms) const;
+
+        // Throw std::invalid_argument on malformed expressions
+        static TimerDefinition parse(Type type, const std::string& expression);
+        static std::int64_t parseDuration(const std::string& expression);
+        static std::int64_t parseDate(const std::string& expression);
+    };
+
+} // namespace bpmn
+
+#endif // BPMN_TIMER_DEFINITION_H
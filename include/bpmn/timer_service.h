@@ -0,0 +1,68 @@
+#ifndef BPMN_TIMER_SERVICE_H
+#define BPMN_TIMER_SERVICE_H
+
+#include "bpmn/timing_wheel.h"
+#include "db/orm.h"
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace bpmn {
+
+    // Pending timers of one executor on a TimingWheel, with a thread that
+    // advances the wheel every tick and hands due timers to the handler.
+    // Timers are keyed by (instance_id, element_id); scheduling a key again
+    // replaces the pending timer. Persistence is up to the caller.
+    class TimerService {
+    public:
+        using Timer = db::Database::TimerRecord;
+        // Runs on the timer thread and must not block, e.g. submit to a pool
+        using Handler = std::function<void(Timer)>;
+
+        explicit TimerService(Handler handler, std::chrono::milliseconds resolution = std::chrono::milliseconds(10));
+        ~TimerService();
+
+        TimerService(const TimerService&) = delete;
+        TimerService& operator=(const TimerService&) = delete;
+
+        void schedule(Timer timer);
+        // Bulk insert under one lock, e.g. when reloading persisted timers
+        void schedule(std::vector<Timer> timers);
+        bool cancel(const std::string& instance_id, const std::string& element_id);
+        // Returns the number of timers removed
+        std::size_t cancelInstance(const std::string& instance_id);
+
+        // Stops the thread; pending timers stay pending and nothing fires afterwards
+        void stop();
+
+        std::size_t pending() const;
+
+        static std::int64_t nowMs();
+
+    private:
+        using Wheel = TimingWheel<Timer>;
+
+        void insertLocked(Timer timer);
+        void loop();
+
+        Handler handler_;
+        const std::int64_t resolution_;
+        mutable std::mutex mutex_;
+        std::condition_variable wake_;
+        Wheel wheel_;
+        // instance_id -> element_id -> wheel id
+        std::unordered_map<std::string, std::unordered_map<std::string, Wheel::TimerId>> pending_;
+        bool stopping_ = false;
+        // Started with the first timer
+        std::thread thread_;
+    };
+
+} // namespace bpmn
+
+#endif // BPMN_TIMER_SERVICE_H
@@ -0,0 +1,257 @@
+#ifndef BPMN_TIMING_WHEEL_H
+#define BPMN_TIMING_WHEEL_H
+
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+#include <utility>
+#include <vector>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+namespace bpmn {
+
+    // Hierarchical timing wheel over integer ticks. Six levels of 64 slots
+    // cover 2^36 ticks ahead; later deadlines wait in the top level and are
+    // re-placed as time approaches. Insert and cancel are O(1): timers are
+    // nodes of intrusive lists in a slab, addressed by generation-tagged ids.
+    // advance() visits only ticks where a slot is occupied, found through
+    // per-level occupancy bitmaps, so idle time costs nothing.
+    // Not thread-safe; TimerService adds the locking.
+    template <class T>
+    class TimingWheel {
+    public:
+        using TimerId = std::uint64_t;
+        static constexpr TimerId npos = 0;
+
+        explicit TimingWheel(std::uint64_t now = 0) : now_(now) {
+            for (auto& head : heads_) {
+                head = kNil;
+            }
+        }
+
+        // Deadlines at or before now() fire on the next advance()
+        TimerId insert(std::uint64_t deadline, T value) {
+            std::uint32_t index;
+            if (!free_.empty()) {
+                index = free_.back();
+                free_.pop_back();
+            }
+            else {
+                index = static_cast<std::uint32_t>(nodes_.size());
+                nodes_.emplace_back();
+            }
+            Node& node = nodes_[index];
+            node.deadline = deadline;
+            node.value = std::move(value);
+            place(index);
+            ++size_;
+            return (static_cast<TimerId>(node.generation) << 32) | (static_cast<TimerId>(index) + 1);
+        }
+
+        // False if the timer already fired or was cancelled
+        bool cancel(TimerId id) {
+            const std::uint64_t low = id & 0xffffffffu;
+            if (low == 0 || low > nodes_.size()) {
+                return false;
+            }
+            const auto index = static_cast<std::uint32_t>(low - 1);
+            Node& node = nodes_[index];
+            if (node.slot == kFree || node.generation != static_cast<std::uint32_t>(id >> 32)) {
+                return false;
+            }
+            unlink(index);
+            release(index);
+            return true;
+        }
+
+        // Moves time forward to now and appends every timer due by then to
+        // expired, tick by tick
+        void advance(std::uint64_t now, std::vector<T>& expired) {
+            if (now < now_) {
+                now = now_;
+            }
+            for (;;) {
+                expireSlot(static_cast<unsigned>(now_ & kMask), expired);
+                if (now_ == now) {
+                    return;
+                }
+                now_ = size_ == 0 ? now : std::min(now, nextEvent());
+                if ((now_ & kMask) == 0) {
+                    cascade();
+                }
+            }
+        }
+
+        std::size_t size() const { return size_; }
+        std::uint64_t now() const { return now_; }
+
+    private:
+        static constexpr unsigned kBits = 6;
+        static constexpr unsigned kSlots = 1u << kBits;
+        static constexpr std::uint64_t kMask = kSlots - 1;
+        static constexpr unsigned kLevels = 6;
+        static constexpr std::uint32_t kNil = std::numeric_limits<std::uint32_t>::max();
+        static constexpr std::uint16_t kFree = std::numeric_limits<std::uint16_t>::max();
+
+        struct Node {
+            std::uint64_t deadline = 0;
+            T value{};
+            std::uint32_t prev = kNil;
+            std::uint32_t next = kNil;
+            std::uint32_t generation = 0;
+            // level * kSlots + slot, kFree when not scheduled
+            std::uint16_t slot = kFree;
+        };
+
+        static unsigned lowestBit(std::uint64_t bits) {
+#ifdef _MSC_VER
+            unsigned long index;
+            _BitScanForward64(&index, bits);
+            return static_cast<unsigned>(index);
+#else
+            return static_cast<unsigned>(__builtin_ctzll(bits));
+#endif
+        }
+
+        // Distance from slot to the next occupied slot after it, wrapping
+        // around; 64 means the slot itself one rotation later
+        static unsigned nextOccupied(std::uint64_t bits, unsigned slot) {
+            const unsigned shift = (slot + 1) & kMask;
+            const std::uint64_t rotated = shift == 0 ? bits : (bits >> shift) | (bits << (kSlots - shift));
+            return lowestBit(rotated) + 1;
+        }
+
+        // Earliest tick after now_ at which a slot fires or cascades
+        std::uint64_t nextEvent() const {
+            std::uint64_t next = std::numeric_limits<std::uint64_t>::max();
+            for (unsigned level = 0; level < kLevels; ++level) {
+                if (occupied_[level] == 0) {
+                    continue;
+                }
+                const unsigned shift = level * kBits;
+                const std::uint64_t bucket = now_ >> shift;
+                const unsigned distance = nextOccupied(occupied_[level], static_cast<unsigned>(bucket & kMask));
+                next = std::min(next, (bucket + distance) << shift);
+            }
+            return next;
+        }
+
+        void place(std::uint32_t index) {
+            Node& node = nodes_[index];
+            const std::uint64_t delta = node.deadline > now_ ? node.deadline - now_ : 0;
+
+            unsigned level = 0;
+            while (level + 1 < kLevels && delta >= (std::uint64_t(1) << (kBits * (level + 1)))) {
+                ++level;
+            }
+            std::uint64_t deadline = node.deadline;
+            if (delta == 0) {
+                deadline = now_;
+            }
+            else if (level + 1 == kLevels && delta >= (std::uint64_t(1) << (kBits * kLevels))) {
+                // Beyond the wheel: park in the farthest slot, re-placed on cascade
+                deadline = now_ + (std::uint64_t(1) << (kBits * kLevels)) - 1;
+            }
+            const unsigned slot = static_cast<unsigned>((deadline >> (kBits * level)) & kMask);
+            link(index, static_cast<std::uint16_t>(level * kSlots + slot));
+        }
+
+        void link(std::uint32_t index, std::uint16_t slot) {
+            Node& node = nodes_[index];
+            node.slot = slot;
+            node.prev = kNil;
+            node.next = heads_[slot];
+            if (node.next != kNil) {
+                nodes_[node.next].prev = index;
+            }
+            heads_[slot] = index;
+            occupied_[slot / kSlots] |= std::uint64_t(1) << (slot % kSlots);
+        }
+
+        void unlink(std::uint32_t index) {
+            Node& node = nodes_[index];
+            if (node.prev != kNil) {
+                nodes_[node.prev].next = node.next;
+            }
+            else {
+                heads_[node.slot] = node.next;
+            }
+            if (node.next != kNil) {
+                nodes_[node.next].prev = node.prev;
+            }
+            if (heads_[node.slot] == kNil) {
+                occupied_[node.slot / kSlots] &= ~(std::uint64_t(1) << (node.slot % kSlots));
+            }
+            node.slot = kFree;
+        }
+
+        void release(std::uint32_t index) {
+            Node& node = nodes_[index];
+            node.value = T();
+            node.slot = kFree;
+            ++node.generation;
+            free_.push_back(index);
+            --size_;
+        }
+
+        // Detaches a whole slot and returns its first node
+        std::uint32_t take(unsigned slot) {
+            const std::uint32_t head = heads_[slot];
+            heads_[slot] = kNil;
+            occupied_[slot / kSlots] &= ~(std::uint64_t(1) << (slot % kSlots));
+            return head;
+        }
+
+        void expireSlot(unsigned slot, std::vector<T>& expired) {
+            if (heads_[slot] == kNil) {
+                return;
+            }
+            // Lists are LIFO; collect first to report in insertion order
+            std::vector<std::uint32_t>& due = scratch_;
+            due.clear();
+            for (std::uint32_t index = take(slot); index != kNil;) {
+                const std::uint32_t next = nodes_[index].next;
+                if (nodes_[index].deadline <= now_) {
+                    due.push_back(index);
+                }
+                else {
+                    place(index);
+                }
+                index = next;
+            }
+            for (auto it = due.rbegin(); it != due.rend(); ++it) {
+                expired.push_back(std::move(nodes_[*it].value));
+                release(*it);
+            }
+        }
+
+        // Moves the slots that start at now_ one or more levels down
+        void cascade() {
+            for (unsigned level = kLevels - 1; level > 0; --level) {
+                const unsigned shift = level * kBits;
+                if ((now_ & ((std::uint64_t(1) << shift) - 1)) != 0) {
+                    continue;
+                }
+                const unsigned slot = level * kSlots + static_cast<unsigned>((now_ >> shift) & kMask);
+                for (std::uint32_t index = take(slot); index != kNil;) {
+                    const std::uint32_t next = nodes_[index].next;
+                    place(index);
+                    index = next;
+                }
+            }
+        }
+
+        std::uint64_t now_;
+        std::size_t size_ = 0;
+        std::vector<Node> nodes_;
+        std::vector<std::uint32_t> free_;
+        std::vector<std::uint32_t> scratch_;
+        std::uint32_t heads_[kLevels * kSlots];
+        std::uint64_t occupied_[kLevels] = {};
+    };
+
+} // namespace bpmn
+
+#endif // BPMN_TIMING_WHEEL_H
@@ -0,0 +1,162 @@
+#ifndef BPMN_VARIABLES_H
+#define BPMN_VARIABLES_H
+
+#include "bpmn/container.h"
+#include "bpmn/small_vector.h"
+#include <nlohmann/json_fwd.hpp>
+#include <cstddef>
+#include <map>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace bpmn {
+
+    // How a parallel join resolves two branches writing different values to
+    // the same variable. Arrival order is the order tokens reach the join.
+    enum class VariableMergePolicy {
+        LastArrivalWins,
+        FirstArrivalWins,
+        // The join throws std::runtime_error
+        Fail
+    };
+
+    // Variables of one process instance, typed with Container's value
+    // variant. Entries sit in flat arrays sorted by name that stay inline up
+    // to kInlineVariables entries. The first kInternedNames distinct names are
+    // interned once per process; later ones, e.g. keys of arbitrary payloads,
+    // are owned by their entries. Strings rely on std::string's small string
+    // buffer.
+    //
+    // Parallel branches share copy-on-write scopes. fork() moves the
+    // token's writes into an immutable layer that every branch reads
+    // through. Each branch records only its own writes and erasures in a
+    // delta. At the join each arriving token hands in its delta, and the
+    // continuing token merges them all and leaves the fork's layer.
+    // Tokens restored from a checkpoint have no layers, so their delta
+    // holds all of their variables.
+    //
+    // State stores keep the string form of each value, and conditions
+    // compare typed values directly. JSON converts both ways at the API
+    // edges.
+    class Variables {
+    public:
+        using Value = Container::Value;
+
+        class Entry {
+        public:
+            Entry(const std::string* name, Value value) : name_(name), value_(std::move(value)) {}
+            Entry(const Entry& other)
+                : name_(other.name_), owned_(other.owned_), value_(Container::cloneValue(other.value_)), erased_(other.erased_) {}
+            Entry(Entry&&) noexcept = default;
+            Entry& operator=(const Entry& other) {
+                name_ = other.name_;
+                owned_ = other.owned_;
+                value_ = Container::cloneValue(other.value_);
+                erased_ = other.erased_;
+                return *this;
+            }
+            Entry& operator=(Entry&&) noexcept = default;
+
+            const std::string& name() const { return *name_; }
+            const Value& value() const { return value_; }
+
+        private:
+            friend class Variables;
+
+            const std::string* name_;
+            // Keeps name_ alive when it is not interned
+            std::shared_ptr<const std::string> owned_;
+            Value value_;
+            // Hides the variable of a lower layer
+            bool erased_ = false;
+        };
+
+        static constexpr std::size_t kInlineVariables = 8;
+        static constexpr std::size_t kInternedNames = 4096;
+        // Distinct names interned so far, at most kInternedNames
+        static std::size_t internedNames();
+
+        // Writes of one token since its fork, sorted by name
+        using Delta = SmallVector<Entry, kInlineVariables>;
+
+        bool empty() const { return visible().empty(); }
+        std::size_t size() const { return visible().size(); }
+        std::size_t count(std::string_view name) const { return find(name) ? 1 : 0; }
+
+        // Calls fn(name, value) for every variable in name order
+        template <typename Fn>
+        void forEach(Fn&& fn) const {
+            for (const Entry* entry : visible()) {
+                fn(*entry->name_, entry->value_);
+            }
+        }
+
+        // nullptr if the variable is not set
+        const Value* find(std::string_view name) const;
+        // Throws std::out_of_range if the variable is not set
+        const Value& at(std::string_view name) const;
+        // Empty if the variable is not set
+        std::string getString(std::string_view name) const;
+
+        void set(std::string_view name, Value value);
+        // String literals would otherwise convert to bool on older compilers
+        template <std::size_t Size>
+        void set(std::string_view name, const char (&value)[Size]) { set(name, Value(std::string(value))); }
+        bool erase(std::string_view name);
+        void clear();
+
+        // Opens a scope for parallel branches and returns the variables a
+        // branch starts with. Copies of the result share every value, so
+        // the cost per branch does not depend on the number of variables.
+        Variables fork();
+        // Hands this token's writes to a join and leaves its delta empty
+        Delta takeDelta();
+        // Merges the deltas of every token arriving at a join, in arrival
+        // order, and closes the scope opened by the matching fork
+        void join(std::vector<Delta> arrivals, VariableMergePolicy policy);
+
+        // Strings as they are, everything else as JSON text
+        static std::string toString(const Value& value);
+
+        // Form kept by StateStore. Text that is the canonical form of a
+        // boolean or number is read back as one, the rest stays a string.
+        std::map<std::string, std::string> toStringMap() const;
+        static Variables fromStringMap(const std::map<std::string, std::string>& values);
+
+        // Objects become nested Containers and arrays of objects Container
+        // arrays. Other arrays and null keep their JSON text, null members of
+        // objects are dropped.
+        static Value valueFromJson(const nlohmann::json& json);
+        static nlohmann::json valueToJson(const Value& value);
+        nlohmann::json toJson() const;
+        // Throws std::invalid_argument unless json is an object
+        static Variables fromJson(const nlohmann::json& json);
+
+    private:
+        // Entry with an interned name while the table has room
+        static Entry makeEntry(std::string_view name, Value value);
+
+        // Writes a token made before a fork, shared read-only by its branches
+        struct Layer {
+            std::shared_ptr<const Layer> parent;
+            Delta entries;
+        };
+
+        // Entry for name in a sorted delta, tombstones included
+        static const Entry* lookup(const Delta& entries, std::string_view name);
+        // Entry for name in a sorted delta, inserted if missing
+        static Entry& place(Delta& entries, std::string_view name);
+        // Puts entry into a sorted delta, replacing the one of the same name
+        static void overlay(Delta& entries, Entry&& entry);
+        // Live entries of every layer in name order
+        std::vector<const Entry*> visible() const;
+
+        std::shared_ptr<const Layer> scope_;
+        Delta delta_;
+    };
+
+} // namespace bpmn
+
+#endif // BPMN_VARIABLES_H
@@ -0,0 +1,195 @@
+#ifndef BPMN_WAL_STATE_STORE_H
+#define BPMN_WAL_STATE_STORE_H
+
+#include "bpmn/state_store.h"
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace bpmn {
+
+    // Durable StateStore without PostgreSQL for single-node deployments.
+    // Every operation appends one checksummed record to a write-ahead log.
+    // The log is a sequence of preallocated segment files in one
+    // directory, written through memory maps. An in-memory index maps each
+    // instance id to the offset of its latest state, so a load decodes one
+    // record.
+    //
+    // With sync_commits, a write returns once its record is on disk. One
+    // background flush covers every record appended while the previous
+    // flush ran (group commit). Without it, writes return at memory speed
+    // and reach the disk within flush_interval.
+    //
+    // A compaction thread copies the live records out of sealed segments
+    // that are mostly superseded and then deletes them. Opening the store
+    // replays the segments. A torn record at the end of a segment ends that
+    // segment.
+    class WalStateStore : public StateStore {
+    public:
+        struct Options {
+            // Size of a new segment file; larger records get a segment of their own.
+            // Segments and records are limited to 4 GiB.
+            std::size_t segment_size = 64u << 20;
+            // Wait for the disk in every write
+            bool sync_commits = true;
+            // Longest time an unsynced record waits without sync_commits
+            std::chrono::milliseconds flush_interval{ 10 };
+            // Sealed segments with less than this share of live bytes are compacted
+            double compaction_threshold = 0.5;
+            std::chrono::milliseconds compaction_interval{ 1000 };
+        };
+
+        // Creates directory if needed and replays the segments in it; throws
+        // std::invalid_argument if segment_size is over 4 GiB
+        explicit WalStateStore(const std::string& directory);
+        WalStateStore(const std::string& directory, const Options& options);
+        // Flushes what was appended and stops the background threads
+        ~WalStateStore();
+
+        WalStateStore(const WalStateStore&) = delete;
+        WalStateStore& operator=(const WalStateStore&) = delete;
+
+        void saveProcessInstance(const std::string& instance_id, const std::string& process_id,
+            const std::string& current_element, const Variables& variables) override;
+        ProcessInstance loadProcessInstance(const std::string& instance_id) override;
+        bool containsProcessInstance(const std::string& instance_id) override;
+        // Also drops the user tasks and errors of the instance at compaction
+        void completeProcessInstance(const std::string& instance_id) override;
+        void saveUserTask(const std::string& instance_id, const std::string& task_id,
+            const std::string& form_key, const Variables& variables) override;
+        void saveError(const std::string& instance_id, const std::string& error_message) override;
+
+        void saveTimer(const TimerRecord& timer) override;
+        void deleteTimer(const std::string& instance_id, const std::string& element_id) override;
+        void deleteTimers(const std::string& instance_id) override;
+        std::vector<TimerRecord> loadTimers() override;
+        void saveMessageSubscription(const MessageSubscriptionRecord& subscription) override;
+        void deleteMessageSubscription(const std::string& instance_id, const std::string& element_id) override;
+        void deleteMessageSubscriptions(const std::string& instance_id) override;
+        std::vector<MessageSubscriptionRecord> loadMessageSubscriptions() override;
+
+        // User tasks and errors of a running instance
+        std::vector<UserTaskRecord> getUserTasks(const std::string& instance_id) const;
+        std::vector<std::string> getErrors(const std::string& instance_id) const;
+
+        // Returns once everything appended before the call is on disk
+        void flush();
+        // One compaction pass on the calling thread; returns the segments deleted
+        std::size_t compact();
+
+        struct Stats {
+            std::size_t segments = 0;
+            std::size_t instances = 0;
+            // Bytes of all segments, and of the records the index refers to
+            std::uint64_t bytes = 0;
+            std::uint64_t live_bytes = 0;
+            std::uint64_t flushes = 0;
+            std::uint64_t compacted_segments = 0;
+        };
+        Stats stats() const;
+
+    private:
+        class Segment;
+
+        enum class RecordType : std::uint8_t {
+            Instance = 1,
+            Complete,
+            UserTask,
+            Error,
+            Timer,
+            DeleteTimer,
+            DeleteTimers,
+            Subscription,
+            DeleteSubscription,
+            DeleteSubscriptions
+        };
+
+        // Where a record lives; segment ids start at 1. Segments never exceed
+        // 4 GiB, so offset and size fit 32 bits.
+        struct Location {
+            std::uint64_t segment = 0;
+            std::uint32_t offset = 0;
+            std::uint32_t size = 0;
+
+            bool operator==(const Location& other) const {
+                return segment == other.segment && offset == other.offset;
+            }
+        };
+
+        struct InstanceEntry {
+            Location state;
+            std::vector<Location> tasks;
+            std::vector<Location> errors;
+        };
+
+        using Key = std::pair<std::string, std::string>;
+
+        // Appends a record and indexes it, then waits for the disk if sync_commits is set
+        void commit(RecordType type, const std::string& payload);
+        // Copies a whole record to the head, rolling over to a new segment if needed
+        Location write(const char* record, std::size_t size);
+        // Applies a record to the index; used by commits and replay
+        void index(RecordType type, const char* payload, std::size_t size, const Location& location);
+        // Slot of the index that refers to the record at location, null if it is superseded
+        Location* findReference(RecordType type, const char* payload, std::size_t size, const Location& location);
+        void addLive(const Location& location);
+        void release(const Location& location);
+        std::string readPayload(const Location& location) const;
+
+        void open();
+        std::shared_ptr<Segment> createSegment(std::size_t minimum_size);
+        void waitDurable(std::uint64_t sequence);
+        void syncLoop();
+        void compactionLoop();
+        // Copies the live records of segment to the head; false if it is gone
+        bool compactSegment(std::uint64_t segment_id);
+        // Whether a segment older than segment_id holds a record of the instance
+        bool olderRecords(std::uint64_t segment_id, std::uint64_t instance) const;
+
+        const std::string directory_;
+        const Options options_;
+
+        mutable std::mutex mutex_;
+        std::map<std::uint64_t, std::shared_ptr<Segment>> segments_;
+        std::shared_ptr<Segment> head_;
+        std::unordered_map<std::string, InstanceEntry> instances_;
+        std::map<Key, Location> timers_;
+        std::map<Key, Location> subscriptions_;
+        // Bytes appended and bytes known to be on disk, as commit sequences
+        std::uint64_t appended_ = 0;
+        std::uint64_t synced_ = 0;
+        std::uint64_t syncRequested_ = 0;
+        std::uint64_t flushes_ = 0;
+        std::uint64_t compactedSegments_ = 0;
+        // Stamped into every record. Replay applies records in this order,
+        // wherever compaction moved them.
+        std::uint64_t nextSequence_ = 1;
+        // Set when a flush failed; every later durable write throws it
+        std::string syncError_;
+        bool stop_ = false;
+        // Set once the compaction thread is joined; until then the sync
+        // thread serves the flushes compaction waits for
+        bool stopSync_ = false;
+        std::condition_variable syncWake_;
+        std::condition_variable durable_;
+        std::condition_variable compactionWake_;
+
+        // Only one compaction pass at a time
+        std::mutex compactionMutex_;
+        std::thread syncThread_;
+        std::thread compactionThread_;
+    };
+
+} // namespace bpmn
+
+#endif // BPMN_WAL_STATE_STORE_H
@@ -0,0 +1,79 @@
+#ifndef BPMN_WORK_STEALING_POOL_H
+#define BPMN_WORK_STEALING_POOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace bpmn {
+
+    // Fixed-size pool of worker threads with one deque per worker. A task
+    // submitted from a worker goes to that worker's own deque and is run
+    // LIFO; idle workers steal the oldest task from the others. Tasks
+    // submitted from outside go through a shared injection queue. Tasks must
+    // not block on other tasks: a fork submits its children and returns.
+    class WorkStealingPool {
+    public:
+        using Task = std::function<void()>;
+
+        struct Stats {
+            std::size_t workers = 0;
+            // Tasks submitted but not started yet
+            std::size_t queued = 0;
+            std::uint64_t submitted = 0;
+            std::uint64_t executed = 0;
+            // Tasks taken from another worker's deque
+            std::uint64_t steals = 0;
+        };
+
+        // 0 threads means one per hardware thread
+        explicit WorkStealingPool(std::size_t threads = 0);
+        // Runs every queued task, including ones submitted meanwhile, then joins
+        ~WorkStealingPool();
+
+        WorkStealingPool(const WorkStealingPool&) = delete;
+        WorkStealingPool& operator=(const WorkStealingPool&) = delete;
+
+        // Exceptions escaping a task are dropped, tasks report their own errors
+        void submit(Task task);
+
+        Stats stats() const;
+        std::size_t size() const { return workers_.size(); }
+
+    private:
+        struct Worker {
+            std::mutex mutex;
+            std::deque<Task> tasks;
+            std::thread thread;
+        };
+
+        void workerLoop(std::size_t index);
+        bool popLocal(std::size_t index, Task& task);
+        bool popInjected(Task& task);
+        bool steal(std::size_t thief, Task& task);
+        void wakeOne();
+
+        std::vector<std::unique_ptr<Worker>> workers_;
+
+        std::mutex injectedMutex_;
+        std::deque<Task> injected_;
+
+        std::mutex sleepMutex_;
+        std::condition_variable wakeUp_;
+        std::atomic<bool> stopping_{ false };
+
+        std::atomic<std::size_t> pending_{ 0 };
+        std::atomic<std::uint64_t> submitted_{ 0 };
+        std::atomic<std::uint64_t> executed_{ 0 };
+        std::atomic<std::uint64_t> steals_{ 0 };
+    };
+
+} // namespace bpmn
+
+#endif // BPMN_WORK_STEALING_POOL_H
@@ -0,0 +1,115 @@
+// db/journal.h
+#ifndef DB_JOURNAL_H
+#define DB_JOURNAL_H
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <list>
+#include <map>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace db {
+
+    // One row of process_journal
+    struct JournalRecord {
+        enum class Kind : char {
+            Element = 'E',  // the token moved to value
+            Set = 'S',      // variable name was set to value
+            Erase = 'D'     // variable name was removed
+        };
+
+        std::int64_t seq = 0;
+        Kind kind = Kind::Element;
+        std::string name;
+        std::string value;
+    };
+
+    // What one checkpoint of an instance writes
+    struct JournalWrite {
+        // The instance was not known: its row is upserted and the snapshot
+        // replaces whatever journal it had
+        bool fresh = false;
+        // Write a snapshot at snapshot_seq and drop the journal instead of records
+        bool snapshot = false;
+        std::int64_t snapshot_seq = 0;
+        std::vector<JournalRecord> records;
+
+        bool empty() const { return !snapshot && records.empty(); }
+        // Journal rows the snapshot replaces, up to this seq. A fresh head
+        // does not know what an evicted or forgotten one appended, so all.
+        std::int64_t coveredSeq() const { return fresh ? std::numeric_limits<std::int64_t>::max() : snapshot_seq; }
+    };
+
+    // Turns full checkpoints into journal appends. Keeps the last persisted
+    // state of recently saved instances and diffs every checkpoint against
+    // it. An unchanged checkpoint writes nothing. A changed one writes one
+    // record per transition and changed variable. Every snapshot_interval
+    // records a snapshot replaces the journal. Instances that are not cached
+    // write a snapshot, so evicting one only costs a larger write; the least
+    // recently used instance goes first. Thread-safe.
+    //
+    // Parallel branches of one instance checkpoint concurrently, so callers
+    // hold lockInstance from plan() until the planned write is committed or
+    // forgotten. An instance's writes then reach the database in plan order.
+    class InstanceJournal {
+    public:
+        using Variables = std::map<std::string, std::string>;
+
+        explicit InstanceJournal(std::size_t snapshot_interval = 64, std::size_t max_instances = 10000);
+
+        // Striped by instance id
+        std::unique_lock<std::mutex> lockInstance(const std::string& instance_id);
+        // The stripes of every instance, taken in a fixed order
+        std::vector<std::unique_lock<std::mutex>> lockInstances(const std::vector<std::string>& instance_ids);
+
+        JournalWrite plan(const std::string& instance_id, const std::string& current_element, const Variables& variables);
+        // State rebuilt from the database becomes the base of the next plan;
+        // seq is the last record applied, records the journal rows after the snapshot
+        void restore(const std::string& instance_id, std::int64_t seq, std::size_t records,
+            const std::string& current_element, const Variables& variables);
+        // After completion or a failed write; the next plan is fresh
+        void forget(const std::string& instance_id);
+
+        void setSnapshotInterval(std::size_t records);
+        std::size_t getSnapshotInterval() const;
+        std::size_t size() const;
+
+        static void apply(const JournalRecord& record, std::string& current_element, Variables& variables);
+        // Variables of a snapshot as a JSON object of strings
+        static std::string encodeSnapshot(const Variables& variables);
+        static Variables decodeSnapshot(const std::string& text);
+
+    private:
+        struct Head {
+            // Last appended record, or the snapshot's seq when there is none
+            std::int64_t seq = 0;
+            std::size_t sinceSnapshot = 0;
+            std::string current_element;
+            Variables variables;
+            // Position in recent_
+            std::list<std::string>::iterator recent;
+        };
+
+        // Head of instance_id, created and made most recent; evicts the least
+        // recent one when full. fresh tells whether it was created.
+        Head& touchLocked(const std::string& instance_id, bool& fresh);
+
+        static constexpr std::size_t kInstanceStripes = 64;
+        std::array<std::mutex, kInstanceStripes> instanceLocks_;
+
+        mutable std::mutex mutex_;
+        std::unordered_map<std::string, Head> heads_;
+        // Instance ids, most recently planned or restored first
+        std::list<std::string> recent_;
+        std::size_t snapshotInterval_;
+        const std::size_t maxInstances_;
+    };
+
+} // namespace db
+
+#endif // DB_JOURNAL_H
@@ -3,16 +3,36 @@
 #define DB_ORM_H
 
 #include <libpq-fe.h>
+#include <cstdint>
 #include <string>
+#include <string_view>
 #include <map>
 #include <memory>
+#include <mutex>
 #include <vector>
 #include "config.h"
+#include "journal.h"
+
+namespace bpmn {
+    class LatencyHistogram;
+    class Metrics;
+}
 
 namespace db {
 
     class Database {
     public:
+        // How saveProcessInstance(s) persist an instance
+        enum class PersistenceMode {
+            // Appends one process_journal row per transition and changed
+            // variable; a row in process_snapshots replaces the journal
+            // every snapshot interval. Instances saved before in Rewrite
+            // mode are read from process_variables until their first save.
+            Journal,
+            // Deletes and reinserts every process_variables row on each save
+            Rewrite
+        };
+
         Database();
         explicit Database(const std::string& connection_string);
         ~Database();
@@ -36,8 +56,29 @@ namespace db {
         };
 
         ProcessInstance loadProcessInstance(const std::string& instance_id);
+        // Whether a running instance with this id exists
+        bool hasProcessInstance(const std::string& instance_id);
         void completeProcessInstance(const std::string& instance_id);
 
+        struct ProcessInstanceRecord {
+            std::string instance_id;
+            std::string process_id;
+            std::string current_element;
+            std::map<std::string, std::string> variables;
+            bool completed = false;
+        };
+
+        // Same as saveProcessInstance (and completeProcessInstance for completed
+        // records) for many instances in one transaction: multi-row INSERTs for
+        // the instances and a COPY for their variables or journal rows
+        void saveProcessInstances(const std::vector<ProcessInstanceRecord>& instances);
+
+        // Defaults to Journal; set it before the first save
+        void setPersistenceMode(PersistenceMode mode) { persistenceMode_ = mode; }
+        PersistenceMode getPersistenceMode() const { return persistenceMode_; }
+        // Journal rows of an instance between two snapshots, 64 by default
+        void setSnapshotInterval(std::size_t records) { journal_.setSnapshotInterval(records); }
+
         // User task management
         void saveUserTask(
             const std::string& instance_id,
@@ -46,24 +87,119 @@ namespace db {
             const std::map<std::string, std::string>& variables
         );
 
+        struct UserTaskRecord {
+            std::string instance_id;
+            std::string task_id;
+            std::string form_key;
+            std::map<std::string, std::string> variables;
+        };
+
+        // Bulk form of saveUserTask, one transaction
+        void saveUserTasks(const std::vector<UserTaskRecord>& tasks);
+        // saveProcessInstances and saveUserTasks in one transaction, so no
+        // instance is left waiting at a task without its task row
+        void saveProcessInstancesWithTasks(const std::vector<ProcessInstanceRecord>& instances,
+            const std::vector<UserTaskRecord>& tasks);
+
         // Error handling
         void saveError(const std::string& instance_id, const std::string& error_message);
 
+        // Pending timer; one per (instance_id, element_id). Timer start events
+        // use the process id as instance_id and are kept in their own table,
+        // the instance timers table has a UUID key.
+        struct TimerRecord {
+            std::string instance_id;
+            std::string element_id;
+            std::string process_id;
+            // "start", "catch" or "boundary"
+            std::string kind;
+            // Milliseconds since the Unix epoch
+            std::int64_t due_at = 0;
+            // Remaining occurrences of a cycle, -1 = unbounded
+            std::int32_t repetitions = 0;
+            std::int64_t interval_ms = 0;
+        };
+
+        // Insert or replace
+        void saveTimer(const TimerRecord& timer);
+        void deleteTimer(const std::string& instance_id, const std::string& element_id);
+        void deleteTimers(const std::string& instance_id);
+        // Every pending timer, earliest first
+        std::vector<TimerRecord> loadTimers();
+
+        // Token waiting in a message or signal catch event; one per (instance_id, element_id)
+        struct MessageSubscriptionRecord {
+            std::string instance_id;
+            std::string element_id;
+            std::string message_name;
+            // Empty for signals and uncorrelated messages
+            std::string correlation_key;
+        };
+
+        void saveMessageSubscription(const MessageSubscriptionRecord& subscription);
+        void deleteMessageSubscription(const std::string& instance_id, const std::string& element_id);
+        void deleteMessageSubscriptions(const std::string& instance_id);
+        std::vector<MessageSubscriptionRecord> loadMessageSubscriptions();
+
         // Process definition storage
         std::string loadProcessDefinition(const std::string& process_id);
+        std::string loadProcessDefinition(const std::string& process_id, int version);
+        int loadProcessDefinitionVersion(const std::string& process_id);
+        // Stores XML with its precompiled binary form, returns the deployed version
+        int deployProcessDefinition(const std::string& process_id, const std::string& bpmn_xml, const std::string& compiled);
+
+        struct ProcessDefinitionRecord {
+            std::string process_id;
+            std::string bpmn_xml;
+            std::string compiled;
+        };
+
+        // Deploys all definitions in one transaction, returns versions in input order
+        std::vector<int> deployProcessDefinitions(const std::vector<ProcessDefinitionRecord>& definitions);
+        // Precompiled binary form, empty if the definition was stored without one
+        std::string loadCompiledProcessDefinition(const std::string& process_id, int version);
+        // Raw connection, not covered by the connection mutex; only for callers
+        // that run while nothing else uses this database
         PGconn* getConnection() const;
         nlohmann::json getFormById(const std::string formId) const;
 
+        // Times every call in metrics.statement(<method name in snake case>);
+        // null stops recording. metrics must outlive the database.
+        void setMetrics(bpmn::Metrics* metrics) { metrics_ = metrics; }
+
     private:
         PGconn* conn_;
+        // One connection serves every thread: each public method holds this
+        // for its whole statement or transaction
+        std::mutex connectionMutex_;
         std::string last_error_;
+        bpmn::Metrics* metrics_ = nullptr;
+        PersistenceMode persistenceMode_ = PersistenceMode::Journal;
+        InstanceJournal journal_;
 
         void initializeSchema();
         std::map<std::string, std::string> loadVariables(const std::string& instance_id);
+        // Journal mode parts of saveProcessInstance(s) and loadProcessInstance
+        void appendProcessInstance(const std::string& instance_id, const std::string& process_id,
+            const std::string& current_element, const std::map<std::string, std::string>& variables);
+        void appendProcessInstances(const std::vector<ProcessInstanceRecord>& instances);
+        // Transaction of the bulk saves; either list may be empty
+        void saveBatch(const std::vector<ProcessInstanceRecord>& instances, const std::vector<UserTaskRecord>& tasks);
+        // Rewrite mode part of saveBatch
+        void rewriteProcessInstances(const std::vector<ProcessInstanceRecord>& instances);
+        void insertUserTasks(const std::vector<UserTaskRecord>& tasks);
+        // Rebuilds current_element and variables from the snapshot and the journal tail
+        void replayProcessInstance(const std::string& instance_id, ProcessInstance& instance);
+        // Multi-row upsert of process_instances with the status of each record
+        void upsertProcessInstances(const std::vector<ProcessInstanceRecord>& instances);
+        int upsertProcessDefinition(const std::string& process_id, const std::string& bpmn_xml, const std::string& compiled);
 
         //  
+        bpmn::LatencyHistogram* statementTimer(std::string_view name) const;
         void executeQuery(const std::string& query);
         void executeQueryWithParams(const std::string& query, const std::vector<const char*>& params);
+        // COPY ... FROM STDIN with rows already in COPY text format
+        void copyRows(const std::string& copy_statement, const std::string& rows);
         std::vector<std::vector<std::string>> executeQueryWithResults(const std::string& query,
             const std::vector<const char*>& params = {});
         bool tableExists(const std::string& table_name);
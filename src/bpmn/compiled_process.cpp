@@ -0,0 +1,321 @@
+#include "bpmn/compiled_process.h"
+#include "bpmn/services/abstractService.h"
+#include "bpmn/process_generated.h"  // generated by flatc from schema/process.fbs
+#include <flatbuffers/flatbuffers.h>
+#include <stdexcept>
+#include <unordered_map>
+#include <vector>
+
+namespace bpmn {
+
+    namespace {
+
+        using StringOffset = flatbuffers::Offset<flatbuffers::String>;
+
+        fb::ElementKind kindOf(const FlowElement& element) {
+            switch (element.getKind()) {
+            case ElementKind::StartEvent: return fb::ElementKind::StartEvent;
+            case ElementKind::EndEvent: return fb::ElementKind::EndEvent;
+            case ElementKind::UserTask: return fb::ElementKind::UserTask;
+            case ElementKind::ServiceTask: return fb::ElementKind::ServiceTask;
+            case ElementKind::ParallelGateway: return fb::ElementKind::ParallelGateway;
+            case ElementKind::ExclusiveGateway: return fb::ElementKind::ExclusiveGateway;
+            case ElementKind::TimerCatchEvent: return fb::ElementKind::TimerCatchEvent;
+            case ElementKind::BoundaryEvent: return fb::ElementKind::BoundaryEvent;
+            case ElementKind::MessageCatchEvent: return fb::ElementKind::MessageCatchEvent;
+            default: return fb::ElementKind::Unknown;
+            }
+        }
+
+        // Empty strings are left out of the buffer entirely
+        StringOffset optionalString(flatbuffers::FlatBufferBuilder& builder, const std::string& value) {
+            return value.empty() ? StringOffset() : builder.CreateString(value);
+        }
+
+        std::string toString(const flatbuffers::String* value) {
+            return value ? value->str() : std::string();
+        }
+
+        TimerDefinition timerOf(const fb::Element& element) {
+            const auto type = static_cast<TimerDefinition::Type>(element.timer_type());
+            if (type == TimerDefinition::Type::None) {
+                return TimerDefinition();
+            }
+            return TimerDefinition::parse(type, toString(element.timer_expression()));
+        }
+
+        std::unique_ptr<FlowElement> createElement(const fb::Element& element,
+            const flatbuffers::Vector<flatbuffers::Offset<fb::Element>>* elements,
+            const flatbuffers::Vector<flatbuffers::Offset<fb::Flow>>* flows) {
+            const std::string id = element.id()->str();
+            const std::string name = toString(element.name());
+
+            switch (element.kind()) {
+            case fb::ElementKind::StartEvent: {
+                auto startEvent = std::make_unique<StartEvent>(id, name);
+                startEvent->timer = timerOf(element);
+                return startEvent;
+            }
+            case fb::ElementKind::EndEvent:
+                return std::make_unique<EndEvent>(id, name);
+            case fb::ElementKind::UserTask: {
+                auto userTask = std::make_unique<UserTask>(id, name);
+                userTask->form_key = toString(element.form_key());
+                userTask->assignee = toString(element.assignee());
+                return userTask;
+            }
+            case fb::ElementKind::ServiceTask: {
+                auto serviceTask = std::make_unique<services::ServiceTask>(id, name);
+                serviceTask->topic = toString(element.topic());
+                serviceTask->class_name = toString(element.class_name());
+                serviceTask->expression = toString(element.expression());
+                return serviceTask;
+            }
+            case fb::ElementKind::ParallelGateway:
+                return std::make_unique<ParallelGateway>(id, name);
+            case fb::ElementKind::ExclusiveGateway: {
+                auto exclusiveGateway = std::make_unique<ExclusiveGateway>(id, name);
+                const int32_t defaultFlow = element.default_flow();
+                if (defaultFlow >= 0 && flows && static_cast<flatbuffers::uoffset_t>(defaultFlow) < flows->size()) {
+                    exclusiveGateway->default_flow = flows->Get(defaultFlow)->id()->str();
+                }
+                return exclusiveGateway;
+            }
+            case fb::ElementKind::TimerCatchEvent: {
+                auto timerEvent = std::make_unique<TimerCatchEvent>(id, name);
+                timerEvent->timer = timerOf(element);
+                return timerEvent;
+            }
+            case fb::ElementKind::BoundaryEvent: {
+                auto boundaryEvent = std::make_unique<BoundaryEvent>(id, name);
+                const int32_t attachedTo = element.attached_to();
+                if (attachedTo >= 0 && elements && static_cast<flatbuffers::uoffset_t>(attachedTo) < elements->size()) {
+                    boundaryEvent->attached_to_ref = elements->Get(attachedTo)->id()->str();
+                }
+                boundaryEvent->timer = timerOf(element);
+                return boundaryEvent;
+            }
+            case fb::ElementKind::MessageCatchEvent: {
+                auto messageEvent = std::make_unique<MessageCatchEvent>(id, name);
+                messageEvent->message_name = toString(element.message_name());
+                messageEvent->correlation_variable = toString(element.correlation_variable());
+                messageEvent->signal = element.signal();
+                return messageEvent;
+            }
+            default:
+                throw std::runtime_error("Unsupported element kind in compiled process: " + id);
+            }
+        }
+
+    } // anonymous namespace
+
+    std::string CompiledProcess::compile(const Process& process) {
+        const auto& elements = process.getElements();
+        const auto& flows = process.getSequenceFlows();
+
+        std::unordered_map<std::string, uint32_t> elementIndex;
+        elementIndex.reserve(elements.size());
+        for (uint32_t i = 0; i < elements.size(); ++i) {
+            elementIndex.emplace(elements[i]->getId(), i);
+        }
+
+        std::unordered_map<std::string, uint32_t> flowIndex;
+        flowIndex.reserve(flows.size());
+        for (uint32_t i = 0; i < flows.size(); ++i) {
+            flowIndex.emplace(flows[i]->getId(), i);
+        }
+
+        flatbuffers::FlatBufferBuilder builder(1024 + 64 * (elements.size() + flows.size()));
+
+        std::vector<flatbuffers::Offset<fb::Element>> elementOffsets;
+        elementOffsets.reserve(elements.size());
+        for (const auto& element : elements) {
+            // Strings must be created before the table builder is started
+            auto id = builder.CreateString(element->getId());
+            auto name = optionalString(builder, element->getName());
+            StringOffset formKey, assignee, topic, className, expression, timerExpression, messageName, correlationVariable;
+            bool signal = false;
+            int32_t defaultFlow = -1;
+            int32_t attachedTo = -1;
+            const TimerDefinition* timer = nullptr;
+
+            if (auto userTask = dynamic_cast<const UserTask*>(element.get())) {
+                formKey = optionalString(builder, userTask->form_key);
+                assignee = optionalString(builder, userTask->assignee);
+            }
+            else if (auto serviceTask = dynamic_cast<const services::ServiceTask*>(element.get())) {
+                topic = optionalString(builder, serviceTask->topic);
+                className = optionalString(builder, serviceTask->class_name);
+                expression = optionalString(builder, serviceTask->expression);
+            }
+            else if (auto exclusiveGateway = dynamic_cast<const ExclusiveGateway*>(element.get())) {
+                auto it = flowIndex.find(exclusiveGateway->default_flow);
+                if (it != flowIndex.end()) {
+                    defaultFlow = static_cast<int32_t>(it->second);
+                }
+            }
+            else if (auto startEvent = dynamic_cast<const StartEvent*>(element.get())) {
+                timer = &startEvent->timer;
+            }
+            else if (auto timerEvent = dynamic_cast<const TimerCatchEvent*>(element.get())) {
+                timer = &timerEvent->timer;
+            }
+            else if (auto boundaryEvent = dynamic_cast<const BoundaryEvent*>(element.get())) {
+                timer = &boundaryEvent->timer;
+                auto it = elementIndex.find(boundaryEvent->attached_to_ref);
+                if (it != elementIndex.end()) {
+                    attachedTo = static_cast<int32_t>(it->second);
+                }
+            }
+            else if (auto messageEvent = dynamic_cast<const MessageCatchEvent*>(element.get())) {
+                messageName = optionalString(builder, messageEvent->message_name);
+                correlationVariable = optionalString(builder, messageEvent->correlation_variable);
+                signal = messageEvent->signal;
+            }
+            if (timer) {
+                timerExpression = optionalString(builder, timer->expression);
+            }
+
+            fb::ElementBuilder elementBuilder(builder);
+            elementBuilder.add_id(id);
+            elementBuilder.add_name(name);
+            elementBuilder.add_kind(kindOf(*element));
+            elementBuilder.add_form_key(formKey);
+            elementBuilder.add_assignee(assignee);
+            elementBuilder.add_topic(topic);
+            elementBuilder.add_class_name(className);
+            elementBuilder.add_expression(expression);
+            elementBuilder.add_default_flow(defaultFlow);
+            elementBuilder.add_timer_type(static_cast<uint8_t>(timer ? timer->type : TimerDefinition::Type::None));
+            elementBuilder.add_timer_expression(timerExpression);
+            elementBuilder.add_attached_to(attachedTo);
+            elementBuilder.add_message_name(messageName);
+            elementBuilder.add_correlation_variable(correlationVariable);
+            elementBuilder.add_signal(signal);
+            elementOffsets.push_back(elementBuilder.Finish());
+        }
+
+        std::vector<flatbuffers::Offset<fb::Flow>> flowOffsets;
+        flowOffsets.reserve(flows.size());
+        for (const auto& flow : flows) {
+            auto source = elementIndex.find(flow->source_ref);
+            auto target = elementIndex.find(flow->target_ref);
+            if (source == elementIndex.end() || target == elementIndex.end()) {
+                throw std::runtime_error("Sequence flow " + flow->getId() + " references an unknown element");
+            }
+
+            auto id = builder.CreateString(flow->getId());
+            auto name = optionalString(builder, flow->getName());
+            auto condition = optionalString(builder, flow->condition_expression);
+
+            fb::FlowBuilder flowBuilder(builder);
+            flowBuilder.add_id(id);
+            flowBuilder.add_name(name);
+            flowBuilder.add_source(source->second);
+            flowBuilder.add_target(target->second);
+            flowBuilder.add_condition_expression(condition);
+            flowOffsets.push_back(flowBuilder.Finish());
+        }
+
+        // CSR adjacency in the same order as Process::getOutgoingFlows/getIncomingFlows
+        std::vector<uint32_t> outgoingOffsets{ 0 };
+        std::vector<uint32_t> outgoingFlows;
+        std::vector<uint32_t> incomingOffsets{ 0 };
+        std::vector<uint32_t> incomingFlows;
+        outgoingOffsets.reserve(elements.size() + 1);
+        incomingOffsets.reserve(elements.size() + 1);
+        outgoingFlows.reserve(flows.size());
+        incomingFlows.reserve(flows.size());
+        for (const auto& element : elements) {
+            for (const auto& flow : process.getOutgoingFlows(element->getId())) {
+                outgoingFlows.push_back(flowIndex.at(flow->getId()));
+            }
+            outgoingOffsets.push_back(static_cast<uint32_t>(outgoingFlows.size()));
+
+            for (const auto& flow : process.getIncomingFlows(element->getId())) {
+                incomingFlows.push_back(flowIndex.at(flow->getId()));
+            }
+            incomingOffsets.push_back(static_cast<uint32_t>(incomingFlows.size()));
+        }
+
+        int32_t startElement = -1;
+        auto start = elementIndex.find(process.getStartEventId());
+        if (start != elementIndex.end()) {
+            startElement = static_cast<int32_t>(start->second);
+        }
+
+        auto processId = builder.CreateString(process.getId());
+        auto processName = optionalString(builder, process.getName());
+        auto elementsVector = builder.CreateVector(elementOffsets);
+        auto flowsVector = builder.CreateVector(flowOffsets);
+        auto outgoingOffsetsVector = builder.CreateVector(outgoingOffsets);
+        auto outgoingFlowsVector = builder.CreateVector(outgoingFlows);
+        auto incomingOffsetsVector = builder.CreateVector(incomingOffsets);
+        auto incomingFlowsVector = builder.CreateVector(incomingFlows);
+
+        fb::CompiledProcessBuilder root(builder);
+        root.add_format_version(kFormatVersion);
+        root.add_id(processId);
+        root.add_name(processName);
+        root.add_start_element(startElement);
+        root.add_elements(elementsVector);
+        root.add_flows(flowsVector);
+        root.add_outgoing_offsets(outgoingOffsetsVector);
+        root.add_outgoing_flows(outgoingFlowsVector);
+        root.add_incoming_offsets(incomingOffsetsVector);
+        root.add_incoming_flows(incomingFlowsVector);
+        fb::FinishCompiledProcessBuffer(builder, root.Finish());
+
+        return std::string(reinterpret_cast<const char*>(builder.GetBufferPointer()), builder.GetSize());
+    }
+
+    std::unique_ptr<Process> CompiledProcess::load(const void* data, std::size_t size) {
+        flatbuffers::Verifier verifier(static_cast<const uint8_t*>(data), size);
+        if (!fb::VerifyCompiledProcessBuffer(verifier)) {
+            throw std::runtime_error("Invalid compiled process buffer");
+        }
+
+        const fb::CompiledProcess* compiled = fb::GetCompiledProcess(data);
+        if (compiled->format_version() != kFormatVersion) {
+            throw std::runtime_error("Unsupported compiled process format version: " +
+                std::to_string(compiled->format_version()));
+        }
+
+        auto process = std::make_unique<Process>(compiled->id()->str(), toString(compiled->name()));
+        const auto* elements = compiled->elements();
+        const auto* flows = compiled->flows();
+        const flatbuffers::uoffset_t elementCount = elements ? elements->size() : 0;
+
+        for (flatbuffers::uoffset_t i = 0; i < elementCount; ++i) {
+            process->addElement(std::shared_ptr<FlowElement>(createElement(*elements->Get(i), elements, flows)));
+        }
+
+        if (compiled->start_element() >= 0 && static_cast<flatbuffers::uoffset_t>(compiled->start_element()) < elementCount) {
+            process->setStartEventId(elements->Get(compiled->start_element())->id()->str());
+        }
+
+        // Flows are re-added in stored order, which reproduces the compiled adjacency
+        if (flows) {
+            for (const fb::Flow* flow : *flows) {
+                if (flow->source() >= elementCount || flow->target() >= elementCount) {
+                    throw std::runtime_error("Compiled sequence flow " + flow->id()->str() + " is out of range");
+                }
+                process->addSequenceFlow(flow->id()->str(), toString(flow->name()),
+                    elements->Get(flow->source())->id()->str(),
+                    elements->Get(flow->target())->id()->str(),
+                    toString(flow->condition_expression()));
+            }
+        }
+
+        return process;
+    }
+
+    std::unique_ptr<Process> CompiledProcess::load(const std::string& buffer) {
+        return load(buffer.data(), buffer.size());
+    }
+
+    bool CompiledProcess::isCompiledProcess(const void* data, std::size_t size) {
+        return data && size >= 2 * sizeof(flatbuffers::uoffset_t) && fb::CompiledProcessBufferHasIdentifier(data);
+    }
+
+} // namespace bpmn
@@ -0,0 +1,540 @@
+#include "bpmn/condition_expression.h"
+#include "bpmn/variables.h"
+#include <algorithm>
+#include <cctype>
+#include <charconv>
+#include <cmath>
+#include <stdexcept>
+
+namespace bpmn {
+
+    namespace {
+
+        struct Value {
+            enum class Type : std::uint8_t { Null, Bool, Number, String } type = Type::Null;
+            bool boolean = false;
+            double number = 0.0;
+            std::string_view string;
+
+            static Value ofBool(bool value) {
+                Value result;
+                result.type = Type::Bool;
+                result.boolean = value;
+                return result;
+            }
+
+            static Value ofNumber(double value) {
+                Value result;
+                result.type = Type::Number;
+                result.number = value;
+                return result;
+            }
+        };
+
+        bool equalsIgnoreCase(std::string_view left, std::string_view right) {
+            return left.size() == right.size() &&
+                std::equal(left.begin(), left.end(), right.begin(), [](char a, char b) {
+                    return std::tolower(static_cast<unsigned char>(a)) == std::tolower(static_cast<unsigned char>(b));
+                });
+        }
+
+        bool toNumber(const Value& value, double& out) {
+            switch (value.type) {
+            case Value::Type::Number:
+                out = value.number;
+                return true;
+            case Value::Type::Bool:
+                out = value.boolean ? 1.0 : 0.0;
+                return true;
+            case Value::Type::String: {
+                const char* first = value.string.data();
+                const char* last = first + value.string.size();
+                if (first != last && *first == '+') {
+                    ++first;
+                }
+                auto result = std::from_chars(first, last, out);
+                return first != last && result.ec == std::errc() && result.ptr == last;
+            }
+            default:
+                return false;
+            }
+        }
+
+        bool truthy(const Value& value) {
+            switch (value.type) {
+            case Value::Type::Bool: return value.boolean;
+            case Value::Type::Number: return value.number != 0.0 && !std::isnan(value.number);
+            case Value::Type::String: return equalsIgnoreCase(value.string, "true");
+            default: return false;
+            }
+        }
+
+        bool equal(const Value& left, const Value& right) {
+            if (left.type == Value::Type::Null || right.type == Value::Type::Null) {
+                return left.type == right.type;
+            }
+            if (left.type == Value::Type::String && right.type == Value::Type::String) {
+                return left.string == right.string;
+            }
+            if (left.type == Value::Type::Bool || right.type == Value::Type::Bool) {
+                return truthy(left) == truthy(right);
+            }
+            double a, b;
+            return toNumber(left, a) && toNumber(right, b) && a == b;
+        }
+
+        // Negative, zero or positive; false if the operands cannot be ordered
+        bool compare(const Value& left, const Value& right, int& order) {
+            double a, b;
+            if (toNumber(left, a) && toNumber(right, b)) {
+                order = a < b ? -1 : (a > b ? 1 : 0);
+                return !std::isnan(a) && !std::isnan(b);
+            }
+            if (left.type == Value::Type::String && right.type == Value::Type::String) {
+                order = left.string.compare(right.string);
+                return true;
+            }
+            return false;
+        }
+
+        bool isIdentifierStart(char c) {
+            return std::isalpha(static_cast<unsigned char>(c)) || c == '_';
+        }
+
+        bool isIdentifierPart(char c) {
+            return std::isalnum(static_cast<unsigned char>(c)) || c == '_' || c == '.';
+        }
+
+    } // anonymous namespace
+
+    // Recursive descent straight to bytecode, tracking the stack depth
+    class ConditionExpression::Compiler {
+    public:
+        Compiler(ConditionExpression& expression, std::string_view text)
+            : expression_(expression), text_(text) {
+        }
+
+        void compile() {
+            parseOr();
+            skipSpace();
+            if (pos_ != text_.size()) {
+                fail("unexpected '" + std::string(1, text_[pos_]) + "'");
+            }
+            if (depth_ != 1) {
+                fail("internal stack mismatch");
+            }
+        }
+
+    private:
+        static constexpr int kMaxNesting = 64;
+
+        [[noreturn]] void fail(const std::string& message) const {
+            throw std::invalid_argument("Invalid condition expression '" + expression_.source_ + "': " +
+                message + " at position " + std::to_string(pos_));
+        }
+
+        void skipSpace() {
+            while (pos_ < text_.size() && std::isspace(static_cast<unsigned char>(text_[pos_]))) {
+                ++pos_;
+            }
+        }
+
+        bool match(std::string_view token) {
+            skipSpace();
+            if (text_.substr(pos_, token.size()) != token) {
+                return false;
+            }
+            pos_ += token.size();
+            return true;
+        }
+
+        // Word operators must not run into an identifier
+        bool matchKeyword(std::string_view word) {
+            skipSpace();
+            if (text_.substr(pos_, word.size()) != word) {
+                return false;
+            }
+            const std::size_t end = pos_ + word.size();
+            if (end < text_.size() && isIdentifierPart(text_[end])) {
+                return false;
+            }
+            pos_ = end;
+            return true;
+        }
+
+        std::size_t emit(Op op, std::size_t operand, int stackEffect) {
+            if (operand > UINT16_MAX) {
+                fail("expression too large");
+            }
+            expression_.code_.push_back({ op, static_cast<std::uint16_t>(operand) });
+            depth_ += stackEffect;
+            if (depth_ > static_cast<int>(kMaxStack)) {
+                fail("expression too deeply nested");
+            }
+            return expression_.code_.size() - 1;
+        }
+
+        void patch(std::size_t jump) {
+            expression_.code_[jump].operand = static_cast<std::uint16_t>(expression_.code_.size());
+        }
+
+        void pushConstant(const Constant& constant) {
+            expression_.constants_.push_back(constant);
+            emit(Op::PushConst, expression_.constants_.size() - 1, 1);
+        }
+
+        void enter() {
+            if (++nesting_ > kMaxNesting) {
+                fail("expression too deeply nested");
+            }
+        }
+
+        void parseOr() {
+            parseAnd();
+            while (match("||") || matchKeyword("or")) {
+                // The jump keeps a true left operand as the result
+                const std::size_t jump = emit(Op::JumpIfTrue, 0, -1);
+                parseAnd();
+                patch(jump);
+            }
+        }
+
+        void parseAnd() {
+            parseEquality();
+            while (match("&&") || matchKeyword("and")) {
+                const std::size_t jump = emit(Op::JumpIfFalse, 0, -1);
+                parseEquality();
+                patch(jump);
+            }
+        }
+
+        void parseEquality() {
+            parseRelational();
+            for (;;) {
+                Op op;
+                if (match("==") || matchKeyword("eq")) op = Op::Equal;
+                else if (match("!=") || matchKeyword("ne")) op = Op::NotEqual;
+                else return;
+                parseRelational();
+                emit(op, 0, -1);
+            }
+        }
+
+        void parseRelational() {
+            parseAdditive();
+            for (;;) {
+                Op op;
+                if (match("<=") || matchKeyword("le")) op = Op::LessEqual;
+                else if (match(">=") || matchKeyword("ge")) op = Op::GreaterEqual;
+                else if (match("<") || matchKeyword("lt")) op = Op::Less;
+                else if (match(">") || matchKeyword("gt")) op = Op::Greater;
+                else return;
+                parseAdditive();
+                emit(op, 0, -1);
+            }
+        }
+
+        void parseAdditive() {
+            parseMultiplicative();
+            for (;;) {
+                Op op;
+                if (match("+")) op = Op::Add;
+                else if (match("-")) op = Op::Subtract;
+                else return;
+                parseMultiplicative();
+                emit(op, 0, -1);
+            }
+        }
+
+        void parseMultiplicative() {
+            parseUnary();
+            for (;;) {
+                Op op;
+                if (match("*")) op = Op::Multiply;
+                else if (match("/") || matchKeyword("div")) op = Op::Divide;
+                else if (match("%") || matchKeyword("mod")) op = Op::Modulo;
+                else return;
+                parseUnary();
+                emit(op, 0, -1);
+            }
+        }
+
+        void parseUnary() {
+            enter();
+            if ((match("!") && !match("=")) || matchKeyword("not")) {
+                parseUnary();
+                emit(Op::Not, 0, 0);
+            }
+            else if (match("-")) {
+                parseUnary();
+                emit(Op::Negate, 0, 0);
+            }
+            else {
+                parsePrimary();
+            }
+            --nesting_;
+        }
+
+        void parsePrimary() {
+            skipSpace();
+            if (pos_ >= text_.size()) {
+                fail("unexpected end of expression");
+            }
+
+            const char c = text_[pos_];
+            if (c == '(') {
+                ++pos_;
+                parseOr();
+                if (!match(")")) {
+                    fail("expected ')'");
+                }
+            }
+            else if (c == '\'' || c == '"') {
+                parseString(c);
+            }
+            else if (std::isdigit(static_cast<unsigned char>(c)) || c == '.') {
+                parseNumber();
+            }
+            else if (isIdentifierStart(c)) {
+                parseIdentifier();
+            }
+            else {
+                fail("unexpected '" + std::string(1, c) + "'");
+            }
+        }
+
+        void parseString(char quote) {
+            std::string value;
+            ++pos_;
+            while (pos_ < text_.size() && text_[pos_] != quote) {
+                if (text_[pos_] == '\\' && pos_ + 1 < text_.size()) {
+                    ++pos_;
+                }
+                value += text_[pos_++];
+            }
+            if (pos_ >= text_.size()) {
+                fail("unterminated string");
+            }
+            ++pos_;
+
+            expression_.strings_.push_back(std::move(value));
+            Constant constant{};
+            constant.type = Constant::Type::String;
+            constant.string = static_cast<std::uint32_t>(expression_.strings_.size() - 1);
+            pushConstant(constant);
+        }
+
+        void parseNumber() {
+            const char* first = text_.data() + pos_;
+            const char* last = text_.data() + text_.size();
+            Constant constant{};
+            constant.type = Constant::Type::Number;
+            auto result = std::from_chars(first, last, constant.number);
+            if (result.ec != std::errc()) {
+                fail("invalid number");
+            }
+            pos_ += static_cast<std::size_t>(result.ptr - first);
+            pushConstant(constant);
+        }
+
+        void parseIdentifier() {
+            const std::size_t start = pos_;
+            while (pos_ < text_.size() && isIdentifierPart(text_[pos_])) {
+                ++pos_;
+            }
+            const std::string_view name = text_.substr(start, pos_ - start);
+
+            Constant constant{};
+            if (name == "true" || name == "false") {
+                constant.type = Constant::Type::Bool;
+                constant.boolean = name == "true";
+                pushConstant(constant);
+                return;
+            }
+            if (name == "null") {
+                pushConstant(constant);
+                return;
+            }
+
+            auto& slots = expression_.slots_;
+            auto it = std::find(slots.begin(), slots.end(), name);
+            if (it == slots.end()) {
+                if (slots.size() == kMaxSlots) {
+                    fail("too many variables");
+                }
+                it = slots.emplace(slots.end(), name);
+            }
+            emit(Op::PushVar, static_cast<std::size_t>(it - slots.begin()), 1);
+        }
+
+        ConditionExpression& expression_;
+        std::string_view text_;
+        std::size_t pos_ = 0;
+        int depth_ = 0;
+        int nesting_ = 0;
+    };
+
+    std::shared_ptr<const ConditionExpression> ConditionExpression::compile(const std::string& source) {
+        std::string_view text(source);
+
+        // Trim and unwrap ${...} / #{...}
+        auto trim = [](std::string_view value) {
+            while (!value.empty() && std::isspace(static_cast<unsigned char>(value.front()))) value.remove_prefix(1);
+            while (!value.empty() && std::isspace(static_cast<unsigned char>(value.back()))) value.remove_suffix(1);
+            return value;
+        };
+        text = trim(text);
+        if (text.size() >= 3 && (text[0] == '$' || text[0] == '#') && text[1] == '{' && text.back() == '}') {
+            text = trim(text.substr(2, text.size() - 3));
+        }
+
+        std::shared_ptr<ConditionExpression> expression(new ConditionExpression(source));
+        if (text.empty()) {
+            throw std::invalid_argument("Invalid condition expression '" + source + "': empty expression");
+        }
+        Compiler(*expression, text).compile();
+        return expression;
+    }
+
+    bool ConditionExpression::evaluate(const std::map<std::string, std::string>& variables) const {
+        return run([&variables](const std::string& name, Value& value) {
+            auto it = variables.find(name);
+            if (it != variables.end()) {
+                value.type = Value::Type::String;
+                value.string = it->second;
+            }
+        });
+    }
+
+    bool ConditionExpression::evaluate(const Variables& variables) const {
+        return run([&variables](const std::string& name, Value& value) {
+            const Variables::Value* variable = variables.find(name);
+            if (!variable) {
+                return;
+            }
+            if (const std::string* text = std::get_if<std::string>(variable)) {
+                value.type = Value::Type::String;
+                value.string = *text;
+            }
+            else if (const int* integer = std::get_if<int>(variable)) {
+                value = Value::ofNumber(*integer);
+            }
+            else if (const double* number = std::get_if<double>(variable)) {
+                value = Value::ofNumber(*number);
+            }
+            else if (const bool* boolean = std::get_if<bool>(variable)) {
+                value = Value::ofBool(*boolean);
+            }
+        });
+    }
+
+    template <typename Lookup>
+    bool ConditionExpression::run(Lookup&& lookup) const {
+        Value stack[kMaxStack];
+        std::size_t top = 0;
+
+        // Slots are resolved on first use
+        Value resolved[kMaxSlots];
+        bool looked_up[kMaxSlots] = {};
+
+        const std::size_t size = code_.size();
+        for (std::size_t pc = 0; pc < size; ++pc) {
+            const Instruction& instruction = code_[pc];
+            switch (instruction.op) {
+            case Op::PushConst: {
+                const Constant& constant = constants_[instruction.operand];
+                Value& value = stack[top++];
+                value = Value();
+                value.type = static_cast<Value::Type>(constant.type);
+                value.boolean = constant.boolean;
+                value.number = constant.number;
+                if (constant.type == Constant::Type::String) {
+                    value.string = strings_[constant.string];
+                }
+                break;
+            }
+            case Op::PushVar: {
+                const std::uint16_t slot = instruction.operand;
+                if (!looked_up[slot]) {
+                    lookup(slots_[slot], resolved[slot]);
+                    looked_up[slot] = true;
+                }
+                stack[top++] = resolved[slot];
+                break;
+            }
+            case Op::Not:
+                stack[top - 1] = Value::ofBool(!truthy(stack[top - 1]));
+                break;
+            case Op::Negate: {
+                double number;
+                stack[top - 1] = toNumber(stack[top - 1], number) ? Value::ofNumber(-number) : Value();
+                break;
+            }
+            case Op::Add:
+            case Op::Subtract:
+            case Op::Multiply:
+            case Op::Divide:
+            case Op::Modulo: {
+                const Value right = stack[--top];
+                Value& left = stack[top - 1];
+                double a, b;
+                if (!toNumber(left, a) || !toNumber(right, b)) {
+                    // No string concatenation, it would allocate
+                    left = Value();
+                    break;
+                }
+                double result = 0.0;
+                switch (instruction.op) {
+                case Op::Add: result = a + b; break;
+                case Op::Subtract: result = a - b; break;
+                case Op::Multiply: result = a * b; break;
+                case Op::Divide: result = a / b; break;
+                default: result = std::fmod(a, b); break;
+                }
+                left = Value::ofNumber(result);
+                break;
+            }
+            case Op::Equal:
+            case Op::NotEqual: {
+                const Value right = stack[--top];
+                const bool same = equal(stack[top - 1], right);
+                stack[top - 1] = Value::ofBool(instruction.op == Op::Equal ? same : !same);
+                break;
+            }
+            case Op::Less:
+            case Op::LessEqual:
+            case Op::Greater:
+            case Op::GreaterEqual: {
+                const Value right = stack[--top];
+                int order = 0;
+                bool result = compare(stack[top - 1], right, order);
+                if (result) {
+                    switch (instruction.op) {
+                    case Op::Less: result = order < 0; break;
+                    case Op::LessEqual: result = order <= 0; break;
+                    case Op::Greater: result = order > 0; break;
+                    default: result = order >= 0; break;
+                    }
+                }
+                stack[top - 1] = Value::ofBool(result);
+                break;
+            }
+            case Op::JumpIfFalse:
+            case Op::JumpIfTrue: {
+                const bool value = truthy(stack[top - 1]);
+                if (value == (instruction.op == Op::JumpIfTrue)) {
+                    stack[top - 1] = Value::ofBool(value);
+                    pc = static_cast<std::size_t>(instruction.operand) - 1;
+                }
+                else {
+                    --top;
+                }
+                break;
+            }
+            }
+        }
+
+        return top == 1 && truthy(stack[0]);
+    }
+
+} // namespace bpmn
@@ -0,0 +1,141 @@
+#include "bpmn/definition_cache.h"
+#include <limits>
+#include <stdexcept>
+
+namespace bpmn {
+
+    ProcessDefinitionCache::ProcessDefinitionCache(std::size_t capacity)
+        : capacity_(capacity == 0 ? 1 : capacity) {
+    }
+
+    std::shared_ptr<const Process> ProcessDefinitionCache::getOrLoad(const std::string& process_id, int version, const Loader& loader) {
+        const Key key(process_id, version);
+        std::promise<std::shared_ptr<const Process>> promise;
+        Future future;
+        std::uint64_t ticket = 0;
+        bool owner = false;
+
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            auto it = entries_.find(key);
+            if (it != entries_.end()) {
+                ++hits_;
+                touch(it->second);
+                future = it->second.definition;
+            }
+            else {
+                ++misses_;
+                ticket = ++nextTicket_;
+                future = promise.get_future().share();
+                insert(key, future, ticket);
+                owner = true;
+            }
+        }
+
+        if (!owner) {
+            return future.get();
+        }
+
+        // Load outside the lock so that other definitions stay available
+        try {
+            std::shared_ptr<const Process> process = loader();
+            if (!process) {
+                throw std::runtime_error("Process definition loader returned nothing: " + process_id);
+            }
+            promise.set_value(std::move(process));
+        }
+        catch (...) {
+            promise.set_exception(std::current_exception());
+
+            std::lock_guard<std::mutex> lock(mutex_);
+            auto it = entries_.find(key);
+            if (it != entries_.end() && it->second.ticket == ticket) {
+                lru_.erase(it->second.lru);
+                entries_.erase(it);
+            }
+        }
+
+        return future.get();
+    }
+
+    std::shared_ptr<const Process> ProcessDefinitionCache::find(const std::string& process_id, int version) const {
+        Future future;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            auto it = entries_.find(Key(process_id, version));
+            if (it == entries_.end()) {
+                return nullptr;
+            }
+            touch(it->second);
+            future = it->second.definition;
+        }
+
+        try {
+            return future.get();
+        }
+        catch (const std::exception&) {
+            return nullptr;
+        }
+    }
+
+    void ProcessDefinitionCache::put(const std::string& process_id, int version, std::shared_ptr<const Process> process) {
+        if (!process) {
+            throw std::invalid_argument("Cannot cache null process definition: " + process_id);
+        }
+
+        std::promise<std::shared_ptr<const Process>> promise;
+        promise.set_value(std::move(process));
+
+        std::lock_guard<std::mutex> lock(mutex_);
+        const Key key(process_id, version);
+        auto it = entries_.find(key);
+        if (it != entries_.end()) {
+            lru_.erase(it->second.lru);
+            entries_.erase(it);
+        }
+        insert(key, promise.get_future().share(), ++nextTicket_);
+    }
+
+    void ProcessDefinitionCache::invalidate(const std::string& process_id) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = entries_.lower_bound(Key(process_id, std::numeric_limits<int>::min()));
+        while (it != entries_.end() && it->first.first == process_id) {
+            lru_.erase(it->second.lru);
+            it = entries_.erase(it);
+        }
+    }
+
+    void ProcessDefinitionCache::clear() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        entries_.clear();
+        lru_.clear();
+    }
+
+    ProcessDefinitionCache::Stats ProcessDefinitionCache::stats() const {
+        Stats result;
+        result.hits = hits_.load();
+        result.misses = misses_.load();
+        result.evictions = evictions_.load();
+
+        std::lock_guard<std::mutex> lock(mutex_);
+        result.size = entries_.size();
+        return result;
+    }
+
+    void ProcessDefinitionCache::touch(const Entry& entry) const {
+        lru_.splice(lru_.begin(), lru_, entry.lru);
+    }
+
+    void ProcessDefinitionCache::insert(const Key& key, Future definition, std::uint64_t ticket) {
+        lru_.push_front(key);
+        entries_.emplace(key, Entry{ std::move(definition), lru_.begin(), ticket });
+
+        // Drop least recently used entries; instances keep their shared_ptr alive
+        while (entries_.size() > capacity_) {
+            entries_.erase(lru_.back());
+            lru_.pop_back();
+            ++evictions_;
+        }
+    }
+
+} // namespace bpmn
@@ -1,39 +1,94 @@
 #include "bpmn/engine.h"
 #include "bpmn/parser.h"
 #include "bpmn/executor.h"
+#include "bpmn/compiled_process.h"
+#include "bpmn/instance_id.h"
 #include "db/config.h"
 #include "db/orm.h"
 #include <nlohmann/json.hpp>
-#include <random>
+#include <algorithm>
+#include <atomic>
+#include <fstream>
 #include <sstream>
 #include <iomanip>
+#include <thread>
 
 namespace bpmn {
 
+    namespace {
+
+        std::string readFile(const std::string& filePath) {
+            std::ifstream file(filePath, std::ios::binary);
+            if (!file.is_open()) {
+                throw std::runtime_error("Cannot open BPMN file: " + filePath);
+            }
+
+            std::ostringstream content;
+            content << file.rdbuf();
+            return content.str();
+        }
+
+    } // anonymous namespace
+
     //  
-    std::unique_ptr<BpmnEngine> BpmnEngine::create(const db::DatabaseConfig& config) {
-        return std::unique_ptr<BpmnEngine>(new BpmnEngine(config));
+    std::unique_ptr<BpmnEngine> BpmnEngine::create(const db::DatabaseConfig& config, std::size_t workerThreads) {
+        return std::unique_ptr<BpmnEngine>(new BpmnEngine(config, workerThreads));
     }
 
-    std::unique_ptr<BpmnEngine> BpmnEngine::createFromConfig(const std::string& configPath) {
+    std::unique_ptr<BpmnEngine> BpmnEngine::createFromConfig(const std::string& configPath, std::size_t workerThreads) {
         auto config = db::DatabaseConfig::fromJson(configPath);
-        return std::unique_ptr<BpmnEngine>(new BpmnEngine(config));
+        return std::unique_ptr<BpmnEngine>(new BpmnEngine(config, workerThreads));
     }
 
-    std::unique_ptr<BpmnEngine> BpmnEngine::createFromEnvironment() {
+    std::unique_ptr<BpmnEngine> BpmnEngine::createFromEnvironment(std::size_t workerThreads) {
         auto config = db::DatabaseConfig::fromEnvironment();
-        return std::unique_ptr<BpmnEngine>(new BpmnEngine(config));
+        return std::unique_ptr<BpmnEngine>(new BpmnEngine(config, workerThreads));
     }
 
     // 
-    BpmnEngine::BpmnEngine(const db::DatabaseConfig& config)
-        : config_(config) {
+    BpmnEngine::BpmnEngine(const db::DatabaseConfig& config, std::size_t workerThreads)
+        : config_(config), workerPool_(std::make_unique<WorkStealingPool>(workerThreads)) {
 
         initializeDatabase();
         parser_ = std::make_unique<BpmnParser>();
         //  Database    ProcessExecutor
         database_ = std::make_unique<db::Database>(config_.getConnectionString());
-        executor_ = std::make_unique<ProcessExecutor>(*database_);
+        database_->setMetrics(&metrics_);
+        executor_ = std::make_unique<ProcessExecutor>(*database_, *workerPool_);
+        executor_->setMetrics(metrics_);
+        // Timers and waiting message events survive a restart
+        executor_->loadTimers();
+        executor_->loadMessageSubscriptions();
+    }
+
+    std::unique_ptr<BpmnEngine> BpmnEngine::createInMemory(std::size_t workerThreads) {
+        return std::unique_ptr<BpmnEngine>(new BpmnEngine(workerThreads));
+    }
+
+    BpmnEngine::BpmnEngine(std::size_t workerThreads)
+        : workerPool_(std::make_unique<WorkStealingPool>(workerThreads)) {
+        parser_ = std::make_unique<BpmnParser>();
+        executor_ = std::make_unique<ProcessExecutor>(memoryStore(), *workerPool_);
+        executor_->setMetrics(metrics_);
+    }
+
+    std::unique_ptr<BpmnEngine> BpmnEngine::createEmbedded(const std::string& directory, std::size_t workerThreads) {
+        return std::unique_ptr<BpmnEngine>(new BpmnEngine(std::make_unique<WalStateStore>(directory), workerThreads));
+    }
+
+    BpmnEngine::BpmnEngine(std::unique_ptr<WalStateStore> walStore, std::size_t workerThreads)
+        : walStore_(std::move(walStore)), workerPool_(std::make_unique<WorkStealingPool>(workerThreads)) {
+        parser_ = std::make_unique<BpmnParser>();
+        executor_ = std::make_unique<ProcessExecutor>(*walStore_, *workerPool_);
+        executor_->setMetrics(metrics_);
+        // Timers wait for their definition, see deployInMemory
+        executor_->loadMessageSubscriptions();
+    }
+
+    BpmnEngine::~BpmnEngine() {
+        if (executor_) {
+            executor_->stopTimers();
+        }
     }
 
     void BpmnEngine::initializeDatabase() {
@@ -93,18 +148,154 @@ namespace bpmn {
         }
     }
 
+    std::vector<StartResult> BpmnEngine::startProcesses(const std::string& processId, const std::vector<std::string>& initData) {
+        std::lock_guard<std::mutex> lock(engineMutex_);
+
+        try {
+            return executor_->startProcessesById(processId, initData);
+        }
+        catch (const std::exception& e) {
+            throw std::runtime_error("Failed to start processes: " + std::string(e.what()));
+        }
+    }
+
+    int BpmnEngine::deployProcess(const std::string& processDefinition) {
+        std::lock_guard<std::mutex> lock(engineMutex_);
+
+        try {
+            auto process = parser_->parseFromString(processDefinition);
+            if (!process->validate()) {
+                throw std::runtime_error("Process definition is not valid: " + process->getId());
+            }
+
+            if (!database_) {
+                return deployInMemory(std::move(process));
+            }
+
+            const std::string compiled = CompiledProcess::compile(*process);
+            const int version = database_->deployProcessDefinition(process->getId(), processDefinition, compiled);
+            executor_->invalidateProcessDefinition(process->getId());
+            executor_->scheduleStartTimers(process->getId());
+            return version;
+        }
+        catch (const std::exception& e) {
+            throw std::runtime_error("Failed to deploy process: " + std::string(e.what()));
+        }
+    }
+
+    std::vector<DeploymentResult> BpmnEngine::deployProcessFiles(const std::vector<std::string>& filePaths, std::size_t workers) {
+        std::vector<DeploymentResult> results(filePaths.size());
+        std::vector<db::Database::ProcessDefinitionRecord> records(filePaths.size());
+        if (filePaths.empty()) {
+            return results;
+        }
+
+        if (workers == 0) {
+            workers = std::max(1u, std::thread::hardware_concurrency());
+        }
+        workers = std::min(workers, filePaths.size());
+
+        // Parsing touches no engine state, so it runs without engineMutex_.
+        // Workers claim files one at a time; each index is written by one thread only.
+        std::atomic<std::size_t> next{ 0 };
+        auto worker = [&]() {
+            BpmnParser parser;
+            for (std::size_t i = next++; i < filePaths.size(); i = next++) {
+                DeploymentResult& result = results[i];
+                db::Database::ProcessDefinitionRecord& record = records[i];
+                result.source = filePaths[i];
+
+                try {
+                    record.bpmn_xml = readFile(filePaths[i]);
+                    auto process = parser.parseFromString(record.bpmn_xml);
+                    if (!process->validate()) {
+                        throw std::runtime_error("Process definition is not valid: " + process->getId());
+                    }
+                    record.process_id = process->getId();
+                    record.compiled = CompiledProcess::compile(*process);
+                    result.process_id = record.process_id;
+                }
+                catch (const std::exception& e) {
+                    result.error = e.what();
+                }
+            }
+        };
+
+        std::vector<std::thread> threads;
+        threads.reserve(workers - 1);
+        for (std::size_t i = 1; i < workers; ++i) {
+            threads.emplace_back(worker);
+        }
+        worker();
+        for (auto& thread : threads) {
+            thread.join();
+        }
+
+        // Only definitions that parsed are written, all in one transaction
+        std::vector<db::Database::ProcessDefinitionRecord> valid;
+        std::vector<std::size_t> indices;
+        for (std::size_t i = 0; i < results.size(); ++i) {
+            if (results[i].error.empty()) {
+                indices.push_back(i);
+                valid.push_back(std::move(records[i]));
+            }
+        }
+
+        std::lock_guard<std::mutex> lock(engineMutex_);
+        if (!database_) {
+            for (std::size_t k = 0; k < indices.size(); ++k) {
+                DeploymentResult& result = results[indices[k]];
+                try {
+                    result.version = deployInMemory(CompiledProcess::load(valid[k].compiled));
+                    result.deployed = true;
+                }
+                catch (const std::exception& e) {
+                    result.error = e.what();
+                }
+            }
+            return results;
+        }
+
+        try {
+            const std::vector<int> versions = database_->deployProcessDefinitions(valid);
+            for (std::size_t k = 0; k < indices.size(); ++k) {
+                results[indices[k]].version = versions[k];
+                results[indices[k]].deployed = true;
+            }
+        }
+        catch (const std::exception& e) {
+            for (std::size_t index : indices) {
+                results[index].error = "Failed to store process definition: " + std::string(e.what());
+            }
+        }
+
+        for (std::size_t index : indices) {
+            if (!results[index].deployed) {
+                continue;
+            }
+            try {
+                executor_->invalidateProcessDefinition(results[index].process_id);
+                executor_->scheduleStartTimers(results[index].process_id);
+            }
+            catch (const std::exception& e) {
+                results[index].error = "Failed to schedule start timers: " + std::string(e.what());
+            }
+        }
+
+        return results;
+    }
+
     void BpmnEngine::completeTask(const std::string& instanceId, const std::string& taskId, const std::string& data) {
         std::lock_guard<std::mutex> lock(engineMutex_);
 
         try {
             //    
-            auto it = processCache_.find(instanceId);
-            if (it == processCache_.end()) {
-                throw std::runtime_error("Process instance not found: " + instanceId);
-            }
+            requireInstance(instanceId);
 
             //  
-            // executor_->completeTask(instanceId, taskId, data);
+            if (!executor_->completeTask(instanceId, taskId, data)) {
+                throw std::runtime_error("Process instance " + instanceId + " is not waiting in task " + taskId);
+            }
         }
         catch (const std::exception& e) {
             throw std::runtime_error("Failed to complete task: " + std::string(e.what()));
@@ -115,38 +306,46 @@ namespace bpmn {
         std::lock_guard<std::mutex> lock(engineMutex_);
 
         try {
-            auto it = processCache_.find(instanceId);
-            if (it == processCache_.end()) {
-                throw std::runtime_error("Process instance not found: " + instanceId);
+            if (!executor_->deliverMessage(instanceId, eventId, data, nullptr)) {
+                throw std::runtime_error("Process instance " + instanceId + " is not waiting for " + eventId);
             }
-
-            //  
-            // executor_->signalEvent(instanceId, eventId, data);
         }
         catch (const std::exception& e) {
             throw std::runtime_error("Failed to signal event: " + std::string(e.what()));
         }
     }
 
+    std::string BpmnEngine::correlateMessage(const std::string& messageName, const std::string& correlationKey, const std::string& data) {
+        std::lock_guard<std::mutex> lock(engineMutex_);
+
+        try {
+            return executor_->correlateMessage(messageName, correlationKey, data, nullptr);
+        }
+        catch (const std::exception& e) {
+            throw std::runtime_error("Failed to correlate message: " + std::string(e.what()));
+        }
+    }
+
+    std::size_t BpmnEngine::broadcastSignal(const std::string& signalName, const std::string& data) {
+        std::lock_guard<std::mutex> lock(engineMutex_);
+
+        try {
+            return executor_->broadcastSignal(signalName, data);
+        }
+        catch (const std::exception& e) {
+            throw std::runtime_error("Failed to broadcast signal: " + std::string(e.what()));
+        }
+    }
+
     std::string BpmnEngine::getProcessState(const std::string& instanceId) const {
         std::lock_guard<std::mutex> lock(engineMutex_);
 
         try {
-            auto it = processCache_.find(instanceId);
-            if (it == processCache_.end()) {
-                throw std::runtime_error("Process instance not found: " + instanceId);
-            }
+            requireInstance(instanceId);
 
             //   
-            // auto state = executor_->getProcessState(instanceId);
-
-            //   -  JSON   
-            nlohmann::json state = {
-                {"instance_id", instanceId},
-                {"status", "active"},
-                {"current_element", "unknown"},
-                {"variables", nlohmann::json::object()}
-            };
+            nlohmann::json state = executor_->getProcessState(instanceId);
+            state["status"] = "active";
 
             return state.dump(4);
         }
@@ -159,10 +358,7 @@ namespace bpmn {
         std::lock_guard<std::mutex> lock(engineMutex_);
 
         try {
-            auto it = processCache_.find(instanceId);
-            if (it == processCache_.end()) {
-                throw std::runtime_error("Process instance not found: " + instanceId);
-            }
+            requireInstance(instanceId);
 
             //   
             // auto tasks = executor_->getActiveTasks(instanceId);
@@ -182,10 +378,7 @@ namespace bpmn {
         std::lock_guard<std::mutex> lock(engineMutex_);
 
         try {
-            auto it = processCache_.find(instanceId);
-            if (it == processCache_.end()) {
-                throw std::runtime_error("Process instance not found: " + instanceId);
-            }
+            requireInstance(instanceId);
 
             //  
             // executor_->suspendProcess(instanceId);
@@ -199,10 +392,7 @@ namespace bpmn {
         std::lock_guard<std::mutex> lock(engineMutex_);
 
         try {
-            auto it = processCache_.find(instanceId);
-            if (it == processCache_.end()) {
-                throw std::runtime_error("Process instance not found: " + instanceId);
-            }
+            requireInstance(instanceId);
 
             //  
             // executor_->resumeProcess(instanceId);
@@ -216,16 +406,13 @@ namespace bpmn {
         std::lock_guard<std::mutex> lock(engineMutex_);
 
         try {
-            auto it = processCache_.find(instanceId);
-            if (it == processCache_.end()) {
-                throw std::runtime_error("Process instance not found: " + instanceId);
-            }
+            requireInstance(instanceId);
 
             //  
             // executor_->terminateProcess(instanceId);
 
             //   
-            processCache_.erase(it);
+            processCache_.erase(instanceId);
         }
         catch (const std::exception& e) {
             throw std::runtime_error("Failed to terminate process: " + std::string(e.what()));
@@ -245,26 +432,58 @@ namespace bpmn {
 
     bool BpmnEngine::isProcessActive(const std::string& instanceId) const {
         std::lock_guard<std::mutex> lock(engineMutex_);
-        return processCache_.find(instanceId) != processCache_.end();
+        return processCache_.find(instanceId) != processCache_.end() || executor_->hasProcessInstance(instanceId);
     }
 
-    //  
-    std::string BpmnEngine::generateInstanceId() const {
-        std::random_device rd;
-        std::mt19937 gen(rd());
-        std::uniform_int_distribution<> dis(0, 15);
+    void BpmnEngine::requireInstance(const std::string& instanceId) const {
+        if (processCache_.find(instanceId) == processCache_.end() && !executor_->hasProcessInstance(instanceId)) {
+            throw std::runtime_error("Process instance not found: " + instanceId);
+        }
+    }
+
+    WorkStealingPool::Stats BpmnEngine::getWorkerPoolStats() const {
+        // Counters are atomic, no need for engineMutex_
+        return workerPool_->stats();
+    }
 
-        std::stringstream ss;
-        ss << std::hex;
+    std::string BpmnEngine::getMetricsPrometheus() const {
+        // Metrics synchronize themselves, no need for engineMutex_
+        return metrics_.toPrometheus();
+    }
 
-        for (int i = 0; i < 32; i++) {
-            if (i == 8 || i == 12 || i == 16 || i == 20) {
-                ss << "-";
-            }
-            ss << dis(gen);
+    std::string BpmnEngine::getMetricsJson() const {
+        return metrics_.toJson().dump();
+    }
+
+    void BpmnEngine::useInMemoryStore(const std::string& processId) {
+        std::lock_guard<std::mutex> lock(engineMutex_);
+        executor_->setStateStore(processId, memoryStore());
+    }
+
+    int BpmnEngine::deployInMemory(std::shared_ptr<const Process> process) {
+        const std::string processId = process->getId();
+        executor_->addProcessDefinition(std::move(process));
+        executor_->scheduleStartTimers(processId);
+        const int version = ++memoryVersions_[processId];
+        if (walStore_ && version == 1) {
+            // Timers logged before a restart; start timers were just scheduled again
+            executor_->loadTimers([&processId](const TimerService::Timer& timer) {
+                return timer.process_id == processId && timer.kind != "start";
+            });
         }
+        return version;
+    }
 
-        return ss.str();
+    InMemoryStateStore& BpmnEngine::memoryStore() {
+        if (!memoryStore_) {
+            memoryStore_ = std::make_unique<InMemoryStateStore>();
+        }
+        return *memoryStore_;
+    }
+
+    //  
+    std::string BpmnEngine::generateInstanceId() const {
+        return InstanceIdGenerator::global().next().toString();
     }
 
     void BpmnEngine::validateProcessDefinition(const std::string& processDefinition) const {
@@ -2,47 +2,423 @@
 #include "./bpmn/model.h"
 
 
+#include <algorithm>
+#include <atomic>
 #include <chrono>
+#include <condition_variable>
 #include <thread>
 #include <stdexcept>
 #include <sstream>
-#include <iostream>
-#include <boost/uuid/uuid.hpp>
-#include <boost/uuid/uuid_generators.hpp>
-#include <boost/uuid/uuid_io.hpp>
 
 namespace bpmn {
 
-    ProcessExecutor::ProcessExecutor(db::Database& db) : db_(db), random_engine_(random_device_()), uuid_generator_() {}
+    namespace {
+
+        // Owning copy of a caller's definition. Elements are shared, so the
+        // copy keeps them alive for tokens that outlive the caller's Process.
+        std::shared_ptr<const Process> copyDefinition(const Process& process) {
+            auto copy = std::make_shared<Process>(process.getId(), process.getName());
+            for (const auto& element : process.getElements()) {
+                copy->addElement(element);
+            }
+            for (const auto& flow : process.getSequenceFlows()) {
+                copy->addSequenceFlow(flow->getId(), flow->getName(), flow->source_ref, flow->target_ref, flow->condition_expression);
+            }
+            copy->setStartEventId(process.getStartEventId());
+            return copy;
+        }
+
+        // Fields of a JSON object payload become variables of their own; the
+        // caller sets the raw text under its usual name afterwards
+        void setPayloadFields(Variables& variables, const std::string& payload) {
+            const std::size_t first = payload.find_first_not_of(" \t\r\n");
+            if (first == std::string::npos || payload[first] != '{') {
+                return;
+            }
+            const json parsed = json::parse(payload, nullptr, false);
+            if (!parsed.is_object()) {
+                return;
+            }
+            Variables::fromJson(parsed).forEach([&variables](const std::string& name, const Variables::Value& value) {
+                variables.set(name, Container::cloneValue(value));
+            });
+        }
+
+    } // anonymous namespace
+
+    // Write buffer of one startProcesses call. Until flush() every checkpoint
+    // of the batch's instances lands here, the latest one per instance wins;
+    // afterwards the record methods return false and callers write directly.
+    // Flushing under the mutex keeps later direct writes behind the batch.
+    // Timers and subscriptions are held back too: armed before their instance
+    // is stored, they could fire or be correlated against a missing row.
+    class StartBatch {
+    public:
+        explicit StartBatch(std::size_t instances) {
+            instances_.reserve(instances);
+            slots_.reserve(instances);
+        }
+
+        bool saveInstance(const std::string& instance_id, const std::string& process_id,
+            const std::string& current_element, const std::map<std::string, std::string>& variables) {
+            if (flushed_.load(std::memory_order_acquire)) {
+                return false;
+            }
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (flushed_.load(std::memory_order_relaxed)) {
+                return false;
+            }
+            auto it = slots_.find(instance_id);
+            if (it == slots_.end()) {
+                it = slots_.emplace(instance_id, instances_.size()).first;
+                instances_.emplace_back();
+                instances_.back().instance_id = instance_id;
+            }
+            auto& record = instances_[it->second];
+            record.process_id = process_id;
+            record.current_element = current_element;
+            record.variables = variables;
+            record.completed = false;
+            return true;
+        }
+
+        bool completeInstance(const std::string& instance_id) {
+            if (flushed_.load(std::memory_order_acquire)) {
+                return false;
+            }
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (flushed_.load(std::memory_order_relaxed)) {
+                return false;
+            }
+            // The end event checkpoints first, so the record exists
+            auto it = slots_.find(instance_id);
+            if (it != slots_.end()) {
+                instances_[it->second].completed = true;
+            }
+            // Timers and subscriptions of other branches die with the instance
+            timers_.erase(std::remove_if(timers_.begin(), timers_.end(),
+                [&instance_id](const TimerService::Timer& timer) { return timer.instance_id == instance_id; }), timers_.end());
+            subscriptions_.erase(std::remove_if(subscriptions_.begin(), subscriptions_.end(),
+                [&instance_id](const MessageSubscriptions::Subscription& subscription) { return subscription.instance_id == instance_id; }),
+                subscriptions_.end());
+            return true;
+        }
+
+        bool saveUserTask(const std::string& instance_id, const std::string& task_id,
+            const std::string& form_key, const std::map<std::string, std::string>& variables) {
+            if (flushed_.load(std::memory_order_acquire)) {
+                return false;
+            }
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (flushed_.load(std::memory_order_relaxed)) {
+                return false;
+            }
+            userTasks_.push_back({ instance_id, task_id, form_key, variables });
+            return true;
+        }
+
+        bool saveError(const std::string& instance_id, const std::string& error_message) {
+            if (flushed_.load(std::memory_order_acquire)) {
+                return false;
+            }
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (flushed_.load(std::memory_order_relaxed)) {
+                return false;
+            }
+            errors_.emplace_back(instance_id, error_message);
+            return true;
+        }
+
+        bool armTimer(const TimerService::Timer& timer) {
+            if (flushed_.load(std::memory_order_acquire)) {
+                return false;
+            }
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (flushed_.load(std::memory_order_relaxed)) {
+                return false;
+            }
+            timers_.push_back(timer);
+            return true;
+        }
+
+        bool addSubscription(const MessageSubscriptions::Subscription& subscription) {
+            if (flushed_.load(std::memory_order_acquire)) {
+                return false;
+            }
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (flushed_.load(std::memory_order_relaxed)) {
+                return false;
+            }
+            subscriptions_.push_back(subscription);
+            return true;
+        }
+
+        // Instances first: task, error, timer and subscription rows reference
+        // them. The persisted timers and subscriptions are handed back for the
+        // caller to arm.
+        void flush(StateStore& store, std::vector<TimerService::Timer>& timers,
+            std::vector<MessageSubscriptions::Subscription>& subscriptions) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            flushed_.store(true, std::memory_order_release);
+            store.saveProcessInstancesWithTasks(instances_, userTasks_);
+            for (const auto& [instance_id, error_message] : errors_) {
+                store.saveError(instance_id, error_message);
+            }
+            for (const TimerService::Timer& timer : timers_) {
+                store.saveTimer(timer);
+            }
+            for (const MessageSubscriptions::Subscription& subscription : subscriptions_) {
+                store.saveMessageSubscription(subscription);
+            }
+            instances_.clear();
+            slots_.clear();
+            userTasks_.clear();
+            errors_.clear();
+            timers = std::move(timers_);
+            subscriptions = std::move(subscriptions_);
+            timers_.clear();
+            subscriptions_.clear();
+        }
+
+    private:
+        std::mutex mutex_;
+        std::atomic<bool> flushed_{ false };
+        std::vector<db::Database::ProcessInstanceRecord> instances_;
+        std::unordered_map<std::string, std::size_t> slots_;
+        std::vector<db::Database::UserTaskRecord> userTasks_;
+        std::vector<std::pair<std::string, std::string>> errors_;
+        std::vector<TimerService::Timer> timers_;
+        std::vector<MessageSubscriptions::Subscription> subscriptions_;
+    };
+
+    namespace {
+
+        // Counts a token in Metrics::activeTokens while it runs elements
+        class ActiveToken {
+        public:
+            explicit ActiveToken(Metrics& metrics) : metrics_(metrics) { metrics_.tokenActivated(); }
+            ~ActiveToken() { metrics_.tokenDeactivated(); }
+
+            ActiveToken(const ActiveToken&) = delete;
+            ActiveToken& operator=(const ActiveToken&) = delete;
+
+        private:
+            Metrics& metrics_;
+        };
+
+    } // anonymous namespace
+
+    // Indexed by ElementKind; nullptr marks kinds that cannot be executed
+    const ProcessExecutor::ElementHandler ProcessExecutor::elementHandlers_[static_cast<std::size_t>(ElementKind::Count)] = {
+        nullptr,                                                                                      // Unknown
+        &ProcessExecutor::dispatch<StartEvent, &ProcessExecutor::handleStartEvent>,                   // StartEvent
+        &ProcessExecutor::dispatch<EndEvent, &ProcessExecutor::handleEndEvent>,                       // EndEvent
+        &ProcessExecutor::dispatch<UserTask, &ProcessExecutor::handleUserTask>,                       // UserTask
+        &ProcessExecutor::dispatch<services::ServiceTask, &ProcessExecutor::handleServiceTask>,       // ServiceTask
+        &ProcessExecutor::dispatch<ParallelGateway, &ProcessExecutor::handleParallelGateway>,         // ParallelGateway
+        &ProcessExecutor::dispatch<ExclusiveGateway, &ProcessExecutor::handleExclusiveGateway>,       // ExclusiveGateway
+        &ProcessExecutor::dispatch<TimerCatchEvent, &ProcessExecutor::handleTimerCatchEvent>,         // TimerCatchEvent
+        &ProcessExecutor::dispatch<BoundaryEvent, &ProcessExecutor::handleBoundaryEvent>,             // BoundaryEvent
+        &ProcessExecutor::dispatch<MessageCatchEvent, &ProcessExecutor::handleMessageCatchEvent>,     // MessageCatchEvent
+        nullptr,                                                                                      // SequenceFlow
+    };
+
+    ProcessExecutor::ProcessExecutor(db::Database& db, std::size_t definition_cache_capacity)
+        : db_(&db), ownStore_(std::make_unique<DatabaseStateStore>(db)),
+        store_(ownStore_.get()), definitionCache_(definition_cache_capacity),
+        timers_(makeTimerService()), ownPool_(std::make_unique<WorkStealingPool>()), pool_(ownPool_.get()) {}
+
+    ProcessExecutor::ProcessExecutor(db::Database& db, WorkStealingPool& pool, std::size_t definition_cache_capacity)
+        : db_(&db), ownStore_(std::make_unique<DatabaseStateStore>(db)),
+        store_(ownStore_.get()), definitionCache_(definition_cache_capacity),
+        timers_(makeTimerService()), pool_(&pool) {}
+
+    ProcessExecutor::ProcessExecutor(StateStore& store, std::size_t definition_cache_capacity)
+        : db_(nullptr), store_(&store), definitionCache_(definition_cache_capacity),
+        timers_(makeTimerService()), ownPool_(std::make_unique<WorkStealingPool>()), pool_(ownPool_.get()) {}
+
+    ProcessExecutor::ProcessExecutor(StateStore& store, WorkStealingPool& pool, std::size_t definition_cache_capacity)
+        : db_(nullptr), store_(&store), definitionCache_(definition_cache_capacity),
+        timers_(makeTimerService()), pool_(&pool) {}
+
+    ProcessExecutor::~ProcessExecutor() {
+        // The timer thread submits to the pool, stop it before anything goes away
+        stopTimers();
+    }
+
+    std::unique_ptr<TimerService> ProcessExecutor::makeTimerService() {
+        // The thread only starts with the first timer, by then pool_ is set
+        return std::make_unique<TimerService>([this](TimerService::Timer timer) {
+            pool_->submit([this, timer = std::move(timer)]() {
+                fireTimer(timer);
+            });
+        });
+    }
 
     std::string ProcessExecutor::startProcessById(const std::string& process_id, const std::string& init_data, std::function<bool(const std::string&)> user_task_callback) {
-        const std::string processXml = db_.loadProcessDefinition(process_id);
-        BpmnParser parser = BpmnParser();
-        const auto processDefinition = parser.parse(processXml);
-        return startProcess(*processDefinition, init_data, user_task_callback);
+        return startProcess(getProcessDefinition(process_id), init_data, user_task_callback);
     }
-    
+
     std::string ProcessExecutor::startProcess(const Process& process, const std::string& init_data, std::function<bool(const std::string&)> user_task_callback) {
+        // Pool tasks and suspended tokens outlive the call, so they must not
+        // point into the caller's object
+        return startProcess(copyDefinition(process), init_data, user_task_callback);
+    }
+
+    std::string ProcessExecutor::startProcess(std::shared_ptr<const Process> process, const std::string& init_data, std::function<bool(const std::string&)> user_task_callback) {
+        if (!process) {
+            throw std::invalid_argument("Cannot start null process definition");
+        }
+
         // Generate unique process instance ID
 
         std::string instance_id = generate_uuid();
 
+        const ProcessGraph& graph = process->getGraph();
+        if (graph.startElement() == ProcessGraph::npos) {
+            throw std::runtime_error("Process has no start event: " + process->getId());
+        }
+        if (graph.parallelWait() != ProcessGraph::npos) {
+            throw std::runtime_error("Timer and message events inside parallel branches are not supported: " + graph.elementId(graph.parallelWait()));
+        }
+
         ExecutionState state;
-        state.current_element = process.getStartEventId();
-        state.variables["init_data"] = init_data;
-        state.process_id = process.getId();
+        state.current_index = graph.startElement();
+        setPayloadFields(state.variables, init_data);
+        state.variables.set("init_data", init_data);
+        state.process_id = process->getId();
+        state.store = &storeFor(state.process_id);
+        state.definition = std::move(process);
 
-        saveState(instance_id, state);
-        executeElement(instance_id, state.current_element, state);
-        if (state.isPaused) {
-            if (!user_task_callback(state.current_element)) {
-                return "";
+        // Nothing is written until the first checkpoint
+        return finishRun(instance_id, run(instance_id, state, stepBudget_), state, user_task_callback);
+    }
+
+    std::vector<StartResult> ProcessExecutor::startProcessesById(const std::string& process_id, const std::vector<std::string>& init_data) {
+        return startProcesses(getProcessDefinition(process_id), init_data);
+    }
+
+    std::vector<StartResult> ProcessExecutor::startProcesses(std::shared_ptr<const Process> process, const std::vector<std::string>& init_data) {
+        if (!process) {
+            throw std::invalid_argument("Cannot start null process definition");
+        }
+
+        // Built once here instead of racing in the first segments
+        const ProcessGraph& graph = process->getGraph();
+        if (graph.startElement() == ProcessGraph::npos) {
+            throw std::runtime_error("Process has no start event: " + process->getId());
+        }
+        if (graph.parallelWait() != ProcessGraph::npos) {
+            throw std::runtime_error("Timer and message events inside parallel branches are not supported: " + graph.elementId(graph.parallelWait()));
+        }
+
+        std::vector<StartResult> results(init_data.size());
+        for (StartResult& result : results) {
+            result.instance_id = generate_uuid();
+        }
+        if (results.empty()) {
+            return results;
+        }
+
+        // Instances are claimed in chunks by the caller and by up to one helper
+        // per worker. Helpers that start late find nothing left and return, so
+        // the caller only waits for chunks that were actually claimed.
+        constexpr std::size_t kChunk = 64;
+        struct Progress {
+            std::atomic<std::size_t> next{ 0 };
+            std::size_t done = 0;
+            std::mutex mutex;
+            std::condition_variable finished;
+        };
+        auto progress = std::make_shared<Progress>();
+        const std::size_t chunks = (results.size() + kChunk - 1) / kChunk;
+        auto batch = std::make_shared<StartBatch>(results.size());
+
+        auto work = [this, progress, chunks, process, batch, &init_data, &results]() {
+            std::size_t chunk;
+            while ((chunk = progress->next.fetch_add(1)) < chunks) {
+                const std::size_t first = chunk * kChunk;
+                const std::size_t last = std::min(first + kChunk, results.size());
+                for (std::size_t i = first; i < last; ++i) {
+                    startBatchedInstance(process, init_data[i], batch, results[i]);
+                }
+                std::lock_guard<std::mutex> lock(progress->mutex);
+                if (++progress->done == chunks) {
+                    progress->finished.notify_all();
+                }
+            }
+        };
+
+        const std::size_t helpers = std::min(pool_->size(), chunks - 1);
+        for (std::size_t i = 0; i < helpers; ++i) {
+            pool_->submit(work);
+        }
+        work();
+        {
+            std::unique_lock<std::mutex> lock(progress->mutex);
+            progress->finished.wait(lock, [&progress, chunks]() { return progress->done == chunks; });
+        }
+
+        std::vector<TimerService::Timer> timers;
+        std::vector<MessageSubscriptions::Subscription> subscriptions;
+        batch->flush(storeFor(process->getId()), timers, subscriptions);
+        if (!timers.empty()) {
+            timers_->schedule(std::move(timers));
+        }
+        if (!subscriptions.empty()) {
+            messages_.add(subscriptions);
+        }
+        return results;
+    }
+
+    void ProcessExecutor::startBatchedInstance(const std::shared_ptr<const Process>& process, const std::string& init_data,
+        const std::shared_ptr<StartBatch>& batch, StartResult& result) {
+        const ProcessGraph& graph = process->getGraph();
+
+        ExecutionState state;
+        state.current_index = graph.startElement();
+        setPayloadFields(state.variables, init_data);
+        state.variables.set("init_data", init_data);
+        state.process_id = process->getId();
+        state.definition = process;
+        state.batch = batch;
+        state.store = &storeFor(state.process_id);
+
+        try {
+            switch (run(result.instance_id, state, stepBudget_)) {
+            case RunResult::Waiting:
+                result.status = StartResult::Status::Waiting;
+                result.current_element = graph.elementId(state.current_index);
+                break;
+            case RunResult::Yielded:
+                result.status = StartResult::Status::Running;
+                result.current_element = graph.elementId(state.current_index);
+                break;
+            case RunResult::Stopped:
+                // A fork also stops the caller's token
+                result.status = state.isCompleted ? StartResult::Status::Completed : StartResult::Status::Running;
+                break;
+            case RunResult::Suspended:
+                result.status = StartResult::Status::Running;
+                break;
+            }
+        }
+        catch (const std::exception& e) {
+            result.status = StartResult::Status::Failed;
+            result.error = e.what();
+            try {
+                handleError(result.instance_id, "Process start failed: " + result.error, state);
+            }
+            catch (const std::exception&) {
+                // Already reported through result
             }
         }
-        return instance_id;
     }
     nlohmann::json ProcessExecutor::getFormById(const std::string formId) const {
-        return db_.getFormById(formId);
+        if (!db_) {
+            throw std::runtime_error("Forms are not available without a database");
+        }
+        return db_->getFormById(formId);
     };
 
     const ExecutionState& ProcessExecutor::getExecutionState(const std::string& instanceId) const {
@@ -52,18 +428,107 @@ namespace bpmn {
         return *lastState_;
     };
 
-    void ProcessExecutor::completeTask(const std::string& instance_id, const std::string& user_task, const std::string& user_task_callback) {
-    
-    };
+    json ProcessExecutor::getProcessState(const std::string& instance_id) {
+        const ExecutionState state = loadState(instance_id);
+        return json{
+            {"instance_id", instance_id},
+            {"process_id", state.process_id},
+            {"current_element", state.current_element},
+            {"variables", state.variables.toJson()}
+        };
+    }
+
+    bool ProcessExecutor::hasProcessInstance(const std::string& instance_id) const {
+        for (StateStore* store : allStores()) {
+            if (store->containsProcessInstance(instance_id)) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void ProcessExecutor::setMetrics(Metrics& metrics) {
+        std::lock_guard<std::mutex> lock(elementTimersMutex_);
+        metrics_ = &metrics;
+        // Runs in progress keep recording into the old metrics
+        elementTimers_.clear();
+    }
+
+    std::shared_ptr<ProcessExecutor::ElementTimers> ProcessExecutor::elementTimersFor(const std::shared_ptr<const Process>& definition) {
+        std::lock_guard<std::mutex> lock(elementTimersMutex_);
+        auto it = elementTimers_.find(definition.get());
+        if (it != elementTimers_.end() && !it->second->definition.expired()) {
+            return it->second;
+        }
+        // A miss means a new definition; drop the entries of unloaded ones
+        for (auto stale = elementTimers_.begin(); stale != elementTimers_.end();) {
+            stale = stale->second->definition.expired() ? elementTimers_.erase(stale) : std::next(stale);
+        }
+        auto timers = std::make_shared<ElementTimers>();
+        timers->definition = definition;
+        timers->metrics = metrics_;
+        timers->histograms.reset(new std::atomic<LatencyHistogram*>[definition->getGraph().elementCount()]());
+        elementTimers_[definition.get()] = timers;
+        return timers;
+    }
+
+    ProcessDefinitionCache::Stats ProcessExecutor::getDefinitionCacheStats() const {
+        return definitionCache_.stats();
+    }
+
+    WorkStealingPool::Stats ProcessExecutor::getWorkerPoolStats() const {
+        return pool_->stats();
+    }
+
+    bool ProcessExecutor::completeTask(const std::string& instance_id, const std::string& user_task, const std::string& user_task_result) {
+        std::unique_lock<std::mutex> claim = lockInstance(instance_id);
+        ExecutionState state = loadState(instance_id);
+        // A boundary timer may have taken the token out of the task first
+        if (state.current_element != user_task || state.definition->getGraph().kind(state.current_index) != ElementKind::UserTask) {
+            return false;
+        }
+        resumeUserTask(instance_id, state, user_task_result);
+        return true;
+    }
 
 
     std::string ProcessExecutor::resumeProcess(const std::string& instance_id, const std::string& user_task_result, std::function<bool(const std::string&)> user_task_callback) {
+        std::unique_lock<std::mutex> claim = lockInstance(instance_id);
         ExecutionState state = std::move(loadState(instance_id));
-        state.variables["user_task_result"] = user_task_result;
+        const RunResult result = resumeUserTask(instance_id, state, user_task_result);
+        claim.unlock();
+        return finishRun(instance_id, result, state, user_task_callback);
+    }
 
-        saveState(instance_id, state);
-        executeElement(instance_id, state.current_element, state);
-        if (state.isPaused) {
+    ProcessExecutor::RunResult ProcessExecutor::resumeUserTask(const std::string& instance_id, ExecutionState& state, const std::string& user_task_result) {
+        setPayloadFields(state.variables, user_task_result);
+        state.variables.set("user_task_result", user_task_result);
+
+        // The user task itself already ran when the instance paused on it
+        if (state.definition->getGraph().kind(state.current_index) == ElementKind::UserTask) {
+            cancelBoundaryTimers(instance_id, state);
+            const ProcessGraph::Index next = firstSuccessor(state);
+            if (next == ProcessGraph::npos) {
+                throw std::runtime_error("No outgoing sequence flows from user task: " + state.current_element);
+            }
+            state.current_index = next;
+        }
+        return run(instance_id, state, stepBudget_);
+    }
+
+    std::string ProcessExecutor::continueProcess(const std::string& instance_id, std::function<bool(const std::string&)> user_task_callback) {
+        // Claimed like a waiting token, a concurrent continue or timer sees the next checkpoint
+        std::unique_lock<std::mutex> claim = lockInstance(instance_id);
+        ExecutionState state = loadState(instance_id);
+        const RunResult result = run(instance_id, state, stepBudget_);
+        claim.unlock();
+        return finishRun(instance_id, result, state, user_task_callback);
+    }
+
+    std::string ProcessExecutor::finishRun(const std::string& instance_id, RunResult result, ExecutionState& state, const std::function<bool(const std::string&)>& user_task_callback) {
+        // Timer waits are not reported, nothing can be done about them from outside
+        if (result == RunResult::Waiting && user_task_callback &&
+            state.definition->getGraph().kind(state.current_index) == ElementKind::UserTask) {
             if (!user_task_callback(state.current_element)) {
                 return "";
             }
@@ -71,241 +536,794 @@ namespace bpmn {
         return instance_id;
     }
 
-    void ProcessExecutor::executeElement(const std::string& instance_id, const std::string& element_id, ExecutionState& state) {
-        const Process* process = getProcessDefinition(state.process_id);
-        if (!process) {
+    ProcessExecutor::RunResult ProcessExecutor::run(const std::string& instance_id, ExecutionState& state, std::size_t budget) {
+        state.isPaused = false;
+        if (!state.definition) {
             throw std::runtime_error("Process definition not found: " + state.process_id);
         }
-
-        FlowElement* element = process->getElement(element_id);
-        if (!element) {
-            throw std::runtime_error("Element not found: " + element_id);
+        // Held for the whole run, a suspending handler moves state out
+        const std::shared_ptr<ElementTimers> timers = elementTimersFor(state.definition);
+        const ActiveToken active(*metrics_);
+        // Wait states, async boundaries, the end and errors checkpoint in their
+        // handlers; plain automated steps only every checkpointPolicy_.everySteps
+        std::size_t since_checkpoint = 0;
+        for (std::size_t steps = 0; budget == 0 || steps < budget; ++steps) {
+            switch (executeElement(instance_id, state.current_index, state, *timers)) {
+            case Step::Advance:
+                if (checkpointPolicy_.everySteps != 0 && ++since_checkpoint >= checkpointPolicy_.everySteps) {
+                    saveState(instance_id, state);
+                    since_checkpoint = 0;
+                }
+                break;
+            case Step::Wait:
+                return RunResult::Waiting;
+            case Step::Stop:
+                return RunResult::Stopped;
+            case Step::Suspend:
+                return RunResult::Suspended;
+            }
         }
+        // continueProcess picks the instance up from the database
+        saveState(instance_id, state);
+        return RunResult::Yielded;
+    }
 
-        // Handle different element types
-        if (auto start_event = dynamic_cast<StartEvent*>(element)) {
-            handleStartEvent(instance_id, *start_event, state);
-        }
-        else if (auto user_task = dynamic_cast<UserTask*>(element)) {
-            handleUserTask(instance_id, *user_task, state);
-        }
-        else if (auto service_task = dynamic_cast<services::ServiceTask*>(element)) {
-            handleServiceTask(instance_id, *service_task, state);
+    ProcessExecutor::Step ProcessExecutor::executeElement(const std::string& instance_id, ProcessGraph::Index element_index, ExecutionState& state,
+        ElementTimers& timers) {
+        const ProcessGraph& graph = state.definition->getGraph();
+        if (element_index >= graph.elementCount()) {
+            throw std::runtime_error("Element not found: #" + std::to_string(element_index));
         }
-        else if (auto parallel_gateway = dynamic_cast<ParallelGateway*>(element)) {
-            handleParallelGateway(instance_id, *parallel_gateway, state);
-        }
-        else if (auto exclusive_gateway = dynamic_cast<ExclusiveGateway*>(element)) {
-            handleExclusiveGateway(instance_id, *exclusive_gateway, state);
+
+        state.current_index = element_index;
+
+        // One indexed load instead of a dynamic_cast chain
+        const ElementHandler handler = elementHandlers_[static_cast<std::size_t>(graph.kind(element_index))];
+        if (!handler) {
+            throw std::runtime_error("Unsupported element type: " + graph.elementId(element_index));
         }
-        else if (auto end_event = dynamic_cast<EndEvent*>(element)) {
-            handleEndEvent(instance_id, *end_event, state);
+        // Looked up before the call, the handler may move state out
+        std::atomic<LatencyHistogram*>& slot = timers.histograms[element_index];
+        LatencyHistogram* resolved = slot.load(std::memory_order_acquire);
+        if (!resolved) {
+            resolved = &timers.metrics->element(state.process_id, graph.elementId(element_index));
+            slot.store(resolved, std::memory_order_release);
         }
-        else {
-            throw std::runtime_error("Unsupported element type: " + std::string(typeid(*element).name()));
+        LatencyHistogram& histogram = *resolved;
+        if constexpr (Logger::compiledIn(LogLevel::Trace)) {
+            if (logger_->enabled(LogLevel::Trace)) {
+                // Suspending handlers move state out, the definition stays alive here
+                const std::shared_ptr<const Process> definition = state.definition;
+                const auto started = std::chrono::steady_clock::now();
+                const Step step = (this->*handler)(instance_id, *graph.element(element_index), state);
+                const auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - started);
+                histogram.record(elapsed);
+                logger_->log<LogLevel::Trace>("Element executed",
+                    { instance_id, graph.elementId(element_index), static_cast<std::uint64_t>(elapsed.count()) });
+                return step;
+            }
         }
+        const ScopedLatency timer(&histogram);
+        return (this->*handler)(instance_id, *graph.element(element_index), state);
     }
 
-    void ProcessExecutor::handleStartEvent(const std::string& instance_id, const StartEvent& start_event, ExecutionState& state) {
-        log("Process instance " + instance_id + " started");
+    ProcessExecutor::Step ProcessExecutor::handleStartEvent(const std::string& instance_id, const StartEvent& start_event, ExecutionState& state) {
+        logger_->log<LogLevel::Info>("Process instance started", { instance_id, start_event.getId() });
+        metrics_->instanceStarted();
 
         // Move to next element
-        auto next_elements = getOutgoingElements(start_event.getId(), state.process_id);
-        if (next_elements.empty()) {
+        const ProcessGraph::Index next = firstSuccessor(state);
+        if (next == ProcessGraph::npos) {
             throw std::runtime_error("No outgoing sequence flows from start event");
         }
 
-        state.current_element = next_elements[0]->getId();
-        saveState(instance_id, state);
-        executeElement(instance_id, state.current_element, state);
+        state.current_index = next;
+        return Step::Advance;
     }
 
-    void ProcessExecutor::handleUserTask(const std::string& instance_id, const UserTask& user_task, ExecutionState& state) {
-        log("User task reached: " + user_task.getId());
+    ProcessExecutor::Step ProcessExecutor::handleUserTask(const std::string& instance_id, const UserTask& user_task, ExecutionState& state) {
+        logger_->log<LogLevel::Debug>("User task reached", { instance_id, user_task.getId() });
+
+        // Checkpoint first, the task row references the instance
+        state.isPaused = true;
+        saveState(instance_id, state);
 
         // Save task to database for human completion
-        db_.saveUserTask(instance_id, user_task.getId(), user_task.form_key, state.variables);
+        const std::map<std::string, std::string> variables = state.variables.toStringMap();
+        if (!state.batch || !state.batch->saveUserTask(instance_id, user_task.getId(), user_task.form_key, variables)) {
+            storeOf(state).saveUserTask(instance_id, user_task.getId(), user_task.form_key, variables);
+        }
+
+        // Boundary timers run while the task waits
+        const ProcessGraph& graph = state.definition->getGraph();
+        for (ProcessGraph::Index boundary : graph.boundaryEvents(state.current_index)) {
+            const auto& boundary_event = static_cast<const BoundaryEvent&>(*graph.element(boundary));
+            armTimer(storeOf(state), state.batch.get(), instance_id, boundary_event.getId(), state.process_id, "boundary", boundary_event.timer);
+        }
 
         // Process pauses here until resumed via REST API
+        return Step::Wait;
     }
 
-    void ProcessExecutor::handleServiceTask(const std::string& instance_id, const services::ServiceTask& service_task, ExecutionState& state) {
-        log("Executing service task: " + service_task.getId());
+    ProcessExecutor::Step ProcessExecutor::handleServiceTask(const std::string& instance_id, const services::ServiceTask& service_task, ExecutionState& state) {
+        logger_->log<LogLevel::Debug>("Executing service task", { instance_id, service_task.getId() });
+
+        if (checkpointPolicy_.atAsyncBoundaries) {
+            saveState(instance_id, state);
+        }
 
+        // The token leaves the run loop until the service calls back, so no
+        // thread is held while the call is in flight
+        auto token = std::make_shared<ExecutionState>(std::move(state));
+        ++inFlightServiceCalls_;
         try {
-            // Execute the service (implementation would be in a separate service layer)
-            //service_executor_.execute(service_task, state.variables);
+            service_task.executeAsync(*token, [this, instance_id, token, &service_task](json result) {
+                pool_->submit([this, instance_id, token, &service_task, result = std::move(result)]() {
+                    resumeServiceTask(instance_id, service_task, *token, result);
+                });
+            });
+        }
+        catch (const std::exception& e) {
+            --inFlightServiceCalls_;
+            handleError(instance_id, "Service task failed: " + std::string(e.what()), *token);
+        }
+        return Step::Suspend;
+    }
+
+    void ProcessExecutor::resumeServiceTask(const std::string& instance_id, const services::ServiceTask& service_task, ExecutionState& state, const json& result) {
+        --inFlightServiceCalls_;
+        try {
+            if (result.is_object() && result.contains("error")) {
+                handleError(instance_id, "Service task failed: " + result["error"].dump(), state);
+                return;
+            }
+            // Tasks without an implementation return nothing and set nothing
+            if (!result.is_null()) {
+                state.variables.set(service_task.getId(), Variables::valueFromJson(result));
+            }
 
             // Move to next element
-            auto next_elements = getOutgoingElements(service_task.getId(), state.process_id);
-            if (!next_elements.empty()) {
-                state.current_element = next_elements[0]->getId();
-                saveState(instance_id, state);
-                executeElement(instance_id, state.current_element, state);
+            const ProcessGraph::Index next = firstSuccessor(state);
+            if (next == ProcessGraph::npos) {
+                return;
             }
+            state.current_index = next;
+            // Resumed tokens run to their next wait state on the pool
+            run(instance_id, state, 0);
         }
         catch (const std::exception& e) {
             handleError(instance_id, "Service task failed: " + std::string(e.what()), state);
         }
     }
 
-    void ProcessExecutor::handleParallelGateway(const std::string& instance_id,
+    ProcessExecutor::Step ProcessExecutor::handleParallelGateway(const std::string& instance_id,
         const ParallelGateway& gateway,
         ExecutionState& state) {
-        log("Processing parallel gateway: " + gateway.getId());
+        logger_->log<LogLevel::Debug>("Processing parallel gateway", { instance_id, gateway.getId() });
+
+        const ProcessGraph& graph = state.definition->getGraph();
+        const ProcessGraph::Index gateway_index = state.current_index;
+        if (graph.joinCount() > 0 && !state.joins) {
+            state.joins = joinCountersFor(instance_id, graph);
+        }
+
+        // Join: every arriving token but the last one ends here, the last one
+        // carries on through the gateway with the variables of all branches.
+        // Nobody waits for the others.
+        const ProcessGraph::Index join_slot = graph.joinSlot(gateway_index);
+        if (join_slot != ProcessGraph::npos) {
+            const auto expected = static_cast<std::uint32_t>(graph.incoming(gateway_index).size());
+            state.joins->deposit(join_slot, state.variables.takeDelta());
+            if (!state.joins->arrive(join_slot, expected)) {
+                logger_->log<LogLevel::Debug>("Token waits for other branches", { instance_id, gateway.getId() });
+                return Step::Stop;
+            }
+            state.variables.join(state.joins->collect(join_slot), variableMergePolicy_);
+        }
 
-        auto outgoing_flows = getProcessDefinition(state.process_id)->getOutgoingFlows(gateway.getId());
+        const ProcessGraph::Range outgoing_flows = graph.outgoing(gateway_index);
         if (outgoing_flows.empty()) {
             throw std::runtime_error("No outgoing flows from parallel gateway");
         }
-        // Execute all outgoing paths in parallel
-        std::vector<std::future<void>> futures;
-        for (const auto& flow : outgoing_flows) {
-            futures.emplace_back(std::async(std::launch::async,
-                [this, instance_id, target = flow->target_ref,
+        if (outgoing_flows.size() == 1) {
+            state.current_index = graph.flowTarget(outgoing_flows[0]);
+            return Step::Advance;
+        }
+
+        if (checkpointPolicy_.atAsyncBoundaries) {
+            saveState(instance_id, state);
+        }
+
+        // Every outgoing path becomes a pool task; the gateway does not wait
+        // for them, so nested forks never tie up a worker. Branches share the
+        // variables read-only and keep their own writes.
+        const Variables scope = state.variables.fork();
+        for (ProcessGraph::Index flow : outgoing_flows) {
+            pool_->submit([this, instance_id, target = graph.flowTarget(flow),
                 proc_id = state.process_id,  // Copy only primitives
-                vars = state.variables]() {  // Copy only needed data
+                definition = state.definition,
+                joins = state.joins,
+                batch = state.batch,
+                store = state.store,
+                vars = scope]() {  // Shares the values, copies no variable
                     // Create fresh state without futures
                     ExecutionState branch_state;
                     branch_state.process_id = proc_id;
-                    branch_state.current_element = target;
-                    branch_state.variables = vars;  // Copy is safe (no futures)
+                    branch_state.definition = definition;
+                    branch_state.joins = joins;
+                    branch_state.batch = batch;
+                    branch_state.store = store;
+                    branch_state.current_index = target;
+                    branch_state.variables = vars;
 
-                    executeElement(instance_id, target, branch_state);
-                }));
+                    try {
+                        // Branches run to their next wait state, the budget applies to callers
+                        run(instance_id, branch_state, 0);
+                    }
+                    catch (const std::exception& e) {
+                        handleError(instance_id, "Parallel branch failed: " + std::string(e.what()), branch_state);
+                    }
+                });
         }
 
-        // Store only if needed (otherwise they'll block in destructor)
-        state.parallel_tasks = std::move(futures);
+        return Step::Stop;
+    }
 
-        // Wait for all branches to complete
-        for (auto& future : futures) {
-            future.wait();
+    std::shared_ptr<JoinCounters> ProcessExecutor::joinCountersFor(const std::string& instance_id, const ProcessGraph& graph) {
+        std::lock_guard<std::mutex> lock(joinsMutex_);
+        std::shared_ptr<JoinCounters>& counters = joins_[instance_id];
+        if (!counters) {
+            counters = std::make_shared<JoinCounters>(graph.joinCount());
         }
-
-        handleGatewayCompletion(instance_id, gateway.getId(), state);
+        return counters;
     }
-    void ProcessExecutor::handleGatewayCompletion(const std::string& instance_id, const std::string& gateway_id, ExecutionState& state) {
-    
+
+    void ProcessExecutor::releaseJoinCounters(const std::string& instance_id) {
+        // Tokens still holding the counters keep them alive
+        std::lock_guard<std::mutex> lock(joinsMutex_);
+        joins_.erase(instance_id);
     }
     
     
-    void ProcessExecutor::handleExclusiveGateway(const std::string& instance_id, const ExclusiveGateway& gateway, ExecutionState& state) {
-        log("Processing exclusive gateway: " + gateway.getId());
+    ProcessExecutor::Step ProcessExecutor::handleExclusiveGateway(const std::string& instance_id, const ExclusiveGateway& gateway, ExecutionState& state) {
+        logger_->log<LogLevel::Debug>("Processing exclusive gateway", { instance_id, gateway.getId() });
 
-        auto outgoing_flows = getProcessDefinition(state.process_id)->getOutgoingFlows(gateway.getId());
+        const ProcessGraph& graph = state.definition->getGraph();
+        const ProcessGraph::Range outgoing_flows = graph.outgoing(state.current_index);
         if (outgoing_flows.empty()) {
             throw std::runtime_error("No outgoing flows from exclusive gateway");
         }
 
-        // Evaluate conditions to choose the right path
-        std::shared_ptr<SequenceFlow> selected_flow;
-        //for (const auto& flow : outgoing_flows) {
-        //    if (flow->condition_expression.empty() ||
-        //        condition_evaluator_.evaluate(flow->condition_expression, state.variables)) {
-        //        selected_flow = flow;
-        //        break;
-        //    }
-        //}
+        // First flow in document order whose condition holds; the default flow
+        // is only taken when no other flow matches
+        const ProcessGraph::Index default_flow = graph.defaultFlow(state.current_index);
+        ProcessGraph::Index selected_flow = ProcessGraph::npos;
+        for (ProcessGraph::Index flow : outgoing_flows) {
+            if (flow == default_flow) {
+                continue;
+            }
+            const auto& condition = graph.flow(flow)->condition;
+            if (!condition || condition->evaluate(state.variables)) {
+                selected_flow = flow;
+                break;
+            }
+        }
 
-        if (!selected_flow) {
-            selected_flow = getDefaultFlow(gateway, outgoing_flows);
+        if (selected_flow == ProcessGraph::npos) {
+            selected_flow = default_flow;
         }
 
-        if (selected_flow) {
-            state.current_element = selected_flow->target_ref;
-            saveState(instance_id, state);
-            executeElement(instance_id, state.current_element, state);
+        if (selected_flow != ProcessGraph::npos) {
+            state.current_index = graph.flowTarget(selected_flow);
+            return Step::Advance;
         }
         else {
             throw std::runtime_error("No valid outgoing sequence flow from exclusive gateway");
         }
     }
 
-    void ProcessExecutor::handleEndEvent(const std::string& instance_id, const EndEvent& end_event, ExecutionState& state) {
-        log("Process instance " + instance_id + " completed");
-        db_.completeProcessInstance(instance_id);
+    ProcessExecutor::Step ProcessExecutor::handleEndEvent(const std::string& instance_id, const EndEvent& end_event, ExecutionState& state) {
+        logger_->log<LogLevel::Info>("Process instance completed", { instance_id, end_event.getId() });
+        metrics_->instanceCompleted();
+        state.isCompleted = true;
+        saveState(instance_id, state);
+        if (!state.batch || !state.batch->completeInstance(instance_id)) {
+            storeOf(state).completeProcessInstance(instance_id);
+        }
+        releaseJoinCounters(instance_id);
+        // Timers of other branches die with the instance
+        if (state.definition->getGraph().hasTimers()) {
+            timers_->cancelInstance(instance_id);
+            storeOf(state).deleteTimers(instance_id);
+        }
+        if (state.definition->getGraph().hasMessageEvents() && messages_.removeInstance(instance_id) > 0) {
+            storeOf(state).deleteMessageSubscriptions(instance_id);
+        }
+        return Step::Stop;
+    }
+
+    ProcessExecutor::Step ProcessExecutor::handleMessageCatchEvent(const std::string& instance_id, const MessageCatchEvent& message_event, ExecutionState& state) {
+        logger_->log<LogLevel::Debug>(message_event.signal ? "Waiting for signal" : "Waiting for message",
+            { instance_id, message_event.getId() }, message_event.message_name);
+
+        MessageSubscriptions::Subscription subscription;
+        subscription.instance_id = instance_id;
+        subscription.element_id = message_event.getId();
+        subscription.message_name = message_event.message_name;
+        if (!message_event.correlation_variable.empty()) {
+            if (const Variables::Value* key = state.variables.find(message_event.correlation_variable)) {
+                subscription.correlation_key = Variables::toString(*key);
+            }
+        }
+
+        // Checkpoint and subscription are written before the token can be found
+        state.isPaused = true;
+        saveState(instance_id, state);
+        if (!state.batch || !state.batch->addSubscription(subscription)) {
+            storeOf(state).saveMessageSubscription(subscription);
+            messages_.add(subscription);
+        }
+        return Step::Wait;
+    }
+
+    std::string ProcessExecutor::correlateMessage(const std::string& message_name, const std::string& correlation_key,
+        const std::string& data, std::function<bool(const std::string&)> user_task_callback) {
+        // The message is only consumed by a token it actually resumes
+        std::string result;
+        for (const MessageSubscriptions::Subscription& subscription : messages_.find(message_name, correlation_key)) {
+            if (resumeMessageEvent(subscription, data, user_task_callback, result)) {
+                return result;
+            }
+        }
+        return "";
+    }
+
+    bool ProcessExecutor::deliverMessage(const std::string& instance_id, const std::string& message_name,
+        const std::string& data, std::function<bool(const std::string&)> user_task_callback) {
+        MessageSubscriptions::Subscription subscription;
+        if (!messages_.findForInstance(instance_id, message_name, subscription)) {
+            return false;
+        }
+        std::string result;
+        return resumeMessageEvent(subscription, data, user_task_callback, result);
+    }
+
+    std::size_t ProcessExecutor::broadcastSignal(const std::string& signal_name, const std::string& data) {
+        // Signals carry no correlation key
+        std::vector<MessageSubscriptions::Subscription> subscriptions = messages_.find(signal_name, "");
+        for (auto& subscription : subscriptions) {
+            pool_->submit([this, subscription, data]() {
+                try {
+                    std::string result;
+                    resumeMessageEvent(subscription, data, nullptr, result);
+                }
+                catch (const std::exception& e) {
+                    logger_->log<LogLevel::Error>("Signal delivery failed", { subscription.instance_id, subscription.element_id }, e.what());
+                }
+            });
+        }
+        return subscriptions.size();
+    }
+
+    bool ProcessExecutor::resumeMessageEvent(const MessageSubscriptions::Subscription& subscription, const std::string& data,
+        const std::function<bool(const std::string&)>& user_task_callback, std::string& result) {
+        std::unique_lock<std::mutex> claim = lockInstance(subscription.instance_id);
+        ExecutionState state = loadState(subscription.instance_id);
+        if (state.current_element != subscription.element_id) {
+            // The stored token is elsewhere, e.g. in another parallel branch;
+            // the subscription stays and the message goes to the next one
+            return false;
+        }
+        // A concurrent delivery to the same token may have taken it first
+        if (!messages_.remove(subscription)) {
+            return false;
+        }
+        storeOf(state).deleteMessageSubscription(subscription.instance_id, subscription.element_id);
+
+        // The payload is available to later elements under the message name
+        setPayloadFields(state.variables, data);
+        state.variables.set(subscription.message_name, data);
+        const ProcessGraph::Index next = firstSuccessor(state);
+        if (next == ProcessGraph::npos) {
+            throw std::runtime_error("No outgoing sequence flows from message event: " + subscription.element_id);
+        }
+        state.current_index = next;
+
+        const RunResult run_result = run(subscription.instance_id, state, stepBudget_);
+        claim.unlock();
+        result = finishRun(subscription.instance_id, run_result, state, user_task_callback);
+        return true;
+    }
+
+    std::size_t ProcessExecutor::loadMessageSubscriptions() {
+        std::size_t count = 0;
+        for (StateStore* store : allStores()) {
+            const std::vector<MessageSubscriptions::Subscription> subscriptions = store->loadMessageSubscriptions();
+            messages_.add(subscriptions);
+            count += subscriptions.size();
+        }
+        return count;
+    }
+
+    ProcessExecutor::Step ProcessExecutor::handleTimerCatchEvent(const std::string& instance_id, const TimerCatchEvent& timer_event, ExecutionState& state) {
+        logger_->log<LogLevel::Debug>("Timer catch event reached", { instance_id, timer_event.getId() });
+
+        // Checkpoint first, fireTimer loads the instance from the database
+        state.isPaused = true;
+        saveState(instance_id, state);
+        armTimer(storeOf(state), state.batch.get(), instance_id, timer_event.getId(), state.process_id, "catch", timer_event.timer);
+        return Step::Wait;
+    }
+
+    ProcessExecutor::Step ProcessExecutor::handleBoundaryEvent(const std::string& instance_id, const BoundaryEvent& boundary_event, ExecutionState& state) {
+        logger_->log<LogLevel::Debug>("Boundary event triggered", { instance_id, boundary_event.getId() });
+
+        const ProcessGraph::Index next = firstSuccessor(state);
+        if (next == ProcessGraph::npos) {
+            throw std::runtime_error("No outgoing sequence flows from boundary event: " + boundary_event.getId());
+        }
+        state.current_index = next;
+        return Step::Advance;
+    }
+
+    void ProcessExecutor::armTimer(StateStore& store, StartBatch* batch, const std::string& instance_id, const std::string& element_id,
+        const std::string& process_id, const std::string& kind, const TimerDefinition& timer) {
+        TimerService::Timer record;
+        record.instance_id = instance_id;
+        record.element_id = element_id;
+        record.process_id = process_id;
+        record.kind = kind;
+        record.due_at = timer.firstDue(TimerService::nowMs());
+        if (timer.type == TimerDefinition::Type::Cycle) {
+            record.repetitions = timer.repetitions;
+            record.interval_ms = timer.interval_ms;
+        }
+        else {
+            record.repetitions = 1;
+        }
+
+        // A batch arms it once the instance is stored
+        if (batch && batch->armTimer(record)) {
+            return;
+        }
+        // Persisted before it can fire, loadTimers picks it up after a restart
+        store.saveTimer(record);
+        timers_->schedule(std::move(record));
+    }
+
+    void ProcessExecutor::cancelBoundaryTimers(const std::string& instance_id, const ExecutionState& state) {
+        const ProcessGraph& graph = state.definition->getGraph();
+        for (ProcessGraph::Index boundary : graph.boundaryEvents(state.current_index)) {
+            const std::string& element_id = graph.elementId(boundary);
+            timers_->cancel(instance_id, element_id);
+            storeOf(state).deleteTimer(instance_id, element_id);
+        }
+    }
+
+    std::unique_lock<std::mutex> ProcessExecutor::lockInstance(const std::string& instance_id) {
+        return std::unique_lock<std::mutex>(instanceLocks_[std::hash<std::string>{}(instance_id) % instanceLocks_.size()]);
+    }
+
+    void ProcessExecutor::fireTimer(const TimerService::Timer& timer) {
+        logger_->log<LogLevel::Debug>("Timer fired", { timer.instance_id, timer.element_id }, timer.kind);
+
+        if (timer.kind == "start") {
+            StateStore& store = storeFor(timer.process_id);
+            try {
+                // Next occurrence first; occurrences missed while the engine was down are dropped
+                if (timer.repetitions < 0 || timer.repetitions > 1) {
+                    TimerService::Timer next = timer;
+                    if (next.repetitions > 0) {
+                        --next.repetitions;
+                    }
+                    next.due_at = std::max(timer.due_at + timer.interval_ms, TimerService::nowMs());
+                    store.saveTimer(next);
+                    timers_->schedule(std::move(next));
+                }
+                else {
+                    store.deleteTimer(timer.instance_id, timer.element_id);
+                }
+
+                std::shared_ptr<const Process> process = getProcessDefinition(timer.process_id);
+                const ProcessGraph& graph = process->getGraph();
+                ExecutionState state;
+                state.current_index = graph.indexOf(timer.element_id);
+                if (state.current_index == ProcessGraph::npos) {
+                    throw std::runtime_error("Timer start event not found: " + timer.element_id);
+                }
+                state.process_id = timer.process_id;
+                state.store = &store;
+                state.definition = std::move(process);
+
+                const std::string instance_id = generate_uuid();
+                try {
+                    run(instance_id, state, stepBudget_);
+                }
+                catch (const std::exception& e) {
+                    handleError(instance_id, "Process start failed: " + std::string(e.what()), state);
+                }
+            }
+            catch (const std::exception& e) {
+                logger_->log<LogLevel::Error>("Timer start failed", { {}, timer.element_id }, e.what());
+            }
+            return;
+        }
+
+        // A timer already handed to the pool cannot be cancelled; it finds the
+        // token moved once the completion that beat it has checkpointed
+        const std::unique_lock<std::mutex> claim = lockInstance(timer.instance_id);
+        ExecutionState state;
+        try {
+            state = loadState(timer.instance_id);
+        }
+        catch (const std::exception& e) {
+            logger_->log<LogLevel::Error>("Timer failed", { timer.instance_id, timer.element_id }, e.what());
+            return;
+        }
+
+        try {
+            const ProcessGraph& graph = state.definition->getGraph();
+            const ProcessGraph::Index element = graph.indexOf(timer.element_id);
+            if (element == ProcessGraph::npos) {
+                throw std::runtime_error("Timer event not found: " + timer.element_id);
+            }
+
+            // The token is checked before the timer goes away. One that moved
+            // on took the timer's record with it, e.g. a completed activity.
+            if (timer.kind == "boundary") {
+                const auto& boundary_event = static_cast<const BoundaryEvent&>(*graph.element(element));
+                if (state.current_element != boundary_event.attached_to_ref) {
+                    logger_->log<LogLevel::Debug>("Timer found the token gone", { timer.instance_id, timer.element_id }, state.current_element);
+                    return;
+                }
+                // Interrupting: the activity and its boundary timers, this one included, are cancelled
+                cancelBoundaryTimers(timer.instance_id, state);
+                state.current_index = element;
+            }
+            else {
+                if (state.current_index != element) {
+                    logger_->log<LogLevel::Debug>("Timer found the token gone", { timer.instance_id, timer.element_id }, state.current_element);
+                    return;
+                }
+                storeOf(state).deleteTimer(timer.instance_id, timer.element_id);
+                const ProcessGraph::Index next = firstSuccessor(state);
+                if (next == ProcessGraph::npos) {
+                    throw std::runtime_error("No outgoing sequence flows from timer event: " + timer.element_id);
+                }
+                state.current_index = next;
+            }
+
+            // Timer tokens run to their next wait state on the pool
+            run(timer.instance_id, state, 0);
+        }
+        catch (const std::exception& e) {
+            handleError(timer.instance_id, "Timer event failed: " + std::string(e.what()), state);
+        }
+    }
+
+    void ProcessExecutor::scheduleStartTimers(const std::string& process_id) {
+        std::shared_ptr<const Process> process = getProcessDefinition(process_id);
+        const ProcessGraph& graph = process->getGraph();
+
+        // Start timers of earlier versions are replaced
+        StateStore& store = storeFor(process_id);
+        timers_->cancelInstance(process_id);
+        store.deleteTimers(process_id);
+
+        const std::int64_t now = TimerService::nowMs();
+        for (ProcessGraph::Index i = 0; i < graph.elementCount(); ++i) {
+            if (graph.kind(i) != ElementKind::StartEvent) {
+                continue;
+            }
+            const auto& start_event = static_cast<const StartEvent&>(*graph.element(i));
+            // A date that has already passed does not start anything on redeploy
+            if (start_event.timer.empty() ||
+                (start_event.timer.type == TimerDefinition::Type::Date && start_event.timer.date_ms <= now)) {
+                continue;
+            }
+            armTimer(store, nullptr, process_id, start_event.getId(), process_id, "start", start_event.timer);
+        }
+    }
+
+    std::size_t ProcessExecutor::loadTimers(const std::function<bool(const TimerService::Timer&)>& owns) {
+        std::vector<TimerService::Timer> timers;
+        for (StateStore* store : allStores()) {
+            std::vector<TimerService::Timer> loaded = store->loadTimers();
+            timers.insert(timers.end(), std::make_move_iterator(loaded.begin()), std::make_move_iterator(loaded.end()));
+        }
+        if (owns) {
+            timers.erase(std::remove_if(timers.begin(), timers.end(),
+                [&owns](const TimerService::Timer& timer) { return !owns(timer); }), timers.end());
+        }
+        const std::size_t count = timers.size();
+        timers_->schedule(std::move(timers));
+        return count;
+    }
+
+    void ProcessExecutor::stopTimers() {
+        timers_->stop();
+    }
+
+    std::size_t ProcessExecutor::getPendingTimers() const {
+        return timers_->pending();
     }
 
     void ProcessExecutor::saveState(const std::string& instance_id, ExecutionState& state) {
+        // Element ids are only materialized when state leaves the executor
+        if (state.definition && state.current_index != ProcessGraph::npos) {
+            state.current_element = state.definition->getGraph().elementId(state.current_index);
+        }
+
         // 
         std::string process_id = state.process_id;
         std::string current_element = state.current_element;
-        std::map<std::string, std::string> variables = state.variables;
+        std::map<std::string, std::string> variables = state.variables.toStringMap();
         // 
-        lastState_ = std::make_unique<ExecutionState>(std::move(state));
+        // Snapshot only: the caller keeps executing with state
+        auto snapshot = std::make_unique<ExecutionState>();
+        snapshot->process_id = process_id;
+        snapshot->definition = state.definition;
+        snapshot->current_element = current_element;
+        snapshot->variables = state.variables;
+        snapshot->isPaused = state.isPaused;
+        snapshot->isCompleted = state.isCompleted;
+        snapshot->isStarted = state.isStarted;
+        {
+            // Branch tasks save concurrently
+            std::lock_guard<std::mutex> lock(lastStateMutex_);
+            lastState_ = std::move(snapshot);
+        }
         //  
-        db_.saveProcessInstance(instance_id, process_id, current_element, variables);
+        const ScopedLatency timer(&metrics_->checkpoint());
+        if (state.batch && state.batch->saveInstance(instance_id, process_id, current_element, variables)) {
+            return;
+        }
+        storeOf(state).saveProcessInstance(instance_id, process_id, current_element, variables);
     }
 
     ExecutionState ProcessExecutor::loadState(const std::string& instance_id) {
         ExecutionState result;
-        const db::Database::ProcessInstance processData = db_.loadProcessInstance(instance_id);
-        result.variables = processData.variables;
+        StateStore* store = store_;
+        for (StateStore* candidate : extraStores_) {
+            if (candidate->containsProcessInstance(instance_id)) {
+                store = candidate;
+                break;
+            }
+        }
+
+        const StateStore::ProcessInstance processData = store->loadProcessInstance(instance_id);
+        result.store = store;
+        result.variables = Variables::fromStringMap(processData.variables);
         result.process_id = processData.process_id;
         result.current_element = processData.current_element;
+        result.definition = getProcessDefinition(result.process_id);
+        result.current_index = result.definition->getGraph().indexOf(result.current_element);
+        if (result.current_index == ProcessGraph::npos) {
+            throw std::runtime_error("Element not found: " + result.current_element);
+        }
         return result;
     }
 
-    void ProcessExecutor::log(const std::string& message) {
-        // Implementation would use a proper logging library
-        std::cout << "[BPMN Engine] " << message << std::endl;
-    }
-
     void ProcessExecutor::handleError(const std::string& instance_id, const std::string& error_message, ExecutionState& state) {
-        log("ERROR: " + error_message);
-        state.variables["last_error"] = error_message;
-        db_.saveError(instance_id, error_message);
+        const std::string& element_id = state.definition && state.current_index != ProcessGraph::npos
+            ? state.definition->getGraph().elementId(state.current_index) : state.current_element;
+        logger_->log<LogLevel::Error>("Process instance failed", { instance_id, element_id }, error_message);
+        metrics_->instanceFailed();
+        state.variables.set("last_error", error_message);
+        // Checkpoint first, the error row references the instance
+        saveState(instance_id, state);
+        if (!state.batch || !state.batch->saveError(instance_id, error_message)) {
+            storeOf(state).saveError(instance_id, error_message);
+        }
 
         // Could implement error handling flow here
     }
 
     // Helper methods
-    std::vector<FlowElement*> ProcessExecutor::getOutgoingElements(const std::string& element_id, const std::string& process_id) {
-        const Process* process = getProcessDefinition(process_id);
-        if (!process) return {};
+    ProcessGraph::Index ProcessExecutor::firstSuccessor(const ExecutionState& state) const {
+        const ProcessGraph& graph = state.definition->getGraph();
+        const ProcessGraph::Range outgoing = graph.outgoing(state.current_index);
+        return outgoing.empty() ? ProcessGraph::npos : graph.flowTarget(outgoing[0]);
+    }
 
-        auto flows = process->getOutgoingFlows(element_id);
-        std::vector<FlowElement*> elements;
-        for (const auto& flow : flows) {
-            if (auto element = process->getElement(flow->target_ref)) {
-                elements.push_back(element);
+    std::shared_ptr<const Process> ProcessExecutor::getProcessDefinition(const std::string& process_id) {
+        // The version number is read once until the definition is deployed
+        // again; the XML is loaded, parsed and validated once per (process_id, version)
+        int version = 0;
+        {
+            std::lock_guard<std::mutex> lock(definitionsMutex_);
+            auto it = definitions_.find(process_id);
+            if (it != definitions_.end()) {
+                return it->second;
+            }
+            auto latest = latestVersions_.find(process_id);
+            if (latest != latestVersions_.end()) {
+                version = latest->second;
             }
         }
-        return elements;
-    }
+        if (!db_) {
+            throw std::runtime_error("Process definition not found: " + process_id);
+        }
 
-    std::shared_ptr<SequenceFlow> ProcessExecutor::getDefaultFlow(const ExclusiveGateway& gateway, const std::vector<std::shared_ptr<SequenceFlow>>& flows) {
-        if (!gateway.default_flow.empty()) {
-            for (const auto& flow : flows) {
-                if (flow->getId() == gateway.default_flow) {
-                    return flow;
-                }
+        if (version == 0) {
+            version = db_->loadProcessDefinitionVersion(process_id);
+            std::lock_guard<std::mutex> lock(definitionsMutex_);
+            latestVersions_.emplace(process_id, version);
+        }
+
+        return definitionCache_.getOrLoad(process_id, version, [this, &process_id, version]() {
+            // Prefer the precompiled form stored at deploy time, fall back to the XML
+            std::shared_ptr<const Process> process;
+            const std::string compiled = db_->loadCompiledProcessDefinition(process_id, version);
+            if (CompiledProcess::isCompiledProcess(compiled.data(), compiled.size())) {
+                process = CompiledProcess::load(compiled);
+            }
+            else {
+                BpmnParser parser;
+                process = parser.parseFromString(db_->loadProcessDefinition(process_id, version));
+            }
+            if (!process->validate()) {
+                throw std::runtime_error("Invalid process definition: " + process_id);
             }
+            return process;
+        });
+    }
+
+    void ProcessExecutor::addProcessDefinition(std::shared_ptr<const Process> process) {
+        if (!process) {
+            throw std::invalid_argument("Cannot add null process definition");
         }
+        if (!process->validate()) {
+            throw std::runtime_error("Invalid process definition: " + process->getId());
+        }
+        // Built here instead of racing in the first instances
+        process->getGraph();
+
+        std::lock_guard<std::mutex> lock(definitionsMutex_);
+        definitions_[process->getId()] = std::move(process);
     }
 
-    const Process* ProcessExecutor::getProcessDefinition(const std::string& process_id) {
-        // In a real implementation, you'd want to:
-        // 1. Check a cache of loaded processes
-        // 2. Load from database/file system if not cached
-        // 3. Parse and validate the process
+    void ProcessExecutor::invalidateProcessDefinition(const std::string& process_id) {
+        std::lock_guard<std::mutex> lock(definitionsMutex_);
+        latestVersions_.erase(process_id);
+    }
+
+    void ProcessExecutor::setStateStore(StateStore& store) {
+        store_ = &store;
+    }
 
-        // Simple implementation - would need proper process storage in real system
-        static std::map<std::string, std::unique_ptr<Process>> process_cache_;
+    void ProcessExecutor::setStateStore(const std::string& process_id, StateStore& store) {
+        processStores_[process_id] = &store;
+        if (&store != store_ && std::find(extraStores_.begin(), extraStores_.end(), &store) == extraStores_.end()) {
+            extraStores_.push_back(&store);
+        }
+    }
 
-        auto it = process_cache_.find(process_id);
-        if (it != process_cache_.end()) {
-            return it->second.get();
+    StateStore& ProcessExecutor::storeFor(const std::string& process_id) const {
+        if (!processStores_.empty()) {
+            auto it = processStores_.find(process_id);
+            if (it != processStores_.end()) {
+                return *it->second;
+            }
         }
+        return *store_;
+    }
 
-        // In a real system, you'd load this from persistent storage
-        // For now we'll return nullptr to indicate not found
-        return nullptr;
+    std::vector<StateStore*> ProcessExecutor::allStores() const {
+        std::vector<StateStore*> stores{ store_ };
+        for (StateStore* store : extraStores_) {
+            if (store != store_) {
+                stores.push_back(store);
+            }
+        }
+        return stores;
     }
 
     std::string ProcessExecutor::generate_uuid() {
-        return boost::uuids::to_string(uuid_generator_());
+        if (instanceIdGenerator_) {
+            return instanceIdGenerator_();
+        }
+        return InstanceIdGenerator::global().next().toString();
     }
 
 } // namespace bpmn
\ No newline at end of file
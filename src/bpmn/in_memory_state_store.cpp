@@ -0,0 +1,114 @@
+#include "bpmn/in_memory_state_store.h"
+#include <functional>
+#include <stdexcept>
+
+namespace bpmn {
+
+    namespace {
+
+        std::size_t roundUpToPowerOfTwo(std::size_t value) {
+            std::size_t result = 1;
+            while (result < value) {
+                result <<= 1;
+            }
+            return result;
+        }
+
+    } // anonymous namespace
+
+    InMemoryStateStore::InMemoryStateStore(bool keep_completed, std::size_t stripes)
+        : keepCompleted_(keep_completed), stripeMask_(roundUpToPowerOfTwo(stripes == 0 ? 1 : stripes) - 1),
+        stripes_(new Stripe[stripeMask_ + 1]) {
+    }
+
+    InMemoryStateStore::Stripe& InMemoryStateStore::stripeFor(const std::string& instance_id) const {
+        return stripes_[std::hash<std::string>()(instance_id) & stripeMask_];
+    }
+
+    void InMemoryStateStore::saveProcessInstance(const std::string& instance_id, const std::string& process_id,
+        const std::string& current_element, const Variables& variables) {
+        Stripe& stripe = stripeFor(instance_id);
+        std::lock_guard<std::mutex> lock(stripe.mutex);
+        Instance& instance = stripe.instances[instance_id];
+        instance.state.process_id = process_id;
+        instance.state.current_element = current_element;
+        instance.state.variables = variables;
+        instance.completed = false;
+    }
+
+    StateStore::ProcessInstance InMemoryStateStore::loadProcessInstance(const std::string& instance_id) {
+        Stripe& stripe = stripeFor(instance_id);
+        std::lock_guard<std::mutex> lock(stripe.mutex);
+        auto it = stripe.instances.find(instance_id);
+        if (it == stripe.instances.end() || it->second.completed) {
+            throw std::runtime_error("Process instance not found or completed: " + instance_id);
+        }
+        return it->second.state;
+    }
+
+    bool InMemoryStateStore::containsProcessInstance(const std::string& instance_id) {
+        Stripe& stripe = stripeFor(instance_id);
+        std::lock_guard<std::mutex> lock(stripe.mutex);
+        auto it = stripe.instances.find(instance_id);
+        return it != stripe.instances.end() && !it->second.completed;
+    }
+
+    void InMemoryStateStore::completeProcessInstance(const std::string& instance_id) {
+        Stripe& stripe = stripeFor(instance_id);
+        std::lock_guard<std::mutex> lock(stripe.mutex);
+        auto it = stripe.instances.find(instance_id);
+        if (it == stripe.instances.end()) {
+            return;
+        }
+        if (keepCompleted_) {
+            it->second.completed = true;
+        }
+        else {
+            stripe.instances.erase(it);
+        }
+    }
+
+    void InMemoryStateStore::saveUserTask(const std::string& instance_id, const std::string& task_id,
+        const std::string& form_key, const Variables& variables) {
+        Stripe& stripe = stripeFor(instance_id);
+        std::lock_guard<std::mutex> lock(stripe.mutex);
+        stripe.instances[instance_id].tasks.push_back({ instance_id, task_id, form_key, variables });
+    }
+
+    void InMemoryStateStore::saveError(const std::string& instance_id, const std::string& error_message) {
+        Stripe& stripe = stripeFor(instance_id);
+        std::lock_guard<std::mutex> lock(stripe.mutex);
+        stripe.instances[instance_id].errors.push_back(error_message);
+    }
+
+    std::size_t InMemoryStateStore::size() const {
+        std::size_t count = 0;
+        for (std::size_t i = 0; i <= stripeMask_; ++i) {
+            std::lock_guard<std::mutex> lock(stripes_[i].mutex);
+            count += stripes_[i].instances.size();
+        }
+        return count;
+    }
+
+    bool InMemoryStateStore::isCompleted(const std::string& instance_id) const {
+        Stripe& stripe = stripeFor(instance_id);
+        std::lock_guard<std::mutex> lock(stripe.mutex);
+        auto it = stripe.instances.find(instance_id);
+        return it != stripe.instances.end() && it->second.completed;
+    }
+
+    std::vector<StateStore::UserTaskRecord> InMemoryStateStore::getUserTasks(const std::string& instance_id) const {
+        Stripe& stripe = stripeFor(instance_id);
+        std::lock_guard<std::mutex> lock(stripe.mutex);
+        auto it = stripe.instances.find(instance_id);
+        return it != stripe.instances.end() ? it->second.tasks : std::vector<UserTaskRecord>();
+    }
+
+    std::vector<std::string> InMemoryStateStore::getErrors(const std::string& instance_id) const {
+        Stripe& stripe = stripeFor(instance_id);
+        std::lock_guard<std::mutex> lock(stripe.mutex);
+        auto it = stripe.instances.find(instance_id);
+        return it != stripe.instances.end() ? it->second.errors : std::vector<std::string>();
+    }
+
+} // namespace bpmn
@@ -0,0 +1,133 @@
+#include "bpmn/instance_id.h"
+#include <chrono>
+#include <random>
+#include <stdexcept>
+
+namespace bpmn {
+
+    namespace {
+
+        constexpr char kHex[] = "0123456789abcdef";
+
+        int hexValue(char c) {
+            if (c >= '0' && c <= '9') return c - '0';
+            if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+            if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+            return -1;
+        }
+
+        bool isDashPosition(std::size_t position) {
+            return position == 8 || position == 13 || position == 18 || position == 23;
+        }
+
+        // splitmix64, seeded once per thread; ids need uniqueness, not secrecy
+        std::uint64_t randomBits() {
+            thread_local std::uint64_t state = []() {
+                std::random_device device;
+                return (static_cast<std::uint64_t>(device()) << 32) ^ device();
+            }();
+            std::uint64_t z = (state += 0x9e3779b97f4a7c15ull);
+            z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+            z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+            return z ^ (z >> 31);
+        }
+
+    } // anonymous namespace
+
+    bool InstanceId::tryParse(std::string_view text, InstanceId& id) {
+        if (text.size() != 36) {
+            return false;
+        }
+        Bytes bytes{};
+        std::size_t nibble = 0;
+        for (std::size_t i = 0; i < text.size(); ++i) {
+            if (isDashPosition(i)) {
+                if (text[i] != '-') {
+                    return false;
+                }
+                continue;
+            }
+            const int value = hexValue(text[i]);
+            if (value < 0) {
+                return false;
+            }
+            bytes[nibble / 2] = static_cast<std::uint8_t>(bytes[nibble / 2] | (nibble % 2 == 0 ? value << 4 : value));
+            ++nibble;
+        }
+        id.bytes_ = bytes;
+        return true;
+    }
+
+    InstanceId InstanceId::parse(std::string_view text) {
+        InstanceId id;
+        if (!tryParse(text, id)) {
+            throw std::invalid_argument("Invalid instance id: " + std::string(text));
+        }
+        return id;
+    }
+
+    std::string InstanceId::toString() const {
+        std::string text(36, '-');
+        std::size_t position = 0;
+        for (std::uint8_t byte : bytes_) {
+            if (isDashPosition(position)) {
+                ++position;
+            }
+            text[position++] = kHex[byte >> 4];
+            text[position++] = kHex[byte & 0x0f];
+        }
+        return text;
+    }
+
+    std::uint64_t InstanceId::timestampMs() const {
+        std::uint64_t ms = 0;
+        for (std::size_t i = 0; i < 6; ++i) {
+            ms = (ms << 8) | bytes_[i];
+        }
+        return ms;
+    }
+
+    std::size_t InstanceId::Hash::operator()(const InstanceId& id) const {
+        // The random tail is already uniformly distributed
+        std::uint64_t tail = 0;
+        for (std::size_t i = 8; i < 16; ++i) {
+            tail = (tail << 8) | id.bytes()[i];
+        }
+        return static_cast<std::size_t>(tail ^ (tail >> 32));
+    }
+
+    InstanceId InstanceIdGenerator::next() {
+        const auto now = std::chrono::system_clock::now().time_since_epoch();
+        const auto ms = static_cast<std::uint64_t>(std::chrono::duration_cast<std::chrono::milliseconds>(now).count());
+        const std::uint64_t floor = (ms & 0xffffffffffffull) << 12;
+
+        std::uint64_t last = last_.load(std::memory_order_relaxed);
+        std::uint64_t stamp;
+        do {
+            // Clocks stepping back reuse the last millisecond
+            stamp = last + 1 > floor ? last + 1 : floor;
+        } while (!last_.compare_exchange_weak(last, stamp, std::memory_order_relaxed));
+
+        const std::uint64_t time = stamp >> 12;
+        const std::uint64_t sequence = stamp & 0xfff;
+        const std::uint64_t random = randomBits();
+
+        InstanceId::Bytes bytes;
+        for (std::size_t i = 0; i < 6; ++i) {
+            bytes[i] = static_cast<std::uint8_t>(time >> (40 - 8 * i));
+        }
+        bytes[6] = static_cast<std::uint8_t>(0x70 | (sequence >> 8));
+        bytes[7] = static_cast<std::uint8_t>(sequence);
+        bytes[8] = static_cast<std::uint8_t>(0x80 | ((random >> 56) & 0x3f));
+        for (std::size_t i = 9; i < 16; ++i) {
+            bytes[i] = static_cast<std::uint8_t>(random >> (8 * (15 - i)));
+        }
+        return InstanceId(bytes);
+    }
+
+    InstanceIdGenerator& InstanceIdGenerator::global() {
+        static InstanceIdGenerator generator;
+        return generator;
+    }
+
+} // namespace bpmn
@@ -0,0 +1,297 @@
+#include "bpmn/logger.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <utility>
+
+namespace bpmn {
+
+    namespace {
+
+        constexpr auto kDrainInterval = std::chrono::milliseconds(5);
+
+        std::atomic<std::uint64_t> nextLoggerId{ 1 };
+
+        template <std::size_t Size>
+        void copyField(char (&target)[Size], std::string_view value) {
+            const std::size_t length = std::min(value.size(), Size - 1);
+            std::memcpy(target, value.data(), length);
+            target[length] = '\0';
+        }
+
+        const char* levelName(LogLevel level) {
+            switch (level) {
+            case LogLevel::Trace: return "trace";
+            case LogLevel::Debug: return "debug";
+            case LogLevel::Info: return "info";
+            case LogLevel::Warn: return "warn";
+            default: return "error";
+            }
+        }
+
+        void appendQuoted(std::string& out, const char* text) {
+            out += '"';
+            for (; *text; ++text) {
+                switch (*text) {
+                case '"': out += "\\\""; break;
+                case '\\': out += "\\\\"; break;
+                case '\n': out += "\\n"; break;
+                default: out += *text; break;
+                }
+            }
+            out += '"';
+        }
+
+    } // anonymous namespace
+
+    struct Logger::Record {
+        std::uint64_t timestamp_ns;
+        std::uint64_t elapsed_ns;
+        LogLevel level;
+        char message[64];
+        char instance_id[40];
+        char element_id[64];
+        char detail[160];
+    };
+
+    // Single producer (the owning thread), single consumer (the sink thread)
+    class Logger::Ring {
+    public:
+        explicit Ring(std::size_t capacity) : records_(capacity), capacity_(capacity) {}
+
+        // Fills the next free slot; false if the ring is full
+        template <typename Fill>
+        bool push(Fill&& fill) {
+            const std::uint64_t head = head_.load(std::memory_order_relaxed);
+            if (head - tail_.load(std::memory_order_acquire) >= capacity_) {
+                dropped_.fetch_add(1, std::memory_order_relaxed);
+                return false;
+            }
+            fill(records_[head % capacity_]);
+            head_.store(head + 1, std::memory_order_release);
+            return true;
+        }
+
+        template <typename Consume>
+        void drain(Consume&& consume) {
+            std::uint64_t tail = tail_.load(std::memory_order_relaxed);
+            const std::uint64_t head = head_.load(std::memory_order_acquire);
+            for (; tail != head; ++tail) {
+                consume(records_[tail % capacity_]);
+            }
+            tail_.store(tail, std::memory_order_release);
+        }
+
+        std::uint64_t dropped() const { return dropped_.load(std::memory_order_relaxed); }
+
+        // Set when the producing thread ends
+        std::atomic<bool> retired{ false };
+
+    private:
+        std::vector<Record> records_;
+        const std::size_t capacity_;
+        alignas(64) std::atomic<std::uint64_t> head_{ 0 };
+        alignas(64) std::atomic<std::uint64_t> tail_{ 0 };
+        std::atomic<std::uint64_t> dropped_{ 0 };
+    };
+
+    namespace {
+
+        // Rings of the current thread, one per logger it wrote to
+        struct ThreadRings {
+            std::vector<std::pair<std::uint64_t, std::shared_ptr<void>>> rings;
+            std::vector<std::atomic<bool>*> retired;
+
+            ~ThreadRings() {
+                for (std::atomic<bool>* flag : retired) {
+                    flag->store(true, std::memory_order_release);
+                }
+            }
+        };
+
+        thread_local ThreadRings threadRings;
+
+    } // anonymous namespace
+
+    Logger::Logger(Sink sink, LogLevel level, std::size_t ring_capacity)
+        : id_(nextLoggerId.fetch_add(1)), ringCapacity_(ring_capacity == 0 ? 1 : ring_capacity),
+        sink_(std::move(sink)), level_(level) {
+        if (!sink_) {
+            sink_ = [](const std::string& batch) {
+                std::cout.write(batch.data(), static_cast<std::streamsize>(batch.size()));
+                std::cout.flush();
+            };
+        }
+        thread_ = std::thread(&Logger::sinkLoop, this);
+    }
+
+    Logger::~Logger() {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stop_ = true;
+        }
+        wake_.notify_all();
+        thread_.join();
+    }
+
+    Logger& Logger::global() {
+        static Logger logger;
+        return logger;
+    }
+
+    Logger::Ring& Logger::threadRing() {
+        for (auto& [id, ring] : threadRings.rings) {
+            if (id == id_) {
+                return *static_cast<Ring*>(ring.get());
+            }
+        }
+        auto ring = std::make_shared<Ring>(ringCapacity_);
+        {
+            std::lock_guard<std::mutex> lock(ringsMutex_);
+            rings_.push_back(ring);
+        }
+        threadRings.retired.push_back(&ring->retired);
+        threadRings.rings.emplace_back(id_, ring);
+        return *ring;
+    }
+
+    void Logger::write(LogLevel level, std::string_view message, const LogFields& fields, std::string_view detail) {
+        const auto now = std::chrono::system_clock::now().time_since_epoch();
+        threadRing().push([&](Record& record) {
+            record.timestamp_ns = static_cast<std::uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(now).count());
+            record.elapsed_ns = fields.elapsed_ns;
+            record.level = level;
+            copyField(record.message, message);
+            copyField(record.instance_id, fields.instance_id);
+            copyField(record.element_id, fields.element_id);
+            copyField(record.detail, detail);
+        });
+    }
+
+    void Logger::flush() {
+        std::unique_lock<std::mutex> lock(mutex_);
+        const std::uint64_t request = ++flushRequests_;
+        wake_.notify_all();
+        flushed_.wait(lock, [this, request]() { return flushesDone_ >= request || stop_; });
+    }
+
+    std::uint64_t Logger::dropped() const {
+        std::lock_guard<std::mutex> lock(ringsMutex_);
+        std::uint64_t total = retiredDropped_;
+        for (const auto& ring : rings_) {
+            total += ring->dropped();
+        }
+        return total;
+    }
+
+    bool Logger::drain(std::string& batch) {
+        std::vector<const Record*> records;
+        std::vector<std::shared_ptr<Ring>> rings;
+        // Rings whose thread had ended before draining are empty afterwards
+        std::vector<std::shared_ptr<Ring>> retired;
+        {
+            std::lock_guard<std::mutex> lock(ringsMutex_);
+            rings = rings_;
+        }
+        for (const auto& ring : rings) {
+            if (ring->retired.load(std::memory_order_acquire)) {
+                retired.push_back(ring);
+            }
+        }
+
+        // Records are copied out so every ring is released before formatting
+        std::vector<Record> copies;
+        for (const auto& ring : rings) {
+            ring->drain([&copies](const Record& record) { copies.push_back(record); });
+        }
+        for (const Record& record : copies) {
+            records.push_back(&record);
+        }
+        // Rings are drained one after another, the timestamps restore the order
+        std::stable_sort(records.begin(), records.end(), [](const Record* left, const Record* right) {
+            return left->timestamp_ns < right->timestamp_ns;
+        });
+
+        char number[64];
+        for (const Record* record : records) {
+            std::snprintf(number, sizeof(number), "%llu.%06llu",
+                static_cast<unsigned long long>(record->timestamp_ns / 1000000000ull),
+                static_cast<unsigned long long>(record->timestamp_ns % 1000000000ull / 1000ull));
+            batch += "[BPMN Engine] ts=";
+            batch += number;
+            batch += " level=";
+            batch += levelName(record->level);
+            batch += " msg=";
+            appendQuoted(batch, record->message);
+            if (record->instance_id[0]) {
+                batch += " instance_id=";
+                batch += record->instance_id;
+            }
+            if (record->element_id[0]) {
+                batch += " element_id=";
+                batch += record->element_id;
+            }
+            if (record->elapsed_ns) {
+                batch += " elapsed_ns=";
+                batch += std::to_string(record->elapsed_ns);
+            }
+            if (record->detail[0]) {
+                batch += " detail=";
+                appendQuoted(batch, record->detail);
+            }
+            batch += '\n';
+        }
+        written_.fetch_add(records.size(), std::memory_order_relaxed);
+
+        std::uint64_t dropped = 0;
+        {
+            std::lock_guard<std::mutex> lock(ringsMutex_);
+            for (auto it = rings_.begin(); it != rings_.end();) {
+                if (std::find(retired.begin(), retired.end(), *it) != retired.end()) {
+                    retiredDropped_ += (*it)->dropped();
+                    it = rings_.erase(it);
+                }
+                else {
+                    ++it;
+                }
+            }
+            dropped = retiredDropped_;
+            for (const auto& ring : rings_) {
+                dropped += ring->dropped();
+            }
+        }
+        if (dropped != reportedDropped_) {
+            batch += "[BPMN Engine] level=warn msg=\"Log records dropped, rings full\" dropped=";
+            batch += std::to_string(dropped - reportedDropped_);
+            batch += '\n';
+            reportedDropped_ = dropped;
+        }
+        return !batch.empty();
+    }
+
+    void Logger::sinkLoop() {
+        std::string batch;
+        std::unique_lock<std::mutex> lock(mutex_);
+        for (;;) {
+            wake_.wait_for(lock, kDrainInterval, [this]() { return stop_ || flushRequests_ != flushesDone_; });
+            const bool stopping = stop_;
+            const std::uint64_t requests = flushRequests_;
+            lock.unlock();
+
+            batch.clear();
+            if (drain(batch)) {
+                sink_(batch);
+            }
+
+            lock.lock();
+            flushesDone_ = requests;
+            flushed_.notify_all();
+            if (stopping) {
+                return;
+            }
+        }
+    }
+
+} // namespace bpmn
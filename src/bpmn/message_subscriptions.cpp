@@ -0,0 +1,192 @@
+#include "bpmn/message_subscriptions.h"
+#include <algorithm>
+
+namespace bpmn {
+
+    std::string MessageSubscriptions::join(const std::string& first, const std::string& second) {
+        std::string key;
+        key.reserve(first.size() + second.size() + 1);
+        key.append(first).push_back('\0');
+        key.append(second);
+        return key;
+    }
+
+    void MessageSubscriptions::add(const Subscription& subscription) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        addLocked(subscription);
+    }
+
+    void MessageSubscriptions::add(const std::vector<Subscription>& subscriptions) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (const Subscription& subscription : subscriptions) {
+            addLocked(subscription);
+        }
+    }
+
+    void MessageSubscriptions::addLocked(const Subscription& subscription) {
+        auto& instance = byInstance_[subscription.instance_id];
+        auto existing = std::find_if(instance.begin(), instance.end(), [&subscription](const Subscription& other) {
+            return other.element_id == subscription.element_id;
+        });
+        if (existing != instance.end()) {
+            // Same token subscribing again, e.g. after a reload
+            const Subscription previous = *existing;
+            eraseLocked(previous);
+        }
+
+        byMessage_[join(subscription.message_name, subscription.correlation_key)]
+            .emplace(join(subscription.instance_id, subscription.element_id), subscription);
+        byInstance_[subscription.instance_id].push_back(subscription);
+        ++size_;
+    }
+
+    void MessageSubscriptions::eraseLocked(const Subscription& subscription) {
+        auto bucket = byMessage_.find(join(subscription.message_name, subscription.correlation_key));
+        if (bucket != byMessage_.end()) {
+            bucket->second.erase(join(subscription.instance_id, subscription.element_id));
+            if (bucket->second.empty()) {
+                byMessage_.erase(bucket);
+            }
+        }
+
+        auto instance = byInstance_.find(subscription.instance_id);
+        if (instance != byInstance_.end()) {
+            auto& subscriptions = instance->second;
+            subscriptions.erase(std::remove_if(subscriptions.begin(), subscriptions.end(), [&subscription](const Subscription& other) {
+                return other.element_id == subscription.element_id;
+            }), subscriptions.end());
+            if (subscriptions.empty()) {
+                byInstance_.erase(instance);
+            }
+        }
+        --size_;
+    }
+
+    bool MessageSubscriptions::takeOne(const std::string& message_name, const std::string& correlation_key, Subscription& subscription) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto bucket = byMessage_.find(join(message_name, correlation_key));
+        if (bucket == byMessage_.end()) {
+            return false;
+        }
+        subscription = bucket->second.begin()->second;
+        eraseLocked(subscription);
+        return true;
+    }
+
+    std::vector<MessageSubscriptions::Subscription> MessageSubscriptions::takeAll(const std::string& message_name, const std::string& correlation_key) {
+        std::vector<Subscription> result;
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto bucket = byMessage_.find(join(message_name, correlation_key));
+        if (bucket == byMessage_.end()) {
+            return result;
+        }
+
+        result.reserve(bucket->second.size());
+        for (auto& entry : bucket->second) {
+            result.push_back(std::move(entry.second));
+        }
+        byMessage_.erase(bucket);
+
+        for (const Subscription& subscription : result) {
+            auto instance = byInstance_.find(subscription.instance_id);
+            if (instance == byInstance_.end()) {
+                continue;
+            }
+            auto& subscriptions = instance->second;
+            subscriptions.erase(std::remove_if(subscriptions.begin(), subscriptions.end(), [&subscription](const Subscription& other) {
+                return other.element_id == subscription.element_id;
+            }), subscriptions.end());
+            if (subscriptions.empty()) {
+                byInstance_.erase(instance);
+            }
+        }
+        size_ -= result.size();
+        return result;
+    }
+
+    bool MessageSubscriptions::takeForInstance(const std::string& instance_id, const std::string& message_name, Subscription& subscription) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto instance = byInstance_.find(instance_id);
+        if (instance == byInstance_.end()) {
+            return false;
+        }
+        auto it = std::find_if(instance->second.begin(), instance->second.end(), [&message_name](const Subscription& other) {
+            return other.message_name == message_name;
+        });
+        if (it == instance->second.end()) {
+            return false;
+        }
+        subscription = *it;
+        eraseLocked(subscription);
+        return true;
+    }
+
+    std::vector<MessageSubscriptions::Subscription> MessageSubscriptions::find(const std::string& message_name, const std::string& correlation_key) const {
+        std::vector<Subscription> result;
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto bucket = byMessage_.find(join(message_name, correlation_key));
+        if (bucket == byMessage_.end()) {
+            return result;
+        }
+        result.reserve(bucket->second.size());
+        for (const auto& entry : bucket->second) {
+            result.push_back(entry.second);
+        }
+        return result;
+    }
+
+    bool MessageSubscriptions::findForInstance(const std::string& instance_id, const std::string& message_name, Subscription& subscription) const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto instance = byInstance_.find(instance_id);
+        if (instance == byInstance_.end()) {
+            return false;
+        }
+        auto it = std::find_if(instance->second.begin(), instance->second.end(), [&message_name](const Subscription& other) {
+            return other.message_name == message_name;
+        });
+        if (it == instance->second.end()) {
+            return false;
+        }
+        subscription = *it;
+        return true;
+    }
+
+    bool MessageSubscriptions::remove(const Subscription& subscription) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto instance = byInstance_.find(subscription.instance_id);
+        if (instance == byInstance_.end()) {
+            return false;
+        }
+        auto it = std::find_if(instance->second.begin(), instance->second.end(), [&subscription](const Subscription& other) {
+            return other.element_id == subscription.element_id;
+        });
+        if (it == instance->second.end()) {
+            return false;
+        }
+        // The stored copy: its key may differ from the caller's if it was re-added
+        const Subscription existing = *it;
+        eraseLocked(existing);
+        return true;
+    }
+
+    std::size_t MessageSubscriptions::removeInstance(const std::string& instance_id) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto instance = byInstance_.find(instance_id);
+        if (instance == byInstance_.end()) {
+            return 0;
+        }
+
+        // Copied out: eraseLocked drops the instance entry with its last subscription
+        const std::vector<Subscription> subscriptions = instance->second;
+        for (const Subscription& subscription : subscriptions) {
+            eraseLocked(subscription);
+        }
+        return subscriptions.size();
+    }
+
+    std::size_t MessageSubscriptions::size() const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return size_;
+    }
+
+} // namespace bpmn
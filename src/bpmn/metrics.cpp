@@ -0,0 +1,262 @@
+#include "bpmn/metrics.h"
+#include <cmath>
+#include <cstdio>
+#include <mutex>
+
+namespace bpmn {
+
+    namespace {
+
+        constexpr double kQuantiles[] = { 0.5, 0.9, 0.99, 0.999 };
+
+        // Index of the highest set bit, value must not be zero
+        std::size_t highestBit(std::uint64_t value) {
+            std::size_t bit = 0;
+            for (std::size_t shift = 32; shift > 0; shift /= 2) {
+                if (value >> shift) {
+                    value >>= shift;
+                    bit += shift;
+                }
+            }
+            return bit;
+        }
+
+        std::string formatDouble(double value) {
+            char text[32];
+            std::snprintf(text, sizeof(text), "%.9g", value);
+            return text;
+        }
+
+        std::string seconds(std::uint64_t ns) {
+            return formatDouble(static_cast<double>(ns) / 1e9);
+        }
+
+        void appendLabelValue(std::string& out, std::string_view value) {
+            for (char c : value) {
+                switch (c) {
+                case '\\': out += "\\\\"; break;
+                case '"': out += "\\\""; break;
+                case '\n': out += "\\n"; break;
+                default: out += c; break;
+                }
+            }
+        }
+
+        // name{labels,quantile="q"} lines plus _sum and _count; labels is
+        // empty or ends with a comma
+        void appendSummary(std::string& out, const std::string& name, const std::string& labels,
+            const LatencyHistogram::Snapshot& snapshot) {
+            for (double q : kQuantiles) {
+                out += name + "{" + labels + "quantile=\"" + formatDouble(q) + "\"} " + seconds(snapshot.percentile(q)) + "\n";
+            }
+            const std::string plain = labels.empty() ? std::string() : "{" + labels.substr(0, labels.size() - 1) + "}";
+            out += name + "_sum" + plain + " " + seconds(snapshot.sum_ns) + "\n";
+            out += name + "_count" + plain + " " + std::to_string(snapshot.count) + "\n";
+        }
+
+        void appendHeader(std::string& out, const char* name, const char* type, const char* help) {
+            out += std::string("# HELP ") + name + " " + help + "\n";
+            out += std::string("# TYPE ") + name + " " + type + "\n";
+        }
+
+        nlohmann::json summaryJson(const LatencyHistogram::Snapshot& snapshot) {
+            return {
+                { "count", snapshot.count },
+                { "sum_ns", snapshot.sum_ns },
+                { "max_ns", snapshot.max_ns },
+                { "p50_ns", snapshot.percentile(0.5) },
+                { "p90_ns", snapshot.percentile(0.9) },
+                { "p99_ns", snapshot.percentile(0.99) },
+                { "p999_ns", snapshot.percentile(0.999) }
+            };
+        }
+
+    } // anonymous namespace
+
+    std::size_t LatencyHistogram::bucketOf(std::uint64_t ns) {
+        if (ns < kSubBuckets) {
+            return static_cast<std::size_t>(ns);
+        }
+        const std::size_t exponent = highestBit(ns);
+        if (exponent >= kMaxExponent) {
+            return kBuckets - 1;
+        }
+        const std::size_t shift = exponent - 4;
+        return kSubBuckets + shift * kSubBuckets + static_cast<std::size_t>((ns >> shift) & (kSubBuckets - 1));
+    }
+
+    std::uint64_t LatencyHistogram::bucketUpperBound(std::size_t bucket) {
+        if (bucket < kSubBuckets) {
+            return bucket;
+        }
+        const std::size_t shift = (bucket - kSubBuckets) / kSubBuckets;
+        const std::uint64_t sub = (bucket - kSubBuckets) % kSubBuckets;
+        return ((kSubBuckets + sub + 1) << shift) - 1;
+    }
+
+    void LatencyHistogram::record(std::uint64_t ns) {
+        buckets_[bucketOf(ns)].fetch_add(1, std::memory_order_relaxed);
+        count_.fetch_add(1, std::memory_order_relaxed);
+        sum_.fetch_add(ns, std::memory_order_relaxed);
+        std::uint64_t max = max_.load(std::memory_order_relaxed);
+        while (ns > max && !max_.compare_exchange_weak(max, ns, std::memory_order_relaxed)) {
+        }
+    }
+
+    LatencyHistogram::Snapshot LatencyHistogram::snapshot() const {
+        Snapshot snapshot;
+        for (std::size_t i = 0; i < kBuckets; ++i) {
+            snapshot.buckets[i] = buckets_[i].load(std::memory_order_relaxed);
+        }
+        snapshot.count = count_.load(std::memory_order_relaxed);
+        snapshot.sum_ns = sum_.load(std::memory_order_relaxed);
+        snapshot.max_ns = max_.load(std::memory_order_relaxed);
+        return snapshot;
+    }
+
+    std::uint64_t LatencyHistogram::Snapshot::percentile(double q) const {
+        // Buckets are the truth: count may run ahead of them while recording
+        std::uint64_t total = 0;
+        for (std::uint64_t bucket : buckets) {
+            total += bucket;
+        }
+        if (total == 0) {
+            return 0;
+        }
+        const double clamped = q < 0.0 ? 0.0 : (q > 1.0 ? 1.0 : q);
+        std::uint64_t rank = static_cast<std::uint64_t>(std::ceil(clamped * static_cast<double>(total)));
+        if (rank == 0) {
+            rank = 1;
+        }
+        std::uint64_t seen = 0;
+        for (std::size_t i = 0; i < kBuckets; ++i) {
+            seen += buckets[i];
+            if (seen >= rank) {
+                const std::uint64_t bound = bucketUpperBound(i);
+                return max_ns != 0 && bound > max_ns ? max_ns : bound;
+            }
+        }
+        return max_ns;
+    }
+
+    Metrics& Metrics::global() {
+        static Metrics metrics;
+        return metrics;
+    }
+
+    LatencyHistogram& Metrics::findOrCreate(std::shared_mutex& mutex, Histograms& histograms, std::string_view key) {
+        {
+            std::shared_lock<std::shared_mutex> lock(mutex);
+            auto it = histograms.find(key);
+            if (it != histograms.end()) {
+                return *it->second;
+            }
+        }
+        std::unique_lock<std::shared_mutex> lock(mutex);
+        std::unique_ptr<LatencyHistogram>& histogram = histograms[std::string(key)];
+        if (!histogram) {
+            histogram = std::make_unique<LatencyHistogram>();
+        }
+        return *histogram;
+    }
+
+    LatencyHistogram& Metrics::element(std::string_view process_id, std::string_view element_id) {
+        {
+            std::shared_lock<std::shared_mutex> lock(elementsMutex_);
+            auto process = elements_.find(process_id);
+            if (process != elements_.end()) {
+                auto it = process->second.find(element_id);
+                if (it != process->second.end()) {
+                    return *it->second;
+                }
+            }
+        }
+        std::unique_lock<std::shared_mutex> lock(elementsMutex_);
+        std::unique_ptr<LatencyHistogram>& histogram = elements_[std::string(process_id)][std::string(element_id)];
+        if (!histogram) {
+            histogram = std::make_unique<LatencyHistogram>();
+        }
+        return *histogram;
+    }
+
+    LatencyHistogram& Metrics::statement(std::string_view name) {
+        return findOrCreate(statementsMutex_, statements_, name);
+    }
+
+    std::string Metrics::toPrometheus() const {
+        std::string out;
+
+        appendHeader(out, "bpmn_instances_started_total", "counter", "Process instances that ran their start event.");
+        out += "bpmn_instances_started_total " + std::to_string(instancesStarted()) + "\n";
+        appendHeader(out, "bpmn_instances_completed_total", "counter", "Process instances that reached an end event.");
+        out += "bpmn_instances_completed_total " + std::to_string(instancesCompleted()) + "\n";
+        appendHeader(out, "bpmn_instances_failed_total", "counter", "Process instances that recorded an error.");
+        out += "bpmn_instances_failed_total " + std::to_string(instancesFailed()) + "\n";
+        appendHeader(out, "bpmn_active_tokens", "gauge", "Tokens executing elements right now.");
+        out += "bpmn_active_tokens " + std::to_string(activeTokens()) + "\n";
+
+        appendHeader(out, "bpmn_element_duration_seconds", "summary", "Time spent in the handler of a flow element.");
+        {
+            std::shared_lock<std::shared_mutex> lock(elementsMutex_);
+            for (const auto& [process_id, histograms] : elements_) {
+                for (const auto& [element_id, histogram] : histograms) {
+                    std::string labels = "process_id=\"";
+                    appendLabelValue(labels, process_id);
+                    labels += "\",element_id=\"";
+                    appendLabelValue(labels, element_id);
+                    labels += "\",";
+                    appendSummary(out, "bpmn_element_duration_seconds", labels, histogram->snapshot());
+                }
+            }
+        }
+
+        appendHeader(out, "bpmn_db_statement_duration_seconds", "summary", "Time of one database call.");
+        {
+            std::shared_lock<std::shared_mutex> lock(statementsMutex_);
+            for (const auto& [name, histogram] : statements_) {
+                std::string labels = "statement=\"";
+                appendLabelValue(labels, name);
+                labels += "\",";
+                appendSummary(out, "bpmn_db_statement_duration_seconds", labels, histogram->snapshot());
+            }
+        }
+
+        appendHeader(out, "bpmn_checkpoint_duration_seconds", "summary", "Time to write an instance checkpoint.");
+        appendSummary(out, "bpmn_checkpoint_duration_seconds", "", checkpoint_.snapshot());
+        return out;
+    }
+
+    nlohmann::json Metrics::toJson() const {
+        nlohmann::json result = {
+            { "instances", {
+                { "started", instancesStarted() },
+                { "completed", instancesCompleted() },
+                { "failed", instancesFailed() } } },
+            { "active_tokens", activeTokens() },
+            { "elements", nlohmann::json::array() },
+            { "statements", nlohmann::json::array() },
+            { "checkpoints", summaryJson(checkpoint_.snapshot()) }
+        };
+        {
+            std::shared_lock<std::shared_mutex> lock(elementsMutex_);
+            for (const auto& [process_id, histograms] : elements_) {
+                for (const auto& [element_id, histogram] : histograms) {
+                    nlohmann::json entry = summaryJson(histogram->snapshot());
+                    entry["process_id"] = process_id;
+                    entry["element_id"] = element_id;
+                    result["elements"].push_back(std::move(entry));
+                }
+            }
+        }
+        {
+            std::shared_lock<std::shared_mutex> lock(statementsMutex_);
+            for (const auto& [name, histogram] : statements_) {
+                nlohmann::json entry = summaryJson(histogram->snapshot());
+                entry["statement"] = name;
+                result["statements"].push_back(std::move(entry));
+            }
+        }
+        return result;
+    }
+
+} // namespace bpmn
@@ -16,6 +16,7 @@ namespace bpmn {
         if (!element) {
             throw std::invalid_argument("Cannot add null element to process");
         }
+        checkMutable();
 
         std::string elementId = element->getId();
 
@@ -28,7 +29,8 @@ namespace bpmn {
         std::shared_ptr<FlowElement> sharedElement = std::move(element);
 
         //  unique_ptr  
-        elements.push_back(std::unique_ptr<FlowElement>(sharedElement.get()));
+        elements.push_back(sharedElement);
+        element_map[elementId] = sharedElement.get();
 
         //  shared_ptr     
         elementsById[elementId] = sharedElement;
@@ -38,6 +40,7 @@ namespace bpmn {
         if (!element) {
             throw std::invalid_argument("Cannot add null element to process");
         }
+        checkMutable();
 
         std::string elementId = element->getId();
 
@@ -46,17 +49,18 @@ namespace bpmn {
             throw std::runtime_error("Element with id " + elementId + " already exists in process");
         }
 
-        //  unique_ptr  shared_ptr
-        std::unique_ptr<FlowElement> uniqueElement = std::unique_ptr<FlowElement>(element.get());
-
         //  unique_ptr  
-        elements.push_back(std::move(uniqueElement));
+        elements.push_back(element);
+        element_map[elementId] = element.get();
 
         //  shared_ptr  
         elementsById[elementId] = element;
     }
     
-    void Process::addSequenceFlow(const std::string& id, const std::string& name, const std::string& sourceRef, const std::string& targetRef) {
+    void Process::addSequenceFlow(const std::string& id, const std::string& name, const std::string& sourceRef, const std::string& targetRef,
+        const std::string& conditionExpression) {
+        checkMutable();
+
         //   
         auto sourceElement = getElement(sourceRef);
         auto targetElement = getElement(targetRef);
@@ -75,12 +79,16 @@ namespace bpmn {
 
         //  unique_ptr  
         auto sequenceFlow = std::make_unique<SequenceFlow>(id, name, sourceRef, targetRef);
+        sequenceFlow->condition_expression = conditionExpression;
+        if (!conditionExpression.empty()) {
+            sequenceFlow->condition = ConditionExpression::compile(conditionExpression);
+        }
 
         //  shared_ptr   
         std::shared_ptr<SequenceFlow> sharedFlow = std::move(sequenceFlow);
 
         //  unique_ptr   (  )
-        flows.push_back(std::unique_ptr<SequenceFlow>(sharedFlow.get()));
+        flows.push_back(sharedFlow);
 
         //  shared_ptr     
         flowsById[id] = sharedFlow;
@@ -95,6 +103,24 @@ namespace bpmn {
         auto it = outgoingFlows.find(elementId);
         return (it != outgoingFlows.end()) ? it->second : std::vector<std::shared_ptr<SequenceFlow>>{};
     }
+
+    const std::vector<std::shared_ptr<SequenceFlow>> Process::getIncomingFlows(const std::string& elementId) const {
+        auto it = incomingFlows.find(elementId);
+        return (it != incomingFlows.end()) ? it->second : std::vector<std::shared_ptr<SequenceFlow>>{};
+    }
+    const ProcessGraph& Process::getGraph() const {
+        std::call_once(graph_once, [this]() {
+            graph = std::make_unique<ProcessGraph>(*this);
+        });
+        return *graph;
+    }
+
+    void Process::checkMutable() const {
+        if (graph) {
+            throw std::logic_error("Process " + id + " is already compiled and can no longer be modified");
+        }
+    }
+
     const std::string Process::getId() const {
         return id;
     }
@@ -105,10 +131,10 @@ namespace bpmn {
     namespace {
 
         template<typename T>
-        T* findElementById(const std::vector<std::unique_ptr<FlowElement>>& elements, const std::string& id) {
+        T* findElementById(const std::vector<std::shared_ptr<FlowElement>>& elements, const std::string& id) {
             auto it = std::find_if(elements.begin(), elements.end(),
-                [&id](const std::unique_ptr<FlowElement>& elem) {
-                    return elem->id == id && dynamic_cast<T*>(elem.get()) != nullptr;
+                [&id](const std::shared_ptr<FlowElement>& elem) {
+                    return elem->getId() == id && dynamic_cast<T*>(elem.get()) != nullptr;
                 });
             return it != elements.end() ? dynamic_cast<T*>(it->get()) : nullptr;
         }
@@ -157,6 +183,11 @@ namespace bpmn {
             }
         }
 
+        // Timers and messages can only resume a token outside parallel branches
+        if (getGraph().parallelWait() != ProcessGraph::npos) {
+            return false;
+        }
+
         return true;
     }
 
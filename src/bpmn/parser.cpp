@@ -1,134 +1,157 @@
 #include "bpmn/parser.h"
 #include "bpmn/model.h"
-#include <libxml/xpath.h>
+#include <libxml/xmlreader.h>
 #include <stdexcept>
-#include <libxml/xpathInternals.h>
+#include <cstring>
 
 namespace bpmn {
 
-    BpmnParser::BpmnParser() : doc_(nullptr) {}
+    namespace {
 
-    BpmnParser::~BpmnParser() {
-        if (doc_) xmlFreeDoc(doc_);
+        const char* const kBpmnNamespace = "http://www.omg.org/spec/BPMN/20100524/MODEL";
+
+        // Reader options: no network access, no blank text nodes to skip over
+        const int kReaderOptions = XML_PARSE_NONET | XML_PARSE_NOBLANKS;
+
+    } // anonymous namespace
+
+    BpmnParser::BpmnParser() {
+        // Idempotent; must happen before readers are used from several threads
+        xmlInitParser();
     }
 
-    std::unique_ptr<Process> BpmnParser::parse(const std::string& file_path) {
-        doc_ = xmlReadFile(file_path.c_str(), nullptr, 0);
-        if (!doc_) {
+    BpmnParser::~BpmnParser() = default;
+
+    std::unique_ptr<Process> BpmnParser::parse(const std::string& file_path) const {
+        xmlTextReaderPtr reader = xmlReaderForFile(file_path.c_str(), nullptr, kReaderOptions);
+        if (!reader) {
             throw std::runtime_error("Failed to parse BPMN file: " + file_path);
         }
 
-        return parseDocument();
+        return parseStream(reader, "BPMN file: " + file_path);
     }
 
-    std::unique_ptr<Process> BpmnParser::parseFromString(const std::string& xml_content) {
-        doc_ = xmlReadMemory(xml_content.c_str(), xml_content.length(),
-            "noname.xml", nullptr, 0);
-        if (!doc_) {
+    std::unique_ptr<Process> BpmnParser::parseFromString(const std::string& xml_content) const {
+        xmlTextReaderPtr reader = xmlReaderForMemory(xml_content.c_str(), static_cast<int>(xml_content.length()),
+            "noname.xml", nullptr, kReaderOptions);
+        if (!reader) {
             throw std::runtime_error("Failed to parse BPMN XML content");
         }
 
-        return parseDocument();
+        return parseStream(reader, "BPMN XML content");
     }
 
-    std::unique_ptr<Process> BpmnParser::parseDocument() {
-        // Set up XPath context
-        xmlXPathContextPtr xpathCtx = xmlXPathNewContext(doc_);
-        if (!xpathCtx) {
-            throw std::runtime_error("Failed to create XPath context");
-        }
-
-        // Register BPMN namespace
-        if (xmlXPathRegisterNs(xpathCtx, BAD_CAST "bpmn",
-            BAD_CAST "http://www.omg.org/spec/BPMN/20100524/MODEL") != 0) {
-            xmlXPathFreeContext(xpathCtx);
-            throw std::runtime_error("Failed to register BPMN namespace");
-        }
+    std::unique_ptr<Process> BpmnParser::parseStream(xmlTextReaderPtr reader, const std::string& source) const {
+        std::unique_ptr<Process> process;
+        std::vector<PendingFlow> flows;
+        // id -> name of <message> and <signal> elements
+        std::unordered_map<std::string, std::string> messageNames;
+        // Depth of the first <process> while we are inside it, -1 otherwise
+        int processDepth = -1;
 
         try {
-            // Find all process elements
-            xmlXPathObjectPtr xpathObj = xmlXPathEvalExpression(
-                BAD_CAST "//bpmn:process", xpathCtx);
-
-            if (!xpathObj || !xpathObj->nodesetval || xpathObj->nodesetval->nodeNr == 0) {
-                xmlXPathFreeObject(xpathObj);
-                xmlXPathFreeContext(xpathCtx);
-                throw std::runtime_error("No process definition found in BPMN file");
-            }
-
-            // Parse the first process found
-            xmlNodePtr processNode = xpathObj->nodesetval->nodeTab[0];
-
-            // Get process ID and name
-            std::string processId = getAttribute(processNode, "id");
-            std::string processName = getAttribute(processNode, "name");
-
-            auto process = std::make_unique<Process>(processId, processName);
-            parseProcess(processNode, *process);
+            int ret;
+            while ((ret = xmlTextReaderRead(reader)) == 1) {
+                const int nodeType = xmlTextReaderNodeType(reader);
+                const int depth = xmlTextReaderDepth(reader);
+
+                if (nodeType == XML_READER_TYPE_END_ELEMENT) {
+                    if (depth == processDepth) {
+                        processDepth = -1;
+                    }
+                    continue;
+                }
+                if (nodeType != XML_READER_TYPE_ELEMENT) {
+                    continue;
+                }
 
-            xmlXPathFreeObject(xpathObj);
+                const std::string nodeName = getNodeName(reader);
 
-            // Parse all sequence flows from the entire document
-            xpathObj = xmlXPathEvalExpression(BAD_CAST "//bpmn:sequenceFlow", xpathCtx);
-            if (xpathObj && xpathObj->nodesetval) {
-                for (int i = 0; i < xpathObj->nodesetval->nodeNr; i++) {
-                    parseSequenceFlow(xpathObj->nodesetval->nodeTab[i], *process);
+                if (nodeName == "process" && isBpmnNode(reader)) {
+                    // Only the first process is loaded, as before
+                    if (!process) {
+                        process = std::make_unique<Process>(getAttribute(reader, "id"), getAttribute(reader, "name"));
+                        if (!xmlTextReaderIsEmptyElement(reader)) {
+                            processDepth = depth;
+                        }
+                    }
+                }
+                else if (nodeName == "sequenceFlow" && isBpmnNode(reader)) {
+                    // Flows are collected from the entire document, they may
+                    // reference elements that have not been read yet
+                    parseSequenceFlow(reader, flows);
+                }
+                else if ((nodeName == "message" || nodeName == "signal") && isBpmnNode(reader)) {
+                    messageNames[getAttribute(reader, "id")] = getAttribute(reader, "name");
+                }
+                else if (processDepth >= 0 && depth == processDepth + 1) {
+                    parseElement(reader, nodeName, *process);
                 }
             }
-            xmlXPathFreeObject(xpathObj);
-
-            xmlXPathFreeContext(xpathCtx);
 
-            return process;
+            if (ret < 0) {
+                throw std::runtime_error("Failed to parse " + source);
+            }
         }
         catch (...) {
-            xmlXPathFreeContext(xpathCtx);
+            xmlFreeTextReader(reader);
             throw;
         }
-    }
+        xmlFreeTextReader(reader);
 
-    void BpmnParser::parseProcess(xmlNodePtr node, Process& process) {
-        // Parse all elements in the process
-        for (xmlNodePtr cur = node->children; cur; cur = cur->next) {
-            if (cur->type != XML_ELEMENT_NODE) continue;
+        if (!process) {
+            throw std::runtime_error("No process definition found in BPMN file");
+        }
 
-            const std::string nodeName = getNodeName(cur);
+        resolveSequenceFlows(flows, *process);
+        resolveMessageRefs(messageNames, *process);
+        return process;
+    }
 
-            if (nodeName == "startEvent") {
-                parseStartEvent(cur, process);
-            }
-            else if (nodeName == "userTask") {
-                parseUserTask(cur, process);
-            }
-            else if (nodeName == "serviceTask") {
-                parseServiceTask(cur, process);
-            }
-            else if (nodeName == "endEvent") {
-                parseEndEvent(cur, process);
-            }
-            else if (nodeName == "parallelGateway") {
-                parseParallelGateway(cur, process);
-            }
-            else if (nodeName == "exclusiveGateway") {
-                parseExclusiveGateway(cur, process);
-            }
-            // Note: sequence flows are parsed separately from the entire document
+    void BpmnParser::parseElement(xmlTextReaderPtr reader, const std::string& nodeName, Process& process) const {
+        if (nodeName == "startEvent") {
+            parseStartEvent(reader, process);
+        }
+        else if (nodeName == "userTask") {
+            parseUserTask(reader, process);
+        }
+        else if (nodeName == "serviceTask") {
+            parseServiceTask(reader, process);
+        }
+        else if (nodeName == "endEvent") {
+            parseEndEvent(reader, process);
+        }
+        else if (nodeName == "parallelGateway") {
+            parseParallelGateway(reader, process);
+        }
+        else if (nodeName == "exclusiveGateway") {
+            parseExclusiveGateway(reader, process);
+        }
+        else if (nodeName == "intermediateCatchEvent") {
+            parseIntermediateCatchEvent(reader, process);
+        }
+        else if (nodeName == "boundaryEvent") {
+            parseBoundaryEvent(reader, process);
         }
     }
 
-    void BpmnParser::parseStartEvent(xmlNodePtr node, Process& process) {
-        std::string id = getAttribute(node, "id");
-        std::string name = getAttribute(node, "name");
+    void BpmnParser::parseStartEvent(xmlTextReaderPtr reader, Process& process) const {
+        std::string id = getAttribute(reader, "id");
+        std::string name = getAttribute(reader, "name");
 
         if (!id.empty()) {
             auto startEvent = std::make_unique<StartEvent>(id, name);
+            startEvent->timer = readEventDefinition(reader).timer;
             process.addElement(std::unique_ptr<FlowElement>(startEvent.release()));
+            if (process.getStartEventId().empty()) {
+                process.setStartEventId(id);
+            }
         }
     }
 
-    void BpmnParser::parseUserTask(xmlNodePtr node, Process& process) {
-        std::string id = getAttribute(node, "id");
-        std::string name = getAttribute(node, "name");
+    void BpmnParser::parseUserTask(xmlTextReaderPtr reader, Process& process) const {
+        std::string id = getAttribute(reader, "id");
+        std::string name = getAttribute(reader, "name");
 
         if (!id.empty()) {
             auto userTask = std::make_unique<UserTask>(id, name);
@@ -136,19 +159,22 @@ namespace bpmn {
         }
     }
 
-    void BpmnParser::parseServiceTask(xmlNodePtr node, Process& process) {
-        std::string id = getAttribute(node, "id");
-        std::string name = getAttribute(node, "name");
+    void BpmnParser::parseServiceTask(xmlTextReaderPtr reader, Process& process) const {
+        std::string id = getAttribute(reader, "id");
+        std::string name = getAttribute(reader, "name");
 
         if (!id.empty()) {
             auto serviceTask = std::make_unique<services::ServiceTask>(id, name);
+            serviceTask->class_name = getLocalAttribute(reader, "class");
+            serviceTask->topic = getLocalAttribute(reader, "topic");
+            serviceTask->expression = getLocalAttribute(reader, "expression");
             process.addElement(std::unique_ptr<FlowElement>(serviceTask.release()));
         }
     }
 
-    void BpmnParser::parseEndEvent(xmlNodePtr node, Process& process) {
-        std::string id = getAttribute(node, "id");
-        std::string name = getAttribute(node, "name");
+    void BpmnParser::parseEndEvent(xmlTextReaderPtr reader, Process& process) const {
+        std::string id = getAttribute(reader, "id");
+        std::string name = getAttribute(reader, "name");
 
         if (!id.empty()) {
             auto endEvent = std::make_unique<EndEvent>(id, name);
@@ -156,9 +182,9 @@ namespace bpmn {
         }
     }
 
-    void BpmnParser::parseParallelGateway(xmlNodePtr node, Process& process) {
-        std::string id = getAttribute(node, "id");
-        std::string name = getAttribute(node, "name");
+    void BpmnParser::parseParallelGateway(xmlTextReaderPtr reader, Process& process) const {
+        std::string id = getAttribute(reader, "id");
+        std::string name = getAttribute(reader, "name");
 
         if (!id.empty()) {
             auto parallelGateway = std::make_unique<ParallelGateway>(id, name);
@@ -166,25 +192,160 @@ namespace bpmn {
         }
     }
 
-    void BpmnParser::parseExclusiveGateway(xmlNodePtr node, Process& process) {
-        std::string id = getAttribute(node, "id");
-        std::string name = getAttribute(node, "name");
+    void BpmnParser::parseExclusiveGateway(xmlTextReaderPtr reader, Process& process) const {
+        std::string id = getAttribute(reader, "id");
+        std::string name = getAttribute(reader, "name");
 
         if (!id.empty()) {
             auto exclusiveGateway = std::make_unique<ExclusiveGateway>(id, name);
+            exclusiveGateway->default_flow = getAttribute(reader, "default");
             process.addElement(std::unique_ptr<FlowElement>(exclusiveGateway.release()));
         }
     }
 
-    void BpmnParser::parseSequenceFlow(xmlNodePtr node, Process& process) {
-        std::string id = getAttribute(node, "id");
-        std::string name = getAttribute(node, "name");
-        std::string sourceRef = getAttribute(node, "sourceRef");
-        std::string targetRef = getAttribute(node, "targetRef");
+    void BpmnParser::parseIntermediateCatchEvent(xmlTextReaderPtr reader, Process& process) const {
+        std::string id = getAttribute(reader, "id");
+        std::string name = getAttribute(reader, "name");
+        std::string correlationKey = getAttribute(reader, "correlationKey");
+        EventDefinition definition = readEventDefinition(reader);
 
-        if (!id.empty() && !sourceRef.empty() && !targetRef.empty()) {
+        if (id.empty()) {
+            return;
+        }
+        if (!definition.timer.empty()) {
+            auto timerEvent = std::make_unique<TimerCatchEvent>(id, name);
+            timerEvent->timer = std::move(definition.timer);
+            process.addElement(std::unique_ptr<FlowElement>(timerEvent.release()));
+        }
+        else if (!definition.messageRef.empty()) {
+            auto messageEvent = std::make_unique<MessageCatchEvent>(id, name);
+            messageEvent->message_name = definition.messageRef;
+            messageEvent->signal = definition.signal;
+            // Signals are broadcast and never correlated
+            if (!definition.signal) {
+                messageEvent->correlation_variable = correlationKey;
+            }
+            process.addElement(std::unique_ptr<FlowElement>(messageEvent.release()));
+        }
+    }
+
+    void BpmnParser::parseBoundaryEvent(xmlTextReaderPtr reader, Process& process) const {
+        std::string id = getAttribute(reader, "id");
+        std::string name = getAttribute(reader, "name");
+        std::string attachedToRef = getAttribute(reader, "attachedToRef");
+        const bool cancelActivity = getAttribute(reader, "cancelActivity") != "false";
+        TimerDefinition timer = readEventDefinition(reader).timer;
+
+        if (id.empty() || timer.empty()) {
+            return;
+        }
+        if (!cancelActivity) {
+            throw std::runtime_error("Non-interrupting boundary timers are not supported: " + id);
+        }
+
+        auto boundaryEvent = std::make_unique<BoundaryEvent>(id, name);
+        boundaryEvent->attached_to_ref = attachedToRef;
+        boundaryEvent->cancel_activity = cancelActivity;
+        boundaryEvent->timer = std::move(timer);
+        process.addElement(std::unique_ptr<FlowElement>(boundaryEvent.release()));
+    }
+
+    BpmnParser::EventDefinition BpmnParser::readEventDefinition(xmlTextReaderPtr reader) const {
+        EventDefinition definition;
+        if (xmlTextReaderIsEmptyElement(reader)) {
+            return definition;
+        }
+
+        const int depth = xmlTextReaderDepth(reader);
+        while (xmlTextReaderRead(reader) == 1) {
+            const int nodeType = xmlTextReaderNodeType(reader);
+            if (nodeType == XML_READER_TYPE_END_ELEMENT && xmlTextReaderDepth(reader) == depth) {
+                break;
+            }
+            if (nodeType != XML_READER_TYPE_ELEMENT || !isBpmnNode(reader)) {
+                continue;
+            }
+
+            const std::string nodeName = getNodeName(reader);
+            if (nodeName == "messageEventDefinition") {
+                definition.messageRef = getAttribute(reader, "messageRef");
+                continue;
+            }
+            if (nodeName == "signalEventDefinition") {
+                definition.messageRef = getAttribute(reader, "signalRef");
+                definition.signal = true;
+                continue;
+            }
+
+            TimerDefinition::Type type = TimerDefinition::Type::None;
+            if (nodeName == "timeDate") type = TimerDefinition::Type::Date;
+            else if (nodeName == "timeDuration") type = TimerDefinition::Type::Duration;
+            else if (nodeName == "timeCycle") type = TimerDefinition::Type::Cycle;
+            else continue;
+
+            std::string expression;
+            xmlChar* text = xmlTextReaderReadString(reader);
+            if (text) {
+                expression = reinterpret_cast<char*>(text);
+                xmlFree(text);
+            }
+            // Malformed expressions fail the parse with std::invalid_argument
+            definition.timer = TimerDefinition::parse(type, expression);
+        }
+        return definition;
+    }
+
+    void BpmnParser::parseSequenceFlow(xmlTextReaderPtr reader, std::vector<PendingFlow>& flows) const {
+        PendingFlow flow;
+        flow.id = getAttribute(reader, "id");
+        flow.name = getAttribute(reader, "name");
+        flow.sourceRef = getAttribute(reader, "sourceRef");
+        flow.targetRef = getAttribute(reader, "targetRef");
+
+        // Consume the flow's subtree so that the condition text is read here
+        if (!xmlTextReaderIsEmptyElement(reader)) {
+            const int depth = xmlTextReaderDepth(reader);
+            while (xmlTextReaderRead(reader) == 1) {
+                const int nodeType = xmlTextReaderNodeType(reader);
+                const int childDepth = xmlTextReaderDepth(reader);
+                if (nodeType == XML_READER_TYPE_END_ELEMENT && childDepth == depth) {
+                    break;
+                }
+                if (nodeType == XML_READER_TYPE_ELEMENT && childDepth == depth + 1 &&
+                    getNodeName(reader) == "conditionExpression" && isBpmnNode(reader)) {
+                    xmlChar* text = xmlTextReaderReadString(reader);
+                    if (text) {
+                        flow.condition = reinterpret_cast<char*>(text);
+                        xmlFree(text);
+                    }
+                }
+            }
+        }
+
+        if (!flow.id.empty() && !flow.sourceRef.empty() && !flow.targetRef.empty()) {
+            flows.push_back(std::move(flow));
+        }
+    }
+
+    void BpmnParser::resolveMessageRefs(const std::unordered_map<std::string, std::string>& names, Process& process) const {
+        for (const auto& element : process.getElements()) {
+            auto messageEvent = dynamic_cast<MessageCatchEvent*>(element.get());
+            if (!messageEvent) {
+                continue;
+            }
+            // Unknown refs and unnamed messages keep the ref as the name
+            auto it = names.find(messageEvent->message_name);
+            if (it != names.end() && !it->second.empty()) {
+                messageEvent->message_name = it->second;
+            }
+        }
+    }
+
+    void BpmnParser::resolveSequenceFlows(const std::vector<PendingFlow>& flows, Process& process) const {
+        for (const auto& flow : flows) {
             try {
-                process.addSequenceFlow(id, name, sourceRef, targetRef);
+                // Invalid conditions are std::invalid_argument and fail the parse
+                process.addSequenceFlow(flow.id, flow.name, flow.sourceRef, flow.targetRef, flow.condition);
             }
             catch (const std::runtime_error& e) {
                 // Log warning but don't stop parsing
@@ -193,8 +354,8 @@ namespace bpmn {
         }
     }
 
-    std::string BpmnParser::getAttribute(xmlNodePtr node, const std::string& attribute_name) {
-        xmlChar* value = xmlGetProp(node, BAD_CAST attribute_name.c_str());
+    std::string BpmnParser::getAttribute(xmlTextReaderPtr reader, const std::string& attribute_name) const {
+        xmlChar* value = xmlTextReaderGetAttribute(reader, BAD_CAST attribute_name.c_str());
         if (value) {
             std::string result(reinterpret_cast<char*>(value));
             xmlFree(value);
@@ -203,11 +364,34 @@ namespace bpmn {
         return "";
     }
 
-    std::string BpmnParser::getNodeName(xmlNodePtr node) {
-        if (node->name) {
-            return std::string(reinterpret_cast<const char*>(node->name));
+    std::string BpmnParser::getLocalAttribute(xmlTextReaderPtr reader, const std::string& local_name) const {
+        std::string result;
+        if (xmlTextReaderMoveToFirstAttribute(reader) != 1) {
+            return result;
+        }
+        do {
+            const xmlChar* name = xmlTextReaderConstLocalName(reader);
+            if (name && local_name == reinterpret_cast<const char*>(name)) {
+                const xmlChar* value = xmlTextReaderConstValue(reader);
+                result = value ? reinterpret_cast<const char*>(value) : "";
+                break;
+            }
+        } while (xmlTextReaderMoveToNextAttribute(reader) == 1);
+        xmlTextReaderMoveToElement(reader);
+        return result;
+    }
+
+    std::string BpmnParser::getNodeName(xmlTextReaderPtr reader) const {
+        const xmlChar* name = xmlTextReaderConstLocalName(reader);
+        if (name) {
+            return std::string(reinterpret_cast<const char*>(name));
         }
         return "";
     }
 
-} // namespace bpmn
\ No newline at end of file
+    bool BpmnParser::isBpmnNode(xmlTextReaderPtr reader) const {
+        const xmlChar* uri = xmlTextReaderConstNamespaceUri(reader);
+        return uri && std::strcmp(reinterpret_cast<const char*>(uri), kBpmnNamespace) == 0;
+    }
+
+} // namespace bpmn
@@ -0,0 +1,169 @@
+#include "bpmn/process_graph.h"
+#include "bpmn/model.h"
+#include <stdexcept>
+
+namespace bpmn {
+
+    namespace {
+
+        // Counting sort of flow indices by element: offsets get n + 1 entries,
+        // targets keep flows of one element in declaration order
+        void buildAdjacency(std::size_t elementCount, const std::vector<ProcessGraph::Index>& endpoints,
+            std::vector<ProcessGraph::Index>& offsets, std::vector<ProcessGraph::Index>& targets) {
+            offsets.assign(elementCount + 1, 0);
+            for (ProcessGraph::Index endpoint : endpoints) {
+                ++offsets[endpoint + 1];
+            }
+            for (std::size_t i = 1; i < offsets.size(); ++i) {
+                offsets[i] += offsets[i - 1];
+            }
+
+            targets.resize(endpoints.size());
+            std::vector<ProcessGraph::Index> cursor(offsets.begin(), offsets.end() - 1);
+            for (ProcessGraph::Index flow = 0; flow < endpoints.size(); ++flow) {
+                targets[cursor[endpoints[flow]]++] = flow;
+            }
+        }
+
+    } // anonymous namespace
+
+    ProcessGraph::ProcessGraph(const Process& process) {
+        const auto& elements = process.getElements();
+        const auto& flows = process.getSequenceFlows();
+
+        elements_.reserve(elements.size());
+        elementIds_.reserve(elements.size());
+        kinds_.reserve(elements.size());
+        index_.reserve(elements.size());
+        for (const auto& element : elements) {
+            index_.emplace(element->getId(), static_cast<Index>(elements_.size()));
+            elements_.push_back(element.get());
+            elementIds_.push_back(element->getId());
+            kinds_.push_back(element->getKind());
+        }
+
+        std::unordered_map<std::string, Index> flowIndex;
+        flowIndex.reserve(flows.size());
+        flows_.reserve(flows.size());
+        flowSource_.reserve(flows.size());
+        flowTarget_.reserve(flows.size());
+        for (const auto& flow : flows) {
+            const Index source = indexOf(flow->source_ref);
+            const Index target = indexOf(flow->target_ref);
+            if (source == npos || target == npos) {
+                throw std::runtime_error("Sequence flow " + flow->getId() + " references an unknown element");
+            }
+
+            flowIndex.emplace(flow->getId(), static_cast<Index>(flows_.size()));
+            flows_.push_back(flow.get());
+            flowSource_.push_back(source);
+            flowTarget_.push_back(target);
+        }
+
+        buildAdjacency(elements_.size(), flowSource_, outOffsets_, outFlows_);
+        buildAdjacency(elements_.size(), flowTarget_, inOffsets_, inFlows_);
+
+        defaultFlow_.assign(elements_.size(), npos);
+        for (Index i = 0; i < elements_.size(); ++i) {
+            if (kinds_[i] != ElementKind::ExclusiveGateway) {
+                continue;
+            }
+            auto gateway = static_cast<const ExclusiveGateway*>(elements_[i]);
+            if (gateway->default_flow.empty()) {
+                continue;
+            }
+            auto it = flowIndex.find(gateway->default_flow);
+            // A default flow must leave the gateway it belongs to
+            if (it != flowIndex.end() && flowSource_[it->second] == i) {
+                defaultFlow_[i] = it->second;
+            }
+        }
+
+        joinSlot_.assign(elements_.size(), npos);
+        for (Index i = 0; i < elements_.size(); ++i) {
+            if (kinds_[i] == ElementKind::ParallelGateway && inOffsets_[i + 1] - inOffsets_[i] > 1) {
+                joinSlot_[i] = static_cast<Index>(joinCount_++);
+            }
+        }
+
+        // Boundary events grouped by the activity they are attached to
+        std::vector<Index> attachedTo;
+        std::vector<Index> boundaryElements;
+        for (Index i = 0; i < elements_.size(); ++i) {
+            if (kinds_[i] == ElementKind::TimerCatchEvent) {
+                hasTimers_ = true;
+            }
+            if (kinds_[i] == ElementKind::MessageCatchEvent) {
+                hasMessageEvents_ = true;
+            }
+            if (kinds_[i] != ElementKind::BoundaryEvent) {
+                continue;
+            }
+            auto boundary = static_cast<const BoundaryEvent*>(elements_[i]);
+            const Index activity = indexOf(boundary->attached_to_ref);
+            if (activity == npos) {
+                throw std::runtime_error("Boundary event " + boundary->getId() + " is attached to an unknown element");
+            }
+            attachedTo.push_back(activity);
+            boundaryElements.push_back(i);
+            hasTimers_ = hasTimers_ || !boundary->timer.empty();
+        }
+        std::vector<Index> order;
+        buildAdjacency(elements_.size(), attachedTo, boundaryOffsets_, order);
+        boundaries_.reserve(order.size());
+        for (Index position : order) {
+            boundaries_.push_back(boundaryElements[position]);
+        }
+
+        start_ = indexOf(process.getStartEventId());
+
+        // Number of open branches at every reachable element: forks open one
+        // per gateway, joins close one. The first depth found wins, so loops
+        // through a fork end the walk instead of nesting forever.
+        std::vector<int> depth(elements_.size(), -1);
+        std::vector<Index> pending;
+        for (Index i = 0; i < elements_.size(); ++i) {
+            if (kinds_[i] == ElementKind::StartEvent) {
+                depth[i] = 0;
+                pending.push_back(i);
+            }
+        }
+        while (!pending.empty()) {
+            const Index element = pending.back();
+            pending.pop_back();
+            int next = depth[element];
+            if (joinSlot_[element] != npos && next > 0) {
+                --next;
+            }
+            if (kinds_[element] == ElementKind::ParallelGateway && outgoing(element).size() > 1) {
+                ++next;
+            }
+            for (Index flow : outgoing(element)) {
+                const Index target = flowTarget_[flow];
+                if (depth[target] < 0) {
+                    depth[target] = next;
+                    pending.push_back(target);
+                }
+            }
+            // Boundary events wait alongside their activity
+            for (Index boundary : boundaryEvents(element)) {
+                if (depth[boundary] < 0) {
+                    depth[boundary] = depth[element];
+                    pending.push_back(boundary);
+                }
+            }
+        }
+        for (Index i = 0; i < elements_.size() && parallelWait_ == npos; ++i) {
+            if (depth[i] > 0 && (kinds_[i] == ElementKind::TimerCatchEvent ||
+                kinds_[i] == ElementKind::MessageCatchEvent || kinds_[i] == ElementKind::BoundaryEvent)) {
+                parallelWait_ = i;
+            }
+        }
+    }
+
+    ProcessGraph::Index ProcessGraph::indexOf(const std::string& element_id) const {
+        auto it = index_.find(element_id);
+        return it != index_.end() ? it->second : npos;
+    }
+
+} // namespace bpmn
@@ -11,42 +11,39 @@ namespace bpmn {
         ServiceTask::~ServiceTask() = default;
 
         std::future<json> ServiceTask::execute(ExecutionState& state) {
-            // Capture state by move (assumes ExecutionState is movable)
-            ExecutionState stateCopy = std::move(state);
-
-            // Use a mutex if class_name, expression, or topic can be modified concurrently
-            static std::mutex mtx;
-
-            return std::async(std::launch::async,
-                [this, stateCopy = std::move(stateCopy)]() -> json {
-                    try {
-                        json result;
-
-                        // Lock if needed (uncomment if thread safety is required)
-                        // std::lock_guard<std::mutex> lock(mtx);
+            // The call does not depend on the state, so the caller keeps it
+            return std::async(std::launch::async, [this]() { return invoke(); });
+        }
 
-                        if (!class_name.empty()) {
-                            // Java delegate logic
-                            result["output"] = "Java delegate executed";
-                        }
-                        else if (!expression.empty()) {
-                            // Expression evaluation logic
-                            result["output"] = "Expression evaluated";
-                        }
-                        else if (!topic.empty()) {
-                            // External service call logic
-                            result["output"] = "External service called";
-                        }
-                        else {
-                            throw std::runtime_error("No execution method specified (class_name, expression, or topic missing)");
-                        }
+        void ServiceTask::executeAsync(const ExecutionState& state, Callback done) const {
+            // The built-in handlers complete immediately; I/O-bound services
+            // call done from their own completion instead
+            done(invoke());
+        }
 
-                        return result;
-                    }
-                    catch (const std::exception& e) {
-                        return json{ {"error", e.what()} };
-                    }
-                });
+        json ServiceTask::invoke() const {
+            try {
+                json result;
+
+                if (!class_name.empty()) {
+                    // Java delegate logic
+                    result["output"] = "Java delegate executed";
+                }
+                else if (!expression.empty()) {
+                    // Expression evaluation logic
+                    result["output"] = "Expression evaluated";
+                }
+                else if (!topic.empty()) {
+                    // External service call logic
+                    result["output"] = "External service called";
+                }
+                // A task without an implementation passes the token through
+
+                return result;
+            }
+            catch (const std::exception& e) {
+                return json{ {"error", e.what()} };
+            }
         }
     }
-}
\ No newline at end of file
+}
@@ -0,0 +1,232 @@
+#include "bpmn/sharded_executor.h"
+#include "bpmn/instance_id.h"
+#include <algorithm>
+#include <cctype>
+#include <stdexcept>
+#include <thread>
+
+namespace bpmn {
+
+    namespace {
+
+        constexpr std::size_t kRoutingDigits = 8;
+
+        bool routingDigits(const std::string& instance_id, std::uint32_t& value) {
+            if (instance_id.size() < kRoutingDigits) {
+                return false;
+            }
+            value = 0;
+            for (std::size_t i = instance_id.size() - kRoutingDigits; i < instance_id.size(); ++i) {
+                const char c = instance_id[i];
+                if (!std::isxdigit(static_cast<unsigned char>(c))) {
+                    return false;
+                }
+                const std::uint32_t digit = std::isdigit(static_cast<unsigned char>(c))
+                    ? c - '0' : std::tolower(static_cast<unsigned char>(c)) - 'a' + 10;
+                value = (value << 4) | digit;
+            }
+            return true;
+        }
+
+    } // anonymous namespace
+
+    ShardedExecutor::ShardedExecutor(const std::string& connection_string, std::size_t shards, std::size_t definition_cache_capacity) {
+        if (shards == 0) {
+            shards = std::max(1u, std::thread::hardware_concurrency());
+        }
+
+        shards_.reserve(shards);
+        for (std::size_t i = 0; i < shards; ++i) {
+            auto shard = std::make_unique<Shard>();
+            shard->database = std::make_unique<db::Database>(connection_string);
+            addShard(std::move(shard), shards, definition_cache_capacity);
+        }
+    }
+
+    ShardedExecutor::ShardedExecutor(const StoreFactory& make_store, std::size_t shards, std::size_t definition_cache_capacity) {
+        if (shards == 0) {
+            shards = std::max(1u, std::thread::hardware_concurrency());
+        }
+
+        shards_.reserve(shards);
+        for (std::size_t i = 0; i < shards; ++i) {
+            auto shard = std::make_unique<Shard>();
+            shard->store = make_store(i);
+            if (!shard->store) {
+                throw std::invalid_argument("No state store for shard " + std::to_string(i));
+            }
+            addShard(std::move(shard), shards, definition_cache_capacity);
+        }
+    }
+
+    void ShardedExecutor::addShard(std::unique_ptr<Shard> shard, std::size_t shards, std::size_t definition_cache_capacity) {
+        const std::size_t index = shards_.size();
+        shard->queue = std::make_unique<WorkStealingPool>(1);
+        if (shard->database) {
+            shard->executor = std::make_unique<ProcessExecutor>(*shard->database, *shard->queue, definition_cache_capacity);
+        }
+        else {
+            shard->executor = std::make_unique<ProcessExecutor>(*shard->store, *shard->queue, definition_cache_capacity);
+        }
+
+        // The routing digits are random bits of the id, its time prefix stays intact
+        shard->executor->setInstanceIdGenerator([index, shards]() {
+            return stampShard(InstanceIdGenerator::global().next().toString(), index, shards);
+        });
+        shards_.push_back(std::move(shard));
+    }
+
+    ShardedExecutor::~ShardedExecutor() {
+        // Timers first, they submit to the queues
+        for (auto& shard : shards_) {
+            shard->executor->stopTimers();
+        }
+        // Queues next, so no shard runs while another's executor is destroyed
+        for (auto& shard : shards_) {
+            shard->queue.reset();
+        }
+    }
+
+    std::size_t ShardedExecutor::loadTimers() {
+        const std::size_t shards = shards_.size();
+        std::vector<std::future<std::size_t>> loaded;
+        loaded.reserve(shards);
+        for (std::size_t i = 0; i < shards; ++i) {
+            loaded.push_back(submitTo(i, [i, shards](ProcessExecutor& executor) {
+                return executor.loadTimers([i, shards](const TimerService::Timer& timer) {
+                    return shardOf(timer.instance_id, shards) == i;
+                });
+            }));
+        }
+
+        std::size_t count = 0;
+        for (auto& future : loaded) {
+            count += future.get();
+        }
+        return count;
+    }
+
+    std::future<std::string> ShardedExecutor::startProcess(std::shared_ptr<const Process> process, const std::string& init_data,
+        std::function<bool(const std::string&)> user_task_callback) {
+        return submitTo(nextShard(), [process = std::move(process), init_data, user_task_callback](ProcessExecutor& executor) {
+            return executor.startProcess(process, init_data, user_task_callback);
+        });
+    }
+
+    std::future<std::string> ShardedExecutor::startProcessById(const std::string& process_id, const std::string& init_data,
+        std::function<bool(const std::string&)> user_task_callback) {
+        return submitTo(nextShard(), [process_id, init_data, user_task_callback](ProcessExecutor& executor) {
+            return executor.startProcessById(process_id, init_data, user_task_callback);
+        });
+    }
+
+    std::vector<StartResult> ShardedExecutor::startProcessesById(const std::string& process_id, const std::vector<std::string>& init_data) {
+        const std::size_t shards = shards_.size();
+        std::vector<std::future<std::vector<StartResult>>> parts;
+        parts.reserve(shards);
+
+        // Contiguous slices keep the results in input order
+        const std::size_t slice = (init_data.size() + shards - 1) / shards;
+        for (std::size_t shard = 0; shard < shards && shard * slice < init_data.size(); ++shard) {
+            const auto first = init_data.begin() + shard * slice;
+            const auto last = init_data.begin() + std::min(init_data.size(), (shard + 1) * slice);
+            parts.push_back(submitTo(shard, [process_id, part = std::vector<std::string>(first, last)](ProcessExecutor& executor) {
+                return executor.startProcessesById(process_id, part);
+            }));
+        }
+
+        std::vector<StartResult> results;
+        results.reserve(init_data.size());
+        for (auto& part : parts) {
+            for (StartResult& result : part.get()) {
+                results.push_back(std::move(result));
+            }
+        }
+        return results;
+    }
+
+    std::future<std::string> ShardedExecutor::resumeProcess(const std::string& instance_id, const std::string& user_task_result,
+        std::function<bool(const std::string&)> user_task_callback) {
+        return submit(instance_id, [instance_id, user_task_result, user_task_callback](ProcessExecutor& executor) {
+            return executor.resumeProcess(instance_id, user_task_result, user_task_callback);
+        });
+    }
+
+    std::future<std::string> ShardedExecutor::continueProcess(const std::string& instance_id,
+        std::function<bool(const std::string&)> user_task_callback) {
+        return submit(instance_id, [instance_id, user_task_callback](ProcessExecutor& executor) {
+            return executor.continueProcess(instance_id, user_task_callback);
+        });
+    }
+
+    std::string ShardedExecutor::correlateMessage(const std::string& message_name, const std::string& correlation_key,
+        const std::string& data, std::function<bool(const std::string&)> user_task_callback) {
+        // Each shard indexes only the tokens of its own instances
+        for (std::size_t shard = 0; shard < shards_.size(); ++shard) {
+            std::string instance_id = submitTo(shard, [&message_name, &correlation_key, &data, &user_task_callback](ProcessExecutor& executor) {
+                return executor.correlateMessage(message_name, correlation_key, data, user_task_callback);
+            }).get();
+            if (!instance_id.empty()) {
+                return instance_id;
+            }
+        }
+        return "";
+    }
+
+    void ShardedExecutor::addProcessDefinition(std::shared_ptr<const Process> process) {
+        std::vector<std::future<void>> added;
+        added.reserve(shards_.size());
+        for (std::size_t shard = 0; shard < shards_.size(); ++shard) {
+            added.push_back(submitTo(shard, [process](ProcessExecutor& executor) {
+                executor.addProcessDefinition(process);
+            }));
+        }
+        for (auto& future : added) {
+            future.get();
+        }
+    }
+
+    std::vector<WorkStealingPool::Stats> ShardedExecutor::getShardStats() const {
+        std::vector<WorkStealingPool::Stats> stats;
+        stats.reserve(shards_.size());
+        for (const auto& shard : shards_) {
+            stats.push_back(shard->queue->stats());
+        }
+        return stats;
+    }
+
+    std::size_t ShardedExecutor::shardOf(const std::string& instance_id, std::size_t shards) {
+        if (shards <= 1) {
+            return 0;
+        }
+        std::uint32_t value;
+        if (routingDigits(instance_id, value)) {
+            return value % shards;
+        }
+        // Ids that were not generated by this engine still route consistently
+        return std::hash<std::string>()(instance_id) % shards;
+    }
+
+    std::string ShardedExecutor::stampShard(const std::string& uuid, std::size_t shard, std::size_t shards) {
+        std::uint32_t random;
+        if (shards <= 1 || !routingDigits(uuid, random)) {
+            return uuid;
+        }
+
+        // Largest multiple of shards that still fits, plus the shard
+        const std::uint64_t buckets = (std::uint64_t(1) << 32) / shards;
+        const std::uint64_t value = (random % buckets) * shards + shard;
+
+        static const char digits[] = "0123456789abcdef";
+        std::string result = uuid;
+        for (std::size_t i = 0; i < kRoutingDigits; ++i) {
+            result[result.size() - 1 - i] = digits[(value >> (4 * i)) & 0xf];
+        }
+        return result;
+    }
+
+    std::size_t ShardedExecutor::nextShard() {
+        return nextShard_.fetch_add(1, std::memory_order_relaxed) % shards_.size();
+    }
+
+} // namespace bpmn
@@ -0,0 +1,97 @@
+#include "bpmn/state_store.h"
+
+namespace bpmn {
+
+    void StateStore::saveProcessInstances(const std::vector<ProcessInstanceRecord>& instances) {
+        for (const auto& instance : instances) {
+            saveProcessInstance(instance.instance_id, instance.process_id, instance.current_element, instance.variables);
+            if (instance.completed) {
+                completeProcessInstance(instance.instance_id);
+            }
+        }
+    }
+
+    void StateStore::saveUserTasks(const std::vector<UserTaskRecord>& tasks) {
+        for (const auto& task : tasks) {
+            saveUserTask(task.instance_id, task.task_id, task.form_key, task.variables);
+        }
+    }
+
+    void StateStore::saveProcessInstancesWithTasks(const std::vector<ProcessInstanceRecord>& instances,
+        const std::vector<UserTaskRecord>& tasks) {
+        saveProcessInstances(instances);
+        saveUserTasks(tasks);
+    }
+
+    void DatabaseStateStore::saveProcessInstance(const std::string& instance_id, const std::string& process_id,
+        const std::string& current_element, const Variables& variables) {
+        db_.saveProcessInstance(instance_id, process_id, current_element, variables);
+    }
+
+    StateStore::ProcessInstance DatabaseStateStore::loadProcessInstance(const std::string& instance_id) {
+        return db_.loadProcessInstance(instance_id);
+    }
+
+    bool DatabaseStateStore::containsProcessInstance(const std::string& instance_id) {
+        return db_.hasProcessInstance(instance_id);
+    }
+
+    void DatabaseStateStore::completeProcessInstance(const std::string& instance_id) {
+        db_.completeProcessInstance(instance_id);
+    }
+
+    void DatabaseStateStore::saveUserTask(const std::string& instance_id, const std::string& task_id,
+        const std::string& form_key, const Variables& variables) {
+        db_.saveUserTask(instance_id, task_id, form_key, variables);
+    }
+
+    void DatabaseStateStore::saveError(const std::string& instance_id, const std::string& error_message) {
+        db_.saveError(instance_id, error_message);
+    }
+
+    void DatabaseStateStore::saveProcessInstances(const std::vector<ProcessInstanceRecord>& instances) {
+        db_.saveProcessInstances(instances);
+    }
+
+    void DatabaseStateStore::saveUserTasks(const std::vector<UserTaskRecord>& tasks) {
+        db_.saveUserTasks(tasks);
+    }
+
+    void DatabaseStateStore::saveProcessInstancesWithTasks(const std::vector<ProcessInstanceRecord>& instances,
+        const std::vector<UserTaskRecord>& tasks) {
+        db_.saveProcessInstancesWithTasks(instances, tasks);
+    }
+
+    void DatabaseStateStore::saveTimer(const TimerRecord& timer) {
+        db_.saveTimer(timer);
+    }
+
+    void DatabaseStateStore::deleteTimer(const std::string& instance_id, const std::string& element_id) {
+        db_.deleteTimer(instance_id, element_id);
+    }
+
+    void DatabaseStateStore::deleteTimers(const std::string& instance_id) {
+        db_.deleteTimers(instance_id);
+    }
+
+    std::vector<StateStore::TimerRecord> DatabaseStateStore::loadTimers() {
+        return db_.loadTimers();
+    }
+
+    void DatabaseStateStore::saveMessageSubscription(const MessageSubscriptionRecord& subscription) {
+        db_.saveMessageSubscription(subscription);
+    }
+
+    void DatabaseStateStore::deleteMessageSubscription(const std::string& instance_id, const std::string& element_id) {
+        db_.deleteMessageSubscription(instance_id, element_id);
+    }
+
+    void DatabaseStateStore::deleteMessageSubscriptions(const std::string& instance_id) {
+        db_.deleteMessageSubscriptions(instance_id);
+    }
+
+    std::vector<StateStore::MessageSubscriptionRecord> DatabaseStateStore::loadMessageSubscriptions() {
+        return db_.loadMessageSubscriptions();
+    }
+
+} // namespace bpmn
@@ -0,0 +1,246 @@
+#include "bpmn/timer_definition.h"
+#include <cctype>
+#include <limits>
+#include <stdexcept>
+
+namespace bpmn {
+
+    namespace {
+
+        [[noreturn]] void invalid(const std::string& what, const std::string& expression) {
+            throw std::invalid_argument("Invalid timer " + what + ": '" + expression + "'");
+        }
+
+        // Fixed-width decimal field at pos
+        int readDigits(const std::string& text, std::size_t& pos, std::size_t count, const std::string& expression) {
+            int value = 0;
+            for (std::size_t i = 0; i < count; ++i, ++pos) {
+                if (pos >= text.size() || !std::isdigit(static_cast<unsigned char>(text[pos]))) {
+                    invalid("date", expression);
+                }
+                value = value * 10 + (text[pos] - '0');
+            }
+            return value;
+        }
+
+        void expect(const std::string& text, std::size_t& pos, char c, const std::string& expression) {
+            if (pos >= text.size() || text[pos] != c) {
+                invalid("date", expression);
+            }
+            ++pos;
+        }
+
+        // Days since 1970-01-01 of a proleptic Gregorian date
+        std::int64_t daysFromCivil(std::int64_t year, unsigned month, unsigned day) {
+            year -= month <= 2;
+            const std::int64_t era = (year >= 0 ? year : year - 399) / 400;
+            const unsigned yearOfEra = static_cast<unsigned>(year - era * 400);
+            const unsigned dayOfYear = (153 * (month + (month > 2 ? -3 : 9)) + 2) / 5 + day - 1;
+            const unsigned dayOfEra = yearOfEra * 365 + yearOfEra / 4 - yearOfEra / 100 + dayOfYear;
+            return era * 146097 + static_cast<std::int64_t>(dayOfEra) - 719468;
+        }
+
+    } // anonymous namespace
+
+    std::int64_t TimerDefinition::firstDue(std::int64_t now_ms) const {
+        switch (type) {
+        case Type::Date:
+            return date_ms;
+        case Type::Duration:
+            return now_ms + interval_ms;
+        case Type::Cycle:
+            // A cycle with a start fires there first, otherwise one period from now
+            return date_ms != 0 ? date_ms : now_ms + interval_ms;
+        default:
+            return now_ms;
+        }
+    }
+
+    TimerDefinition TimerDefinition::parse(Type type, const std::string& expression) {
+        TimerDefinition timer;
+        timer.type = type;
+        timer.expression = expression;
+
+        // Surrounding whitespace from the XML text is not part of the value
+        const std::size_t first = expression.find_first_not_of(" \t\r\n");
+        const std::size_t last = expression.find_last_not_of(" \t\r\n");
+        const std::string text = first == std::string::npos ? std::string() : expression.substr(first, last - first + 1);
+
+        switch (type) {
+        case Type::Date:
+            timer.date_ms = parseDate(text);
+            break;
+        case Type::Duration:
+            timer.interval_ms = parseDuration(text);
+            break;
+        case Type::Cycle: {
+            // R[n]/[start/]period
+            if (text.size() < 3 || text[0] != 'R') {
+                invalid("cycle", expression);
+            }
+            const std::size_t slash = text.find('/');
+            if (slash == std::string::npos) {
+                invalid("cycle", expression);
+            }
+            const std::string count = text.substr(1, slash - 1);
+            if (count.empty()) {
+                timer.repetitions = -1;
+            }
+            else {
+                for (char c : count) {
+                    if (!std::isdigit(static_cast<unsigned char>(c))) {
+                        invalid("cycle", expression);
+                    }
+                }
+                try {
+                    timer.repetitions = std::stoi(count);
+                }
+                catch (const std::out_of_range&) {
+                    invalid("cycle", expression);
+                }
+            }
+
+            const std::string rest = text.substr(slash + 1);
+            const std::size_t split = rest.find('/');
+            if (split == std::string::npos) {
+                timer.interval_ms = parseDuration(rest);
+            }
+            else {
+                timer.date_ms = parseDate(rest.substr(0, split));
+                timer.interval_ms = parseDuration(rest.substr(split + 1));
+            }
+            if (timer.interval_ms <= 0) {
+                invalid("cycle", expression);
+            }
+            break;
+        }
+        default:
+            break;
+        }
+        return timer;
+    }
+
+    std::int64_t TimerDefinition::parseDuration(const std::string& expression) {
+        // P[nW][nD][T[nH][nM][n[.n]S]]
+        if (expression.size() < 2 || expression[0] != 'P') {
+            invalid("duration", expression);
+        }
+
+        double total_ms = 0;
+        bool time = false;
+        bool any = false;
+        std::size_t pos = 1;
+        while (pos < expression.size()) {
+            if (expression[pos] == 'T') {
+                if (time) {
+                    invalid("duration", expression);
+                }
+                time = true;
+                ++pos;
+                continue;
+            }
+
+            const std::size_t start = pos;
+            while (pos < expression.size() &&
+                (std::isdigit(static_cast<unsigned char>(expression[pos])) || expression[pos] == '.' || expression[pos] == ',')) {
+                ++pos;
+            }
+            if (pos == start || pos >= expression.size()) {
+                invalid("duration", expression);
+            }
+            std::string number = expression.substr(start, pos - start);
+            for (char& c : number) {
+                if (c == ',') {
+                    c = '.';
+                }
+            }
+            // All of it must be the number: "1.2.3" is not 1.2
+            double value = 0;
+            std::size_t used = 0;
+            try {
+                value = std::stod(number, &used);
+            }
+            catch (const std::logic_error&) {
+                invalid("duration", expression);
+            }
+            if (used != number.size()) {
+                invalid("duration", expression);
+            }
+
+            double unit_ms = 0;
+            switch (expression[pos]) {
+            case 'W': unit_ms = time ? 0 : 7 * 86400000.0; break;
+            case 'D': unit_ms = time ? 0 : 86400000.0; break;
+            case 'H': unit_ms = time ? 3600000.0 : 0; break;
+            case 'M': unit_ms = time ? 60000.0 : 0; break;  // months are not supported
+            case 'S': unit_ms = time ? 1000.0 : 0; break;
+            default: break;
+            }
+            if (unit_ms == 0) {
+                invalid("duration", expression);
+            }
+            total_ms += value * unit_ms;
+            any = true;
+            ++pos;
+        }
+        if (!any || total_ms >= static_cast<double>(std::numeric_limits<std::int64_t>::max())) {
+            invalid("duration", expression);
+        }
+        return static_cast<std::int64_t>(total_ms + 0.5);
+    }
+
+    std::int64_t TimerDefinition::parseDate(const std::string& expression) {
+        // YYYY-MM-DDThh:mm[:ss[.fff]][Z|+hh:mm|-hh:mm], UTC without a zone
+        std::size_t pos = 0;
+        const int year = readDigits(expression, pos, 4, expression);
+        expect(expression, pos, '-', expression);
+        const int month = readDigits(expression, pos, 2, expression);
+        expect(expression, pos, '-', expression);
+        const int day = readDigits(expression, pos, 2, expression);
+        expect(expression, pos, 'T', expression);
+        const int hour = readDigits(expression, pos, 2, expression);
+        expect(expression, pos, ':', expression);
+        const int minute = readDigits(expression, pos, 2, expression);
+
+        int second = 0;
+        int millis = 0;
+        if (pos < expression.size() && expression[pos] == ':') {
+            ++pos;
+            second = readDigits(expression, pos, 2, expression);
+            if (pos < expression.size() && expression[pos] == '.') {
+                ++pos;
+                int scale = 100;
+                while (pos < expression.size() && std::isdigit(static_cast<unsigned char>(expression[pos]))) {
+                    millis += (expression[pos] - '0') * scale;
+                    scale /= 10;
+                    ++pos;
+                }
+            }
+        }
+        if (month < 1 || month > 12 || day < 1 || day > 31 || hour > 23 || minute > 59 || second > 60) {
+            invalid("date", expression);
+        }
+
+        std::int64_t offset_minutes = 0;
+        if (pos < expression.size()) {
+            if (expression[pos] == 'Z' && pos + 1 == expression.size()) {
+                ++pos;
+            }
+            else if (expression[pos] == '+' || expression[pos] == '-') {
+                const int sign = expression[pos] == '-' ? -1 : 1;
+                ++pos;
+                const int offset_hours = readDigits(expression, pos, 2, expression);
+                expect(expression, pos, ':', expression);
+                offset_minutes = sign * (offset_hours * 60 + readDigits(expression, pos, 2, expression));
+            }
+            if (pos != expression.size()) {
+                invalid("date", expression);
+            }
+        }
+
+        const std::int64_t days = daysFromCivil(year, static_cast<unsigned>(month), static_cast<unsigned>(day));
+        const std::int64_t seconds = days * 86400 + hour * 3600 + minute * 60 + second - offset_minutes * 60;
+        return seconds * 1000 + millis;
+    }
+
+} // namespace bpmn
@@ -0,0 +1,142 @@
+#include "bpmn/timer_service.h"
+
+namespace bpmn {
+
+    TimerService::TimerService(Handler handler, std::chrono::milliseconds resolution)
+        : handler_(std::move(handler)), resolution_(resolution.count() > 0 ? resolution.count() : 1),
+        wheel_(static_cast<std::uint64_t>(nowMs() / resolution_)) {
+    }
+
+    TimerService::~TimerService() {
+        stop();
+    }
+
+    std::int64_t TimerService::nowMs() {
+        return std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::system_clock::now().time_since_epoch()).count();
+    }
+
+    void TimerService::schedule(Timer timer) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        insertLocked(std::move(timer));
+    }
+
+    void TimerService::schedule(std::vector<Timer> timers) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (Timer& timer : timers) {
+            insertLocked(std::move(timer));
+        }
+    }
+
+    void TimerService::insertLocked(Timer timer) {
+        if (stopping_) {
+            return;
+        }
+
+        // Rounded up so that a timer never fires before its due time
+        const std::int64_t due = timer.due_at > 0 ? timer.due_at : 0;
+        const auto tick = static_cast<std::uint64_t>((due + resolution_ - 1) / resolution_);
+
+        auto& ids = pending_[timer.instance_id];
+        auto it = ids.find(timer.element_id);
+        if (it != ids.end()) {
+            wheel_.cancel(it->second);
+        }
+        const std::string element_id = timer.element_id;
+        ids[element_id] = wheel_.insert(tick, std::move(timer));
+
+        if (!thread_.joinable()) {
+            thread_ = std::thread(&TimerService::loop, this);
+        }
+        wake_.notify_one();
+    }
+
+    bool TimerService::cancel(const std::string& instance_id, const std::string& element_id) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto instance = pending_.find(instance_id);
+        if (instance == pending_.end()) {
+            return false;
+        }
+        auto it = instance->second.find(element_id);
+        if (it == instance->second.end()) {
+            return false;
+        }
+        wheel_.cancel(it->second);
+        instance->second.erase(it);
+        if (instance->second.empty()) {
+            pending_.erase(instance);
+        }
+        return true;
+    }
+
+    std::size_t TimerService::cancelInstance(const std::string& instance_id) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto instance = pending_.find(instance_id);
+        if (instance == pending_.end()) {
+            return 0;
+        }
+        const std::size_t count = instance->second.size();
+        for (const auto& [element_id, id] : instance->second) {
+            wheel_.cancel(id);
+        }
+        pending_.erase(instance);
+        return count;
+    }
+
+    void TimerService::stop() {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stopping_ = true;
+        }
+        wake_.notify_all();
+        if (thread_.joinable()) {
+            thread_.join();
+        }
+    }
+
+    std::size_t TimerService::pending() const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return wheel_.size();
+    }
+
+    void TimerService::loop() {
+        std::vector<Timer> expired;
+        std::unique_lock<std::mutex> lock(mutex_);
+        while (!stopping_) {
+            if (wheel_.size() == 0) {
+                wake_.wait(lock, [this]() { return stopping_ || wheel_.size() > 0; });
+                continue;
+            }
+
+            wheel_.advance(static_cast<std::uint64_t>(nowMs() / resolution_), expired);
+            for (const Timer& timer : expired) {
+                auto instance = pending_.find(timer.instance_id);
+                if (instance != pending_.end()) {
+                    instance->second.erase(timer.element_id);
+                    if (instance->second.empty()) {
+                        pending_.erase(instance);
+                    }
+                }
+            }
+
+            if (!expired.empty()) {
+                // The handler may schedule again
+                lock.unlock();
+                for (Timer& timer : expired) {
+                    try {
+                        handler_(std::move(timer));
+                    }
+                    catch (...) {
+                        // The handler reports its own errors, the thread keeps going
+                    }
+                }
+                expired.clear();
+                lock.lock();
+                continue;
+            }
+
+            wake_.wait_for(lock, std::chrono::milliseconds(resolution_));
+        }
+    }
+
+} // namespace bpmn
@@ -0,0 +1,421 @@
+#include "bpmn/variables.h"
+#include <nlohmann/json.hpp>
+#include <algorithm>
+#include <cctype>
+#include <charconv>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <stdexcept>
+#include <unordered_map>
+
+namespace bpmn {
+
+    namespace {
+
+        // Variable names of every instance, never released. Models use a
+        // small, fixed set of names; payloads may bring any number, so the
+        // table stops growing at Variables::kInternedNames.
+        class NameTable {
+        public:
+            // nullptr once the table is full and name is not in it
+            const std::string* intern(std::string_view name) {
+                {
+                    std::shared_lock<std::shared_mutex> lock(mutex_);
+                    auto it = names_.find(name);
+                    if (it != names_.end()) {
+                        return it->second.get();
+                    }
+                    if (names_.size() >= Variables::kInternedNames) {
+                        return nullptr;
+                    }
+                }
+                std::unique_lock<std::shared_mutex> lock(mutex_);
+                auto it = names_.find(name);
+                if (it == names_.end()) {
+                    if (names_.size() >= Variables::kInternedNames) {
+                        return nullptr;
+                    }
+                    auto stored = std::make_unique<std::string>(name);
+                    const std::string_view key(*stored);
+                    it = names_.emplace(key, std::move(stored)).first;
+                }
+                return it->second.get();
+            }
+
+            std::size_t size() {
+                std::shared_lock<std::shared_mutex> lock(mutex_);
+                return names_.size();
+            }
+
+        private:
+            std::shared_mutex mutex_;
+            // Keys view the owned strings
+            std::unordered_map<std::string_view, std::unique_ptr<std::string>> names_;
+        };
+
+        NameTable& names() {
+            static NameTable table;
+            return table;
+        }
+
+        Container containerFromJson(const nlohmann::json& object) {
+            Container container;
+            for (auto it = object.begin(); it != object.end(); ++it) {
+                if (!it.value().is_null()) {
+                    container.setField(it.key(), Variables::valueFromJson(it.value()));
+                }
+            }
+            return container;
+        }
+
+        nlohmann::json containerToJson(const Container& container) {
+            nlohmann::json object = nlohmann::json::object();
+            for (const auto& [name, value] : container.fields()) {
+                object[name] = Variables::valueToJson(value);
+            }
+            return object;
+        }
+
+        // Value whose string form is exactly text
+        Variables::Value parseCanonical(const std::string& text) {
+            if (text == "true" || text == "false") {
+                return text == "true";
+            }
+            if (text.empty() || !(std::isdigit(static_cast<unsigned char>(text[0])) || text[0] == '-')) {
+                return text;
+            }
+            const char* first = text.data();
+            const char* last = first + text.size();
+            int integer = 0;
+            auto parsed = std::from_chars(first, last, integer);
+            if (parsed.ec == std::errc() && parsed.ptr == last) {
+                if (std::to_string(integer) == text) {
+                    return integer;
+                }
+                return text;
+            }
+            double number = 0.0;
+            parsed = std::from_chars(first, last, number);
+            if (parsed.ec == std::errc() && parsed.ptr == last && Variables::toString(number) == text) {
+                return number;
+            }
+            return text;
+        }
+
+        bool nameBefore(const Variables::Entry& entry, std::string_view name) {
+            return std::string_view(entry.name()) < name;
+        }
+
+        bool sameValue(const Variables::Value& left, const Variables::Value& right) {
+            if (left.index() != right.index()) {
+                return false;
+            }
+            switch (left.index()) {
+            case 0: return std::get<int>(left) == std::get<int>(right);
+            case 1: return std::get<double>(left) == std::get<double>(right);
+            case 2: return std::get<bool>(left) == std::get<bool>(right);
+            case 3: return std::get<std::string>(left) == std::get<std::string>(right);
+            default: return Variables::valueToJson(left) == Variables::valueToJson(right);
+            }
+        }
+
+    } // anonymous namespace
+
+    std::size_t Variables::internedNames() {
+        return names().size();
+    }
+
+    Variables::Entry Variables::makeEntry(std::string_view name, Value value) {
+        if (const std::string* interned = names().intern(name)) {
+            return Entry(interned, std::move(value));
+        }
+        auto owned = std::make_shared<const std::string>(name);
+        Entry entry(owned.get(), std::move(value));
+        entry.owned_ = std::move(owned);
+        return entry;
+    }
+
+    const Variables::Entry* Variables::lookup(const Delta& entries, std::string_view name) {
+        const Entry* it = std::lower_bound(entries.begin(), entries.end(), name, nameBefore);
+        return it != entries.end() && *it->name_ == name ? it : nullptr;
+    }
+
+    Variables::Entry& Variables::place(Delta& entries, std::string_view name) {
+        Entry* it = std::lower_bound(entries.begin(), entries.end(), name, nameBefore);
+        if (it != entries.end() && *it->name_ == name) {
+            return *it;
+        }
+        return *entries.emplace(it, makeEntry(name, Value()));
+    }
+
+    void Variables::overlay(Delta& entries, Entry&& entry) {
+        Entry* it = std::lower_bound(entries.begin(), entries.end(), std::string_view(*entry.name_), nameBefore);
+        // Names that are not interned have their own copies, so compare the text
+        if (it != entries.end() && *it->name_ == *entry.name_) {
+            *it = std::move(entry);
+        }
+        else {
+            entries.emplace(it, std::move(entry));
+        }
+    }
+
+    std::vector<const Variables::Entry*> Variables::visible() const {
+        std::vector<const Entry*> result;
+        result.reserve(delta_.size());
+        for (const Entry& entry : delta_) {
+            result.push_back(&entry);
+        }
+        // Merge each lower layer in, upper entries hide lower ones
+        std::vector<const Entry*> merged;
+        for (const Layer* layer = scope_.get(); layer; layer = layer->parent.get()) {
+            merged.clear();
+            merged.reserve(result.size() + layer->entries.size());
+            auto upper = result.begin();
+            const Entry* lower = layer->entries.begin();
+            while (upper != result.end() || lower != layer->entries.end()) {
+                if (lower == layer->entries.end() || (upper != result.end() && *(*upper)->name_ < *lower->name_)) {
+                    merged.push_back(*upper++);
+                }
+                else if (upper == result.end() || *lower->name_ < *(*upper)->name_) {
+                    merged.push_back(lower++);
+                }
+                else {
+                    merged.push_back(*upper++);
+                    ++lower;
+                }
+            }
+            result.swap(merged);
+        }
+        result.erase(std::remove_if(result.begin(), result.end(), [](const Entry* entry) { return entry->erased_; }),
+            result.end());
+        return result;
+    }
+
+    const Variables::Value* Variables::find(std::string_view name) const {
+        const Entry* entry = lookup(delta_, name);
+        for (const Layer* layer = scope_.get(); !entry && layer; layer = layer->parent.get()) {
+            entry = lookup(layer->entries, name);
+        }
+        return entry && !entry->erased_ ? &entry->value_ : nullptr;
+    }
+
+    const Variables::Value& Variables::at(std::string_view name) const {
+        const Value* value = find(name);
+        if (!value) {
+            throw std::out_of_range("Variable not found: " + std::string(name));
+        }
+        return *value;
+    }
+
+    std::string Variables::getString(std::string_view name) const {
+        const Value* value = find(name);
+        return value ? toString(*value) : std::string();
+    }
+
+    void Variables::set(std::string_view name, Value value) {
+        Entry& entry = place(delta_, name);
+        entry.value_ = std::move(value);
+        entry.erased_ = false;
+    }
+
+    bool Variables::erase(std::string_view name) {
+        if (!find(name)) {
+            return false;
+        }
+        const Entry* below = nullptr;
+        for (const Layer* layer = scope_.get(); !below && layer; layer = layer->parent.get()) {
+            below = lookup(layer->entries, name);
+        }
+        if (below && !below->erased_) {
+            Entry& entry = place(delta_, name);
+            entry.value_ = Value();
+            entry.erased_ = true;
+        }
+        else {
+            delta_.erase(lookup(delta_, name));
+        }
+        return true;
+    }
+
+    void Variables::clear() {
+        delta_.clear();
+        for (const Entry* entry : visible()) {
+            place(delta_, *entry->name_).erased_ = true;
+        }
+    }
+
+    Variables Variables::fork() {
+        scope_ = std::make_shared<const Layer>(Layer{ scope_, std::move(delta_) });
+        delta_.clear();
+        return *this;
+    }
+
+    Variables::Delta Variables::takeDelta() {
+        Delta taken = std::move(delta_);
+        delta_.clear();
+        return taken;
+    }
+
+    void Variables::join(std::vector<Delta> arrivals, VariableMergePolicy policy) {
+        // Anything this token wrote after handing in its delta arrives last
+        arrivals.push_back(takeDelta());
+
+        Delta merged;
+        for (Delta& arrival : arrivals) {
+            for (Entry& entry : arrival) {
+                Entry* it = std::lower_bound(merged.begin(), merged.end(), std::string_view(*entry.name_), nameBefore);
+                if (it == merged.end() || *it->name_ != *entry.name_) {
+                    merged.emplace(it, std::move(entry));
+                    continue;
+                }
+                if (it->erased_ == entry.erased_ && (entry.erased_ || sameValue(it->value_, entry.value_))) {
+                    continue;
+                }
+                switch (policy) {
+                case VariableMergePolicy::LastArrivalWins:
+                    *it = std::move(entry);
+                    break;
+                case VariableMergePolicy::FirstArrivalWins:
+                    break;
+                case VariableMergePolicy::Fail:
+                    throw std::runtime_error("Parallel branches wrote different values to variable " + *entry.name_);
+                }
+            }
+        }
+
+        // The fork's layer becomes part of this token's writes to the enclosing scope
+        if (scope_) {
+            delta_ = scope_->entries;
+            scope_ = scope_->parent;
+        }
+        for (Entry& entry : merged) {
+            if (!entry.erased_) {
+                overlay(delta_, std::move(entry));
+                continue;
+            }
+            // Tombstones are only kept while they hide a lower layer
+            const Entry* below = nullptr;
+            for (const Layer* layer = scope_.get(); !below && layer; layer = layer->parent.get()) {
+                below = lookup(layer->entries, *entry.name_);
+            }
+            if (below && !below->erased_) {
+                overlay(delta_, std::move(entry));
+            }
+            else if (const Entry* own = lookup(delta_, *entry.name_)) {
+                delta_.erase(own);
+            }
+        }
+    }
+
+    std::string Variables::toString(const Value& value) {
+        if (const std::string* text = std::get_if<std::string>(&value)) {
+            return *text;
+        }
+        return valueToJson(value).dump();
+    }
+
+    std::map<std::string, std::string> Variables::toStringMap() const {
+        std::map<std::string, std::string> result;
+        for (const Entry* entry : visible()) {
+            // Sorted input, every insertion lands at the end
+            result.emplace_hint(result.end(), *entry->name_, toString(entry->value_));
+        }
+        return result;
+    }
+
+    Variables Variables::fromStringMap(const std::map<std::string, std::string>& values) {
+        Variables result;
+        result.delta_.reserve(values.size());
+        for (const auto& [name, text] : values) {
+            result.delta_.emplace_back(makeEntry(name, parseCanonical(text)));
+        }
+        return result;
+    }
+
+    Variables::Value Variables::valueFromJson(const nlohmann::json& json) {
+        switch (json.type()) {
+        case nlohmann::json::value_t::boolean:
+            return json.get<bool>();
+        case nlohmann::json::value_t::number_integer: {
+            const auto number = json.get<std::int64_t>();
+            if (number >= std::numeric_limits<int>::min() && number <= std::numeric_limits<int>::max()) {
+                return static_cast<int>(number);
+            }
+            return static_cast<double>(number);
+        }
+        case nlohmann::json::value_t::number_unsigned: {
+            const auto number = json.get<std::uint64_t>();
+            if (number <= static_cast<std::uint64_t>(std::numeric_limits<int>::max())) {
+                return static_cast<int>(number);
+            }
+            return static_cast<double>(number);
+        }
+        case nlohmann::json::value_t::number_float:
+            return json.get<double>();
+        case nlohmann::json::value_t::string:
+            return json.get<std::string>();
+        case nlohmann::json::value_t::object:
+            return std::make_unique<Container>(containerFromJson(json));
+        case nlohmann::json::value_t::array: {
+            Container::Array array;
+            array.reserve(json.size());
+            for (const auto& element : json) {
+                if (!element.is_object()) {
+                    return json.dump();
+                }
+                array.push_back(std::make_unique<Container>(containerFromJson(element)));
+            }
+            return array;
+        }
+        default:
+            return json.dump();
+        }
+    }
+
+    nlohmann::json Variables::valueToJson(const Value& value) {
+        switch (value.index()) {
+        case 0: return std::get<int>(value);
+        case 1: return std::get<double>(value);
+        case 2: return std::get<bool>(value);
+        case 3: return std::get<std::string>(value);
+        case 4: {
+            const Container::Ptr& nested = std::get<Container::Ptr>(value);
+            return nested ? containerToJson(*nested) : nlohmann::json();
+        }
+        default: {
+            nlohmann::json array = nlohmann::json::array();
+            for (const auto& element : std::get<Container::Array>(value)) {
+                array.push_back(element ? containerToJson(*element) : nlohmann::json());
+            }
+            return array;
+        }
+        }
+    }
+
+    nlohmann::json Variables::toJson() const {
+        nlohmann::json object = nlohmann::json::object();
+        for (const Entry* entry : visible()) {
+            object[*entry->name_] = valueToJson(entry->value_);
+        }
+        return object;
+    }
+
+    Variables Variables::fromJson(const nlohmann::json& json) {
+        if (!json.is_object()) {
+            throw std::invalid_argument("Variables must be a JSON object");
+        }
+        Variables result;
+        result.delta_.reserve(json.size());
+        // nlohmann::json objects iterate in key order
+        for (auto it = json.begin(); it != json.end(); ++it) {
+            if (!it.value().is_null()) {
+                result.delta_.emplace_back(makeEntry(it.key(), valueFromJson(it.value())));
+            }
+        }
+        return result;
+    }
+
+} // namespace bpmn
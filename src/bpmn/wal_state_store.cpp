@@ -0,0 +1,1033 @@
+#include "bpmn/wal_state_store.h"
+#include <algorithm>
+#include <array>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <limits>
+#include <stdexcept>
+#include <string_view>
+#include <tuple>
+#include <unordered_set>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#else
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace bpmn {
+
+    namespace {
+
+        // Record layout, little endian:
+        //   u32 payload length, u32 CRC-32 of everything but itself,
+        //   u64 sequence, u8 type, 7 bytes zero, payload, zeros up to 8 bytes.
+        // A zero length marks the unwritten rest of a segment.
+        constexpr std::size_t kHeaderSize = 24;
+        constexpr std::size_t kAlignment = 8;
+        // Records re-examined per lock while a segment is compacted
+        constexpr std::size_t kCompactionBatch = 256;
+        // Locations address segments with 32 bits
+        constexpr std::size_t kMaxSegmentSize = std::numeric_limits<std::uint32_t>::max();
+
+        std::size_t recordSize(std::size_t payload) {
+            return (kHeaderSize + payload + kAlignment - 1) / kAlignment * kAlignment;
+        }
+
+        const std::array<std::uint32_t, 256>& crcTable() {
+            static const std::array<std::uint32_t, 256> table = []() {
+                std::array<std::uint32_t, 256> result{};
+                for (std::uint32_t i = 0; i < 256; ++i) {
+                    std::uint32_t crc = i;
+                    for (int bit = 0; bit < 8; ++bit) {
+                        crc = crc & 1 ? 0xedb88320u ^ (crc >> 1) : crc >> 1;
+                    }
+                    result[i] = crc;
+                }
+                return result;
+            }();
+            return table;
+        }
+
+        std::uint32_t crc32(std::uint32_t crc, const char* data, std::size_t size) {
+            const auto& table = crcTable();
+            crc = ~crc;
+            for (std::size_t i = 0; i < size; ++i) {
+                crc = table[(crc ^ static_cast<std::uint8_t>(data[i])) & 0xff] ^ (crc >> 8);
+            }
+            return ~crc;
+        }
+
+        void putU32(char* out, std::uint32_t value) {
+            for (int i = 0; i < 4; ++i) {
+                out[i] = static_cast<char>(value >> (8 * i));
+            }
+        }
+
+        void putU64(char* out, std::uint64_t value) {
+            for (int i = 0; i < 8; ++i) {
+                out[i] = static_cast<char>(value >> (8 * i));
+            }
+        }
+
+        std::uint32_t getU32(const char* in) {
+            std::uint32_t value = 0;
+            for (int i = 3; i >= 0; --i) {
+                value = (value << 8) | static_cast<std::uint8_t>(in[i]);
+            }
+            return value;
+        }
+
+        std::uint64_t getU64(const char* in) {
+            std::uint64_t value = 0;
+            for (int i = 7; i >= 0; --i) {
+                value = (value << 8) | static_cast<std::uint8_t>(in[i]);
+            }
+            return value;
+        }
+
+        std::uint32_t recordChecksum(const char* record, std::size_t payload) {
+            const std::uint32_t crc = crc32(0, record, 4);
+            return crc32(crc, record + 8, kHeaderSize - 8 + payload);
+        }
+
+        // Every payload starts with the instance id
+        std::uint64_t instanceHash(const char* record) {
+            const std::size_t payload = getU32(record);
+            const std::size_t size = payload < 4 ? 0 : std::min<std::size_t>(getU32(record + kHeaderSize), payload - 4);
+            return std::hash<std::string_view>()(std::string_view(record + kHeaderSize + 4, size));
+        }
+
+        // Payload fields
+        class Writer {
+        public:
+            void u32(std::uint32_t value) {
+                char bytes[4];
+                putU32(bytes, value);
+                out_.append(bytes, 4);
+            }
+            void i64(std::int64_t value) {
+                char bytes[8];
+                putU64(bytes, static_cast<std::uint64_t>(value));
+                out_.append(bytes, 8);
+            }
+            void str(const std::string& value) {
+                u32(static_cast<std::uint32_t>(value.size()));
+                out_ += value;
+            }
+            void vars(const std::map<std::string, std::string>& variables) {
+                u32(static_cast<std::uint32_t>(variables.size()));
+                for (const auto& [name, value] : variables) {
+                    str(name);
+                    str(value);
+                }
+            }
+            std::string take() { return std::move(out_); }
+
+        private:
+            std::string out_;
+        };
+
+        class Reader {
+        public:
+            Reader(const char* data, std::size_t size) : data_(data), end_(data + size) {}
+
+            std::uint32_t u32() {
+                need(4);
+                const std::uint32_t value = getU32(data_);
+                data_ += 4;
+                return value;
+            }
+            std::int64_t i64() {
+                need(8);
+                const std::uint64_t value = getU64(data_);
+                data_ += 8;
+                return static_cast<std::int64_t>(value);
+            }
+            std::string str() {
+                const std::uint32_t size = u32();
+                need(size);
+                std::string value(data_, size);
+                data_ += size;
+                return value;
+            }
+            std::map<std::string, std::string> vars() {
+                std::map<std::string, std::string> variables;
+                for (std::uint32_t count = u32(); count > 0; --count) {
+                    std::string name = str();
+                    variables[std::move(name)] = str();
+                }
+                return variables;
+            }
+
+        private:
+            void need(std::size_t size) const {
+                if (static_cast<std::size_t>(end_ - data_) < size) {
+                    throw std::runtime_error("Corrupt WAL record");
+                }
+            }
+
+            const char* data_;
+            const char* end_;
+        };
+
+        std::string segmentName(std::uint64_t id) {
+            char name[32];
+            std::snprintf(name, sizeof(name), "wal-%020llu.log", static_cast<unsigned long long>(id));
+            return name;
+        }
+
+        // Id of a segment file name, 0 for other files
+        std::uint64_t segmentId(const std::string& name) {
+            if (name.size() != 28 || name.compare(0, 4, "wal-") != 0 || name.compare(24, 4, ".log") != 0) {
+                return 0;
+            }
+            std::uint64_t id = 0;
+            for (std::size_t i = 4; i < 24; ++i) {
+                if (name[i] < '0' || name[i] > '9') {
+                    return 0;
+                }
+                id = id * 10 + static_cast<std::uint64_t>(name[i] - '0');
+            }
+            return id;
+        }
+
+    } // anonymous namespace
+
+    // One memory-mapped segment file. The store's mutex guards written,
+    // synced, liveBytes and instances.
+    class WalStateStore::Segment {
+    public:
+        // A size of 0 maps an existing file as it is
+        Segment(std::uint64_t id, const std::string& path, std::size_t size);
+        // Unmaps; deletes the file if the segment was compacted away
+        ~Segment();
+
+        Segment(const Segment&) = delete;
+        Segment& operator=(const Segment&) = delete;
+
+        char* data() const { return data_; }
+        std::size_t capacity() const { return capacity_; }
+        // Writes [from, to) and the file metadata to disk
+        void sync(std::size_t from, std::size_t to);
+
+        const std::uint64_t id;
+        std::size_t written = 0;
+        std::size_t synced = 0;
+        std::uint64_t liveBytes = 0;
+        // Hashed ids of the instances with a record here, live or superseded
+        std::unordered_set<std::uint64_t> instances;
+        std::atomic<bool> removeOnClose{ false };
+
+    private:
+        const std::string path_;
+        char* data_ = nullptr;
+        std::size_t capacity_ = 0;
+#ifdef _WIN32
+        HANDLE file_ = INVALID_HANDLE_VALUE;
+        HANDLE mapping_ = nullptr;
+#else
+        int fd_ = -1;
+#endif
+    };
+
+#ifdef _WIN32
+
+    WalStateStore::Segment::Segment(std::uint64_t segment_id, const std::string& path, std::size_t size)
+        : id(segment_id), path_(path) {
+        file_ = CreateFileA(path.c_str(), GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ, nullptr,
+            OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+        if (file_ == INVALID_HANDLE_VALUE) {
+            throw std::runtime_error("Cannot open WAL segment " + path + ": error " + std::to_string(GetLastError()));
+        }
+        if (size == 0) {
+            LARGE_INTEGER existing;
+            if (!GetFileSizeEx(file_, &existing)) {
+                CloseHandle(file_);
+                throw std::runtime_error("Cannot size WAL segment " + path + ": error " + std::to_string(GetLastError()));
+            }
+            size = static_cast<std::size_t>(existing.QuadPart);
+        }
+        capacity_ = size;
+        if (capacity_ == 0) {
+            return;
+        }
+        // Grows a new file to size, filled with zeros
+        mapping_ = CreateFileMappingA(file_, nullptr, PAGE_READWRITE,
+            static_cast<DWORD>(static_cast<std::uint64_t>(size) >> 32), static_cast<DWORD>(size & 0xffffffffu), nullptr);
+        if (!mapping_) {
+            CloseHandle(file_);
+            throw std::runtime_error("Cannot map WAL segment " + path + ": error " + std::to_string(GetLastError()));
+        }
+        data_ = static_cast<char*>(MapViewOfFile(mapping_, FILE_MAP_ALL_ACCESS, 0, 0, size));
+        if (!data_) {
+            CloseHandle(mapping_);
+            CloseHandle(file_);
+            throw std::runtime_error("Cannot map WAL segment " + path + ": error " + std::to_string(GetLastError()));
+        }
+    }
+
+    WalStateStore::Segment::~Segment() {
+        if (data_) {
+            UnmapViewOfFile(data_);
+        }
+        if (mapping_) {
+            CloseHandle(mapping_);
+        }
+        CloseHandle(file_);
+        if (removeOnClose.load()) {
+            DeleteFileA(path_.c_str());
+        }
+    }
+
+    void WalStateStore::Segment::sync(std::size_t from, std::size_t to) {
+        if (to > from && !FlushViewOfFile(data_ + from, to - from)) {
+            throw std::runtime_error("Cannot flush WAL segment " + path_ + ": error " + std::to_string(GetLastError()));
+        }
+        if (!FlushFileBuffers(file_)) {
+            throw std::runtime_error("Cannot flush WAL segment " + path_ + ": error " + std::to_string(GetLastError()));
+        }
+    }
+
+#else
+
+    WalStateStore::Segment::Segment(std::uint64_t segment_id, const std::string& path, std::size_t size)
+        : id(segment_id), path_(path) {
+        fd_ = ::open(path.c_str(), O_RDWR | O_CREAT, 0644);
+        if (fd_ < 0) {
+            throw std::runtime_error("Cannot open WAL segment " + path + ": " + std::strerror(errno));
+        }
+        if (size == 0) {
+            struct stat info;
+            if (::fstat(fd_, &info) != 0) {
+                ::close(fd_);
+                throw std::runtime_error("Cannot size WAL segment " + path + ": " + std::strerror(errno));
+            }
+            size = static_cast<std::size_t>(info.st_size);
+        }
+        // A new file reads as zeros up to size
+        else if (::ftruncate(fd_, static_cast<off_t>(size)) != 0 || ::fsync(fd_) != 0) {
+            ::close(fd_);
+            throw std::runtime_error("Cannot allocate WAL segment " + path + ": " + std::strerror(errno));
+        }
+        capacity_ = size;
+        if (capacity_ == 0) {
+            return;
+        }
+        void* mapped = ::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd_, 0);
+        if (mapped == MAP_FAILED) {
+            ::close(fd_);
+            throw std::runtime_error("Cannot map WAL segment " + path + ": " + std::strerror(errno));
+        }
+        data_ = static_cast<char*>(mapped);
+    }
+
+    WalStateStore::Segment::~Segment() {
+        if (data_) {
+            ::munmap(data_, capacity_);
+        }
+        ::close(fd_);
+        if (removeOnClose.load()) {
+            ::unlink(path_.c_str());
+        }
+    }
+
+    void WalStateStore::Segment::sync(std::size_t from, std::size_t to) {
+        if (to <= from) {
+            return;
+        }
+        // msync wants a page aligned start
+        const std::size_t page = static_cast<std::size_t>(::sysconf(_SC_PAGESIZE));
+        const std::size_t start = from / page * page;
+        if (::msync(data_ + start, to - start, MS_SYNC) != 0) {
+            throw std::runtime_error("Cannot flush WAL segment " + path_ + ": " + std::strerror(errno));
+        }
+    }
+
+#endif
+
+    WalStateStore::WalStateStore(const std::string& directory)
+        : WalStateStore(directory, Options()) {}
+
+    WalStateStore::WalStateStore(const std::string& directory, const Options& options)
+        : directory_(directory), options_(options) {
+        if (options_.segment_size > kMaxSegmentSize) {
+            throw std::invalid_argument("WAL segment size over 4 GiB: " + std::to_string(options_.segment_size));
+        }
+        open();
+        syncThread_ = std::thread(&WalStateStore::syncLoop, this);
+        compactionThread_ = std::thread(&WalStateStore::compactionLoop, this);
+    }
+
+    WalStateStore::~WalStateStore() {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stop_ = true;
+        }
+        compactionWake_.notify_all();
+        compactionThread_.join();
+        // The sync thread flushes what is left before it returns
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stopSync_ = true;
+        }
+        syncWake_.notify_all();
+        syncThread_.join();
+    }
+
+    void WalStateStore::open() {
+        std::filesystem::create_directories(directory_);
+
+        std::vector<std::uint64_t> ids;
+        for (const auto& entry : std::filesystem::directory_iterator(directory_)) {
+            const std::uint64_t id = segmentId(entry.path().filename().string());
+            if (id != 0 && entry.is_regular_file()) {
+                ids.push_back(id);
+            }
+        }
+        std::sort(ids.begin(), ids.end());
+
+        // Records are applied in sequence order, not in file order
+        struct Replayed {
+            std::uint64_t sequence;
+            RecordType type;
+            Location location;
+            std::size_t payload;
+        };
+        std::vector<Replayed> records;
+        for (std::uint64_t id : ids) {
+            const std::string path = (std::filesystem::path(directory_) / segmentName(id)).string();
+            auto segment = std::make_shared<Segment>(id, path, 0);
+            if (segment->capacity() == 0) {
+                segment->removeOnClose = true;
+                continue;
+            }
+            if (segment->capacity() > kMaxSegmentSize) {
+                throw std::runtime_error("WAL segment over 4 GiB: " + path);
+            }
+            std::size_t offset = 0;
+            while (offset + kHeaderSize <= segment->capacity()) {
+                const char* record = segment->data() + offset;
+                const std::uint32_t payload = getU32(record);
+                const std::size_t size = recordSize(payload);
+                if (payload == 0 || size > segment->capacity() - offset ||
+                    getU32(record + 4) != recordChecksum(record, payload)) {
+                    break;
+                }
+                records.push_back({ getU64(record + 8), static_cast<RecordType>(record[16]),
+                    { id, static_cast<std::uint32_t>(offset), static_cast<std::uint32_t>(size) }, payload });
+                segment->instances.insert(instanceHash(record));
+                offset += size;
+            }
+            segment->written = offset;
+            segment->synced = offset;
+            segments_[id] = segment;
+        }
+
+        std::sort(records.begin(), records.end(), [](const Replayed& left, const Replayed& right) {
+            return left.sequence < right.sequence;
+        });
+        for (const Replayed& record : records) {
+            const char* payload = segments_[record.location.segment]->data() + record.location.offset + kHeaderSize;
+            index(record.type, payload, record.payload, record.location);
+            nextSequence_ = record.sequence + 1;
+        }
+
+        if (segments_.empty()) {
+            head_ = createSegment(0);
+        }
+        else {
+            head_ = segments_.rbegin()->second;
+            // A torn record may be followed by older bytes that still check
+            // out; new records must never be followed by them
+            std::memset(head_->data() + head_->written, 0, head_->capacity() - head_->written);
+            head_->sync(head_->written, head_->capacity());
+        }
+    }
+
+    std::shared_ptr<WalStateStore::Segment> WalStateStore::createSegment(std::size_t minimum_size) {
+        const std::uint64_t id = segments_.empty() ? 1 : segments_.rbegin()->first + 1;
+        const std::size_t size = std::max(options_.segment_size, minimum_size);
+        const std::filesystem::path path = std::filesystem::path(directory_) / segmentName(id);
+        auto segment = std::make_shared<Segment>(id, path.string(), size);
+#ifndef _WIN32
+        // Makes the new directory entry durable
+        const int directory = ::open(directory_.c_str(), O_RDONLY);
+        if (directory >= 0) {
+            ::fsync(directory);
+            ::close(directory);
+        }
+#endif
+        segments_[id] = segment;
+        return segment;
+    }
+
+    WalStateStore::Location WalStateStore::write(const char* record, std::size_t size) {
+        if (head_->written + size > head_->capacity()) {
+            // The rest of the old head stays zero and ends it
+            head_ = createSegment(size);
+            compactionWake_.notify_one();
+        }
+        const Location location{ head_->id, static_cast<std::uint32_t>(head_->written), static_cast<std::uint32_t>(size) };
+        std::memcpy(head_->data() + head_->written, record, size);
+        head_->written += size;
+        head_->instances.insert(instanceHash(record));
+        appended_ += size;
+        return location;
+    }
+
+    void WalStateStore::commit(RecordType type, const std::string& payload) {
+        if (recordSize(payload.size()) > kMaxSegmentSize) {
+            throw std::invalid_argument("WAL record over 4 GiB: " + std::to_string(payload.size()) + " bytes");
+        }
+        // Encoded before taking the lock, only the copy happens under it
+        std::string record(recordSize(payload.size()), '\0');
+        putU32(&record[0], static_cast<std::uint32_t>(payload.size()));
+        record[16] = static_cast<char>(type);
+        std::memcpy(&record[kHeaderSize], payload.data(), payload.size());
+
+        std::uint64_t sequence;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            putU64(&record[8], nextSequence_++);
+            putU32(&record[4], recordChecksum(record.data(), payload.size()));
+            const Location location = write(record.data(), record.size());
+            index(type, head_->data() + location.offset + kHeaderSize, payload.size(), location);
+            sequence = appended_;
+        }
+        if (options_.sync_commits) {
+            waitDurable(sequence);
+        }
+    }
+
+    void WalStateStore::addLive(const Location& location) {
+        segments_[location.segment]->liveBytes += location.size;
+    }
+
+    void WalStateStore::release(const Location& location) {
+        auto it = segments_.find(location.segment);
+        if (it != segments_.end()) {
+            it->second->liveBytes -= location.size;
+        }
+    }
+
+    void WalStateStore::index(RecordType type, const char* payload, std::size_t size, const Location& location) {
+        Reader reader(payload, size);
+        std::string instance_id = reader.str();
+
+        switch (type) {
+        case RecordType::Instance: {
+            InstanceEntry& entry = instances_[instance_id];
+            if (entry.state.segment != 0) {
+                release(entry.state);
+            }
+            entry.state = location;
+            addLive(location);
+            break;
+        }
+        case RecordType::Complete: {
+            auto it = instances_.find(instance_id);
+            if (it == instances_.end()) {
+                break;
+            }
+            if (it->second.state.segment != 0) {
+                release(it->second.state);
+            }
+            for (const Location& task : it->second.tasks) {
+                release(task);
+            }
+            for (const Location& error : it->second.errors) {
+                release(error);
+            }
+            instances_.erase(it);
+            break;
+        }
+        case RecordType::UserTask:
+            instances_[instance_id].tasks.push_back(location);
+            addLive(location);
+            break;
+        case RecordType::Error:
+            instances_[instance_id].errors.push_back(location);
+            addLive(location);
+            break;
+        case RecordType::Timer:
+        case RecordType::Subscription: {
+            auto& slots = type == RecordType::Timer ? timers_ : subscriptions_;
+            auto [it, inserted] = slots.try_emplace(Key(std::move(instance_id), reader.str()), location);
+            if (!inserted) {
+                release(it->second);
+                it->second = location;
+            }
+            addLive(location);
+            break;
+        }
+        case RecordType::DeleteTimer:
+        case RecordType::DeleteSubscription: {
+            auto& slots = type == RecordType::DeleteTimer ? timers_ : subscriptions_;
+            auto it = slots.find(Key(std::move(instance_id), reader.str()));
+            if (it != slots.end()) {
+                release(it->second);
+                slots.erase(it);
+            }
+            break;
+        }
+        case RecordType::DeleteTimers:
+        case RecordType::DeleteSubscriptions: {
+            auto& slots = type == RecordType::DeleteTimers ? timers_ : subscriptions_;
+            auto it = slots.lower_bound(Key(instance_id, std::string()));
+            while (it != slots.end() && it->first.first == instance_id) {
+                release(it->second);
+                it = slots.erase(it);
+            }
+            break;
+        }
+        default:
+            throw std::runtime_error("Unknown WAL record type " + std::to_string(static_cast<int>(type)));
+        }
+    }
+
+    WalStateStore::Location* WalStateStore::findReference(RecordType type, const char* payload, std::size_t size, const Location& location) {
+        Reader reader(payload, size);
+        std::string instance_id = reader.str();
+
+        switch (type) {
+        case RecordType::Instance:
+        case RecordType::UserTask:
+        case RecordType::Error: {
+            auto it = instances_.find(instance_id);
+            if (it == instances_.end()) {
+                return nullptr;
+            }
+            if (type == RecordType::Instance) {
+                return it->second.state == location ? &it->second.state : nullptr;
+            }
+            auto& locations = type == RecordType::UserTask ? it->second.tasks : it->second.errors;
+            auto found = std::find(locations.begin(), locations.end(), location);
+            return found != locations.end() ? &*found : nullptr;
+        }
+        case RecordType::Timer:
+        case RecordType::Subscription: {
+            auto& slots = type == RecordType::Timer ? timers_ : subscriptions_;
+            auto it = slots.find(Key(std::move(instance_id), reader.str()));
+            return it != slots.end() && it->second == location ? &it->second : nullptr;
+        }
+        default:
+            // Deletions are not indexed
+            return nullptr;
+        }
+    }
+
+    std::string WalStateStore::readPayload(const Location& location) const {
+        const char* record = segments_.at(location.segment)->data() + location.offset;
+        return std::string(record + kHeaderSize, getU32(record));
+    }
+
+    void WalStateStore::saveProcessInstance(const std::string& instance_id, const std::string& process_id,
+        const std::string& current_element, const Variables& variables) {
+        Writer writer;
+        writer.str(instance_id);
+        writer.str(process_id);
+        writer.str(current_element);
+        writer.vars(variables);
+        commit(RecordType::Instance, writer.take());
+    }
+
+    StateStore::ProcessInstance WalStateStore::loadProcessInstance(const std::string& instance_id) {
+        std::string payload;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            auto it = instances_.find(instance_id);
+            if (it == instances_.end() || it->second.state.segment == 0) {
+                throw std::runtime_error("Process instance not found or completed: " + instance_id);
+            }
+            payload = readPayload(it->second.state);
+        }
+        Reader reader(payload.data(), payload.size());
+        reader.str();
+        ProcessInstance instance;
+        instance.process_id = reader.str();
+        instance.current_element = reader.str();
+        instance.variables = reader.vars();
+        return instance;
+    }
+
+    bool WalStateStore::containsProcessInstance(const std::string& instance_id) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = instances_.find(instance_id);
+        return it != instances_.end() && it->second.state.segment != 0;
+    }
+
+    void WalStateStore::completeProcessInstance(const std::string& instance_id) {
+        Writer writer;
+        writer.str(instance_id);
+        commit(RecordType::Complete, writer.take());
+    }
+
+    void WalStateStore::saveUserTask(const std::string& instance_id, const std::string& task_id,
+        const std::string& form_key, const Variables& variables) {
+        Writer writer;
+        writer.str(instance_id);
+        writer.str(task_id);
+        writer.str(form_key);
+        writer.vars(variables);
+        commit(RecordType::UserTask, writer.take());
+    }
+
+    void WalStateStore::saveError(const std::string& instance_id, const std::string& error_message) {
+        Writer writer;
+        writer.str(instance_id);
+        writer.str(error_message);
+        commit(RecordType::Error, writer.take());
+    }
+
+    void WalStateStore::saveTimer(const TimerRecord& timer) {
+        Writer writer;
+        writer.str(timer.instance_id);
+        writer.str(timer.element_id);
+        writer.str(timer.process_id);
+        writer.str(timer.kind);
+        writer.i64(timer.due_at);
+        writer.u32(static_cast<std::uint32_t>(timer.repetitions));
+        writer.i64(timer.interval_ms);
+        commit(RecordType::Timer, writer.take());
+    }
+
+    void WalStateStore::deleteTimer(const std::string& instance_id, const std::string& element_id) {
+        Writer writer;
+        writer.str(instance_id);
+        writer.str(element_id);
+        commit(RecordType::DeleteTimer, writer.take());
+    }
+
+    void WalStateStore::deleteTimers(const std::string& instance_id) {
+        Writer writer;
+        writer.str(instance_id);
+        commit(RecordType::DeleteTimers, writer.take());
+    }
+
+    std::vector<StateStore::TimerRecord> WalStateStore::loadTimers() {
+        std::vector<std::string> payloads;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            payloads.reserve(timers_.size());
+            for (const auto& [key, location] : timers_) {
+                payloads.push_back(readPayload(location));
+            }
+        }
+        std::vector<TimerRecord> timers;
+        timers.reserve(payloads.size());
+        for (const std::string& payload : payloads) {
+            Reader reader(payload.data(), payload.size());
+            TimerRecord timer;
+            timer.instance_id = reader.str();
+            timer.element_id = reader.str();
+            timer.process_id = reader.str();
+            timer.kind = reader.str();
+            timer.due_at = reader.i64();
+            timer.repetitions = static_cast<std::int32_t>(reader.u32());
+            timer.interval_ms = reader.i64();
+            timers.push_back(std::move(timer));
+        }
+        // Earliest first, as from the database
+        std::stable_sort(timers.begin(), timers.end(), [](const TimerRecord& left, const TimerRecord& right) {
+            return left.due_at < right.due_at;
+        });
+        return timers;
+    }
+
+    void WalStateStore::saveMessageSubscription(const MessageSubscriptionRecord& subscription) {
+        Writer writer;
+        writer.str(subscription.instance_id);
+        writer.str(subscription.element_id);
+        writer.str(subscription.message_name);
+        writer.str(subscription.correlation_key);
+        commit(RecordType::Subscription, writer.take());
+    }
+
+    void WalStateStore::deleteMessageSubscription(const std::string& instance_id, const std::string& element_id) {
+        Writer writer;
+        writer.str(instance_id);
+        writer.str(element_id);
+        commit(RecordType::DeleteSubscription, writer.take());
+    }
+
+    void WalStateStore::deleteMessageSubscriptions(const std::string& instance_id) {
+        Writer writer;
+        writer.str(instance_id);
+        commit(RecordType::DeleteSubscriptions, writer.take());
+    }
+
+    std::vector<StateStore::MessageSubscriptionRecord> WalStateStore::loadMessageSubscriptions() {
+        std::vector<std::string> payloads;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            payloads.reserve(subscriptions_.size());
+            for (const auto& [key, location] : subscriptions_) {
+                payloads.push_back(readPayload(location));
+            }
+        }
+        std::vector<MessageSubscriptionRecord> subscriptions;
+        subscriptions.reserve(payloads.size());
+        for (const std::string& payload : payloads) {
+            Reader reader(payload.data(), payload.size());
+            MessageSubscriptionRecord subscription;
+            subscription.instance_id = reader.str();
+            subscription.element_id = reader.str();
+            subscription.message_name = reader.str();
+            subscription.correlation_key = reader.str();
+            subscriptions.push_back(std::move(subscription));
+        }
+        return subscriptions;
+    }
+
+    std::vector<StateStore::UserTaskRecord> WalStateStore::getUserTasks(const std::string& instance_id) const {
+        std::vector<std::string> payloads;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            auto it = instances_.find(instance_id);
+            if (it == instances_.end()) {
+                return {};
+            }
+            for (const Location& location : it->second.tasks) {
+                payloads.push_back(readPayload(location));
+            }
+        }
+        std::vector<UserTaskRecord> tasks;
+        for (const std::string& payload : payloads) {
+            Reader reader(payload.data(), payload.size());
+            UserTaskRecord task;
+            task.instance_id = reader.str();
+            task.task_id = reader.str();
+            task.form_key = reader.str();
+            task.variables = reader.vars();
+            tasks.push_back(std::move(task));
+        }
+        return tasks;
+    }
+
+    std::vector<std::string> WalStateStore::getErrors(const std::string& instance_id) const {
+        std::vector<std::string> errors;
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = instances_.find(instance_id);
+        if (it == instances_.end()) {
+            return errors;
+        }
+        for (const Location& location : it->second.errors) {
+            const std::string payload = readPayload(location);
+            Reader reader(payload.data(), payload.size());
+            reader.str();
+            errors.push_back(reader.str());
+        }
+        return errors;
+    }
+
+    void WalStateStore::flush() {
+        std::uint64_t sequence;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            sequence = appended_;
+        }
+        waitDurable(sequence);
+    }
+
+    void WalStateStore::waitDurable(std::uint64_t sequence) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        if (synced_ < sequence) {
+            syncRequested_ = std::max(syncRequested_, sequence);
+            syncWake_.notify_one();
+            durable_.wait(lock, [this, sequence]() { return synced_ >= sequence || !syncError_.empty(); });
+        }
+        if (!syncError_.empty()) {
+            throw std::runtime_error(syncError_);
+        }
+    }
+
+    void WalStateStore::syncLoop() {
+        std::unique_lock<std::mutex> lock(mutex_);
+        for (;;) {
+            syncWake_.wait_for(lock, options_.flush_interval, [this]() { return stopSync_ || syncRequested_ > synced_; });
+            if (appended_ == synced_ || !syncError_.empty()) {
+                if (stopSync_) {
+                    return;
+                }
+                continue;
+            }
+
+            // Everything appended so far goes out in one flush; writers
+            // arriving meanwhile are covered by the next one
+            const std::uint64_t target = appended_;
+            std::vector<std::tuple<std::shared_ptr<Segment>, std::size_t, std::size_t>> ranges;
+            for (const auto& [id, segment] : segments_) {
+                if (segment->synced < segment->written) {
+                    ranges.emplace_back(segment, segment->synced, segment->written);
+                }
+            }
+            lock.unlock();
+            std::string error;
+            try {
+                for (const auto& [segment, from, to] : ranges) {
+                    segment->sync(from, to);
+                }
+            }
+            catch (const std::exception& e) {
+                error = e.what();
+            }
+            lock.lock();
+
+            if (!error.empty()) {
+                syncError_ = error;
+            }
+            else {
+                for (const auto& [segment, from, to] : ranges) {
+                    segment->synced = std::max(segment->synced, to);
+                }
+                synced_ = target;
+                ++flushes_;
+            }
+            durable_.notify_all();
+        }
+    }
+
+    void WalStateStore::compactionLoop() {
+        std::unique_lock<std::mutex> lock(mutex_);
+        while (!stop_) {
+            compactionWake_.wait_for(lock, options_.compaction_interval);
+            if (stop_) {
+                return;
+            }
+            lock.unlock();
+            try {
+                compact();
+            }
+            catch (const std::exception&) {
+                // Segments stay as they are, the next pass tries again
+            }
+            lock.lock();
+        }
+    }
+
+    std::size_t WalStateStore::compact() {
+        std::lock_guard<std::mutex> compactionLock(compactionMutex_);
+        std::vector<std::uint64_t> candidates;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            for (const auto& [id, segment] : segments_) {
+                if (segment != head_ && static_cast<double>(segment->liveBytes) <
+                    options_.compaction_threshold * static_cast<double>(segment->written)) {
+                    candidates.push_back(id);
+                }
+            }
+        }
+        // Oldest first, so the segments a deletion shadows tend to be gone
+        // by the time it is looked at
+        std::size_t removed = 0;
+        for (std::uint64_t id : candidates) {
+            {
+                // Shutdown waits for the segment in progress only
+                std::lock_guard<std::mutex> lock(mutex_);
+                if (stop_) {
+                    break;
+                }
+            }
+            if (compactSegment(id)) {
+                ++removed;
+            }
+        }
+        return removed;
+    }
+
+    bool WalStateStore::compactSegment(std::uint64_t segment_id) {
+        std::shared_ptr<Segment> segment;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            auto it = segments_.find(segment_id);
+            if (it == segments_.end() || it->second == head_) {
+                return false;
+            }
+            segment = it->second;
+        }
+
+        // Writers get the lock back between batches; every record is checked
+        // against the index under the same lock that moves it
+        std::size_t offset = 0;
+        std::uint64_t sequence = 0;
+        while (offset < segment->written) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            for (std::size_t n = 0; n < kCompactionBatch && offset < segment->written; ++n) {
+                const char* record = segment->data() + offset;
+                const std::uint32_t payload = getU32(record);
+                const std::size_t size = recordSize(payload);
+                const auto type = static_cast<RecordType>(record[16]);
+                const Location location{ segment_id, static_cast<std::uint32_t>(offset), static_cast<std::uint32_t>(size) };
+
+                Location* reference = findReference(type, record + kHeaderSize, payload, location);
+                // Deletions matter while an older segment holds a record of
+                // their instance. Records move only while live, so what a
+                // deletion shadows sits in its segment or an older one.
+                const bool deletion = type == RecordType::Complete || type == RecordType::DeleteTimer ||
+                    type == RecordType::DeleteTimers || type == RecordType::DeleteSubscription ||
+                    type == RecordType::DeleteSubscriptions;
+                if (reference || (deletion && olderRecords(segment_id, instanceHash(record)))) {
+                    // Copied with its sequence, so replay still orders it correctly
+                    const Location moved = write(record, size);
+                    if (reference) {
+                        *reference = moved;
+                        segment->liveBytes -= size;
+                        addLive(moved);
+                    }
+                }
+                offset += size;
+            }
+            sequence = appended_;
+        }
+
+        // The copies must be on disk before the originals go away
+        waitDurable(sequence);
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            segment->removeOnClose = true;
+            segments_.erase(segment_id);
+            ++compactedSegments_;
+        }
+        return true;
+    }
+
+    bool WalStateStore::olderRecords(std::uint64_t segment_id, std::uint64_t instance) const {
+        for (auto it = segments_.begin(); it != segments_.end() && it->first < segment_id; ++it) {
+            if (it->second->instances.count(instance) != 0) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    WalStateStore::Stats WalStateStore::stats() const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        Stats stats;
+        stats.segments = segments_.size();
+        for (const auto& [id, entry] : instances_) {
+            if (entry.state.segment != 0) {
+                ++stats.instances;
+            }
+        }
+        for (const auto& [id, segment] : segments_) {
+            stats.bytes += segment->written;
+            stats.live_bytes += segment->liveBytes;
+        }
+        stats.flushes = flushes_;
+        stats.compacted_segments = compactedSegments_;
+        return stats;
+    }
+
+} // namespace bpmn
@@ -0,0 +1,143 @@
+#include "bpmn/work_stealing_pool.h"
+#include <algorithm>
+
+namespace bpmn {
+
+    namespace {
+
+        // Pool and deque index of the calling thread, if it is a pool worker
+        thread_local const WorkStealingPool* currentPool = nullptr;
+        thread_local std::size_t currentWorker = 0;
+
+    } // anonymous namespace
+
+    WorkStealingPool::WorkStealingPool(std::size_t threads) {
+        if (threads == 0) {
+            threads = std::max(1u, std::thread::hardware_concurrency());
+        }
+
+        workers_.reserve(threads);
+        for (std::size_t i = 0; i < threads; ++i) {
+            workers_.push_back(std::make_unique<Worker>());
+        }
+        // Start only once every deque exists, workers steal from all of them
+        for (std::size_t i = 0; i < threads; ++i) {
+            workers_[i]->thread = std::thread(&WorkStealingPool::workerLoop, this, i);
+        }
+    }
+
+    WorkStealingPool::~WorkStealingPool() {
+        {
+            std::lock_guard<std::mutex> lock(sleepMutex_);
+            stopping_ = true;
+        }
+        wakeUp_.notify_all();
+
+        for (auto& worker : workers_) {
+            if (worker->thread.joinable()) {
+                worker->thread.join();
+            }
+        }
+    }
+
+    void WorkStealingPool::submit(Task task) {
+        if (currentPool == this) {
+            Worker& worker = *workers_[currentWorker];
+            std::lock_guard<std::mutex> lock(worker.mutex);
+            worker.tasks.push_back(std::move(task));
+        }
+        else {
+            std::lock_guard<std::mutex> lock(injectedMutex_);
+            injected_.push_back(std::move(task));
+        }
+
+        ++submitted_;
+        ++pending_;
+        wakeOne();
+    }
+
+    WorkStealingPool::Stats WorkStealingPool::stats() const {
+        Stats result;
+        result.workers = workers_.size();
+        result.queued = pending_.load();
+        result.submitted = submitted_.load();
+        result.executed = executed_.load();
+        result.steals = steals_.load();
+        return result;
+    }
+
+    void WorkStealingPool::workerLoop(std::size_t index) {
+        currentPool = this;
+        currentWorker = index;
+
+        Task task;
+        for (;;) {
+            if (popLocal(index, task) || popInjected(task) || steal(index, task)) {
+                --pending_;
+                try {
+                    task();
+                }
+                catch (...) {
+                }
+                task = nullptr;
+                ++executed_;
+                continue;
+            }
+
+            // pending_ is raised before the notification, so checking it
+            // under sleepMutex_ cannot miss a submission
+            std::unique_lock<std::mutex> lock(sleepMutex_);
+            wakeUp_.wait(lock, [this]() { return pending_.load() > 0 || stopping_.load(); });
+            if (stopping_ && pending_.load() == 0) {
+                return;
+            }
+        }
+    }
+
+    bool WorkStealingPool::popLocal(std::size_t index, Task& task) {
+        Worker& worker = *workers_[index];
+        std::lock_guard<std::mutex> lock(worker.mutex);
+        if (worker.tasks.empty()) {
+            return false;
+        }
+        // Newest first: a branch's own continuation is still hot in cache
+        task = std::move(worker.tasks.back());
+        worker.tasks.pop_back();
+        return true;
+    }
+
+    bool WorkStealingPool::popInjected(Task& task) {
+        std::lock_guard<std::mutex> lock(injectedMutex_);
+        if (injected_.empty()) {
+            return false;
+        }
+        task = std::move(injected_.front());
+        injected_.pop_front();
+        return true;
+    }
+
+    bool WorkStealingPool::steal(std::size_t thief, Task& task) {
+        const std::size_t count = workers_.size();
+        for (std::size_t offset = 1; offset < count; ++offset) {
+            Worker& victim = *workers_[(thief + offset) % count];
+            std::unique_lock<std::mutex> lock(victim.mutex, std::try_to_lock);
+            if (!lock.owns_lock() || victim.tasks.empty()) {
+                continue;
+            }
+            // Oldest first: usually the largest remaining piece of work
+            task = std::move(victim.tasks.front());
+            victim.tasks.pop_front();
+            ++steals_;
+            return true;
+        }
+        return false;
+    }
+
+    void WorkStealingPool::wakeOne() {
+        {
+            std::lock_guard<std::mutex> lock(sleepMutex_);
+        }
+        wakeUp_.notify_one();
+    }
+
+} // namespace bpmn
@@ -4,7 +4,7 @@ namespace bpmn {
     namespace services {
         //  
         IService::IService(const std::string& id, const std::string& name)
-            : FlowElement(id, name) {
+            : FlowElement(id, name, ElementKind::ServiceTask) {
         }
     }
 }
\ No newline at end of file
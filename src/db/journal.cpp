@@ -0,0 +1,175 @@
+// db/journal.cpp
+#include "db/journal.h"
+#include <nlohmann/json.hpp>
+#include <algorithm>
+#include <functional>
+#include <stdexcept>
+
+namespace db {
+
+    InstanceJournal::InstanceJournal(std::size_t snapshot_interval, std::size_t max_instances)
+        : snapshotInterval_(snapshot_interval == 0 ? 1 : snapshot_interval),
+        maxInstances_(max_instances == 0 ? 1 : max_instances) {}
+
+    std::unique_lock<std::mutex> InstanceJournal::lockInstance(const std::string& instance_id) {
+        return std::unique_lock<std::mutex>(instanceLocks_[std::hash<std::string>{}(instance_id) % kInstanceStripes]);
+    }
+
+    std::vector<std::unique_lock<std::mutex>> InstanceJournal::lockInstances(const std::vector<std::string>& instance_ids) {
+        std::vector<std::size_t> stripes;
+        stripes.reserve(instance_ids.size());
+        for (const std::string& instance_id : instance_ids) {
+            stripes.push_back(std::hash<std::string>{}(instance_id) % kInstanceStripes);
+        }
+        // Ascending and once each, so two batches cannot wait on each other
+        std::sort(stripes.begin(), stripes.end());
+        stripes.erase(std::unique(stripes.begin(), stripes.end()), stripes.end());
+
+        std::vector<std::unique_lock<std::mutex>> locks;
+        locks.reserve(stripes.size());
+        for (std::size_t stripe : stripes) {
+            locks.emplace_back(instanceLocks_[stripe]);
+        }
+        return locks;
+    }
+
+    InstanceJournal::Head& InstanceJournal::touchLocked(const std::string& instance_id, bool& fresh) {
+        auto it = heads_.find(instance_id);
+        fresh = it == heads_.end();
+        if (!fresh) {
+            recent_.splice(recent_.begin(), recent_, it->second.recent);
+            return it->second;
+        }
+        if (heads_.size() >= maxInstances_) {
+            heads_.erase(recent_.back());
+            recent_.pop_back();
+        }
+        recent_.push_front(instance_id);
+        Head& head = heads_[instance_id];
+        head.recent = recent_.begin();
+        return head;
+    }
+
+    JournalWrite InstanceJournal::plan(const std::string& instance_id, const std::string& current_element, const Variables& variables) {
+        JournalWrite write;
+        std::lock_guard<std::mutex> lock(mutex_);
+
+        Head& head = touchLocked(instance_id, write.fresh);
+        write.snapshot = write.fresh;
+
+        if (!write.fresh) {
+            std::int64_t seq = head.seq;
+            if (current_element != head.current_element) {
+                write.records.push_back({ ++seq, JournalRecord::Kind::Element, std::string(), current_element });
+            }
+            // Both maps are sorted, one pass finds every change
+            auto before = head.variables.begin();
+            auto after = variables.begin();
+            while (before != head.variables.end() || after != variables.end()) {
+                if (after == variables.end() || (before != head.variables.end() && before->first < after->first)) {
+                    write.records.push_back({ ++seq, JournalRecord::Kind::Erase, before->first, std::string() });
+                    ++before;
+                }
+                else if (before == head.variables.end() || after->first < before->first) {
+                    write.records.push_back({ ++seq, JournalRecord::Kind::Set, after->first, after->second });
+                    ++after;
+                }
+                else {
+                    if (before->second != after->second) {
+                        write.records.push_back({ ++seq, JournalRecord::Kind::Set, after->first, after->second });
+                    }
+                    ++before;
+                    ++after;
+                }
+            }
+            if (write.records.empty()) {
+                return write;
+            }
+            if (head.sinceSnapshot + write.records.size() >= snapshotInterval_) {
+                // The snapshot carries the changes, the journal goes away
+                write.records.clear();
+                write.snapshot = true;
+            }
+            else {
+                head.seq = seq;
+                head.sinceSnapshot += write.records.size();
+            }
+        }
+
+        if (write.snapshot) {
+            head.sinceSnapshot = 0;
+            write.snapshot_seq = head.seq;
+        }
+        head.current_element = current_element;
+        head.variables = variables;
+        return write;
+    }
+
+    void InstanceJournal::restore(const std::string& instance_id, std::int64_t seq, std::size_t records,
+        const std::string& current_element, const Variables& variables) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        bool fresh = false;
+        Head& head = touchLocked(instance_id, fresh);
+        head.seq = seq;
+        head.sinceSnapshot = records;
+        head.current_element = current_element;
+        head.variables = variables;
+    }
+
+    void InstanceJournal::forget(const std::string& instance_id) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = heads_.find(instance_id);
+        if (it != heads_.end()) {
+            recent_.erase(it->second.recent);
+            heads_.erase(it);
+        }
+    }
+
+    void InstanceJournal::setSnapshotInterval(std::size_t records) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        snapshotInterval_ = records == 0 ? 1 : records;
+    }
+
+    std::size_t InstanceJournal::getSnapshotInterval() const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return snapshotInterval_;
+    }
+
+    std::size_t InstanceJournal::size() const {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return heads_.size();
+    }
+
+    void InstanceJournal::apply(const JournalRecord& record, std::string& current_element, Variables& variables) {
+        switch (record.kind) {
+        case JournalRecord::Kind::Element:
+            current_element = record.value;
+            break;
+        case JournalRecord::Kind::Set:
+            variables[record.name] = record.value;
+            break;
+        case JournalRecord::Kind::Erase:
+            variables.erase(record.name);
+            break;
+        default:
+            throw std::runtime_error("Unknown journal record kind: " + std::string(1, static_cast<char>(record.kind)));
+        }
+    }
+
+    std::string InstanceJournal::encodeSnapshot(const Variables& variables) {
+        return nlohmann::json(variables).dump();
+    }
+
+    InstanceJournal::Variables InstanceJournal::decodeSnapshot(const std::string& text) {
+        const nlohmann::json parsed = nlohmann::json::parse(text);
+        if (!parsed.is_object()) {
+            throw std::runtime_error("Snapshot is not a JSON object");
+        }
+        Variables variables;
+        for (const auto& [name, value] : parsed.items()) {
+            variables[name] = value.is_string() ? value.get<std::string>() : value.dump();
+        }
+        return variables;
+    }
+
+} // namespace db
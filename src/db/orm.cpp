@@ -1,10 +1,61 @@
 // db/orm.cpp
 #include "db/orm.h"
+#include "bpmn/metrics.h"
+#include "bpmn/instance_id.h"
 #include <stdexcept>
 #include <iostream>
+#include <algorithm>
 
 namespace db {
 
+    namespace {
+
+        // Rows per multi-row statement, keeps the parameter count far below 65535
+        constexpr std::size_t kRowsPerStatement = 1000;
+        // Bytes handed to PQputCopyData at a time
+        constexpr std::size_t kCopyChunk = 1 << 20;
+
+        // Field in COPY text format: tab separated, backslash escaped
+        void appendCopyField(std::string& out, const std::string& value) {
+            for (char c : value) {
+                switch (c) {
+                case '\\': out += "\\\\"; break;
+                case '\t': out += "\\t"; break;
+                case '\n': out += "\\n"; break;
+                case '\r': out += "\\r"; break;
+                default: out += c; break;
+                }
+            }
+        }
+
+        void appendVariableRow(std::string& out, const std::string& instance_id, const std::string& key, const std::string& value) {
+            appendCopyField(out, instance_id);
+            out += '\t';
+            appendCopyField(out, key);
+            out += '\t';
+            appendCopyField(out, value);
+            out += '\n';
+        }
+
+        // "($1, $2), ($3, $4), ..." for rows of `columns` parameters
+        std::string placeholders(std::size_t rows, std::size_t columns) {
+            std::string result;
+            std::size_t param = 1;
+            for (std::size_t row = 0; row < rows; ++row) {
+                result += row == 0 ? "(" : ", (";
+                for (std::size_t column = 0; column < columns; ++column) {
+                    if (column != 0) {
+                        result += ", ";
+                    }
+                    result += "$" + std::to_string(param++);
+                }
+                result += ")";
+            }
+            return result;
+        }
+
+    } // anonymous namespace
+
     Database::Database() {
         auto dbConfig = DatabaseConfig::fromJson("./config.json");
         std::string connString = dbConfig.getConnectionString();
@@ -35,6 +86,10 @@ namespace db {
         }
     }
 
+    bpmn::LatencyHistogram* Database::statementTimer(std::string_view name) const {
+        return metrics_ ? &metrics_->statement(name) : nullptr;
+    }
+
     void Database::checkConnection() {
         if (PQstatus(conn_) != CONNECTION_OK) {
             throw std::runtime_error("Database connection is broken");
@@ -68,6 +123,38 @@ namespace db {
         PQclear(res);
     }
 
+    void Database::copyRows(const std::string& copy_statement, const std::string& rows) {
+        checkConnection();
+
+        PGresult* res = PQexec(conn_, copy_statement.c_str());
+        if (PQresultStatus(res) != PGRES_COPY_IN) {
+            last_error_ = PQresultErrorMessage(res);
+            PQclear(res);
+            throw std::runtime_error("COPY failed: " + last_error_);
+        }
+        PQclear(res);
+
+        bool sent = true;
+        for (std::size_t offset = 0; offset < rows.size() && sent; offset += kCopyChunk) {
+            const std::size_t size = std::min(kCopyChunk, rows.size() - offset);
+            sent = PQputCopyData(conn_, rows.data() + offset, static_cast<int>(size)) == 1;
+        }
+        // Ending with an error message aborts the COPY on the server
+        PQputCopyEnd(conn_, sent ? NULL : "client failed to send COPY data");
+
+        bool ok = sent;
+        while ((res = PQgetResult(conn_)) != NULL) {
+            if (PQresultStatus(res) != PGRES_COMMAND_OK) {
+                last_error_ = PQresultErrorMessage(res);
+                ok = false;
+            }
+            PQclear(res);
+        }
+        if (!ok) {
+            throw std::runtime_error("COPY failed: " + (sent ? last_error_ : std::string(PQerrorMessage(conn_))));
+        }
+    }
+
     std::vector<std::vector<std::string>> Database::executeQueryWithResults(const std::string& query,
         const std::vector<const char*>& params) {
         checkConnection();
@@ -113,10 +200,11 @@ namespace db {
     }
 
     void Database::initializeSchema() {
-        // Process instances table
+        // Process instances table. Ids are time-ordered UUIDv7 (bpmn::InstanceId),
+        // so new rows land at the right edge of the primary key index.
         executeQuery(R"(
             CREATE TABLE IF NOT EXISTS process_instances (
-                id VARCHAR(36) PRIMARY KEY,
+                id UUID PRIMARY KEY,
                 process_id VARCHAR(255) NOT NULL,
                 current_element VARCHAR(255) NOT NULL,
                 created_at TIMESTAMP DEFAULT CURRENT_TIMESTAMP,
@@ -125,22 +213,74 @@ namespace db {
             )
         )");
 
+        // Databases created before ids were UUIDs hold them as VARCHAR(36).
+        // The foreign keys have to go while both sides change type.
+        executeQuery(R"(
+            DO $$
+            BEGIN
+                IF (SELECT data_type FROM information_schema.columns
+                    WHERE table_schema = current_schema() AND table_name = 'process_instances'
+                    AND column_name = 'id') <> 'uuid' THEN
+                    ALTER TABLE IF EXISTS process_variables DROP CONSTRAINT IF EXISTS process_variables_instance_id_fkey;
+                    ALTER TABLE IF EXISTS user_tasks DROP CONSTRAINT IF EXISTS user_tasks_instance_id_fkey;
+                    ALTER TABLE IF EXISTS process_errors DROP CONSTRAINT IF EXISTS process_errors_instance_id_fkey;
+
+                    ALTER TABLE process_instances ALTER COLUMN id TYPE UUID USING id::uuid;
+                    ALTER TABLE IF EXISTS process_variables ALTER COLUMN instance_id TYPE UUID USING instance_id::uuid;
+                    ALTER TABLE IF EXISTS user_tasks ALTER COLUMN instance_id TYPE UUID USING instance_id::uuid;
+                    ALTER TABLE IF EXISTS process_errors ALTER COLUMN instance_id TYPE UUID USING instance_id::uuid;
+
+                    ALTER TABLE IF EXISTS process_variables ADD CONSTRAINT process_variables_instance_id_fkey
+                        FOREIGN KEY (instance_id) REFERENCES process_instances(id) ON DELETE CASCADE;
+                    ALTER TABLE IF EXISTS user_tasks ADD CONSTRAINT user_tasks_instance_id_fkey
+                        FOREIGN KEY (instance_id) REFERENCES process_instances(id);
+                    ALTER TABLE IF EXISTS process_errors ADD CONSTRAINT process_errors_instance_id_fkey
+                        FOREIGN KEY (instance_id) REFERENCES process_instances(id);
+                END IF;
+            END
+            $$
+        )");
+
         // Process variables table
         executeQuery(R"(
             CREATE TABLE IF NOT EXISTS process_variables (
                 id SERIAL PRIMARY KEY,
-                instance_id VARCHAR(36) NOT NULL REFERENCES process_instances(id) ON DELETE CASCADE,
+                instance_id UUID NOT NULL REFERENCES process_instances(id) ON DELETE CASCADE,
                 var_key VARCHAR(255) NOT NULL,
                 var_value TEXT,
                 UNIQUE(instance_id, var_key)
             )
         )");
 
+        // Journal mode: one row per transition and variable change, appended
+        // after the snapshot of the instance and dropped when the next one is taken
+        executeQuery(R"(
+            CREATE TABLE IF NOT EXISTS process_journal (
+                instance_id UUID NOT NULL REFERENCES process_instances(id) ON DELETE CASCADE,
+                seq BIGINT NOT NULL,
+                kind CHAR(1) NOT NULL,
+                name VARCHAR(255) NOT NULL DEFAULT '',
+                value TEXT NOT NULL DEFAULT '',
+                PRIMARY KEY (instance_id, seq)
+            )
+        )");
+
+        // Journal mode: state of an instance up to journal row seq
+        executeQuery(R"(
+            CREATE TABLE IF NOT EXISTS process_snapshots (
+                instance_id UUID PRIMARY KEY REFERENCES process_instances(id) ON DELETE CASCADE,
+                seq BIGINT NOT NULL,
+                current_element VARCHAR(255) NOT NULL,
+                variables JSONB NOT NULL,
+                taken_at TIMESTAMP DEFAULT CURRENT_TIMESTAMP
+            )
+        )");
+
         // User tasks table
         executeQuery(R"(
             CREATE TABLE IF NOT EXISTS user_tasks (
                 id SERIAL PRIMARY KEY,
-                instance_id VARCHAR(36) NOT NULL REFERENCES process_instances(id),
+                instance_id UUID NOT NULL REFERENCES process_instances(id),
                 task_id VARCHAR(255) NOT NULL,
                 form_key VARCHAR(255) NOT NULL,
                 created_at TIMESTAMP DEFAULT CURRENT_TIMESTAMP,
@@ -153,7 +293,7 @@ namespace db {
         executeQuery(R"(
             CREATE TABLE IF NOT EXISTS process_errors (
                 id SERIAL PRIMARY KEY,
-                instance_id VARCHAR(36) NOT NULL REFERENCES process_instances(id),
+                instance_id UUID NOT NULL REFERENCES process_instances(id),
                 error_message TEXT NOT NULL,
                 occurred_at TIMESTAMP DEFAULT CURRENT_TIMESTAMP
             )
@@ -168,6 +308,50 @@ namespace db {
                 deployed_at TIMESTAMP DEFAULT CURRENT_TIMESTAMP
             )
         )");
+
+        // Precompiled definition (schema/process.fbs), written at deploy time
+        executeQuery("ALTER TABLE process_definitions ADD COLUMN IF NOT EXISTS compiled BYTEA");
+
+        // Pending timers of running instances, reloaded into the in-process
+        // timing wheel on startup
+        executeQuery(R"(
+            CREATE TABLE IF NOT EXISTS process_timers (
+                instance_id UUID NOT NULL,
+                element_id VARCHAR(255) NOT NULL,
+                process_id VARCHAR(255) NOT NULL,
+                kind VARCHAR(20) NOT NULL,
+                due_at BIGINT NOT NULL,
+                repetitions INTEGER NOT NULL DEFAULT 0,
+                interval_ms BIGINT NOT NULL DEFAULT 0,
+                PRIMARY KEY (instance_id, element_id)
+            )
+        )");
+        executeQuery("CREATE INDEX IF NOT EXISTS process_timers_due_at ON process_timers (due_at)");
+
+        // Pending timer start events; they belong to a definition, not an instance
+        executeQuery(R"(
+            CREATE TABLE IF NOT EXISTS process_start_timers (
+                process_id VARCHAR(255) NOT NULL,
+                element_id VARCHAR(255) NOT NULL,
+                due_at BIGINT NOT NULL,
+                repetitions INTEGER NOT NULL DEFAULT 0,
+                interval_ms BIGINT NOT NULL DEFAULT 0,
+                PRIMARY KEY (process_id, element_id)
+            )
+        )");
+
+        // Waiting message and signal catch events, reloaded into the in-process index on startup
+        executeQuery(R"(
+            CREATE TABLE IF NOT EXISTS message_subscriptions (
+                instance_id UUID NOT NULL,
+                element_id VARCHAR(255) NOT NULL,
+                message_name VARCHAR(255) NOT NULL,
+                correlation_key VARCHAR(255) NOT NULL DEFAULT '',
+                PRIMARY KEY (instance_id, element_id)
+            )
+        )");
+        executeQuery("CREATE INDEX IF NOT EXISTS message_subscriptions_correlation "
+            "ON message_subscriptions (message_name, correlation_key)");
     }
 
     void Database::saveProcessInstance(
@@ -176,6 +360,13 @@ namespace db {
         const std::string& current_element,
         const std::map<std::string, std::string>& variables
     ) {
+        const std::lock_guard<std::mutex> connection(connectionMutex_);
+        const bpmn::ScopedLatency latency(statementTimer("save_process_instance"));
+        if (persistenceMode_ == PersistenceMode::Journal) {
+            appendProcessInstance(instance_id, process_id, current_element, variables);
+            return;
+        }
+
         //  
         executeQuery("BEGIN");
 
@@ -217,13 +408,308 @@ namespace db {
 
             executeQuery("COMMIT");
         }
-        catch (const std::exception& e) {
+        catch (...) {
+            executeQuery("ROLLBACK");
+            throw;
+        }
+    }
+
+    void Database::saveProcessInstances(const std::vector<ProcessInstanceRecord>& instances) {
+        const std::lock_guard<std::mutex> connection(connectionMutex_);
+        const bpmn::ScopedLatency latency(statementTimer("save_process_instances"));
+        saveBatch(instances, {});
+    }
+
+    void Database::saveProcessInstancesWithTasks(const std::vector<ProcessInstanceRecord>& instances,
+        const std::vector<UserTaskRecord>& tasks) {
+        const std::lock_guard<std::mutex> connection(connectionMutex_);
+        const bpmn::ScopedLatency latency(statementTimer("save_process_instances_with_tasks"));
+        saveBatch(instances, tasks);
+    }
+
+    void Database::saveBatch(const std::vector<ProcessInstanceRecord>& instances, const std::vector<UserTaskRecord>& tasks) {
+        if (instances.empty() && tasks.empty()) {
+            return;
+        }
+        const bool journal = persistenceMode_ == PersistenceMode::Journal;
+
+        // Held until the planned journal writes are committed or forgotten
+        std::vector<std::unique_lock<std::mutex>> claims;
+        if (journal && !instances.empty()) {
+            std::vector<std::string> ids;
+            ids.reserve(instances.size());
+            for (const auto& instance : instances) {
+                ids.push_back(instance.instance_id);
+            }
+            claims = journal_.lockInstances(ids);
+        }
+
+        executeQuery("BEGIN");
+
+        try {
+            if (!instances.empty()) {
+                if (journal) {
+                    appendProcessInstances(instances);
+                }
+                else {
+                    rewriteProcessInstances(instances);
+                }
+            }
+            if (!tasks.empty()) {
+                insertUserTasks(tasks);
+            }
+
+            executeQuery("COMMIT");
+        }
+        catch (...) {
             executeQuery("ROLLBACK");
+            if (journal) {
+                // The cached states are ahead of the database, start over with snapshots
+                for (const auto& instance : instances) {
+                    journal_.forget(instance.instance_id);
+                }
+            }
             throw;
         }
+
+        if (journal) {
+            for (const auto& instance : instances) {
+                if (instance.completed) {
+                    journal_.forget(instance.instance_id);
+                }
+            }
+        }
+    }
+
+    void Database::rewriteProcessInstances(const std::vector<ProcessInstanceRecord>& instances) {
+        upsertProcessInstances(instances);
+
+        for (std::size_t first = 0; first < instances.size(); first += kRowsPerStatement) {
+            const std::size_t count = std::min(kRowsPerStatement, instances.size() - first);
+            std::vector<const char*> id_params;
+            id_params.reserve(count);
+            for (std::size_t i = first; i < first + count; ++i) {
+                id_params.push_back(instances[i].instance_id.c_str());
+            }
+            executeQueryWithParams(
+                "DELETE FROM process_variables WHERE instance_id IN " + placeholders(1, count),
+                id_params
+            );
+        }
+
+        std::string rows;
+        for (const auto& instance : instances) {
+            for (const auto& [key, value] : instance.variables) {
+                appendVariableRow(rows, instance.instance_id, key, value);
+            }
+        }
+        if (!rows.empty()) {
+            copyRows("COPY process_variables (instance_id, var_key, var_value) FROM STDIN", rows);
+        }
+    }
+
+    void Database::upsertProcessInstances(const std::vector<ProcessInstanceRecord>& instances) {
+        static const std::string kCompleted = "COMPLETED";
+        static const std::string kRunning = "RUNNING";
+
+        for (std::size_t first = 0; first < instances.size(); first += kRowsPerStatement) {
+            const std::size_t count = std::min(kRowsPerStatement, instances.size() - first);
+
+            std::vector<const char*> instance_params;
+            instance_params.reserve(count * 4);
+            for (std::size_t i = first; i < first + count; ++i) {
+                const auto& instance = instances[i];
+                instance_params.push_back(instance.instance_id.c_str());
+                instance_params.push_back(instance.process_id.c_str());
+                instance_params.push_back(instance.current_element.c_str());
+                instance_params.push_back(instance.completed ? kCompleted.c_str() : kRunning.c_str());
+            }
+
+            // Placeholders are numbered per row: ($1, $2, $3, $4), ($5, ...
+            std::string values;
+            for (std::size_t row = 0; row < count; ++row) {
+                const std::string status = "$" + std::to_string(row * 4 + 4);
+                values += row == 0 ? "(" : ", (";
+                values += "$" + std::to_string(row * 4 + 1) + ", $" + std::to_string(row * 4 + 2) + ", $" +
+                    std::to_string(row * 4 + 3) + ", " + status + "::varchar(20), " +
+                    "CASE WHEN " + status + "::varchar(20) = 'COMPLETED' THEN CURRENT_TIMESTAMP END)";
+            }
+            executeQueryWithParams(
+                "INSERT INTO process_instances (id, process_id, current_element, status, completed_at) "
+                "VALUES " + values + " "
+                "ON CONFLICT (id) DO UPDATE SET "
+                "current_element = EXCLUDED.current_element, status = EXCLUDED.status, "
+                "completed_at = EXCLUDED.completed_at",
+                instance_params
+            );
+        }
+    }
+
+    void Database::appendProcessInstance(const std::string& instance_id, const std::string& process_id,
+        const std::string& current_element, const std::map<std::string, std::string>& variables) {
+        // Concurrent checkpoints of parallel branches write in plan order
+        const std::unique_lock<std::mutex> claim = journal_.lockInstance(instance_id);
+        const JournalWrite write = journal_.plan(instance_id, current_element, variables);
+        if (write.empty()) {
+            return;
+        }
+
+        try {
+            if (!write.snapshot) {
+                // The common case: one multi-row INSERT, atomic without a transaction
+                std::vector<std::string> values;
+                values.reserve(write.records.size() * 2);
+                std::vector<const char*> params;
+                params.reserve(write.records.size() * 5);
+                for (const JournalRecord& record : write.records) {
+                    values.push_back(std::to_string(record.seq));
+                    values.push_back(std::string(1, static_cast<char>(record.kind)));
+                }
+                for (std::size_t i = 0; i < write.records.size(); ++i) {
+                    params.push_back(instance_id.c_str());
+                    params.push_back(values[i * 2].c_str());
+                    params.push_back(values[i * 2 + 1].c_str());
+                    params.push_back(write.records[i].name.c_str());
+                    params.push_back(write.records[i].value.c_str());
+                }
+                executeQueryWithParams(
+                    "INSERT INTO process_journal (instance_id, seq, kind, name, value) "
+                    "VALUES " + placeholders(write.records.size(), 5),
+                    params
+                );
+                return;
+            }
+
+            executeQuery("BEGIN");
+            try {
+                std::vector<const char*> instance_params = { instance_id.c_str(), process_id.c_str(), current_element.c_str() };
+                if (write.fresh) {
+                    executeQueryWithParams(
+                        "INSERT INTO process_instances (id, process_id, current_element) "
+                        "VALUES ($1, $2, $3) "
+                        "ON CONFLICT (id) DO UPDATE SET "
+                        "current_element = $3, status = 'RUNNING', completed_at = NULL",
+                        instance_params
+                    );
+                }
+                else {
+                    // Kept current at snapshots only
+                    std::vector<const char*> element_params = { instance_id.c_str(), current_element.c_str() };
+                    executeQueryWithParams(
+                        "UPDATE process_instances SET current_element = $2 WHERE id = $1",
+                        element_params
+                    );
+                }
+
+                const std::string seq = std::to_string(write.snapshot_seq);
+                const std::string covered = std::to_string(write.coveredSeq());
+                const std::string snapshot = InstanceJournal::encodeSnapshot(variables);
+                std::vector<const char*> snapshot_params = { instance_id.c_str(), seq.c_str(), current_element.c_str(), snapshot.c_str() };
+                executeQueryWithParams(
+                    "INSERT INTO process_snapshots (instance_id, seq, current_element, variables) "
+                    "VALUES ($1, $2, $3, $4) "
+                    "ON CONFLICT (instance_id) DO UPDATE SET "
+                    "seq = EXCLUDED.seq, current_element = EXCLUDED.current_element, "
+                    "variables = EXCLUDED.variables, taken_at = CURRENT_TIMESTAMP",
+                    snapshot_params
+                );
+
+                // Only the rows the snapshot covers
+                std::vector<const char*> delete_params = { instance_id.c_str(), covered.c_str() };
+                executeQueryWithParams(
+                    "DELETE FROM process_journal WHERE instance_id = $1 AND seq <= $2",
+                    delete_params
+                );
+
+                executeQuery("COMMIT");
+            }
+            catch (...) {
+                executeQuery("ROLLBACK");
+                throw;
+            }
+        }
+        catch (...) {
+            // The cached state is ahead of the database, start over with a snapshot
+            journal_.forget(instance_id);
+            throw;
+        }
+    }
+
+    void Database::appendProcessInstances(const std::vector<ProcessInstanceRecord>& instances) {
+        std::vector<JournalWrite> writes;
+        writes.reserve(instances.size());
+        std::vector<std::size_t> snapshots;
+        std::string rows;
+        for (std::size_t i = 0; i < instances.size(); ++i) {
+            const auto& instance = instances[i];
+            writes.push_back(journal_.plan(instance.instance_id, instance.current_element, instance.variables));
+            if (writes.back().snapshot) {
+                snapshots.push_back(i);
+            }
+            for (const JournalRecord& record : writes.back().records) {
+                appendCopyField(rows, instance.instance_id);
+                rows += '\t';
+                rows += std::to_string(record.seq);
+                rows += '\t';
+                rows += static_cast<char>(record.kind);
+                rows += '\t';
+                appendCopyField(rows, record.name);
+                rows += '\t';
+                appendCopyField(rows, record.value);
+                rows += '\n';
+            }
+        }
+
+        // Also carries the status of completed records
+        upsertProcessInstances(instances);
+
+        for (std::size_t first = 0; first < snapshots.size(); first += kRowsPerStatement) {
+            const std::size_t count = std::min(kRowsPerStatement, snapshots.size() - first);
+
+            std::vector<std::string> values;
+            values.reserve(count * 3);
+            for (std::size_t i = first; i < first + count; ++i) {
+                values.push_back(std::to_string(writes[snapshots[i]].snapshot_seq));
+                values.push_back(InstanceJournal::encodeSnapshot(instances[snapshots[i]].variables));
+                values.push_back(std::to_string(writes[snapshots[i]].coveredSeq()));
+            }
+            std::vector<const char*> snapshot_params;
+            std::vector<const char*> covered_params;
+            snapshot_params.reserve(count * 4);
+            covered_params.reserve(count * 2);
+            for (std::size_t i = first; i < first + count; ++i) {
+                const auto& instance = instances[snapshots[i]];
+                snapshot_params.push_back(instance.instance_id.c_str());
+                snapshot_params.push_back(values[(i - first) * 3].c_str());
+                snapshot_params.push_back(instance.current_element.c_str());
+                snapshot_params.push_back(values[(i - first) * 3 + 1].c_str());
+                covered_params.push_back(instance.instance_id.c_str());
+                covered_params.push_back(values[(i - first) * 3 + 2].c_str());
+            }
+            executeQueryWithParams(
+                "INSERT INTO process_snapshots (instance_id, seq, current_element, variables) "
+                "VALUES " + placeholders(count, 4) + " "
+                "ON CONFLICT (instance_id) DO UPDATE SET "
+                "seq = EXCLUDED.seq, current_element = EXCLUDED.current_element, "
+                "variables = EXCLUDED.variables, taken_at = CURRENT_TIMESTAMP",
+                snapshot_params
+            );
+            // Only the rows each snapshot covers
+            executeQueryWithParams(
+                "DELETE FROM process_journal AS j USING (VALUES " + placeholders(count, 2) + ") "
+                "AS s(instance_id, seq) WHERE j.instance_id = s.instance_id::uuid AND j.seq <= s.seq::bigint",
+                covered_params
+            );
+        }
+
+        if (!rows.empty()) {
+            copyRows("COPY process_journal (instance_id, seq, kind, name, value) FROM STDIN", rows);
+        }
     }
 
     Database::ProcessInstance Database::loadProcessInstance(const std::string& instance_id) {
+        const std::lock_guard<std::mutex> connection(connectionMutex_);
+        const bpmn::ScopedLatency latency(statementTimer("load_process_instance"));
         ProcessInstance result;
 
         // Load instance metadata
@@ -240,12 +726,75 @@ namespace db {
 
         result.process_id = instance_result[0][0];
         result.current_element = instance_result[0][1];
-        result.variables = loadVariables(instance_id);
+        if (persistenceMode_ == PersistenceMode::Journal) {
+            replayProcessInstance(instance_id, result);
+        }
+        else {
+            result.variables = loadVariables(instance_id);
+        }
 
         return result;
     }
 
+    void Database::replayProcessInstance(const std::string& instance_id, ProcessInstance& instance) {
+        // Snapshot first, then the journal tail, in one round trip. A write
+        // in flight would leave the restored head behind the database.
+        const std::unique_lock<std::mutex> claim = journal_.lockInstance(instance_id);
+        std::vector<const char*> params = { instance_id.c_str() };
+        auto rows = executeQueryWithResults(
+            "SELECT 0 AS part, seq, '' AS kind, current_element AS name, variables::text AS value "
+            "FROM process_snapshots WHERE instance_id = $1 "
+            "UNION ALL "
+            "SELECT 1, seq, kind, name, value FROM process_journal WHERE instance_id = $1 "
+            "ORDER BY 1, 2",
+            params
+        );
+
+        if (rows.empty()) {
+            // Saved before the journal existed; the next save writes a snapshot
+            instance.variables = loadVariables(instance_id);
+            return;
+        }
+
+        std::int64_t seq = 0;
+        std::size_t records = 0;
+        for (const auto& row : rows) {
+            const std::int64_t row_seq = std::stoll(row[1]);
+            if (row[0] == "0") {
+                seq = row_seq;
+                instance.current_element = row[3];
+                instance.variables = InstanceJournal::decodeSnapshot(row[4]);
+                continue;
+            }
+            if (row_seq <= seq || row[2].empty()) {
+                continue;
+            }
+            JournalRecord record;
+            record.seq = row_seq;
+            record.kind = static_cast<JournalRecord::Kind>(row[2][0]);
+            record.name = row[3];
+            record.value = row[4];
+            InstanceJournal::apply(record, instance.current_element, instance.variables);
+            seq = row_seq;
+            ++records;
+        }
+        journal_.restore(instance_id, seq, records, instance.current_element, instance.variables);
+    }
+
+    bool Database::hasProcessInstance(const std::string& instance_id) {
+        const std::lock_guard<std::mutex> connection(connectionMutex_);
+        const bpmn::ScopedLatency latency(statementTimer("has_process_instance"));
+        std::vector<const char*> params = { instance_id.c_str() };
+        return !executeQueryWithResults(
+            "SELECT 1 FROM process_instances WHERE id = $1 AND status = 'RUNNING'",
+            params
+        ).empty();
+    }
+
     void Database::completeProcessInstance(const std::string& instance_id) {
+        const std::lock_guard<std::mutex> connection(connectionMutex_);
+        const bpmn::ScopedLatency latency(statementTimer("complete_process_instance"));
+        journal_.forget(instance_id);
         std::vector<const char*> params = { instance_id.c_str() };
         executeQueryWithParams(
             "UPDATE process_instances SET "
@@ -262,6 +811,8 @@ namespace db {
         const std::string& form_key,
         const std::map<std::string, std::string>& variables
     ) {
+        const std::lock_guard<std::mutex> connection(connectionMutex_);
+        const bpmn::ScopedLatency latency(statementTimer("save_user_task"));
         executeQuery("BEGIN");
 
         try {
@@ -294,13 +845,50 @@ namespace db {
 
             executeQuery("COMMIT");
         }
-        catch (const std::exception& e) {
+        catch (...) {
             executeQuery("ROLLBACK");
             throw;
         }
     }
 
+    void Database::saveUserTasks(const std::vector<UserTaskRecord>& tasks) {
+        const std::lock_guard<std::mutex> connection(connectionMutex_);
+        const bpmn::ScopedLatency latency(statementTimer("save_user_tasks"));
+        saveBatch({}, tasks);
+    }
+
+    void Database::insertUserTasks(const std::vector<UserTaskRecord>& tasks) {
+        for (std::size_t first = 0; first < tasks.size(); first += kRowsPerStatement) {
+            const std::size_t count = std::min(kRowsPerStatement, tasks.size() - first);
+
+            std::vector<const char*> task_params;
+            task_params.reserve(count * 3);
+            for (std::size_t i = first; i < first + count; ++i) {
+                task_params.push_back(tasks[i].instance_id.c_str());
+                task_params.push_back(tasks[i].task_id.c_str());
+                task_params.push_back(tasks[i].form_key.c_str());
+            }
+            executeQueryWithParams(
+                "INSERT INTO user_tasks (instance_id, task_id, form_key) VALUES " + placeholders(count, 3),
+                task_params
+            );
+        }
+
+        // Task-specific variables, prefixed as in saveUserTask
+        std::string rows;
+        for (const auto& task : tasks) {
+            for (const auto& [key, value] : task.variables) {
+                appendVariableRow(rows, task.instance_id, "task_" + task.task_id + "_" + key, value);
+            }
+        }
+        if (!rows.empty()) {
+            copyRows("COPY process_variables (instance_id, var_key, var_value) FROM STDIN", rows);
+        }
+    }
+
     void Database::saveError(const std::string& instance_id, const std::string& error_message) {
+        const std::lock_guard<std::mutex> connection(connectionMutex_);
+        const bpmn::ScopedLatency latency(statementTimer("save_error"));
         std::vector<const char*> params = {
             instance_id.c_str(),
             error_message.c_str()
@@ -312,11 +900,190 @@ namespace db {
         );
     }
 
+    void Database::saveTimer(const TimerRecord& timer) {
+        const std::lock_guard<std::mutex> connection(connectionMutex_);
+        const bpmn::ScopedLatency latency(statementTimer("save_timer"));
+        const std::string due_at = std::to_string(timer.due_at);
+        const std::string repetitions = std::to_string(timer.repetitions);
+        const std::string interval_ms = std::to_string(timer.interval_ms);
+        if (timer.kind == "start") {
+            std::vector<const char*> params = {
+                timer.process_id.c_str(),
+                timer.element_id.c_str(),
+                due_at.c_str(),
+                repetitions.c_str(),
+                interval_ms.c_str()
+            };
+            executeQueryWithParams(
+                "INSERT INTO process_start_timers (process_id, element_id, due_at, repetitions, interval_ms) "
+                "VALUES ($1, $2, $3, $4, $5) "
+                "ON CONFLICT (process_id, element_id) DO UPDATE SET "
+                "due_at = EXCLUDED.due_at, repetitions = EXCLUDED.repetitions, interval_ms = EXCLUDED.interval_ms",
+                params
+            );
+            return;
+        }
+        std::vector<const char*> params = {
+            timer.instance_id.c_str(),
+            timer.element_id.c_str(),
+            timer.process_id.c_str(),
+            timer.kind.c_str(),
+            due_at.c_str(),
+            repetitions.c_str(),
+            interval_ms.c_str()
+        };
+        executeQueryWithParams(
+            "INSERT INTO process_timers (instance_id, element_id, process_id, kind, due_at, repetitions, interval_ms) "
+            "VALUES ($1, $2, $3, $4, $5, $6, $7) "
+            "ON CONFLICT (instance_id, element_id) DO UPDATE SET "
+            "process_id = EXCLUDED.process_id, kind = EXCLUDED.kind, due_at = EXCLUDED.due_at, "
+            "repetitions = EXCLUDED.repetitions, interval_ms = EXCLUDED.interval_ms",
+            params
+        );
+    }
+
+    void Database::deleteTimer(const std::string& instance_id, const std::string& element_id) {
+        const std::lock_guard<std::mutex> connection(connectionMutex_);
+        const bpmn::ScopedLatency latency(statementTimer("delete_timer"));
+        std::vector<const char*> params = { instance_id.c_str(), element_id.c_str() };
+        // Start timers are keyed by their process id, which is no UUID and
+        // would not even parse as one in process_timers
+        bpmn::InstanceId id;
+        if (bpmn::InstanceId::tryParse(instance_id, id)) {
+            executeQueryWithParams(
+                "DELETE FROM process_timers WHERE instance_id = $1 AND element_id = $2",
+                params
+            );
+        }
+        executeQueryWithParams(
+            "DELETE FROM process_start_timers WHERE process_id = $1 AND element_id = $2",
+            params
+        );
+    }
+
+    void Database::deleteTimers(const std::string& instance_id) {
+        const std::lock_guard<std::mutex> connection(connectionMutex_);
+        const bpmn::ScopedLatency latency(statementTimer("delete_timers"));
+        std::vector<const char*> params = { instance_id.c_str() };
+        bpmn::InstanceId id;
+        if (bpmn::InstanceId::tryParse(instance_id, id)) {
+            executeQueryWithParams(
+                "DELETE FROM process_timers WHERE instance_id = $1",
+                params
+            );
+        }
+        executeQueryWithParams(
+            "DELETE FROM process_start_timers WHERE process_id = $1",
+            params
+        );
+    }
+
+    std::vector<Database::TimerRecord> Database::loadTimers() {
+        const std::lock_guard<std::mutex> connection(connectionMutex_);
+        const bpmn::ScopedLatency latency(statementTimer("load_timers"));
+        checkConnection();
+
+        PGresult* res = PQexec(conn_,
+            "SELECT instance_id::text, element_id, process_id, kind, due_at, repetitions, interval_ms "
+            "FROM process_timers "
+            "UNION ALL "
+            "SELECT process_id, element_id, process_id, 'start', due_at, repetitions, interval_ms "
+            "FROM process_start_timers "
+            "ORDER BY due_at");
+        if (PQresultStatus(res) != PGRES_TUPLES_OK) {
+            last_error_ = PQresultErrorMessage(res);
+            PQclear(res);
+            throw std::runtime_error("Failed to load timers: " + last_error_);
+        }
+
+        // Read straight from the result, millions of rows are expected
+        const int rows = PQntuples(res);
+        std::vector<TimerRecord> timers(static_cast<std::size_t>(rows));
+        for (int i = 0; i < rows; ++i) {
+            TimerRecord& timer = timers[static_cast<std::size_t>(i)];
+            timer.instance_id = PQgetvalue(res, i, 0);
+            timer.element_id = PQgetvalue(res, i, 1);
+            timer.process_id = PQgetvalue(res, i, 2);
+            timer.kind = PQgetvalue(res, i, 3);
+            timer.due_at = std::stoll(PQgetvalue(res, i, 4));
+            timer.repetitions = std::stoi(PQgetvalue(res, i, 5));
+            timer.interval_ms = std::stoll(PQgetvalue(res, i, 6));
+        }
+        PQclear(res);
+        return timers;
+    }
+
+    void Database::saveMessageSubscription(const MessageSubscriptionRecord& subscription) {
+        const std::lock_guard<std::mutex> connection(connectionMutex_);
+        const bpmn::ScopedLatency latency(statementTimer("save_message_subscription"));
+        std::vector<const char*> params = {
+            subscription.instance_id.c_str(),
+            subscription.element_id.c_str(),
+            subscription.message_name.c_str(),
+            subscription.correlation_key.c_str()
+        };
+        executeQueryWithParams(
+            "INSERT INTO message_subscriptions (instance_id, element_id, message_name, correlation_key) "
+            "VALUES ($1, $2, $3, $4) "
+            "ON CONFLICT (instance_id, element_id) DO UPDATE SET "
+            "message_name = EXCLUDED.message_name, correlation_key = EXCLUDED.correlation_key",
+            params
+        );
+    }
+
+    void Database::deleteMessageSubscription(const std::string& instance_id, const std::string& element_id) {
+        const std::lock_guard<std::mutex> connection(connectionMutex_);
+        const bpmn::ScopedLatency latency(statementTimer("delete_message_subscription"));
+        std::vector<const char*> params = { instance_id.c_str(), element_id.c_str() };
+        executeQueryWithParams(
+            "DELETE FROM message_subscriptions WHERE instance_id = $1 AND element_id = $2",
+            params
+        );
+    }
+
+    void Database::deleteMessageSubscriptions(const std::string& instance_id) {
+        const std::lock_guard<std::mutex> connection(connectionMutex_);
+        const bpmn::ScopedLatency latency(statementTimer("delete_message_subscriptions"));
+        std::vector<const char*> params = { instance_id.c_str() };
+        executeQueryWithParams(
+            "DELETE FROM message_subscriptions WHERE instance_id = $1",
+            params
+        );
+    }
+
+    std::vector<Database::MessageSubscriptionRecord> Database::loadMessageSubscriptions() {
+        const std::lock_guard<std::mutex> connection(connectionMutex_);
+        const bpmn::ScopedLatency latency(statementTimer("load_message_subscriptions"));
+        checkConnection();
+
+        PGresult* res = PQexec(conn_,
+            "SELECT instance_id, element_id, message_name, correlation_key FROM message_subscriptions");
+        if (PQresultStatus(res) != PGRES_TUPLES_OK) {
+            last_error_ = PQresultErrorMessage(res);
+            PQclear(res);
+            throw std::runtime_error("Failed to load message subscriptions: " + last_error_);
+        }
+
+        const int rows = PQntuples(res);
+        std::vector<MessageSubscriptionRecord> subscriptions(static_cast<std::size_t>(rows));
+        for (int i = 0; i < rows; ++i) {
+            MessageSubscriptionRecord& subscription = subscriptions[static_cast<std::size_t>(i)];
+            subscription.instance_id = PQgetvalue(res, i, 0);
+            subscription.element_id = PQgetvalue(res, i, 1);
+            subscription.message_name = PQgetvalue(res, i, 2);
+            subscription.correlation_key = PQgetvalue(res, i, 3);
+        }
+        PQclear(res);
+        return subscriptions;
+    }
+
     PGconn* Database::getConnection() const {
         return conn_;
     }
 
     std::string Database::loadProcessDefinition(const std::string& process_id) {
+        const std::lock_guard<std::mutex> connection(connectionMutex_);
+        const bpmn::ScopedLatency latency(statementTimer("load_process_definition"));
         std::vector<const char*> params = { process_id.c_str() };
         auto result = executeQueryWithResults(
             "SELECT bpmn_xml FROM process_definitions "
@@ -331,6 +1098,128 @@ namespace db {
         return result[0][0];
     }
 
+    std::string Database::loadProcessDefinition(const std::string& process_id, int version) {
+        const std::lock_guard<std::mutex> connection(connectionMutex_);
+        const bpmn::ScopedLatency latency(statementTimer("load_process_definition"));
+        const std::string version_str = std::to_string(version);
+        std::vector<const char*> params = { process_id.c_str(), version_str.c_str() };
+        auto result = executeQueryWithResults(
+            "SELECT bpmn_xml FROM process_definitions "
+            "WHERE id = $1 AND version = $2",
+            params
+        );
+
+        if (result.empty()) {
+            throw std::runtime_error("Process definition not found: " + process_id + " v" + version_str);
+        }
+
+        return result[0][0];
+    }
+
+    int Database::loadProcessDefinitionVersion(const std::string& process_id) {
+        const std::lock_guard<std::mutex> connection(connectionMutex_);
+        const bpmn::ScopedLatency latency(statementTimer("load_process_definition_version"));
+        std::vector<const char*> params = { process_id.c_str() };
+        auto result = executeQueryWithResults(
+            "SELECT MAX(version) FROM process_definitions WHERE id = $1",
+            params
+        );
+
+        if (result.empty() || result[0][0].empty()) {
+            throw std::runtime_error("Process definition not found: " + process_id);
+        }
+
+        return std::stoi(result[0][0]);
+    }
+
+    int Database::deployProcessDefinition(const std::string& process_id, const std::string& bpmn_xml, const std::string& compiled) {
+        const std::lock_guard<std::mutex> connection(connectionMutex_);
+        const bpmn::ScopedLatency latency(statementTimer("deploy_process_definition"));
+        checkConnection();
+        return upsertProcessDefinition(process_id, bpmn_xml, compiled);
+    }
+
+    std::vector<int> Database::deployProcessDefinitions(const std::vector<ProcessDefinitionRecord>& definitions) {
+        const std::lock_guard<std::mutex> connection(connectionMutex_);
+        const bpmn::ScopedLatency latency(statementTimer("deploy_process_definitions"));
+        std::vector<int> versions;
+        if (definitions.empty()) {
+            return versions;
+        }
+        versions.reserve(definitions.size());
+
+        checkConnection();
+        executeQuery("BEGIN");
+
+        try {
+            for (const auto& definition : definitions) {
+                versions.push_back(upsertProcessDefinition(definition.process_id, definition.bpmn_xml, definition.compiled));
+            }
+
+            executeQuery("COMMIT");
+        }
+        catch (...) {
+            executeQuery("ROLLBACK");
+            throw;
+        }
+
+        return versions;
+    }
+
+    int Database::upsertProcessDefinition(const std::string& process_id, const std::string& bpmn_xml, const std::string& compiled) {
+        // compiled is sent as a binary parameter, the rest as text
+        const char* values[3] = { process_id.c_str(), bpmn_xml.c_str(), compiled.data() };
+        const int lengths[3] = { 0, 0, static_cast<int>(compiled.size()) };
+        const int formats[3] = { 0, 0, 1 };
+
+        PGresult* res = PQexecParams(conn_,
+            "INSERT INTO process_definitions (id, bpmn_xml, compiled, version) "
+            "VALUES ($1, $2, $3, 1) "
+            "ON CONFLICT (id) DO UPDATE SET "
+            "bpmn_xml = EXCLUDED.bpmn_xml, compiled = EXCLUDED.compiled, "
+            "version = process_definitions.version + 1, deployed_at = CURRENT_TIMESTAMP "
+            "RETURNING version",
+            3, NULL, values, lengths, formats, 0);
+
+        if (PQresultStatus(res) != PGRES_TUPLES_OK) {
+            last_error_ = PQresultErrorMessage(res);
+            PQclear(res);
+            throw std::runtime_error("Failed to deploy process definition: " + last_error_);
+        }
+
+        const int version = std::atoi(PQgetvalue(res, 0, 0));
+        PQclear(res);
+        return version;
+    }
+
+    std::string Database::loadCompiledProcessDefinition(const std::string& process_id, int version) {
+        const std::lock_guard<std::mutex> connection(connectionMutex_);
+        const bpmn::ScopedLatency latency(statementTimer("load_compiled_process_definition"));
+        checkConnection();
+
+        const std::string version_str = std::to_string(version);
+        const char* values[2] = { process_id.c_str(), version_str.c_str() };
+
+        // Binary result format: the buffer arrives as is, without hex decoding
+        PGresult* res = PQexecParams(conn_,
+            "SELECT compiled FROM process_definitions "
+            "WHERE id = $1 AND version = $2 AND compiled IS NOT NULL",
+            2, NULL, values, NULL, NULL, 1);
+
+        if (PQresultStatus(res) != PGRES_TUPLES_OK) {
+            last_error_ = PQresultErrorMessage(res);
+            PQclear(res);
+            throw std::runtime_error("Failed to load compiled process definition: " + last_error_);
+        }
+
+        std::string compiled;
+        if (PQntuples(res) > 0) {
+            compiled.assign(PQgetvalue(res, 0, 0), PQgetlength(res, 0, 0));
+        }
+        PQclear(res);
+        return compiled;
+    }
+
     std::map<std::string, std::string> Database::loadVariables(const std::string& instance_id) {
         std::map<std::string, std::string> variables;
 
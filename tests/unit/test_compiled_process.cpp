@@ -0,0 +1,58 @@
+#include <gtest/gtest.h>
+#include <bpmn/compiled_process.h>
+#include <bpmn/parser.h>
+
+using namespace bpmn;
+
+class TestCompiledProcess : public ::testing::Test {
+protected:
+    std::unique_ptr<Process> parseGatewayProcess() {
+        BpmnParser parser;
+        return parser.parseFromString(R"(<?xml version="1.0" encoding="UTF-8"?>
+            <definitions xmlns="http://www.omg.org/spec/BPMN/20100524/MODEL">
+                <process id="routing" name="Routing">
+                    <startEvent id="start"/>
+                    <exclusiveGateway id="decide" default="to_manual"/>
+                    <serviceTask id="auto"/>
+                    <userTask id="manual"/>
+                    <endEvent id="end"/>
+                    <sequenceFlow id="f1" sourceRef="start" targetRef="decide"/>
+                    <sequenceFlow id="to_auto" sourceRef="decide" targetRef="auto"/>
+                    <sequenceFlow id="to_manual" sourceRef="decide" targetRef="manual"/>
+                    <sequenceFlow id="f4" sourceRef="auto" targetRef="end"/>
+                    <sequenceFlow id="f5" sourceRef="manual" targetRef="end"/>
+                </process>
+            </definitions>)");
+    }
+};
+
+TEST_F(TestCompiledProcess, RoundTripKeepsGraph) {
+    auto process = parseGatewayProcess();
+    const std::string buffer = CompiledProcess::compile(*process);
+    ASSERT_TRUE(CompiledProcess::isCompiledProcess(buffer.data(), buffer.size()));
+
+    auto loaded = CompiledProcess::load(buffer);
+    EXPECT_EQ(loaded->getId(), "routing");
+    EXPECT_EQ(loaded->getName(), "Routing");
+    EXPECT_EQ(loaded->getStartEventId(), "start");
+    EXPECT_EQ(loaded->getElements().size(), process->getElements().size());
+    EXPECT_TRUE(loaded->validate());
+
+    auto outgoing = loaded->getOutgoingFlows("decide");
+    ASSERT_EQ(outgoing.size(), 2u);
+    EXPECT_EQ(outgoing[0]->getId(), "to_auto");
+    EXPECT_EQ(outgoing[1]->getId(), "to_manual");
+    EXPECT_EQ(loaded->getIncomingFlows("end").size(), 2u);
+
+    auto gateway = dynamic_cast<ExclusiveGateway*>(loaded->getElement("decide"));
+    ASSERT_NE(gateway, nullptr);
+    EXPECT_EQ(gateway->default_flow, "to_manual");
+    EXPECT_NE(dynamic_cast<services::ServiceTask*>(loaded->getElement("auto")), nullptr);
+}
+
+TEST_F(TestCompiledProcess, RejectsCorruptBuffer) {
+    std::string buffer = CompiledProcess::compile(*parseGatewayProcess());
+    buffer.resize(buffer.size() / 2);
+    EXPECT_THROW(CompiledProcess::load(buffer), std::runtime_error);
+    EXPECT_FALSE(CompiledProcess::isCompiledProcess("<xml/>", 6));
+}
@@ -0,0 +1,58 @@
+#include <gtest/gtest.h>
+#include <bpmn/condition_expression.h>
+#include <map>
+#include <stdexcept>
+#include <string>
+
+using namespace bpmn;
+
+namespace {
+
+    bool eval(const std::string& source, const std::map<std::string, std::string>& variables = {}) {
+        return ConditionExpression::compile(source)->evaluate(variables);
+    }
+
+} // anonymous namespace
+
+TEST(TestConditionExpression, ComparesVariablesNumerically) {
+    const std::map<std::string, std::string> variables{ { "amount", "1500" }, { "limit", "200" } };
+    EXPECT_TRUE(eval("${amount > 1000}", variables));
+    EXPECT_FALSE(eval("${amount <= 1000}", variables));
+    // Two numeric strings compare as numbers, not lexicographically
+    EXPECT_TRUE(eval("${amount gt limit}", variables));
+    EXPECT_TRUE(eval("${amount * 2 - 1000 == 2000}", variables));
+    EXPECT_TRUE(eval("${(amount + 500) / 2 ge 1000}", variables));
+}
+
+TEST(TestConditionExpression, StringsBooleansAndLogic) {
+    const std::map<std::string, std::string> variables{
+        { "order.status", "approved" }, { "vip", "true" }, { "count", "0" } };
+    EXPECT_TRUE(eval("${order.status == 'approved'}", variables));
+    EXPECT_TRUE(eval("${order.status ne \"rejected\"}", variables));
+    EXPECT_TRUE(eval("${vip}", variables));
+    EXPECT_TRUE(eval("${vip == true && !(count > 0)}", variables));
+    EXPECT_TRUE(eval("${not vip or count eq 0}", variables));
+    EXPECT_FALSE(eval("${vip and count}", variables));
+    EXPECT_TRUE(eval("${missing == null}", variables));
+    EXPECT_FALSE(eval("${missing > 1}", variables));
+    // The right operand is never looked at when the left one decides
+    EXPECT_TRUE(eval("${vip || missing > 1}", variables));
+}
+
+TEST(TestConditionExpression, CollectsVariableSlots) {
+    auto expression = ConditionExpression::compile("${a > 1 && b < 2 || a == b}");
+    ASSERT_EQ(expression->variables().size(), 2u);
+    EXPECT_EQ(expression->variables()[0], "a");
+    EXPECT_EQ(expression->variables()[1], "b");
+    EXPECT_EQ(expression->source(), "${a > 1 && b < 2 || a == b}");
+}
+
+TEST(TestConditionExpression, RejectsInvalidSyntax) {
+    EXPECT_THROW(ConditionExpression::compile("${}"), std::invalid_argument);
+    EXPECT_THROW(ConditionExpression::compile("${amount >}"), std::invalid_argument);
+    EXPECT_THROW(ConditionExpression::compile("${(a > 1}"), std::invalid_argument);
+    EXPECT_THROW(ConditionExpression::compile("${'open}"), std::invalid_argument);
+    EXPECT_THROW(ConditionExpression::compile("${a b}"), std::invalid_argument);
+    EXPECT_THROW(ConditionExpression::compile("${" + std::string(200, '(') + "1" + std::string(200, ')') + "}"),
+        std::invalid_argument);
+}
@@ -0,0 +1,80 @@
+#include <gtest/gtest.h>
+#include <bpmn/definition_cache.h>
+#include <atomic>
+#include <thread>
+#include <vector>
+
+using namespace bpmn;
+
+class TestDefinitionCache : public ::testing::Test {
+protected:
+    static std::shared_ptr<const Process> makeProcess(const std::string& id) {
+        return std::make_shared<Process>(id, id);
+    }
+};
+
+TEST_F(TestDefinitionCache, LoadsOncePerVersion) {
+    ProcessDefinitionCache cache(4);
+    int loads = 0;
+    auto loader = [&loads]() {
+        ++loads;
+        return makeProcess("order");
+    };
+
+    auto first = cache.getOrLoad("order", 1, loader);
+    auto second = cache.getOrLoad("order", 1, loader);
+    cache.getOrLoad("order", 2, loader);
+
+    EXPECT_EQ(first, second);
+    EXPECT_EQ(loads, 2);
+
+    auto stats = cache.stats();
+    EXPECT_EQ(stats.hits, 1u);
+    EXPECT_EQ(stats.misses, 2u);
+    EXPECT_EQ(stats.size, 2u);
+}
+
+TEST_F(TestDefinitionCache, EvictsLeastRecentlyUsed) {
+    ProcessDefinitionCache cache(2);
+    cache.put("a", 1, makeProcess("a"));
+    cache.put("b", 1, makeProcess("b"));
+    cache.find("a", 1);
+    cache.put("c", 1, makeProcess("c"));
+
+    EXPECT_NE(cache.find("a", 1), nullptr);
+    EXPECT_EQ(cache.find("b", 1), nullptr);
+    EXPECT_NE(cache.find("c", 1), nullptr);
+    EXPECT_EQ(cache.stats().evictions, 1u);
+}
+
+TEST_F(TestDefinitionCache, FailedLoadIsNotCached) {
+    ProcessDefinitionCache cache;
+    EXPECT_THROW(cache.getOrLoad("broken", 1, []() -> std::shared_ptr<const Process> {
+        throw std::runtime_error("parse error");
+        }), std::runtime_error);
+
+    auto process = cache.getOrLoad("broken", 1, []() { return makeProcess("broken"); });
+    EXPECT_EQ(process->getId(), "broken");
+}
+
+TEST_F(TestDefinitionCache, ConcurrentMissesShareOneLoad) {
+    ProcessDefinitionCache cache;
+    std::atomic<int> loads{ 0 };
+    std::vector<std::thread> threads;
+    for (int i = 0; i < 8; ++i) {
+        threads.emplace_back([&]() {
+            cache.getOrLoad("shared", 1, [&]() {
+                ++loads;
+                std::this_thread::sleep_for(std::chrono::milliseconds(20));
+                return makeProcess("shared");
+                });
+            });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+
+    EXPECT_EQ(loads.load(), 1);
+    EXPECT_EQ(cache.stats().misses, 1u);
+    EXPECT_EQ(cache.stats().hits, 7u);
+}
@@ -1,6 +1,12 @@
 #include <gtest/gtest.h>
 #include <bpmn/executor.h>
 #include <bpmn/model.h>
+#include <bpmn/in_memory_state_store.h>
+#include <bpmn/parser.h>
+#include <atomic>
+#include <chrono>
+#include <set>
+#include <thread>
 
 using namespace bpmn;
 
@@ -25,12 +31,11 @@ protected:
         process->addSequenceFlow("flow2", "flow2", "user_task", "end");
 
         //   
-        database = std::make_unique<db::Database>("test_connection_string");
-        executor = std::make_unique<ProcessExecutor>(*database);
+        executor = std::make_unique<ProcessExecutor>(store);
     }
 
     std::unique_ptr<Process> process;
-    std::unique_ptr<db::Database> database;
+    InMemoryStateStore store;
     std::unique_ptr<ProcessExecutor> executor;
 
 };
@@ -82,8 +87,8 @@ TEST_F(TestExecutor, ProcessVariables) {
 
     const ExecutionState& state = executor->getExecutionState(instanceId);
     
-    EXPECT_EQ(state.variables.at("days"), "5");
-    EXPECT_EQ(state.variables.at("reason"), "vacation");
+    EXPECT_EQ(state.variables.getString("days"), "5");
+    EXPECT_EQ(state.variables.getString("reason"), "vacation");
 }
 
 TEST_F(TestExecutor, InvalidProcess) {
@@ -97,4 +102,437 @@ TEST_F(TestExecutor, NonExistentInstance) {
     EXPECT_THROW({
         executor->getExecutionState("non_existent_id");
         }, std::runtime_error);
-}
\ No newline at end of file
+}
+
+// start -> pass-through gateways -> end
+static std::unique_ptr<Process> makeGatewayChain(std::size_t gateways) {
+    auto chain = std::make_unique<Process>("gateway_chain", "Gateway Chain");
+    chain->addElement(std::make_shared<StartEvent>("start", "Start"));
+    std::string previous = "start";
+    for (std::size_t i = 0; i < gateways; ++i) {
+        const std::string id = "gateway" + std::to_string(i);
+        chain->addElement(std::make_shared<ParallelGateway>(id, id));
+        chain->addSequenceFlow("flow" + std::to_string(i), "", previous, id);
+        previous = id;
+    }
+    chain->addElement(std::make_shared<EndEvent>("end", "End"));
+    chain->addSequenceFlow("flow_end", "", previous, "end");
+    chain->setStartEventId("start");
+    return chain;
+}
+
+// Service calls resume on the pool; wait until nothing is left in flight
+static void waitForIdle(const ProcessExecutor& executor) {
+    for (int i = 0; i < 1000; ++i) {
+        const auto stats = executor.getWorkerPoolStats();
+        if (executor.getInFlightServiceCalls() == 0 && stats.executed == stats.submitted) {
+            return;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+}
+
+// start -> service tasks -> end
+static std::unique_ptr<Process> makeServiceChain(std::size_t tasks) {
+    auto chain = std::make_unique<Process>("service_chain", "Service Chain");
+    chain->addElement(std::make_shared<StartEvent>("start", "Start"));
+    std::string previous = "start";
+    for (std::size_t i = 0; i < tasks; ++i) {
+        const std::string id = "task" + std::to_string(i);
+        auto task = std::make_shared<services::ServiceTask>(id, id);
+        task->topic = "echo";
+        chain->addElement(task);
+        chain->addSequenceFlow("flow" + std::to_string(i), "", previous, id);
+        previous = id;
+    }
+    chain->addElement(std::make_shared<EndEvent>("end", "End"));
+    chain->addSequenceFlow("flow_end", "", previous, "end");
+    chain->setStartEventId("start");
+    return chain;
+}
+
+TEST_F(TestExecutor, LongGatewayChainRunsWithoutRecursion) {
+    // Deep enough to overflow the stack if every element added a frame
+    auto chain = makeGatewayChain(200000);
+    std::string instanceId = executor->startProcess(*chain, "{}", [](auto) { return true; });
+
+    const ExecutionState& state = executor->getExecutionState(instanceId);
+    EXPECT_EQ(state.current_element, "end");
+}
+
+TEST_F(TestExecutor, StepBudgetYieldsAndContinues) {
+    std::shared_ptr<const Process> chain = makeGatewayChain(10);
+    // continueProcess looks the definition up by id
+    executor->addProcessDefinition(chain);
+    executor->setStepBudget(4);
+
+    std::string instanceId = executor->startProcess(chain, "{}", [](auto) { return true; });
+    EXPECT_EQ(executor->getExecutionState(instanceId).current_element, "gateway3");
+
+    executor->setStepBudget(0);
+    executor->continueProcess(instanceId, [](auto) { return true; });
+    EXPECT_EQ(executor->getExecutionState(instanceId).current_element, "end");
+}
+
+TEST_F(TestExecutor, UserTaskPausesRunLoop) {
+    process->setStartEventId("start");
+    std::string pausedAt;
+    executor->startProcess(*process, "{}", [&pausedAt](const std::string& taskId) {
+        pausedAt = taskId;
+        return true;
+    });
+    EXPECT_EQ(pausedAt, "user_task");
+}
+
+TEST_F(TestExecutor, ServiceTasksCompleteAsynchronously) {
+    auto chain = makeServiceChain(1000);
+    std::string instanceId = executor->startProcess(*chain, "{}", [](auto) { return true; });
+    waitForIdle(*executor);
+
+    EXPECT_EQ(executor->getInFlightServiceCalls(), 0u);
+    const ExecutionState& state = executor->getExecutionState(instanceId);
+    EXPECT_EQ(state.current_element, "end");
+    EXPECT_EQ(state.variables.count("task999"), 1u);
+}
+
+TEST_F(TestExecutor, ParallelJoinMergesBranchVariables) {
+    // start -> fork -> two service tasks -> join -> end
+    auto parallel = std::make_unique<Process>("parallel", "Parallel");
+    parallel->addElement(std::make_shared<StartEvent>("start", "Start"));
+    parallel->addElement(std::make_shared<ParallelGateway>("fork", "Fork"));
+    parallel->addElement(std::make_shared<ParallelGateway>("join", "Join"));
+    parallel->addElement(std::make_shared<EndEvent>("end", "End"));
+    parallel->addSequenceFlow("f0", "", "start", "fork");
+    for (const std::string id : { "left", "right" }) {
+        auto task = std::make_shared<services::ServiceTask>(id, id);
+        task->topic = "echo";
+        parallel->addElement(task);
+        parallel->addSequenceFlow("to_" + id, "", "fork", id);
+        parallel->addSequenceFlow("from_" + id, "", id, "join");
+    }
+    parallel->addSequenceFlow("f1", "", "join", "end");
+    parallel->setStartEventId("start");
+
+    std::string instanceId = executor->startProcess(*parallel, "{}", [](auto) { return true; });
+    waitForIdle(*executor);
+
+    const ExecutionState& state = executor->getExecutionState(instanceId);
+    EXPECT_EQ(state.current_element, "end");
+    EXPECT_EQ(state.variables.count("left"), 1u);
+    EXPECT_EQ(state.variables.count("right"), 1u);
+    EXPECT_EQ(state.variables.count("init_data"), 1u);
+}
+
+TEST_F(TestExecutor, ParsedServiceTasksRunOrPassThrough) {
+    const std::string bpmnXml = R"(<?xml version="1.0" encoding="UTF-8"?>
+        <definitions xmlns="http://www.omg.org/spec/BPMN/20100524/MODEL"
+                     xmlns:camunda="http://camunda.org/schema/1.0/bpmn">
+            <process id="services" name="Services">
+                <startEvent id="start"/>
+                <serviceTask id="charge" camunda:class="org.example.Charge"/>
+                <serviceTask id="notify" camunda:type="external" camunda:topic="notify"/>
+                <serviceTask id="noop"/>
+                <userTask id="review"/>
+                <endEvent id="end"/>
+                <sequenceFlow id="f1" sourceRef="start" targetRef="charge"/>
+                <sequenceFlow id="f2" sourceRef="charge" targetRef="notify"/>
+                <sequenceFlow id="f3" sourceRef="notify" targetRef="noop"/>
+                <sequenceFlow id="f4" sourceRef="noop" targetRef="review"/>
+                <sequenceFlow id="f5" sourceRef="review" targetRef="end"/>
+            </process>
+        </definitions>)";
+
+    BpmnParser parser;
+    std::shared_ptr<const Process> parsed = parser.parseFromString(bpmnXml);
+    const auto* charge = static_cast<const services::ServiceTask*>(parsed->getElement("charge"));
+    EXPECT_EQ(charge->class_name, "org.example.Charge");
+    EXPECT_EQ(static_cast<const services::ServiceTask*>(parsed->getElement("notify"))->topic, "notify");
+
+    std::string instanceId = executor->startProcess(parsed, "{}", [](auto) { return true; });
+    waitForIdle(*executor);
+
+    const StateStore::ProcessInstance saved = store.loadProcessInstance(instanceId);
+    EXPECT_EQ(saved.current_element, "review");
+    EXPECT_EQ(saved.variables.count("charge"), 1u);
+    EXPECT_EQ(saved.variables.count("notify"), 1u);
+    EXPECT_EQ(saved.variables.count("noop"), 0u);
+    EXPECT_TRUE(store.getErrors(instanceId).empty());
+}
+
+TEST_F(TestExecutor, ExclusiveGatewayFollowsConditions) {
+    auto routed = std::make_unique<Process>("routed", "Routed");
+    routed->addElement(std::make_shared<StartEvent>("start", "Start"));
+    auto gateway = std::make_shared<ExclusiveGateway>("gateway", "Gateway");
+    gateway->default_flow = "to_low";
+    routed->addElement(gateway);
+    routed->addElement(std::make_shared<EndEvent>("high", "High"));
+    routed->addElement(std::make_shared<EndEvent>("low", "Low"));
+    routed->addSequenceFlow("to_gateway", "", "start", "gateway");
+    // The default flow comes first but is only a fallback
+    routed->addSequenceFlow("to_low", "", "gateway", "low");
+    routed->addSequenceFlow("to_high", "", "gateway", "high", "${init_data == 'high'}");
+    routed->setStartEventId("start");
+
+    std::string highId = executor->startProcess(*routed, "high", [](auto) { return true; });
+    EXPECT_EQ(executor->getExecutionState(highId).current_element, "high");
+
+    std::string lowId = executor->startProcess(*routed, "other", [](auto) { return true; });
+    EXPECT_EQ(executor->getExecutionState(lowId).current_element, "low");
+}
+
+TEST_F(TestExecutor, TimerCatchEventWaitsForTimer) {
+    auto delayed = std::make_unique<Process>("delayed", "Delayed");
+    delayed->addElement(std::make_shared<StartEvent>("start", "Start"));
+    auto wait = std::make_shared<TimerCatchEvent>("wait", "Wait");
+    wait->timer = TimerDefinition::parse(TimerDefinition::Type::Duration, "PT1H");
+    delayed->addElement(wait);
+    delayed->addElement(std::make_shared<EndEvent>("end", "End"));
+    delayed->addSequenceFlow("flow1", "", "start", "wait");
+    delayed->addSequenceFlow("flow2", "", "wait", "end");
+    delayed->setStartEventId("start");
+
+    // Timer waits are not reported as user tasks
+    bool called = false;
+    std::string instanceId = executor->startProcess(*delayed, "{}", [&called](auto) { called = true; return true; });
+    EXPECT_FALSE(called);
+    EXPECT_EQ(executor->getExecutionState(instanceId).current_element, "wait");
+    EXPECT_EQ(executor->getPendingTimers(), 1u);
+}
+
+TEST_F(TestExecutor, WaitStatesInsideParallelBranchesAreRejected) {
+    // start -> fork -> (timer | review) -> join -> end
+    auto forked = std::make_shared<Process>("forked", "Forked");
+    forked->addElement(std::make_shared<StartEvent>("start", "Start"));
+    forked->addElement(std::make_shared<ParallelGateway>("fork", "Fork"));
+    auto wait = std::make_shared<TimerCatchEvent>("wait", "Wait");
+    wait->timer = TimerDefinition::parse(TimerDefinition::Type::Duration, "PT0.01S");
+    forked->addElement(wait);
+    forked->addElement(std::make_shared<UserTask>("review", "Review"));
+    forked->addElement(std::make_shared<ParallelGateway>("join", "Join"));
+    forked->addElement(std::make_shared<EndEvent>("end", "End"));
+    forked->addSequenceFlow("flow1", "", "start", "fork");
+    forked->addSequenceFlow("flow2", "", "fork", "wait");
+    forked->addSequenceFlow("flow3", "", "fork", "review");
+    forked->addSequenceFlow("flow4", "", "wait", "join");
+    forked->addSequenceFlow("flow5", "", "review", "join");
+    forked->addSequenceFlow("flow6", "", "join", "end");
+    forked->setStartEventId("start");
+
+    // The review token would overwrite the one position the timer resumes from
+    EXPECT_THROW(executor->addProcessDefinition(forked), std::runtime_error);
+    EXPECT_THROW(executor->startProcess(forked, "{}", nullptr), std::runtime_error);
+    EXPECT_THROW(executor->startProcesses(forked, { "{}" }), std::runtime_error);
+    EXPECT_EQ(executor->getPendingTimers(), 0u);
+}
+
+TEST_F(TestExecutor, BoundaryTimerAndCompletionMoveTheTokenOnce) {
+    // approve -> archive, or after a short boundary timer -> escalate
+    auto guarded = std::make_shared<Process>("guarded", "Guarded");
+    guarded->addElement(std::make_shared<StartEvent>("start", "Start"));
+    guarded->addElement(std::make_shared<UserTask>("approve", "Approve"));
+    auto timeout = std::make_shared<BoundaryEvent>("timeout", "Timeout");
+    timeout->attached_to_ref = "approve";
+    timeout->timer = TimerDefinition::parse(TimerDefinition::Type::Duration, "PT0.02S");
+    guarded->addElement(timeout);
+    guarded->addElement(std::make_shared<UserTask>("archive", "Archive"));
+    guarded->addElement(std::make_shared<UserTask>("escalate", "Escalate"));
+    guarded->addSequenceFlow("flow1", "", "start", "approve");
+    guarded->addSequenceFlow("flow2", "", "approve", "archive");
+    guarded->addSequenceFlow("flow3", "", "timeout", "escalate");
+    guarded->setStartEventId("start");
+    executor->addProcessDefinition(guarded);
+
+    std::vector<std::string> instances;
+    for (int i = 0; i < 64; ++i) {
+        instances.push_back(executor->startProcessById("guarded", "{}", [](auto) { return true; }));
+    }
+    // Completions are spread over the span in which the timers fire
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    std::set<std::string> completed;
+    for (const std::string& id : instances) {
+        if (executor->completeTask(id, "approve", "approved")) {
+            completed.insert(id);
+        }
+        std::this_thread::sleep_for(std::chrono::microseconds(500));
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    waitForIdle(*executor);
+
+    // Exactly one of the two moved each token: approve plus archive or escalate
+    for (const std::string& id : instances) {
+        const auto tasks = store.getUserTasks(id);
+        ASSERT_EQ(tasks.size(), 2u) << id;
+        EXPECT_EQ(tasks[1].task_id, completed.count(id) ? "archive" : "escalate") << id;
+        EXPECT_EQ(store.loadProcessInstance(id).current_element, tasks[1].task_id) << id;
+        EXPECT_TRUE(store.getErrors(id).empty()) << id;
+    }
+}
+
+TEST_F(TestExecutor, CorrelatedMessageResumesOnlyAWaitingToken) {
+    // start -> paid (message, keyed by init_data) -> ship
+    auto payment = std::make_shared<Process>("payment", "Payment");
+    payment->addElement(std::make_shared<StartEvent>("start", "Start"));
+    auto paid = std::make_shared<MessageCatchEvent>("paid", "Paid");
+    paid->message_name = "payment";
+    paid->correlation_variable = "init_data";
+    payment->addElement(paid);
+    payment->addElement(std::make_shared<UserTask>("ship", "Ship"));
+    payment->addSequenceFlow("flow1", "", "start", "paid");
+    payment->addSequenceFlow("flow2", "", "paid", "ship");
+    payment->setStartEventId("start");
+    executor->addProcessDefinition(payment);
+
+    const std::string first = executor->startProcessById("payment", "order-7", nullptr);
+    const std::string second = executor->startProcessById("payment", "order-8", nullptr);
+    EXPECT_EQ(executor->getWaitingMessages(), 2u);
+    EXPECT_EQ(executor->correlateMessage("payment", "order-9", "{}", nullptr), "");
+
+    std::string reportedTask;
+    EXPECT_EQ(executor->correlateMessage("payment", "order-7", "{\"amount\":5}",
+        [&reportedTask](const std::string& task) { reportedTask = task; return true; }), first);
+    EXPECT_EQ(reportedTask, "ship");
+    const auto resumed = store.loadProcessInstance(first);
+    EXPECT_EQ(resumed.current_element, "ship");
+    EXPECT_EQ(resumed.variables.at("payment"), "{\"amount\":5}");
+    EXPECT_EQ(resumed.variables.at("amount"), "5");
+    EXPECT_EQ(executor->getWaitingMessages(), 1u);
+    EXPECT_EQ(executor->correlateMessage("payment", "order-7", "{}", nullptr), "");
+
+    // A token that is not where its subscription says keeps the subscription
+    // and does not consume the message
+    const auto waiting = store.loadProcessInstance(second);
+    store.saveProcessInstance(second, waiting.process_id, "ship", waiting.variables);
+    EXPECT_EQ(executor->correlateMessage("payment", "order-8", "{}", nullptr), "");
+    EXPECT_FALSE(executor->deliverMessage(second, "payment", "{}", nullptr));
+    EXPECT_EQ(executor->getWaitingMessages(), 1u);
+
+    store.saveProcessInstance(second, waiting.process_id, "paid", waiting.variables);
+    EXPECT_TRUE(executor->deliverMessage(second, "payment", "{}", nullptr));
+    EXPECT_EQ(store.loadProcessInstance(second).current_element, "ship");
+    EXPECT_EQ(executor->getWaitingMessages(), 0u);
+}
+
+TEST_F(TestExecutor, JsonPayloadFieldsBecomeVariables) {
+    auto approval = std::make_shared<Process>("approval", "Approval");
+    approval->addElement(std::make_shared<StartEvent>("start", "Start"));
+    approval->addElement(std::make_shared<UserTask>("approve", "Approve"));
+    approval->addElement(std::make_shared<UserTask>("ship", "Ship"));
+    approval->addElement(std::make_shared<EndEvent>("end", "End"));
+    approval->addSequenceFlow("flow1", "", "start", "approve");
+    approval->addSequenceFlow("flow2", "", "approve", "ship");
+    approval->addSequenceFlow("flow3", "", "ship", "end");
+    approval->setStartEventId("start");
+    executor->addProcessDefinition(approval);
+
+    const std::string init = R"({"amount": 1500, "customer": {"name": "Ann"}, "note": null})";
+    const std::string instanceId = executor->startProcessById("approval", init, nullptr);
+    nlohmann::json state = executor->getProcessState(instanceId);
+    EXPECT_EQ(state["current_element"], "approve");
+    EXPECT_EQ(state["variables"]["amount"], 1500);
+    // Stores keep nested objects as their JSON text
+    EXPECT_EQ(state["variables"]["customer"], R"({"name":"Ann"})");
+    EXPECT_EQ(state["variables"]["init_data"], init);
+    EXPECT_FALSE(state["variables"].contains("note"));
+
+    // Text that is not a JSON object is only kept raw
+    executor->resumeProcess(instanceId, R"({"approved": true})", nullptr);
+    state = executor->getProcessState(instanceId);
+    EXPECT_EQ(state["current_element"], "ship");
+    EXPECT_EQ(state["variables"]["approved"], true);
+    executor->resumeProcess(instanceId, "[1, 2]", nullptr);
+    EXPECT_FALSE(store.containsProcessInstance(instanceId));
+}
+
+TEST_F(TestExecutor, StartProcessesRunsEveryInstance) {
+    std::shared_ptr<const Process> chain = makeGatewayChain(10);
+    std::vector<std::string> initData(1000);
+    for (std::size_t i = 0; i < initData.size(); ++i) {
+        initData[i] = "{\"n\":" + std::to_string(i) + "}";
+    }
+
+    const std::vector<StartResult> results = executor->startProcesses(chain, initData);
+    ASSERT_EQ(results.size(), initData.size());
+
+    std::set<std::string> ids;
+    for (const StartResult& result : results) {
+        EXPECT_EQ(result.status, StartResult::Status::Completed) << result.error;
+        ids.insert(result.instance_id);
+    }
+    EXPECT_EQ(ids.size(), results.size());
+}
+
+TEST_F(TestExecutor, StartProcessesReportsWaitingInstances) {
+    process->setStartEventId("start");
+    std::shared_ptr<const Process> shared(std::move(process));
+
+    const std::vector<StartResult> results = executor->startProcesses(shared, { "{}", "{}", "{}" });
+    ASSERT_EQ(results.size(), 3u);
+    for (const StartResult& result : results) {
+        EXPECT_EQ(result.status, StartResult::Status::Waiting);
+        EXPECT_EQ(result.current_element, "user_task");
+    }
+    EXPECT_TRUE(executor->startProcesses(shared, {}).empty());
+}
+
+namespace {
+    // Counts timer and subscription rows written before their instance row
+    class OrderCheckingStore : public InMemoryStateStore {
+    public:
+        void saveTimer(const TimerRecord& timer) override {
+            ++timers;
+            orphans += containsProcessInstance(timer.instance_id) ? 0 : 1;
+        }
+        void saveMessageSubscription(const MessageSubscriptionRecord& subscription) override {
+            ++subscriptions;
+            orphans += containsProcessInstance(subscription.instance_id) ? 0 : 1;
+        }
+
+        std::atomic<int> timers{ 0 };
+        std::atomic<int> subscriptions{ 0 };
+        std::atomic<int> orphans{ 0 };
+    };
+}
+
+TEST_F(TestExecutor, StartProcessesArmsWaitsAfterTheBatchIsStored) {
+    // start -> wait (timer) -> paid (message, keyed by init_data) -> end
+    auto delayed = std::make_shared<Process>("delayed", "Delayed");
+    delayed->addElement(std::make_shared<StartEvent>("start", "Start"));
+    auto wait = std::make_shared<TimerCatchEvent>("wait", "Wait");
+    wait->timer = TimerDefinition::parse(TimerDefinition::Type::Duration, "PT1H");
+    delayed->addElement(wait);
+    delayed->addElement(std::make_shared<EndEvent>("end", "End"));
+    delayed->addSequenceFlow("flow1", "", "start", "wait");
+    delayed->addSequenceFlow("flow2", "", "wait", "end");
+    delayed->setStartEventId("start");
+
+    auto payment = std::make_shared<Process>("payment", "Payment");
+    payment->addElement(std::make_shared<StartEvent>("start", "Start"));
+    auto paid = std::make_shared<MessageCatchEvent>("paid", "Paid");
+    paid->message_name = "payment";
+    paid->correlation_variable = "init_data";
+    payment->addElement(paid);
+    payment->addElement(std::make_shared<EndEvent>("end", "End"));
+    payment->addSequenceFlow("flow1", "", "start", "paid");
+    payment->addSequenceFlow("flow2", "", "paid", "end");
+    payment->setStartEventId("start");
+
+    OrderCheckingStore checked;
+    ProcessExecutor batched(checked);
+    batched.addProcessDefinition(delayed);
+    batched.addProcessDefinition(payment);
+    std::vector<std::string> keys(200);
+    for (std::size_t i = 0; i < keys.size(); ++i) {
+        keys[i] = "order-" + std::to_string(i);
+    }
+    const std::vector<StartResult> timed = batched.startProcesses(delayed, keys);
+    const std::vector<StartResult> paying = batched.startProcesses(payment, keys);
+
+    EXPECT_EQ(checked.timers, 200);
+    EXPECT_EQ(checked.subscriptions, 200);
+    EXPECT_EQ(checked.orphans, 0);
+    EXPECT_EQ(batched.getPendingTimers(), 200u);
+    EXPECT_EQ(batched.getWaitingMessages(), 200u);
+    EXPECT_EQ(batched.correlateMessage("payment", "order-42", "{}", nullptr), paying[42].instance_id);
+    EXPECT_EQ(timed[7].status, StartResult::Status::Waiting);
+    EXPECT_EQ(timed[7].current_element, "wait");
+}
@@ -0,0 +1,44 @@
+#include <gtest/gtest.h>
+#include <bpmn/engine.h>
+#include <nlohmann/json.hpp>
+#include <stdexcept>
+#include <string>
+
+using namespace bpmn;
+
+namespace {
+
+    const char* const kApprovalXml = R"(<?xml version="1.0" encoding="UTF-8"?>
+        <definitions xmlns="http://www.omg.org/spec/BPMN/20100524/MODEL">
+            <process id="approval" name="Approval">
+                <startEvent id="start"/>
+                <userTask id="approve"/>
+                <endEvent id="end"/>
+                <sequenceFlow id="f1" sourceRef="start" targetRef="approve"/>
+                <sequenceFlow id="f2" sourceRef="approve" targetRef="end"/>
+            </process>
+        </definitions>)";
+
+}
+
+TEST(TestInMemoryEngine, InstancesStartedInBatchesAreFoundByTheExecutor) {
+    std::unique_ptr<BpmnEngine> engine = BpmnEngine::createInMemory(2);
+    engine->deployProcess(kApprovalXml);
+
+    const std::vector<StartResult> results = engine->startProcesses("approval", { "{}", "{}" });
+    ASSERT_EQ(results.size(), 2u);
+    const std::string& instanceId = results[0].instance_id;
+
+    EXPECT_TRUE(engine->isProcessActive(instanceId));
+    const nlohmann::json state = nlohmann::json::parse(engine->getProcessState(instanceId));
+    EXPECT_EQ(state["current_element"], "approve");
+    EXPECT_NO_THROW(engine->getActiveTasks(instanceId));
+
+    engine->completeTask(instanceId, "approve", R"({"approved": true})");
+    EXPECT_FALSE(engine->isProcessActive(instanceId));
+    EXPECT_TRUE(engine->isProcessActive(results[1].instance_id));
+
+    EXPECT_THROW(engine->completeTask(instanceId, "approve"), std::runtime_error);
+    EXPECT_THROW(engine->getProcessState("missing"), std::runtime_error);
+    EXPECT_FALSE(engine->isProcessActive("missing"));
+}
@@ -0,0 +1,91 @@
+#include <gtest/gtest.h>
+#include <bpmn/executor.h>
+#include <bpmn/in_memory_state_store.h>
+#include <bpmn/model.h>
+#include <memory>
+#include <stdexcept>
+#include <string>
+
+using namespace bpmn;
+
+namespace {
+
+    std::shared_ptr<const Process> makeApproval(const std::string& id) {
+        auto process = std::make_shared<Process>(id, "Approval");
+        process->addElement(std::make_shared<StartEvent>("start", "Start"));
+        process->addElement(std::make_shared<UserTask>("approve", "Approve"));
+        process->addElement(std::make_shared<EndEvent>("end", "End"));
+        process->addSequenceFlow("flow1", "", "start", "approve");
+        process->addSequenceFlow("flow2", "", "approve", "end");
+        process->setStartEventId("start");
+        return process;
+    }
+
+} // anonymous namespace
+
+TEST(TestInMemoryStateStore, SavesLoadsAndDropsCompletedInstances) {
+    InMemoryStateStore store;
+    store.saveProcessInstance("i1", "p", "task", { { "a", "1" } });
+    store.saveProcessInstance("i1", "p", "next", { { "a", "2" } });
+    store.saveUserTask("i1", "task", "form", {});
+    store.saveError("i1", "boom");
+
+    ASSERT_TRUE(store.containsProcessInstance("i1"));
+    const StateStore::ProcessInstance loaded = store.loadProcessInstance("i1");
+    EXPECT_EQ(loaded.process_id, "p");
+    EXPECT_EQ(loaded.current_element, "next");
+    EXPECT_EQ(loaded.variables.at("a"), "2");
+    EXPECT_EQ(store.getUserTasks("i1").size(), 1u);
+    EXPECT_EQ(store.getErrors("i1").size(), 1u);
+
+    store.completeProcessInstance("i1");
+    EXPECT_FALSE(store.containsProcessInstance("i1"));
+    EXPECT_EQ(store.size(), 0u);
+    EXPECT_THROW(store.loadProcessInstance("i1"), std::runtime_error);
+
+    InMemoryStateStore keeping(true, 4);
+    keeping.saveProcessInstance("i2", "p", "end", {});
+    keeping.completeProcessInstance("i2");
+    EXPECT_TRUE(keeping.isCompleted("i2"));
+    EXPECT_FALSE(keeping.containsProcessInstance("i2"));
+    EXPECT_EQ(keeping.size(), 1u);
+}
+
+TEST(TestInMemoryStateStore, ExecutorRunsWithoutDatabase) {
+    InMemoryStateStore store;
+    ProcessExecutor executor(store);
+    executor.addProcessDefinition(makeApproval("approval"));
+
+    std::string pausedAt;
+    const std::string instanceId = executor.startProcessById("approval", "{}", [&pausedAt](const std::string& taskId) {
+        pausedAt = taskId;
+        return true;
+    });
+    EXPECT_EQ(pausedAt, "approve");
+    ASSERT_TRUE(store.containsProcessInstance(instanceId));
+    EXPECT_EQ(store.loadProcessInstance(instanceId).current_element, "approve");
+    EXPECT_EQ(store.getUserTasks(instanceId).size(), 1u);
+
+    executor.resumeProcess(instanceId, "approved", nullptr);
+    EXPECT_FALSE(store.containsProcessInstance(instanceId));
+}
+
+TEST(TestInMemoryStateStore, StoreIsSelectablePerDefinition) {
+    InMemoryStateStore durable;
+    InMemoryStateStore ephemeral;
+    ProcessExecutor executor(durable);
+    executor.setStateStore("fast", ephemeral);
+    executor.addProcessDefinition(makeApproval("slow"));
+    executor.addProcessDefinition(makeApproval("fast"));
+
+    const std::string slowId = executor.startProcessById("slow", "{}", nullptr);
+    const std::string fastId = executor.startProcessById("fast", "{}", nullptr);
+    EXPECT_TRUE(durable.containsProcessInstance(slowId));
+    EXPECT_FALSE(durable.containsProcessInstance(fastId));
+    EXPECT_TRUE(ephemeral.containsProcessInstance(fastId));
+
+    // Resuming finds the instance in the store it was started in
+    executor.resumeProcess(fastId, "done", nullptr);
+    EXPECT_FALSE(ephemeral.containsProcessInstance(fastId));
+    EXPECT_TRUE(durable.containsProcessInstance(slowId));
+}
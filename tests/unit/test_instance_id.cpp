@@ -0,0 +1,58 @@
+#include <gtest/gtest.h>
+#include <bpmn/instance_id.h>
+#include <algorithm>
+#include <chrono>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <unordered_set>
+#include <vector>
+
+using namespace bpmn;
+
+TEST(TestInstanceId, HasUuidV7Layout) {
+    const auto before = std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+    const InstanceId id = InstanceIdGenerator::global().next();
+    const std::string text = id.toString();
+
+    ASSERT_EQ(text.size(), 36u);
+    EXPECT_EQ(text[8], '-');
+    EXPECT_EQ(text[23], '-');
+    EXPECT_EQ(text[14], '7');
+    EXPECT_NE(std::string("89ab").find(text[19]), std::string::npos);
+    EXPECT_GE(id.timestampMs(), static_cast<std::uint64_t>(before));
+
+    EXPECT_EQ(InstanceId::parse(text), id);
+    EXPECT_EQ(InstanceId::parse("0190A1B2-C3D4-7E5F-8A6B-7C8D9E0F1A2B").toString(), "0190a1b2-c3d4-7e5f-8a6b-7c8d9e0f1a2b");
+    InstanceId parsed;
+    EXPECT_FALSE(InstanceId::tryParse("order-42", parsed));
+    EXPECT_FALSE(InstanceId::tryParse("0190a1b2xc3d4-7e5f-8a6b-7c8d9e0f1a2b", parsed));
+    EXPECT_THROW(InstanceId::parse("0190a1b2-c3d4-7e5f-8a6b-7c8d9e0f1a2g"), std::invalid_argument);
+}
+
+TEST(TestInstanceId, IdsIncreaseAcrossThreads) {
+    InstanceIdGenerator generator;
+    constexpr int perThread = 20000;
+    std::vector<std::vector<InstanceId>> ids(4);
+    std::vector<std::thread> threads;
+    for (auto& batch : ids) {
+        threads.emplace_back([&generator, &batch]() {
+            for (int i = 0; i < perThread; ++i) {
+                batch.push_back(generator.next());
+            }
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+
+    std::unordered_set<InstanceId, InstanceId::Hash> unique;
+    for (const auto& batch : ids) {
+        // Every thread sees increasing ids, in bytes and in text
+        EXPECT_TRUE(std::is_sorted(batch.begin(), batch.end()));
+        EXPECT_LT(batch.front().toString(), batch.back().toString());
+        unique.insert(batch.begin(), batch.end());
+    }
+    EXPECT_EQ(unique.size(), 4u * perThread);
+}
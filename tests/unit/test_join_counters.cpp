@@ -0,0 +1,65 @@
+#include <gtest/gtest.h>
+#include <bpmn/join_counters.h>
+#include <bpmn/model.h>
+#include <atomic>
+#include <thread>
+#include <vector>
+
+using namespace bpmn;
+
+TEST(TestJoinCounters, LastArrivalContinues) {
+    JoinCounters joins(1);
+    EXPECT_FALSE(joins.arrive(0, 3));
+    EXPECT_FALSE(joins.arrive(0, 3));
+    EXPECT_TRUE(joins.arrive(0, 3));
+    // Starts over for the next round, e.g. a join inside a loop
+    EXPECT_EQ(joins.arrived(0), 0u);
+    EXPECT_FALSE(joins.arrive(0, 3));
+}
+
+TEST(TestJoinCounters, ConcurrentArrivalsReleaseOneTokenPerRound) {
+    constexpr std::uint32_t branches = 8;
+    constexpr int rounds = 10000;
+    JoinCounters joins(1);
+    std::atomic<int> released{ 0 };
+
+    std::vector<std::thread> threads;
+    for (std::uint32_t t = 0; t < branches; ++t) {
+        threads.emplace_back([&]() {
+            for (int i = 0; i < rounds; ++i) {
+                if (joins.arrive(0, branches)) {
+                    ++released;
+                }
+            }
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+
+    EXPECT_EQ(released.load(), rounds);
+    EXPECT_EQ(joins.arrived(0), 0u);
+}
+
+TEST(TestJoinCounters, GraphAssignsSlotsToJoinsOnly) {
+    Process process("join", "Join");
+    process.addElement(std::make_shared<StartEvent>("start", "Start"));
+    process.addElement(std::make_shared<ParallelGateway>("fork", "Fork"));
+    process.addElement(std::make_shared<UserTask>("a", "A"));
+    process.addElement(std::make_shared<UserTask>("b", "B"));
+    process.addElement(std::make_shared<ParallelGateway>("join", "Join"));
+    process.addElement(std::make_shared<EndEvent>("end", "End"));
+    process.setStartEventId("start");
+    process.addSequenceFlow("f1", "", "start", "fork");
+    process.addSequenceFlow("f2", "", "fork", "a");
+    process.addSequenceFlow("f3", "", "fork", "b");
+    process.addSequenceFlow("f4", "", "a", "join");
+    process.addSequenceFlow("f5", "", "b", "join");
+    process.addSequenceFlow("f6", "", "join", "end");
+
+    const ProcessGraph& graph = process.getGraph();
+    EXPECT_EQ(graph.joinCount(), 1u);
+    EXPECT_EQ(graph.joinSlot(graph.indexOf("fork")), ProcessGraph::npos);
+    EXPECT_EQ(graph.joinSlot(graph.indexOf("join")), 0u);
+    EXPECT_EQ(graph.incoming(graph.indexOf("join")).size(), 2u);
+}
@@ -0,0 +1,200 @@
+#include <gtest/gtest.h>
+#include <db/journal.h>
+#include <cstdint>
+#include <map>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+using namespace db;
+
+namespace {
+
+    // What loadProcessInstance rebuilds from a snapshot and the rows appended after it
+    struct Replica {
+        std::string current_element;
+        InstanceJournal::Variables variables;
+
+        void write(const JournalWrite& write, const std::string& element, const InstanceJournal::Variables& snapshot) {
+            if (write.snapshot) {
+                current_element = element;
+                variables = snapshot;
+                return;
+            }
+            for (const JournalRecord& record : write.records) {
+                InstanceJournal::apply(record, current_element, variables);
+            }
+        }
+    };
+
+} // anonymous namespace
+
+TEST(TestJournal, AppendsOnlyTransitionsAndChangedVariables) {
+    InstanceJournal journal(64);
+    Replica replica;
+
+    InstanceJournal::Variables variables{ { "amount", "100" }, { "status", "new" } };
+    JournalWrite write = journal.plan("i1", "start", variables);
+    EXPECT_TRUE(write.fresh);
+    EXPECT_TRUE(write.snapshot);
+    EXPECT_EQ(write.snapshot_seq, 0);
+    replica.write(write, "start", variables);
+
+    // Nothing changed, nothing to write
+    EXPECT_TRUE(journal.plan("i1", "start", variables).empty());
+
+    variables["status"] = "checked";
+    variables.erase("amount");
+    variables["owner"] = "ann";
+    write = journal.plan("i1", "review", variables);
+    EXPECT_FALSE(write.snapshot);
+    ASSERT_EQ(write.records.size(), 4u);
+    EXPECT_EQ(write.records[0].kind, JournalRecord::Kind::Element);
+    EXPECT_EQ(write.records[0].value, "review");
+    EXPECT_EQ(write.records[1].kind, JournalRecord::Kind::Erase);
+    EXPECT_EQ(write.records[1].name, "amount");
+    EXPECT_EQ(write.records[2].kind, JournalRecord::Kind::Set);
+    EXPECT_EQ(write.records[2].name, "owner");
+    EXPECT_EQ(write.records[3].name, "status");
+    EXPECT_EQ(write.records[0].seq, 1);
+    EXPECT_EQ(write.records[3].seq, 4);
+    replica.write(write, "review", variables);
+
+    EXPECT_EQ(replica.current_element, "review");
+    EXPECT_EQ(replica.variables, variables);
+}
+
+TEST(TestJournal, SnapshotReplacesTheJournalEveryInterval) {
+    InstanceJournal journal(3);
+    InstanceJournal::Variables variables;
+    journal.plan("i1", "start", variables);
+
+    variables["a"] = "1";
+    JournalWrite write = journal.plan("i1", "start", variables);
+    EXPECT_EQ(write.records.size(), 1u);
+    variables["b"] = "2";
+    write = journal.plan("i1", "start", variables);
+    EXPECT_EQ(write.records.size(), 1u);
+
+    // The third record since the snapshot triggers the next one
+    variables["c"] = "3";
+    write = journal.plan("i1", "start", variables);
+    EXPECT_TRUE(write.snapshot);
+    EXPECT_FALSE(write.fresh);
+    EXPECT_TRUE(write.records.empty());
+    EXPECT_EQ(write.snapshot_seq, 2);
+
+    // Records continue after the snapshot's seq
+    variables["d"] = "4";
+    write = journal.plan("i1", "start", variables);
+    ASSERT_EQ(write.records.size(), 1u);
+    EXPECT_EQ(write.records[0].seq, 3);
+}
+
+TEST(TestJournal, UnknownInstancesStartWithASnapshot) {
+    InstanceJournal journal(64, 2);
+    const InstanceJournal::Variables variables{ { "a", "1" } };
+    journal.plan("i1", "start", variables);
+    journal.plan("i2", "start", variables);
+    // Evicts one of the others
+    journal.plan("i3", "start", variables);
+    EXPECT_EQ(journal.size(), 2u);
+
+    journal.forget("i3");
+    EXPECT_TRUE(journal.plan("i3", "start", variables).fresh);
+
+    // A restored head continues its journal
+    journal.restore("i4", 7, 2, "task", variables);
+    const JournalWrite write = journal.plan("i4", "end", variables);
+    ASSERT_EQ(write.records.size(), 1u);
+    EXPECT_EQ(write.records[0].seq, 8);
+}
+
+TEST(TestJournal, EvictsTheLeastRecentlyUsedInstance) {
+    InstanceJournal journal(64, 3);
+    InstanceJournal::Variables variables{ { "a", "1" } };
+    journal.plan("i1", "start", variables);
+    journal.plan("i2", "start", variables);
+    journal.restore("i3", 0, 0, "start", variables);
+
+    // i1 is used again, so i2 is now the oldest
+    variables["a"] = "2";
+    EXPECT_FALSE(journal.plan("i1", "start", variables).fresh);
+    journal.plan("i4", "start", variables);
+    EXPECT_EQ(journal.size(), 3u);
+
+    EXPECT_FALSE(journal.plan("i1", "start", variables).fresh);
+    EXPECT_FALSE(journal.plan("i3", "start", variables).fresh);
+    EXPECT_FALSE(journal.plan("i4", "start", variables).fresh);
+    EXPECT_TRUE(journal.plan("i2", "start", variables).fresh);
+
+    // Forgetting leaves room without evicting anything else
+    journal.forget("i2");
+    journal.forget("i1");
+    journal.plan("i5", "start", variables);
+    EXPECT_EQ(journal.size(), 3u);
+    EXPECT_FALSE(journal.plan("i3", "start", variables).fresh);
+}
+
+TEST(TestJournal, SnapshotAfterEvictionReplacesTheWholeJournal) {
+    InstanceJournal journal(64, 1);
+    // process_journal rows of i1 by seq, as the primary key keeps them
+    std::map<std::int64_t, JournalRecord> rows;
+    const auto store = [&rows](const JournalWrite& write) {
+        if (write.snapshot) {
+            for (auto it = rows.begin(); it != rows.end() && it->first <= write.coveredSeq();) {
+                it = rows.erase(it);
+            }
+        }
+        for (const JournalRecord& record : write.records) {
+            ASSERT_TRUE(rows.emplace(record.seq, record).second) << "duplicate seq " << record.seq;
+        }
+    };
+
+    InstanceJournal::Variables variables{ { "a", "1" } };
+    store(journal.plan("i1", "start", variables));
+    variables["a"] = "2";
+    store(journal.plan("i1", "task", variables));
+    EXPECT_EQ(rows.size(), 2u);
+
+    // i2 evicts i1, whose next write is a snapshot at seq 0
+    journal.plan("i2", "start", variables);
+    variables["a"] = "3";
+    const JournalWrite snapshot = journal.plan("i1", "task", variables);
+    EXPECT_TRUE(snapshot.fresh);
+    EXPECT_EQ(snapshot.snapshot_seq, 0);
+    store(snapshot);
+    EXPECT_TRUE(rows.empty());
+
+    // Appends start over at seq 1 without old rows in the way
+    variables["a"] = "4";
+    store(journal.plan("i1", "end", variables));
+    ASSERT_EQ(rows.size(), 2u);
+    EXPECT_EQ(rows.begin()->first, 1);
+
+    // A regular snapshot keeps the rows after its seq
+    JournalWrite regular;
+    regular.snapshot = true;
+    regular.snapshot_seq = 1;
+    EXPECT_EQ(regular.coveredSeq(), 1);
+}
+
+TEST(TestJournal, BatchesLockEachStripeOnce) {
+    InstanceJournal journal;
+    std::vector<std::string> ids;
+    for (int i = 0; i < 500; ++i) {
+        ids.push_back("i" + std::to_string(i % 250));
+    }
+    // Duplicates and shared stripes would deadlock if locked twice
+    auto locks = journal.lockInstances(ids);
+    EXPECT_FALSE(locks.empty());
+    EXPECT_LE(locks.size(), 250u);
+    locks.clear();
+    EXPECT_TRUE(journal.lockInstance("i1").owns_lock());
+}
+
+TEST(TestJournal, SnapshotsRoundTripThroughJson) {
+    const InstanceJournal::Variables variables{ { "quote", "say \"hi\"" }, { "json", "{\"a\":1}" }, { "empty", "" } };
+    EXPECT_EQ(InstanceJournal::decodeSnapshot(InstanceJournal::encodeSnapshot(variables)), variables);
+    EXPECT_THROW(InstanceJournal::decodeSnapshot("[1]"), std::runtime_error);
+}
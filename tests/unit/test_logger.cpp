@@ -0,0 +1,86 @@
+#include <gtest/gtest.h>
+#include <bpmn/logger.h>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace bpmn;
+
+namespace {
+
+    // Collects what the sink thread writes
+    struct Capture {
+        std::mutex mutex;
+        std::string text;
+
+        Logger::Sink sink() {
+            return [this](const std::string& batch) {
+                std::lock_guard<std::mutex> lock(mutex);
+                text += batch;
+            };
+        }
+
+        std::string get() {
+            std::lock_guard<std::mutex> lock(mutex);
+            return text;
+        }
+    };
+
+} // anonymous namespace
+
+TEST(TestLogger, WritesStructuredFields) {
+    Capture capture;
+    Logger logger(capture.sink());
+    logger.log<LogLevel::Info>("Process instance started", { "instance-1", "start", 1500 });
+    logger.log<LogLevel::Error>("Process instance failed", { "instance-1", "task" }, "said \"no\"");
+    logger.flush();
+
+    const std::string text = capture.get();
+    EXPECT_NE(text.find("level=info msg=\"Process instance started\" instance_id=instance-1 element_id=start elapsed_ns=1500\n"),
+        std::string::npos);
+    EXPECT_NE(text.find("level=error msg=\"Process instance failed\" instance_id=instance-1 element_id=task detail=\"said \\\"no\\\"\"\n"),
+        std::string::npos);
+    EXPECT_EQ(logger.written(), 2u);
+    EXPECT_EQ(logger.dropped(), 0u);
+}
+
+TEST(TestLogger, FiltersLevelsAtRunTimeAndCompileTime) {
+    Capture capture;
+    Logger logger(capture.sink(), LogLevel::Warn);
+    logger.log<LogLevel::Info>("hidden");
+    logger.log<LogLevel::Warn>("shown");
+    logger.setLevel(LogLevel::Trace);
+    // Trace is compiled out unless BPMN_LOG_COMPILED_LEVEL is 0
+    logger.log<LogLevel::Trace>("trace");
+    logger.log<LogLevel::Debug>("debug");
+    logger.flush();
+
+    const std::string text = capture.get();
+    EXPECT_EQ(text.find("hidden"), std::string::npos);
+    EXPECT_NE(text.find("shown"), std::string::npos);
+    EXPECT_EQ(text.find("trace") != std::string::npos, Logger::compiledIn(LogLevel::Trace));
+    EXPECT_NE(text.find("debug"), std::string::npos);
+}
+
+TEST(TestLogger, CountsRecordsDroppedByFullRings) {
+    Capture capture;
+    Logger logger(capture.sink(), LogLevel::Info, 4);
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; ++t) {
+        threads.emplace_back([&logger]() {
+            for (int i = 0; i < 10000; ++i) {
+                logger.log<LogLevel::Info>("tick");
+            }
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    logger.flush();
+
+    // Nothing is lost silently
+    EXPECT_EQ(logger.written() + logger.dropped(), 40000u);
+    EXPECT_GT(logger.dropped(), 0u);
+    EXPECT_NE(capture.get().find("Log records dropped"), std::string::npos);
+}
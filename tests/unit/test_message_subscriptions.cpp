@@ -0,0 +1,115 @@
+#include <gtest/gtest.h>
+#include <bpmn/message_subscriptions.h>
+#include <bpmn/parser.h>
+#include <set>
+#include <string>
+#include <vector>
+
+using namespace bpmn;
+
+namespace {
+
+    MessageSubscriptions::Subscription subscription(const std::string& instance, const std::string& element,
+        const std::string& message, const std::string& key) {
+        MessageSubscriptions::Subscription result;
+        result.instance_id = instance;
+        result.element_id = element;
+        result.message_name = message;
+        result.correlation_key = key;
+        return result;
+    }
+
+} // anonymous namespace
+
+TEST(TestMessageSubscriptions, CorrelatesByNameAndKey) {
+    MessageSubscriptions subscriptions;
+    for (int i = 0; i < 1000; ++i) {
+        subscriptions.add(subscription("instance" + std::to_string(i), "wait", "orderPaid", "order" + std::to_string(i)));
+    }
+    EXPECT_EQ(subscriptions.size(), 1000u);
+
+    MessageSubscriptions::Subscription taken;
+    ASSERT_TRUE(subscriptions.takeOne("orderPaid", "order42", taken));
+    EXPECT_EQ(taken.instance_id, "instance42");
+    EXPECT_EQ(taken.element_id, "wait");
+
+    // Each token is delivered once
+    EXPECT_FALSE(subscriptions.takeOne("orderPaid", "order42", taken));
+    EXPECT_FALSE(subscriptions.takeOne("orderShipped", "order1", taken));
+    EXPECT_EQ(subscriptions.size(), 999u);
+
+    ASSERT_TRUE(subscriptions.takeForInstance("instance7", "orderPaid", taken));
+    EXPECT_EQ(taken.correlation_key, "order7");
+    EXPECT_FALSE(subscriptions.takeOne("orderPaid", "order7", taken));
+    EXPECT_EQ(subscriptions.size(), 998u);
+
+    // Finding leaves the token subscribed until it is removed, once
+    const auto found = subscriptions.find("orderPaid", "order9");
+    ASSERT_EQ(found.size(), 1u);
+    ASSERT_TRUE(subscriptions.findForInstance("instance9", "orderPaid", taken));
+    EXPECT_EQ(subscriptions.size(), 998u);
+    EXPECT_TRUE(subscriptions.remove(found[0]));
+    EXPECT_FALSE(subscriptions.remove(found[0]));
+    EXPECT_TRUE(subscriptions.find("orderPaid", "order9").empty());
+    EXPECT_EQ(subscriptions.size(), 997u);
+}
+
+TEST(TestMessageSubscriptions, SignalsTakeEveryWaitingToken) {
+    MessageSubscriptions subscriptions;
+    subscriptions.add(subscription("a", "wait", "shutdown", ""));
+    subscriptions.add(subscription("b", "wait", "shutdown", ""));
+    subscriptions.add(subscription("b", "other", "orderPaid", "1"));
+    // Subscribing the same token again replaces it
+    subscriptions.add(subscription("c", "wait", "orderPaid", "2"));
+    subscriptions.add(subscription("c", "wait", "shutdown", ""));
+    EXPECT_EQ(subscriptions.size(), 4u);
+
+    std::set<std::string> instances;
+    for (const auto& taken : subscriptions.takeAll("shutdown", "")) {
+        instances.insert(taken.instance_id);
+    }
+    EXPECT_EQ(instances, std::set<std::string>({ "a", "b", "c" }));
+    EXPECT_EQ(subscriptions.size(), 1u);
+
+    MessageSubscriptions::Subscription taken;
+    EXPECT_FALSE(subscriptions.takeOne("orderPaid", "2", taken));
+    EXPECT_EQ(subscriptions.removeInstance("b"), 1u);
+    EXPECT_EQ(subscriptions.size(), 0u);
+}
+
+TEST(TestMessageSubscriptions, ParserResolvesMessageRefs) {
+    const std::string bpmnXml = R"(<?xml version="1.0" encoding="UTF-8"?>
+        <definitions xmlns="http://www.omg.org/spec/BPMN/20100524/MODEL">
+            <message id="msg1" name="orderPaid"/>
+            <process id="messages">
+                <startEvent id="start"/>
+                <intermediateCatchEvent id="paid" correlationKey="order_id">
+                    <messageEventDefinition messageRef="msg1"/>
+                </intermediateCatchEvent>
+                <intermediateCatchEvent id="stop">
+                    <signalEventDefinition signalRef="sig1"/>
+                </intermediateCatchEvent>
+                <endEvent id="end"/>
+                <sequenceFlow id="flow1" sourceRef="start" targetRef="paid"/>
+                <sequenceFlow id="flow2" sourceRef="paid" targetRef="stop"/>
+                <sequenceFlow id="flow3" sourceRef="stop" targetRef="end"/>
+            </process>
+            <signal id="sig1" name="shutdown"/>
+        </definitions>)";
+
+    BpmnParser parser;
+    auto process = parser.parseFromString(bpmnXml);
+
+    auto* paid = dynamic_cast<MessageCatchEvent*>(process->getElement("paid"));
+    ASSERT_TRUE(paid);
+    EXPECT_EQ(paid->message_name, "orderPaid");
+    EXPECT_EQ(paid->correlation_variable, "order_id");
+    EXPECT_FALSE(paid->signal);
+
+    // Signals declared after the process are resolved as well
+    auto* stop = dynamic_cast<MessageCatchEvent*>(process->getElement("stop"));
+    ASSERT_TRUE(stop);
+    EXPECT_EQ(stop->message_name, "shutdown");
+    EXPECT_TRUE(stop->signal);
+    EXPECT_TRUE(process->getGraph().hasMessageEvents());
+}
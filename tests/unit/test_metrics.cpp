@@ -0,0 +1,113 @@
+#include <gtest/gtest.h>
+#include <bpmn/executor.h>
+#include <bpmn/in_memory_state_store.h>
+#include <bpmn/metrics.h>
+#include <bpmn/model.h>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace bpmn;
+
+TEST(TestMetrics, HistogramBucketsStayWithinRelativeError) {
+    for (std::uint64_t value : { 0ull, 1ull, 15ull, 16ull, 17ull, 31ull, 32ull, 1000ull, 123456789ull, 1ull << 43 }) {
+        const std::size_t bucket = LatencyHistogram::bucketOf(value);
+        const std::uint64_t upper = LatencyHistogram::bucketUpperBound(bucket);
+        EXPECT_LE(value, upper);
+        EXPECT_LE(upper - value, value / 16) << value;
+        if (bucket > 0) {
+            EXPECT_GT(value, LatencyHistogram::bucketUpperBound(bucket - 1));
+        }
+    }
+    EXPECT_EQ(LatencyHistogram::bucketOf(~0ull), LatencyHistogram::kBuckets - 1);
+
+    LatencyHistogram histogram;
+    for (std::uint64_t us = 1; us <= 1000; ++us) {
+        histogram.record(us * 1000);
+    }
+    const LatencyHistogram::Snapshot snapshot = histogram.snapshot();
+    EXPECT_EQ(snapshot.count, 1000u);
+    EXPECT_EQ(snapshot.sum_ns, 500500000u);
+    EXPECT_EQ(snapshot.max_ns, 1000000u);
+    EXPECT_NEAR(static_cast<double>(snapshot.percentile(0.5)), 500000.0, 500000.0 / 16);
+    EXPECT_NEAR(static_cast<double>(snapshot.percentile(0.99)), 990000.0, 990000.0 / 16);
+    EXPECT_EQ(snapshot.percentile(1.0), 1000000u);
+}
+
+TEST(TestMetrics, ConcurrentRecordingLosesNothing) {
+    Metrics metrics;
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; ++t) {
+        threads.emplace_back([&metrics, t]() {
+            for (std::uint64_t i = 0; i < 50000; ++i) {
+                metrics.element("p", t % 2 == 0 ? "even" : "odd").record(i);
+            }
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    EXPECT_EQ(metrics.element("p", "even").snapshot().count, 100000u);
+    EXPECT_EQ(metrics.element("p", "odd").snapshot().count, 100000u);
+}
+
+TEST(TestMetrics, ExecutorRecordsElementsAndInstances) {
+    auto process = std::make_shared<Process>("approval", "Approval");
+    process->addElement(std::make_shared<StartEvent>("start", "Start"));
+    process->addElement(std::make_shared<UserTask>("approve", "Approve"));
+    process->addElement(std::make_shared<EndEvent>("end", "End"));
+    process->addSequenceFlow("flow1", "", "start", "approve");
+    process->addSequenceFlow("flow2", "", "approve", "end");
+    process->setStartEventId("start");
+
+    InMemoryStateStore store;
+    Metrics metrics;
+    ProcessExecutor executor(store);
+    executor.setMetrics(metrics);
+    executor.addProcessDefinition(process);
+
+    const std::string instanceId = executor.startProcessById("approval", "{}", nullptr);
+    executor.resumeProcess(instanceId, "approved", nullptr);
+
+    const nlohmann::json snapshot = metrics.toJson();
+    EXPECT_EQ(snapshot["instances"]["started"], 1);
+    EXPECT_EQ(snapshot["instances"]["completed"], 1);
+    EXPECT_EQ(snapshot["instances"]["failed"], 0);
+    EXPECT_EQ(snapshot["active_tokens"], 0);
+    // The user task ran on start only, resuming continues after it
+    ASSERT_EQ(snapshot["elements"].size(), 3u);
+    EXPECT_EQ(snapshot["elements"][0]["element_id"], "approve");
+    EXPECT_EQ(snapshot["elements"][0]["count"], 1);
+    EXPECT_EQ(snapshot["checkpoints"]["count"], 2);
+
+    const std::string text = metrics.toPrometheus();
+    EXPECT_NE(text.find("bpmn_instances_completed_total 1\n"), std::string::npos);
+    EXPECT_NE(text.find("bpmn_element_duration_seconds_count{process_id=\"approval\",element_id=\"end\"} 1\n"), std::string::npos);
+    EXPECT_NE(text.find("# TYPE bpmn_element_duration_seconds summary\n"), std::string::npos);
+}
+
+TEST(TestMetrics, ElementHistogramsFollowSetMetrics) {
+    auto process = std::make_shared<Process>("straight", "Straight");
+    process->addElement(std::make_shared<StartEvent>("start", "Start"));
+    process->addElement(std::make_shared<EndEvent>("end", "End"));
+    process->addSequenceFlow("flow1", "", "start", "end");
+    process->setStartEventId("start");
+
+    InMemoryStateStore store;
+    Metrics first;
+    Metrics second;
+    ProcessExecutor executor(store);
+    executor.setMetrics(first);
+    executor.addProcessDefinition(process);
+
+    executor.startProcessById("straight", "{}", nullptr);
+    executor.startProcessById("straight", "{}", nullptr);
+    executor.setMetrics(second);
+    executor.startProcessById("straight", "{}", nullptr);
+
+    EXPECT_EQ(first.element("straight", "end").snapshot().count, 2u);
+    EXPECT_EQ(second.element("straight", "end").snapshot().count, 1u);
+    // Elements are only exported once they ran
+    EXPECT_EQ(second.toJson()["elements"].size(), 2u);
+}
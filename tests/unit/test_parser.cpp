@@ -1,6 +1,8 @@
 // tests/unit/test_parser.cpp
 #include <gtest/gtest.h>
 #include <bpmn/parser.h>
+#include <thread>
+#include <vector>
 
 class ParserTest : public ::testing::Test {
 protected:
@@ -17,4 +19,131 @@ TEST_F(ParserTest, ParseSimpleProcess) {
         auto process = parser.parse(bpmnXml);
         EXPECT_EQ(process->getId(), "test");
         });
-}
\ No newline at end of file
+}
+
+TEST_F(ParserTest, StreamingResolvesForwardSequenceFlows) {
+    std::string bpmnXml = R"(<?xml version="1.0" encoding="UTF-8"?>
+        <definitions xmlns="http://www.omg.org/spec/BPMN/20100524/MODEL">
+            <process id="forward_refs" name="Forward References">
+                <sequenceFlow id="flow1" sourceRef="start" targetRef="task"/>
+                <startEvent id="start"/>
+                <userTask id="task"/>
+                <sequenceFlow id="flow2" sourceRef="task" targetRef="end"/>
+                <endEvent id="end"/>
+            </process>
+        </definitions>)";
+
+    bpmn::BpmnParser parser;
+    auto process = parser.parseFromString(bpmnXml);
+    EXPECT_EQ(process->getId(), "forward_refs");
+    EXPECT_EQ(process->getStartEventId(), "start");
+    ASSERT_EQ(process->getOutgoingFlows("start").size(), 1u);
+    EXPECT_EQ(process->getOutgoingFlows("start")[0]->target_ref, "task");
+    EXPECT_EQ(process->getOutgoingFlows("task").size(), 1u);
+    EXPECT_TRUE(process->validate());
+}
+
+TEST_F(ParserTest, CompilesConditionExpressions) {
+    std::string bpmnXml = R"(<?xml version="1.0" encoding="UTF-8"?>
+        <definitions xmlns="http://www.omg.org/spec/BPMN/20100524/MODEL"
+                     xmlns:xsi="http://www.w3.org/2001/XMLSchema-instance">
+            <process id="conditions">
+                <startEvent id="start"/>
+                <exclusiveGateway id="gateway" default="low"/>
+                <endEvent id="endHigh"/>
+                <endEvent id="endLow"/>
+                <sequenceFlow id="flow1" sourceRef="start" targetRef="gateway"/>
+                <sequenceFlow id="high" sourceRef="gateway" targetRef="endHigh">
+                    <conditionExpression xsi:type="tFormalExpression"><![CDATA[${amount > 1000}]]></conditionExpression>
+                </sequenceFlow>
+                <sequenceFlow id="low" sourceRef="gateway" targetRef="endLow"/>
+            </process>
+        </definitions>)";
+
+    bpmn::BpmnParser parser;
+    auto process = parser.parseFromString(bpmnXml);
+    auto flows = process->getOutgoingFlows("gateway");
+    ASSERT_EQ(flows.size(), 2u);
+    EXPECT_EQ(flows[0]->condition_expression, "${amount > 1000}");
+    ASSERT_TRUE(flows[0]->condition);
+    EXPECT_TRUE(flows[0]->condition->evaluate({ { "amount", "5000" } }));
+    EXPECT_FALSE(flows[1]->condition);
+
+    // Elements after a flow with children are still picked up
+    EXPECT_TRUE(process->getElement("endLow"));
+}
+
+TEST_F(ParserTest, ParsesTimerEvents) {
+    std::string bpmnXml = R"(<?xml version="1.0" encoding="UTF-8"?>
+        <definitions xmlns="http://www.omg.org/spec/BPMN/20100524/MODEL">
+            <process id="timers">
+                <startEvent id="start">
+                    <timerEventDefinition><timeCycle>R3/PT1H</timeCycle></timerEventDefinition>
+                </startEvent>
+                <intermediateCatchEvent id="wait">
+                    <timerEventDefinition><timeDuration>PT15M</timeDuration></timerEventDefinition>
+                </intermediateCatchEvent>
+                <userTask id="approve"/>
+                <boundaryEvent id="timeout" attachedToRef="approve">
+                    <timerEventDefinition><timeDuration>P1D</timeDuration></timerEventDefinition>
+                </boundaryEvent>
+                <endEvent id="end"/>
+                <sequenceFlow id="flow1" sourceRef="start" targetRef="wait"/>
+                <sequenceFlow id="flow2" sourceRef="wait" targetRef="approve"/>
+                <sequenceFlow id="flow3" sourceRef="approve" targetRef="end"/>
+                <sequenceFlow id="flow4" sourceRef="timeout" targetRef="end"/>
+            </process>
+        </definitions>)";
+
+    bpmn::BpmnParser parser;
+    auto process = parser.parseFromString(bpmnXml);
+
+    auto* start = dynamic_cast<bpmn::StartEvent*>(process->getElement("start"));
+    ASSERT_TRUE(start);
+    EXPECT_EQ(start->timer.type, bpmn::TimerDefinition::Type::Cycle);
+    EXPECT_EQ(start->timer.repetitions, 3);
+    EXPECT_EQ(start->timer.interval_ms, 3600000);
+
+    auto* wait = dynamic_cast<bpmn::TimerCatchEvent*>(process->getElement("wait"));
+    ASSERT_TRUE(wait);
+    EXPECT_EQ(wait->timer.interval_ms, 15 * 60000);
+
+    auto* timeout = dynamic_cast<bpmn::BoundaryEvent*>(process->getElement("timeout"));
+    ASSERT_TRUE(timeout);
+    EXPECT_EQ(timeout->attached_to_ref, "approve");
+
+    const bpmn::ProcessGraph& graph = process->getGraph();
+    EXPECT_TRUE(graph.hasTimers());
+    auto boundaries = graph.boundaryEvents(graph.indexOf("approve"));
+    ASSERT_EQ(boundaries.size(), 1u);
+    EXPECT_EQ(graph.elementId(boundaries[0]), "timeout");
+}
+
+TEST_F(ParserTest, StreamingRejectsMalformedXml) {
+    bpmn::BpmnParser parser;
+    EXPECT_THROW(parser.parseFromString("<definitions><process"), std::runtime_error);
+    EXPECT_THROW(parser.parseFromString("<definitions/>"), std::runtime_error);
+}
+
+TEST_F(ParserTest, SharedParserIsReentrant) {
+    const bpmn::BpmnParser parser;
+    std::vector<std::thread> threads;
+    std::vector<std::string> ids(8);
+
+    for (size_t i = 0; i < ids.size(); ++i) {
+        threads.emplace_back([&parser, &ids, i]() {
+            const std::string id = "process_" + std::to_string(i);
+            auto process = parser.parseFromString(
+                "<definitions xmlns=\"http://www.omg.org/spec/BPMN/20100524/MODEL\">"
+                "<process id=\"" + id + "\"><startEvent id=\"start\"/></process></definitions>");
+            ids[i] = process->getId();
+            });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+
+    for (size_t i = 0; i < ids.size(); ++i) {
+        EXPECT_EQ(ids[i], "process_" + std::to_string(i));
+    }
+}
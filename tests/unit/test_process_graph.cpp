@@ -0,0 +1,113 @@
+#include <gtest/gtest.h>
+#include <bpmn/process_graph.h>
+#include <bpmn/model.h>
+#include <memory>
+
+using namespace bpmn;
+
+class TestProcessGraph : public ::testing::Test {
+protected:
+    // start -> gw -> (a | b) -> end, with f3 as the gateway default
+    static std::unique_ptr<Process> makeProcess() {
+        auto process = std::make_unique<Process>("graph", "Graph");
+        process->addElement(std::make_shared<StartEvent>("start", "Start"));
+        auto gateway = std::make_shared<ExclusiveGateway>("gw", "Gateway");
+        gateway->default_flow = "f3";
+        process->addElement(gateway);
+        process->addElement(std::make_shared<UserTask>("a", "A"));
+        process->addElement(std::make_shared<UserTask>("b", "B"));
+        process->addElement(std::make_shared<EndEvent>("end", "End"));
+        process->setStartEventId("start");
+        process->addSequenceFlow("f1", "", "start", "gw");
+        process->addSequenceFlow("f2", "", "gw", "a");
+        process->addSequenceFlow("f3", "", "gw", "b");
+        process->addSequenceFlow("f4", "", "a", "end");
+        process->addSequenceFlow("f5", "", "b", "end");
+        return process;
+    }
+};
+
+TEST_F(TestProcessGraph, IndexesElementsAndAdjacency) {
+    auto process = makeProcess();
+    const ProcessGraph& graph = process->getGraph();
+
+    ASSERT_EQ(graph.elementCount(), 5u);
+    ASSERT_EQ(graph.flowCount(), 5u);
+    EXPECT_EQ(graph.startElement(), graph.indexOf("start"));
+    EXPECT_EQ(graph.indexOf("missing"), ProcessGraph::npos);
+
+    const ProcessGraph::Index gateway = graph.indexOf("gw");
+    ProcessGraph::Range outgoing = graph.outgoing(gateway);
+    ASSERT_EQ(outgoing.size(), 2u);
+    EXPECT_EQ(graph.elementId(graph.flowTarget(outgoing[0])), "a");
+    EXPECT_EQ(graph.elementId(graph.flowTarget(outgoing[1])), "b");
+    EXPECT_EQ(graph.incoming(graph.indexOf("end")).size(), 2u);
+    EXPECT_TRUE(graph.outgoing(graph.indexOf("end")).empty());
+
+    ASSERT_NE(graph.defaultFlow(gateway), ProcessGraph::npos);
+    EXPECT_EQ(graph.flow(graph.defaultFlow(gateway))->getId(), "f3");
+    EXPECT_EQ(graph.defaultFlow(graph.indexOf("a")), ProcessGraph::npos);
+}
+
+TEST_F(TestProcessGraph, ProcessIsFrozenOnceGraphIsBuilt) {
+    auto process = makeProcess();
+    process->getGraph();
+
+    EXPECT_THROW(process->addSequenceFlow("f6", "", "a", "b"), std::logic_error);
+    EXPECT_THROW(process->addElement(std::make_shared<EndEvent>("end2", "End")), std::logic_error);
+}
+
+TEST_F(TestProcessGraph, FindsWaitStatesInsideParallelBranches) {
+    // start -> fork -> (wait | task) -> join -> after -> end; wait is a
+    // message event, or a user task when task has a boundary event
+    const auto makeParallel = [](bool boundary) {
+        auto process = std::make_unique<Process>("parallel", "Parallel");
+        process->addElement(std::make_shared<StartEvent>("start", "Start"));
+        process->addElement(std::make_shared<ParallelGateway>("fork", "Fork"));
+        process->addElement(std::make_shared<UserTask>("task", "Task"));
+        process->addElement(std::make_shared<ParallelGateway>("join", "Join"));
+        process->addElement(std::make_shared<TimerCatchEvent>("after", "After"));
+        process->addElement(std::make_shared<EndEvent>("end", "End"));
+        if (boundary) {
+            auto timeout = std::make_shared<BoundaryEvent>("timeout", "Timeout");
+            timeout->attached_to_ref = "task";
+            process->addElement(timeout);
+            process->addElement(std::make_shared<UserTask>("wait", "Wait"));
+            process->addSequenceFlow("f8", "", "timeout", "end");
+        }
+        else {
+            process->addElement(std::make_shared<MessageCatchEvent>("wait", "Wait"));
+        }
+        process->addSequenceFlow("f2", "", "fork", "wait");
+        process->addSequenceFlow("f4", "", "wait", "join");
+        process->setStartEventId("start");
+        process->addSequenceFlow("f1", "", "start", "fork");
+        process->addSequenceFlow("f3", "", "fork", "task");
+        process->addSequenceFlow("f5", "", "task", "join");
+        process->addSequenceFlow("f6", "", "join", "after");
+        process->addSequenceFlow("f7", "", "after", "end");
+        return process;
+    };
+
+    auto message = makeParallel(false);
+    EXPECT_EQ(message->getGraph().elementId(message->getGraph().parallelWait()), "wait");
+    EXPECT_FALSE(message->validate());
+
+    auto boundary = makeParallel(true);
+    EXPECT_EQ(boundary->getGraph().elementId(boundary->getGraph().parallelWait()), "timeout");
+
+    // A wait after the join is fine
+    EXPECT_EQ(makeProcess()->getGraph().parallelWait(), ProcessGraph::npos);
+    auto joined = std::make_unique<Process>("joined", "Joined");
+    joined->addElement(std::make_shared<StartEvent>("start", "Start"));
+    joined->addElement(std::make_shared<ParallelGateway>("fork", "Fork"));
+    joined->addElement(std::make_shared<ParallelGateway>("join", "Join"));
+    joined->addElement(std::make_shared<TimerCatchEvent>("after", "After"));
+    joined->setStartEventId("start");
+    joined->addSequenceFlow("f1", "", "start", "fork");
+    joined->addSequenceFlow("f2", "", "fork", "join");
+    joined->addSequenceFlow("f3", "", "fork", "join");
+    joined->addSequenceFlow("f4", "", "join", "after");
+    EXPECT_EQ(joined->getGraph().parallelWait(), ProcessGraph::npos);
+    EXPECT_TRUE(joined->validate());
+}
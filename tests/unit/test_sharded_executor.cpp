@@ -0,0 +1,144 @@
+#include <gtest/gtest.h>
+#include <bpmn/sharded_executor.h>
+#include <bpmn/in_memory_state_store.h>
+#include <bpmn/model.h>
+#include <boost/uuid/uuid_generators.hpp>
+#include <boost/uuid/uuid_io.hpp>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace bpmn;
+
+namespace {
+
+    // start -> approve (user task) -> end
+    std::shared_ptr<const Process> makeApproval() {
+        auto process = std::make_shared<Process>("approval", "Approval");
+        process->addElement(std::make_shared<StartEvent>("start", "Start"));
+        process->addElement(std::make_shared<UserTask>("approve", "Approve"));
+        process->addElement(std::make_shared<EndEvent>("end", "End"));
+        process->addSequenceFlow("flow1", "", "start", "approve");
+        process->addSequenceFlow("flow2", "", "approve", "end");
+        process->setStartEventId("start");
+        return process;
+    }
+
+    // start -> wait for "paid" correlated by init_data -> end
+    std::shared_ptr<const Process> makePayment() {
+        auto process = std::make_shared<Process>("payment", "Payment");
+        process->addElement(std::make_shared<StartEvent>("start", "Start"));
+        auto paid = std::make_shared<MessageCatchEvent>("paid", "Paid");
+        paid->message_name = "paid";
+        paid->correlation_variable = "init_data";
+        process->addElement(paid);
+        process->addElement(std::make_shared<EndEvent>("end", "End"));
+        process->addSequenceFlow("flow1", "", "start", "paid");
+        process->addSequenceFlow("flow2", "", "paid", "end");
+        process->setStartEventId("start");
+        return process;
+    }
+
+    // Shards on in-memory stores, remembering which store belongs to which shard
+    class TestShardRouting : public ::testing::Test {
+    protected:
+        static constexpr std::size_t kShards = 4;
+
+        TestShardRouting()
+            : executor([this](std::size_t shard) {
+                auto store = std::make_unique<InMemoryStateStore>();
+                stores[shard] = store.get();
+                return std::unique_ptr<StateStore>(std::move(store));
+            }, kShards) {
+            executor.addProcessDefinition(makeApproval());
+            executor.addProcessDefinition(makePayment());
+        }
+
+        // Shards whose store holds a running instance_id
+        std::vector<std::size_t> holders(const std::string& instance_id) {
+            std::vector<std::size_t> result;
+            for (std::size_t shard = 0; shard < kShards; ++shard) {
+                if (stores[shard]->containsProcessInstance(instance_id)) {
+                    result.push_back(shard);
+                }
+            }
+            return result;
+        }
+
+        InMemoryStateStore* stores[kShards] = {};
+        ShardedExecutor executor;
+    };
+
+} // anonymous namespace
+
+TEST(TestShardedExecutor, StampedIdsRouteToTheirShard) {
+    boost::uuids::random_generator generator;
+    for (std::size_t shards : { 1u, 3u, 8u, 13u }) {
+        for (std::size_t shard = 0; shard < shards; ++shard) {
+            const std::string uuid = boost::uuids::to_string(generator());
+            const std::string id = ShardedExecutor::stampShard(uuid, shard, shards);
+            EXPECT_EQ(ShardedExecutor::shardOf(id, shards), shard) << id;
+            // Still a UUID: only the trailing random digits change
+            ASSERT_EQ(id.size(), uuid.size());
+            EXPECT_EQ(id.substr(0, id.size() - 8), uuid.substr(0, uuid.size() - 8));
+        }
+    }
+}
+
+TEST(TestShardedExecutor, RandomIdsSpreadOverShards) {
+    constexpr std::size_t shards = 8;
+    boost::uuids::random_generator generator;
+    std::vector<std::size_t> counts(shards);
+    for (int i = 0; i < 8000; ++i) {
+        ++counts[ShardedExecutor::shardOf(boost::uuids::to_string(generator()), shards)];
+    }
+    for (std::size_t count : counts) {
+        EXPECT_GT(count, 800u);
+        EXPECT_LT(count, 1200u);
+    }
+
+    // Foreign ids route consistently as well
+    EXPECT_EQ(ShardedExecutor::shardOf("order-42", shards), ShardedExecutor::shardOf("order-42", shards));
+    EXPECT_LT(ShardedExecutor::shardOf("x", shards), shards);
+}
+
+TEST_F(TestShardRouting, InstancesStayOnTheShardThatStartedThem) {
+    std::vector<std::string> ids;
+    std::vector<std::size_t> shardCounts(kShards);
+    for (int i = 0; i < 40; ++i) {
+        std::thread::id startedOn;
+        const std::string id = executor.startProcessById("approval", "{}", [&startedOn](const std::string&) {
+            startedOn = std::this_thread::get_id();
+            return true;
+        }).get();
+        ASSERT_EQ(holders(id), std::vector<std::size_t>{ executor.shardOf(id) }) << id;
+        // Later work on the instance runs on the thread that started it
+        EXPECT_EQ(executor.submit(id, [](ProcessExecutor&) { return std::this_thread::get_id(); }).get(), startedOn);
+        ++shardCounts[executor.shardOf(id)];
+        ids.push_back(id);
+    }
+    // Round-robin starts reach every shard
+    for (std::size_t count : shardCounts) {
+        EXPECT_EQ(count, 10u);
+    }
+
+    for (const std::string& id : ids) {
+        executor.resumeProcess(id, "approved", nullptr).get();
+        EXPECT_TRUE(holders(id).empty()) << id;
+    }
+}
+
+TEST_F(TestShardRouting, CorrelationFindsTheOwningShard) {
+    std::vector<std::string> ids;
+    for (int i = 0; i < 8; ++i) {
+        ids.push_back(executor.startProcessById("payment", "order-" + std::to_string(i), nullptr).get());
+    }
+
+    for (int i = 7; i >= 0; --i) {
+        const std::string& id = ids[static_cast<std::size_t>(i)];
+        ASSERT_EQ(holders(id), std::vector<std::size_t>{ executor.shardOf(id) });
+        EXPECT_EQ(executor.correlateMessage("paid", "order-" + std::to_string(i), "{}", nullptr), id);
+        EXPECT_TRUE(holders(id).empty()) << id;
+    }
+    EXPECT_EQ(executor.correlateMessage("paid", "order-0", "{}", nullptr), "");
+}
@@ -0,0 +1,159 @@
+#include <gtest/gtest.h>
+#include <bpmn/timing_wheel.h>
+#include <bpmn/timer_definition.h>
+#include <bpmn/timer_service.h>
+#include <algorithm>
+#include <condition_variable>
+#include <map>
+#include <mutex>
+#include <random>
+#include <stdexcept>
+#include <vector>
+
+using namespace bpmn;
+
+TEST(TestTimingWheel, FiresAtDeadlineAcrossLevels) {
+    TimingWheel<int> wheel(1000);
+    wheel.insert(1000, 0);           // already due
+    wheel.insert(1005, 1);
+    wheel.insert(1000 + 70, 2);      // level 1
+    wheel.insert(1000 + 5000, 3);    // level 2
+    wheel.insert(1000 + (std::uint64_t(1) << 40), 4);  // beyond the wheel
+
+    std::vector<int> expired;
+    wheel.advance(1000, expired);
+    EXPECT_EQ(expired, std::vector<int>({ 0 }));
+
+    wheel.advance(1004, expired);
+    EXPECT_EQ(expired.size(), 1u);
+    wheel.advance(1005, expired);
+    EXPECT_EQ(expired, std::vector<int>({ 0, 1 }));
+
+    wheel.advance(1069, expired);
+    EXPECT_EQ(expired.size(), 2u);
+    wheel.advance(6000, expired);
+    EXPECT_EQ(expired, std::vector<int>({ 0, 1, 2, 3 }));
+    EXPECT_EQ(wheel.size(), 1u);
+
+    wheel.advance(1000 + (std::uint64_t(1) << 40) - 1, expired);
+    EXPECT_EQ(expired.size(), 4u);
+    wheel.advance(1000 + (std::uint64_t(1) << 40), expired);
+    EXPECT_EQ(expired.back(), 4);
+    EXPECT_EQ(wheel.size(), 0u);
+}
+
+TEST(TestTimingWheel, CancelIsExactAndIdsAreNotReused) {
+    TimingWheel<int> wheel;
+    const auto first = wheel.insert(100, 1);
+    const auto second = wheel.insert(100, 2);
+    EXPECT_TRUE(wheel.cancel(first));
+    EXPECT_FALSE(wheel.cancel(first));
+
+    std::vector<int> expired;
+    wheel.advance(100, expired);
+    EXPECT_EQ(expired, std::vector<int>({ 2 }));
+    EXPECT_FALSE(wheel.cancel(second));
+
+    // The slab slot is recycled under a new id
+    const auto third = wheel.insert(200, 3);
+    EXPECT_NE(third, first);
+    EXPECT_NE(third, second);
+    EXPECT_FALSE(wheel.cancel(second));
+    EXPECT_TRUE(wheel.cancel(third));
+}
+
+TEST(TestTimingWheel, MatchesSortedReference) {
+    std::mt19937_64 random(42);
+    TimingWheel<std::uint64_t> wheel(12345);
+    std::multimap<std::uint64_t, std::uint64_t> reference;
+    std::vector<std::pair<TimingWheel<std::uint64_t>::TimerId, std::uint64_t>> ids;
+
+    std::uint64_t now = 12345;
+    for (int round = 0; round < 2000; ++round) {
+        for (int i = 0; i < 20; ++i) {
+            const std::uint64_t deadline = now + random() % (round % 3 == 0 ? 300000 : 200);
+            ids.emplace_back(wheel.insert(deadline, deadline), deadline);
+            reference.emplace(deadline, deadline);
+        }
+        if (!ids.empty() && round % 2 == 0) {
+            const std::size_t victim = random() % ids.size();
+            if (wheel.cancel(ids[victim].first)) {
+                reference.erase(reference.find(ids[victim].second));
+            }
+        }
+
+        now += random() % 500;
+        std::vector<std::uint64_t> expired;
+        wheel.advance(now, expired);
+
+        std::vector<std::uint64_t> expected;
+        while (!reference.empty() && reference.begin()->first <= now) {
+            expected.push_back(reference.begin()->first);
+            reference.erase(reference.begin());
+        }
+        std::sort(expired.begin(), expired.end());
+        ASSERT_EQ(expired, expected) << "round " << round;
+        ASSERT_EQ(wheel.size(), reference.size());
+    }
+}
+
+TEST(TestTimerDefinition, ParsesIsoExpressions) {
+    EXPECT_EQ(TimerDefinition::parseDuration("PT15M"), 15 * 60000);
+    EXPECT_EQ(TimerDefinition::parseDuration("P2DT4H"), (2 * 24 + 4) * 3600000LL);
+    EXPECT_EQ(TimerDefinition::parseDuration("PT0.5S"), 500);
+    EXPECT_EQ(TimerDefinition::parseDuration("P1W"), 7 * 86400000LL);
+    EXPECT_EQ(TimerDefinition::parseDate("1970-01-02T00:00:00Z"), 86400000LL);
+    EXPECT_EQ(TimerDefinition::parseDate("2024-02-29T12:30:00+02:00"), 1709202600000LL);
+
+    const auto cycle = TimerDefinition::parse(TimerDefinition::Type::Cycle, " R3/PT1H ");
+    EXPECT_EQ(cycle.repetitions, 3);
+    EXPECT_EQ(cycle.interval_ms, 3600000);
+    EXPECT_EQ(cycle.firstDue(1000), 1000 + 3600000);
+    EXPECT_EQ(TimerDefinition::parse(TimerDefinition::Type::Cycle, "R/PT10M").repetitions, -1);
+
+    EXPECT_THROW(TimerDefinition::parseDuration("P1Y"), std::invalid_argument);
+    EXPECT_THROW(TimerDefinition::parseDuration("PT"), std::invalid_argument);
+    EXPECT_THROW(TimerDefinition::parseDate("2024-13-01T00:00:00Z"), std::invalid_argument);
+    EXPECT_THROW(TimerDefinition::parse(TimerDefinition::Type::Cycle, "PT1H"), std::invalid_argument);
+    EXPECT_THROW(TimerDefinition::parseDuration("PT1.2.3S"), std::invalid_argument);
+    EXPECT_THROW(TimerDefinition::parseDuration("PT.S"), std::invalid_argument);
+    EXPECT_THROW(TimerDefinition::parseDuration("P99999999999999999999D"), std::invalid_argument);
+    EXPECT_THROW(TimerDefinition::parse(TimerDefinition::Type::Cycle, "R99999999999/PT1H"), std::invalid_argument);
+}
+
+TEST(TestTimerService, FiresDueTimersAndHonoursCancel) {
+    std::mutex mutex;
+    std::condition_variable fired_cv;
+    std::vector<std::string> fired;
+    TimerService service([&](TimerService::Timer timer) {
+        std::lock_guard<std::mutex> lock(mutex);
+        fired.push_back(timer.element_id);
+        fired_cv.notify_all();
+    }, std::chrono::milliseconds(1));
+
+    const std::int64_t now = TimerService::nowMs();
+    auto timer = [now](const std::string& instance, const std::string& element, std::int64_t delay) {
+        TimerService::Timer result;
+        result.instance_id = instance;
+        result.element_id = element;
+        result.kind = "catch";
+        result.due_at = now + delay;
+        return result;
+    };
+    service.schedule(timer("a", "late", 40));
+    service.schedule(timer("a", "early", 5));
+    service.schedule(timer("b", "cancelled", 10));
+    service.schedule(timer("c", "instance", 10));
+    // Same key: replaces the pending timer
+    service.schedule(timer("a", "early", 20));
+    EXPECT_EQ(service.pending(), 4u);
+
+    EXPECT_TRUE(service.cancel("b", "cancelled"));
+    EXPECT_FALSE(service.cancel("b", "cancelled"));
+    EXPECT_EQ(service.cancelInstance("c"), 1u);
+
+    std::unique_lock<std::mutex> lock(mutex);
+    ASSERT_TRUE(fired_cv.wait_for(lock, std::chrono::seconds(5), [&]() { return fired.size() == 2; }));
+    EXPECT_EQ(fired, std::vector<std::string>({ "early", "late" }));
+    EXPECT_GE(TimerService::nowMs(), now + 40);
+}
@@ -0,0 +1,205 @@
+#include <gtest/gtest.h>
+#include <bpmn/condition_expression.h>
+#include <bpmn/variables.h>
+#include <nlohmann/json.hpp>
+#include <map>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+using namespace bpmn;
+
+TEST(TestVariables, KeepsEntriesSortedAndSpillsPastInlineCapacity) {
+    Variables variables;
+    for (int i = 19; i >= 0; --i) {
+        variables.set("var" + std::to_string(100 + i), i);
+    }
+    variables.set("var105", std::string("replaced"));
+    EXPECT_EQ(variables.size(), 20u);
+
+    std::string previous;
+    variables.forEach([&previous](const std::string& name, const Variables::Value&) {
+        EXPECT_LT(previous, name);
+        previous = name;
+    });
+    EXPECT_EQ(std::get<int>(variables.at("var119")), 19);
+    EXPECT_EQ(variables.getString("var105"), "replaced");
+    EXPECT_EQ(variables.find("missing"), nullptr);
+    EXPECT_THROW(variables.at("missing"), std::out_of_range);
+
+    // Copies are deep and independent
+    Variables copy = variables;
+    EXPECT_TRUE(copy.erase("var100"));
+    EXPECT_FALSE(copy.erase("var100"));
+    EXPECT_EQ(copy.size(), 19u);
+    EXPECT_EQ(variables.count("var100"), 1u);
+}
+
+TEST(TestVariables, StringFormRoundTripsTypes) {
+    Variables variables;
+    variables.set("count", 42);
+    variables.set("ratio", 1.5);
+    variables.set("vip", true);
+    variables.set("code", "007");
+    variables.set("name", "Ann");
+
+    const std::map<std::string, std::string> stored = variables.toStringMap();
+    EXPECT_EQ(stored.at("count"), "42");
+    EXPECT_EQ(stored.at("ratio"), "1.5");
+    EXPECT_EQ(stored.at("vip"), "true");
+
+    const Variables loaded = Variables::fromStringMap(stored);
+    EXPECT_EQ(std::get<int>(loaded.at("count")), 42);
+    EXPECT_EQ(std::get<double>(loaded.at("ratio")), 1.5);
+    EXPECT_TRUE(std::get<bool>(loaded.at("vip")));
+    // Not the canonical text of a number, so the leading zeros survive
+    EXPECT_EQ(std::get<std::string>(loaded.at("code")), "007");
+    EXPECT_EQ(loaded.toStringMap(), stored);
+}
+
+TEST(TestVariables, ConvertsJsonAtTheEdges) {
+    const nlohmann::json input = nlohmann::json::parse(
+        R"({"amount": 1500, "order": {"status": "paid", "lines": [{"sku": "a"}, {"sku": "b"}]}, "tags": [1, 2], "skip": null})");
+    const Variables variables = Variables::fromJson(input);
+
+    EXPECT_EQ(variables.size(), 3u);
+    EXPECT_EQ(std::get<int>(variables.at("amount")), 1500);
+    const Container& order = *std::get<Container::Ptr>(variables.at("order"));
+    EXPECT_EQ(order.getField<std::string>("status"), "paid");
+    EXPECT_EQ(order.getContainerArrayField("lines").size(), 2u);
+    EXPECT_EQ(variables.getString("tags"), "[1,2]");
+
+    nlohmann::json expected = input;
+    expected.erase("skip");
+    expected["tags"] = "[1,2]";
+    EXPECT_EQ(variables.toJson(), expected);
+    EXPECT_THROW(Variables::fromJson(nlohmann::json::array()), std::invalid_argument);
+}
+
+TEST(TestVariables, NamesPastTheInternBoundAreOwnedByEntries) {
+    // Payload keys are unbounded; the shared name table is not
+    Variables variables;
+    const std::size_t count = Variables::kInternedNames + 100;
+    for (std::size_t i = 0; i < count; ++i) {
+        variables.set("payload_key_" + std::to_string(i), static_cast<int>(i));
+    }
+    EXPECT_LE(Variables::internedNames(), Variables::kInternedNames);
+    EXPECT_EQ(variables.size(), count);
+
+    const std::string last = "payload_key_" + std::to_string(count - 1);
+    variables.set(last, std::string("replaced"));
+    EXPECT_EQ(variables.size(), count);
+    EXPECT_EQ(variables.getString(last), "replaced");
+
+    // Branches writing the same name past the bound still merge into one
+    Variables left = variables.fork();
+    Variables right = variables;
+    left.set(last, 1);
+    right.set(last, 2);
+    variables.join({ left.takeDelta(), right.takeDelta() }, VariableMergePolicy::LastArrivalWins);
+    EXPECT_EQ(variables.size(), count);
+    EXPECT_EQ(std::get<int>(variables.at(last)), 2);
+
+    const Variables loaded = Variables::fromStringMap(variables.toStringMap());
+    EXPECT_EQ(loaded.toStringMap(), variables.toStringMap());
+}
+
+TEST(TestVariables, ConditionsCompareTypedValues) {
+    Variables variables;
+    variables.set("amount", 1500);
+    variables.set("vip", true);
+    variables.set("status", "approved");
+
+    EXPECT_TRUE(ConditionExpression::compile("${amount > 1000 && vip}")->evaluate(variables));
+    EXPECT_TRUE(ConditionExpression::compile("${status == 'approved'}")->evaluate(variables));
+    EXPECT_FALSE(ConditionExpression::compile("${amount == '1499'}")->evaluate(variables));
+    EXPECT_TRUE(ConditionExpression::compile("${missing == null}")->evaluate(variables));
+}
+
+TEST(TestVariables, BranchesShareTheForkScopeAndMergeAtTheJoin) {
+    Variables variables;
+    variables.set("amount", 100);
+    variables.set("status", "new");
+    variables.set("obsolete", true);
+
+    const Variables scope = variables.fork();
+    Variables left = scope;
+    Variables right = scope;
+    left.set("status", "checked");
+    left.set("leftOnly", 1);
+    right.erase("obsolete");
+    right.set("rightOnly", 2);
+    // Branches see their own writes only
+    EXPECT_EQ(right.getString("status"), "new");
+    EXPECT_EQ(left.count("obsolete"), 1u);
+    EXPECT_EQ(right.count("obsolete"), 0u);
+
+    std::vector<Variables::Delta> arrivals;
+    arrivals.push_back(left.takeDelta());
+    right.join(std::move(arrivals), VariableMergePolicy::Fail);
+
+    EXPECT_EQ(right.size(), 4u);
+    EXPECT_EQ(right.getString("status"), "checked");
+    EXPECT_EQ(std::get<int>(right.at("leftOnly")), 1);
+    EXPECT_EQ(std::get<int>(right.at("rightOnly")), 2);
+    EXPECT_EQ(right.count("obsolete"), 0u);
+
+    // After the join the token is back in the enclosing scope
+    std::vector<Variables::Delta> none;
+    Variables outer = right;
+    outer.join(std::move(none), VariableMergePolicy::Fail);
+    EXPECT_EQ(outer.toStringMap(), right.toStringMap());
+}
+
+TEST(TestVariables, JoinResolvesConflictsByPolicy) {
+    auto joinWith = [](VariableMergePolicy policy) {
+        Variables variables;
+        variables.set("owner", "nobody");
+        const Variables scope = variables.fork();
+        Variables first = scope;
+        Variables second = scope;
+        Variables last = scope;
+        first.set("owner", "first");
+        second.set("owner", "second");
+        // Same value from two branches is no conflict
+        first.set("shared", 1);
+        second.set("shared", 1);
+
+        std::vector<Variables::Delta> arrivals;
+        arrivals.push_back(first.takeDelta());
+        arrivals.push_back(second.takeDelta());
+        last.join(std::move(arrivals), policy);
+        return last.getString("owner");
+    };
+
+    EXPECT_EQ(joinWith(VariableMergePolicy::LastArrivalWins), "second");
+    EXPECT_EQ(joinWith(VariableMergePolicy::FirstArrivalWins), "first");
+    EXPECT_THROW(joinWith(VariableMergePolicy::Fail), std::runtime_error);
+}
+
+TEST(TestVariables, NestedForksKeepOuterBranchWrites) {
+    Variables variables;
+    variables.set("root", 0);
+    const Variables outer = variables.fork();
+    Variables a = outer;
+    Variables b = outer;
+    a.set("beforeInner", "a");
+
+    const Variables inner = a.fork();
+    Variables a1 = inner;
+    Variables a2 = inner;
+    a1.set("inner1", 1);
+    a2.set("inner2", 2);
+    std::vector<Variables::Delta> innerArrivals;
+    innerArrivals.push_back(a1.takeDelta());
+    a2.join(std::move(innerArrivals), VariableMergePolicy::Fail);
+
+    b.set("fromB", true);
+    std::vector<Variables::Delta> outerArrivals;
+    outerArrivals.push_back(a2.takeDelta());
+    b.join(std::move(outerArrivals), VariableMergePolicy::Fail);
+
+    const std::map<std::string, std::string> expected{
+        { "beforeInner", "a" }, { "fromB", "true" }, { "inner1", "1" }, { "inner2", "2" }, { "root", "0" } };
+    EXPECT_EQ(b.toStringMap(), expected);
+}
@@ -0,0 +1,260 @@
+#include <gtest/gtest.h>
+#include <bpmn/executor.h>
+#include <bpmn/model.h>
+#include <bpmn/wal_state_store.h>
+#include <filesystem>
+#include <fstream>
+#include <limits>
+#include <memory>
+#include <stdexcept>
+#include <string>
+
+using namespace bpmn;
+
+namespace {
+
+    std::shared_ptr<const Process> makeApproval(const std::string& id) {
+        auto process = std::make_shared<Process>(id, "Approval");
+        process->addElement(std::make_shared<StartEvent>("start", "Start"));
+        process->addElement(std::make_shared<UserTask>("approve", "Approve"));
+        process->addElement(std::make_shared<EndEvent>("end", "End"));
+        process->addSequenceFlow("flow1", "", "start", "approve");
+        process->addSequenceFlow("flow2", "", "approve", "end");
+        process->setStartEventId("start");
+        return process;
+    }
+
+    // Fresh directory per test, removed afterwards
+    class TestWalStateStore : public ::testing::Test {
+    protected:
+        void SetUp() override {
+            const auto* info = ::testing::UnitTest::GetInstance()->current_test_info();
+            directory_ = std::filesystem::temp_directory_path() / (std::string("bpmn-wal-") + info->name());
+            std::filesystem::remove_all(directory_);
+        }
+        void TearDown() override { std::filesystem::remove_all(directory_); }
+
+        std::string directory() const { return directory_.string(); }
+
+        std::filesystem::path directory_;
+    };
+
+} // anonymous namespace
+
+TEST_F(TestWalStateStore, SavesLoadsAndCompletesInstances) {
+    WalStateStore store(directory());
+    store.saveProcessInstance("i1", "p", "task", { { "a", "1" } });
+    store.saveProcessInstance("i1", "p", "next", { { "a", "2" } });
+    store.saveUserTask("i1", "task", "form", { { "b", "3" } });
+    store.saveError("i1", "boom");
+
+    ASSERT_TRUE(store.containsProcessInstance("i1"));
+    const StateStore::ProcessInstance loaded = store.loadProcessInstance("i1");
+    EXPECT_EQ(loaded.process_id, "p");
+    EXPECT_EQ(loaded.current_element, "next");
+    EXPECT_EQ(loaded.variables.at("a"), "2");
+    ASSERT_EQ(store.getUserTasks("i1").size(), 1u);
+    EXPECT_EQ(store.getUserTasks("i1")[0].variables.at("b"), "3");
+    ASSERT_EQ(store.getErrors("i1").size(), 1u);
+    EXPECT_EQ(store.getErrors("i1")[0], "boom");
+    EXPECT_GT(store.stats().flushes, 0u);
+
+    store.completeProcessInstance("i1");
+    EXPECT_FALSE(store.containsProcessInstance("i1"));
+    EXPECT_THROW(store.loadProcessInstance("i1"), std::runtime_error);
+    EXPECT_EQ(store.stats().live_bytes, 0u);
+}
+
+TEST_F(TestWalStateStore, ReopenReplaysTheLog) {
+    {
+        WalStateStore::Options options;
+        options.sync_commits = false;
+        WalStateStore store(directory(), options);
+        store.saveProcessInstance("i1", "p", "task", { { "a", "1" } });
+        store.saveProcessInstance("i1", "p", "wait", { { "a", "2" } });
+        store.saveProcessInstance("i2", "p", "end", {});
+        store.completeProcessInstance("i2");
+
+        StateStore::TimerRecord timer;
+        timer.instance_id = "i1";
+        timer.element_id = "t1";
+        timer.process_id = "p";
+        timer.kind = "catch";
+        timer.due_at = 1700000000000;
+        timer.repetitions = -1;
+        timer.interval_ms = 500;
+        store.saveTimer(timer);
+        timer.element_id = "t2";
+        store.saveTimer(timer);
+        store.deleteTimer("i1", "t2");
+
+        store.saveMessageSubscription({ "i1", "m1", "paid", "order-7" });
+        store.saveMessageSubscription({ "i1", "m2", "shipped", "" });
+        store.deleteMessageSubscription("i1", "m2");
+    }
+
+    WalStateStore store(directory());
+    ASSERT_TRUE(store.containsProcessInstance("i1"));
+    EXPECT_FALSE(store.containsProcessInstance("i2"));
+    const StateStore::ProcessInstance loaded = store.loadProcessInstance("i1");
+    EXPECT_EQ(loaded.current_element, "wait");
+    EXPECT_EQ(loaded.variables.at("a"), "2");
+
+    const auto timers = store.loadTimers();
+    ASSERT_EQ(timers.size(), 1u);
+    EXPECT_EQ(timers[0].element_id, "t1");
+    EXPECT_EQ(timers[0].due_at, 1700000000000);
+    EXPECT_EQ(timers[0].repetitions, -1);
+    EXPECT_EQ(timers[0].interval_ms, 500);
+
+    const auto subscriptions = store.loadMessageSubscriptions();
+    ASSERT_EQ(subscriptions.size(), 1u);
+    EXPECT_EQ(subscriptions[0].message_name, "paid");
+    EXPECT_EQ(subscriptions[0].correlation_key, "order-7");
+
+    store.deleteTimers("i1");
+    store.deleteMessageSubscriptions("i1");
+    EXPECT_TRUE(store.loadTimers().empty());
+    EXPECT_TRUE(store.loadMessageSubscriptions().empty());
+}
+
+TEST_F(TestWalStateStore, CompactionDropsSupersededSegments) {
+    WalStateStore::Options options;
+    options.segment_size = 4096;
+    options.compaction_interval = std::chrono::hours(1);
+    {
+        WalStateStore store(directory(), options);
+        for (int i = 0; i < 200; ++i) {
+            store.saveProcessInstance("i1", "p", "step" + std::to_string(i), { { "n", std::to_string(i) } });
+            store.saveProcessInstance("i" + std::to_string(i % 7 + 2), "p", "x", {});
+        }
+        store.saveProcessInstance("done", "p", "end", {});
+        store.completeProcessInstance("done");
+
+        // Rolling over wakes the compaction thread as well; either way every
+        // sealed segment is mostly superseded
+        store.compact();
+        const WalStateStore::Stats stats = store.stats();
+        EXPECT_GE(stats.compacted_segments, 4u);
+        EXPECT_LE(stats.segments, 2u);
+        EXPECT_LT(stats.bytes, 2u * options.segment_size);
+        EXPECT_EQ(stats.instances, 8u);
+        EXPECT_EQ(store.loadProcessInstance("i1").current_element, "step199");
+    }
+
+    // Moved records keep their order across a restart
+    WalStateStore store(directory(), options);
+    EXPECT_EQ(store.stats().instances, 8u);
+    EXPECT_EQ(store.loadProcessInstance("i1").variables.at("n"), "199");
+    EXPECT_FALSE(store.containsProcessInstance("done"));
+}
+
+TEST_F(TestWalStateStore, CompactionDropsDeletionsThatShadowNothing) {
+    WalStateStore::Options options;
+    options.segment_size = 4096;
+    options.compaction_interval = std::chrono::hours(1);
+    {
+        WalStateStore store(directory(), options);
+        // The first segment stays live and is never compacted
+        for (int i = 0; i < 40; ++i) {
+            store.saveProcessInstance("keep" + std::to_string(i), "p", "wait", { { "pad", std::string(64, 'x') } });
+        }
+        for (int i = 0; i < 2000; ++i) {
+            const std::string id = "done" + std::to_string(i);
+            store.saveProcessInstance(id, "p", "end", {});
+            store.completeProcessInstance(id);
+        }
+        store.compact();
+        store.compact();
+        // Only the records of the live instances are left
+        const WalStateStore::Stats stats = store.stats();
+        EXPECT_LE(stats.segments, 3u);
+        EXPECT_EQ(stats.instances, 40u);
+    }
+
+    WalStateStore store(directory(), options);
+    EXPECT_EQ(store.stats().instances, 40u);
+    EXPECT_FALSE(store.containsProcessInstance("done0"));
+    EXPECT_FALSE(store.containsProcessInstance("done1999"));
+    EXPECT_TRUE(store.containsProcessInstance("keep39"));
+}
+
+TEST_F(TestWalStateStore, RejectsSegmentsOver4GiB) {
+    if (sizeof(std::size_t) <= 4) {
+        GTEST_SKIP() << "size_t cannot exceed 4 GiB";
+    }
+    WalStateStore::Options options;
+    options.segment_size = static_cast<std::size_t>(std::numeric_limits<std::uint32_t>::max()) + 1;
+    EXPECT_THROW(WalStateStore(directory(), options), std::invalid_argument);
+}
+
+TEST_F(TestWalStateStore, TornTailIsIgnored) {
+    {
+        WalStateStore store(directory());
+        store.saveProcessInstance("i1", "p", "first", {});
+        store.saveProcessInstance("i1", "p", "second", {});
+    }
+
+    // Corrupts the payload of the second record
+    std::filesystem::path segment;
+    for (const auto& entry : std::filesystem::directory_iterator(directory_)) {
+        segment = entry.path();
+    }
+    {
+        std::fstream file(segment, std::ios::in | std::ios::out | std::ios::binary);
+        std::string header(24, '\0');
+        file.read(&header[0], 4);
+        const std::uint32_t payload = static_cast<std::uint8_t>(header[0]) | static_cast<std::uint8_t>(header[1]) << 8;
+        const std::streamoff second = (24 + payload + 7) / 8 * 8;
+        file.seekp(second + 30);
+        file.put('#');
+    }
+
+    WalStateStore store(directory());
+    EXPECT_EQ(store.loadProcessInstance("i1").current_element, "first");
+    store.saveProcessInstance("i1", "p", "third", {});
+    EXPECT_EQ(store.loadProcessInstance("i1").current_element, "third");
+}
+
+TEST_F(TestWalStateStore, ExecutorRunsOnTheLog) {
+    std::string instanceId;
+    {
+        WalStateStore store(directory());
+        ProcessExecutor executor(store);
+        executor.addProcessDefinition(makeApproval("approval"));
+        instanceId = executor.startProcessById("approval", "{}", [](const std::string&) { return true; });
+        EXPECT_EQ(store.getUserTasks(instanceId).size(), 1u);
+    }
+
+    WalStateStore store(directory());
+    ProcessExecutor executor(store);
+    executor.addProcessDefinition(makeApproval("approval"));
+    ASSERT_TRUE(store.containsProcessInstance(instanceId));
+    EXPECT_EQ(store.loadProcessInstance(instanceId).current_element, "approve");
+    executor.resumeProcess(instanceId, "approved", nullptr);
+    EXPECT_FALSE(store.containsProcessInstance(instanceId));
+}
+
+TEST_F(TestWalStateStore, DestroyingTheStoreWaitsForCompaction) {
+    WalStateStore::Options options;
+    options.segment_size = 4096;
+    options.sync_commits = false;
+    options.flush_interval = std::chrono::milliseconds(1);
+    options.compaction_interval = std::chrono::milliseconds(1);
+    for (int round = 0; round < 20; ++round) {
+        // A quarter of every segment stays live, so compaction copies
+        // records and waits for them while the destructor runs
+        WalStateStore store(directory(), options);
+        for (int i = 0; i < 500; ++i) {
+            store.saveProcessInstance("r" + std::to_string(round) + "-" + std::to_string(i), "p", "wait", {});
+            for (int n = 0; n < 3; ++n) {
+                store.saveProcessInstance("hot", "p", "step", { { "n", std::to_string(round * 1000 + i) } });
+            }
+        }
+    }
+
+    WalStateStore store(directory(), options);
+    EXPECT_EQ(store.stats().instances, 20u * 500u + 1u);
+    EXPECT_EQ(store.loadProcessInstance("hot").variables.at("n"), "19499");
+    EXPECT_EQ(store.loadProcessInstance("r19-499").current_element, "wait");
+}
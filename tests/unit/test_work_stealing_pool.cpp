@@ -0,0 +1,75 @@
+#include <gtest/gtest.h>
+#include <bpmn/work_stealing_pool.h>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <thread>
+
+using namespace bpmn;
+
+TEST(TestWorkStealingPool, RunsAllSubmittedTasks) {
+    std::atomic<int> counter{ 0 };
+    {
+        WorkStealingPool pool(4);
+        for (int i = 0; i < 1000; ++i) {
+            pool.submit([&counter]() { ++counter; });
+        }
+    }
+    EXPECT_EQ(counter.load(), 1000);
+}
+
+TEST(TestWorkStealingPool, NestedForksDoNotBlockSingleWorker) {
+    // Binary fork tree of depth 10: every task submits its children and returns
+    std::atomic<int> leaves{ 0 };
+    WorkStealingPool pool(1);
+    std::function<void(int)> fork = [&](int depth) {
+        if (depth == 0) {
+            ++leaves;
+            return;
+        }
+        pool.submit([&fork, depth]() { fork(depth - 1); });
+        pool.submit([&fork, depth]() { fork(depth - 1); });
+    };
+    pool.submit([&fork]() { fork(10); });
+
+    for (int i = 0; i < 500 && leaves.load() < 1024; ++i) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    EXPECT_EQ(leaves.load(), 1024);
+    // A task counts as executed only after it returns
+    for (int i = 0; i < 500 && pool.stats().executed < pool.stats().submitted; ++i) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    EXPECT_EQ(pool.stats().submitted, 2047u);
+    EXPECT_EQ(pool.stats().executed, 2047u);
+}
+
+TEST(TestWorkStealingPool, IdleWorkersStealFromBusyOne) {
+    std::atomic<int> done{ 0 };
+    WorkStealingPool pool(4);
+    pool.submit([&pool, &done]() {
+        for (int i = 0; i < 64; ++i) {
+            pool.submit([&done]() { ++done; });
+        }
+        // Keep this worker busy so its deque can only be drained by thieves
+        while (done.load() < 64) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+    });
+
+    for (int i = 0; i < 500 && done.load() < 64; ++i) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    EXPECT_EQ(done.load(), 64);
+    EXPECT_EQ(pool.stats().steals, 64u);
+}
+
+TEST(TestWorkStealingPool, ExceptionsDoNotKillWorkers) {
+    std::atomic<int> counter{ 0 };
+    {
+        WorkStealingPool pool(1);
+        pool.submit([]() { throw std::runtime_error("branch failed"); });
+        pool.submit([&counter]() { ++counter; });
+    }
+    EXPECT_EQ(counter.load(), 1);
+}